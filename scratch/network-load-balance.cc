@@ -25,10 +25,19 @@
 #include <ns3/rdma.h>
 #include <ns3/sim-setting.h>
 #include <ns3/switch-node.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <time.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include <fstream>
 #include <iostream>
+#include <set>
+#include <sstream>
 #include <unordered_map>
 
 #include "ns3/applications-module.h"
@@ -37,16 +46,19 @@
 #include "ns3/conweave-voq.h"
 #include "ns3/core-module.h"
 #include "ns3/error-model.h"
+#include "ns3/fluid-flow-model.h"
 #include "ns3/global-route-manager.h"
 #include "ns3/internet-module.h"
 #include "ns3/ipv4-static-routing-helper.h"
 #include "ns3/letflow-routing.h"
 #include "ns3/packet.h"
+#include "ns3/pfc-monitor.h"
 #include "ns3/point-to-point-helper.h"
 #include "ns3/qbb-helper.h"
 #include "ns3/qbb-net-device.h"
 #include "ns3/rdma-hw.h"
 #include "ns3/settings.h"
+#include "ns3/topology-spec.h"
 
 using namespace ns3;
 using namespace std;
@@ -104,6 +116,23 @@ FILE *uplink_output = NULL;
 FILE *conn_output = NULL;
 
 std::string data_rate, link_delay, topology_file, flow_file;
+// binary cache of the topology and its routes, "": none (see TopologyCache)
+std::string topology_cache = "";
+// Chrome trace of the profiled scopes and events, "": none (needs --enable-sim-profiler)
+std::string profile_trace_file = "";
+uint32_t profile_trace_records = 1000000;
+// run statistics as JSON (events, packets, wall time, peak RSS), "": none; read by `waf bench'
+std::string stats_output_file = "";
+// allocate events, packets, QPs and flowlets from slab pools (see SimulationArena)
+bool sim_arena = false;
+// sweep: one worker process per (LB mode, CC mode, load, seed) point, each writing its output
+// files to its own subdirectory of sweep_output_dir, "": single run. An empty list stands for
+// the LB_MODE, CC_MODE, LOAD or RANDOM_SEED of the config; a load replaces "{load}" in FLOW_FILE
+std::string sweep_output_dir = "";
+std::vector<uint32_t> sweep_lb_modes, sweep_cc_modes, sweep_seeds;
+std::vector<std::string> sweep_loads;
+uint32_t sweep_jobs = 0;  // workers at a time, 0: one per core
+double sweep_fct_warmup = 0.005;  // seconds after FLOWGEN_START_TIME left out of the summary
 std::string flow_input_file = "flow.txt";
 std::string fct_output_file = "fct.txt";
 std::string pfc_output_file = "pfc.txt";
@@ -137,6 +166,29 @@ unordered_map<uint64_t, uint32_t> rate2kmax, rate2kmin;
 unordered_map<uint64_t, double> rate2pmax;
 unordered_map<uint32_t, Ptr<SwitchNode>> idxNodeToR;  // Id -> Ptr
 
+// fluid (flow-level) mode for large background flows, 0: disabled
+uint64_t fluid_flow_threshold = 0;  // bytes
+double fluid_max_link_share = 0.9;
+Ptr<FluidFlowModel> fluidModel;
+
+// NIC selection of new QPs on multi-NIC (multi-rail) hosts, see RdmaHw::NicPlacement
+uint32_t nic_placement = 0;
+
+// tick of the per-NIC DCQCN timer wheel, 0: one event per qp and timer (see RdmaHw::MlxTimerTick)
+uint64_t dcqcn_timer_tick = 0;  // ns
+
+// unit of switch buffer accounting (see SwitchMmu::CellSize), 1: bytes
+uint32_t mmu_cell_size = 1;
+
+// switch egress scheduling of queues 1-7 and their weights (see BEgressQueue::SchedulingMode)
+std::string egress_sched = "RR";    // RR, SP, DWRR or WFQ
+std::string egress_weights = "1";  // comma separated from queue 0
+
+// PFC report at the end of the run: pause storms and (periodically checked) deadlocks
+uint64_t pfc_storm_threshold = 1000;     // us
+uint64_t pfc_deadlock_check_interval = 0;  // us, 0: no deadlock check
+Ptr<PfcMonitor> pfcMonitor;
+
 // config of link-down scenario, ACK priority, and buffer
 uint64_t link_down_time = 0;
 uint32_t link_down_A = 0, link_down_B = 0;
@@ -158,21 +210,28 @@ struct Interface {
 
     Interface() : idx(0), up(false) {}
 };
-map<Ptr<Node>, map<Ptr<Node>, Interface>> nbr2if;
+// neighbours in node id order, so that routes (and the ECMP order of next hops) do not
+// depend on where the nodes were allocated
+struct NodeIdLess {
+    bool operator()(const Ptr<Node> &a, const Ptr<Node> &b) const {
+        return a->GetId() < b->GetId();
+    }
+};
+map<Ptr<Node>, map<Ptr<Node>, Interface, NodeIdLess>, NodeIdLess> nbr2if;
 // Mapping destination to next hop for each node: <node, <dest, <nexthop0, ...> > >
-map<Ptr<Node>, map<Ptr<Node>, vector<Ptr<Node>>>> nextHop;
-map<Ptr<Node>, map<Ptr<Node>, uint64_t>> pairDelay;
-map<Ptr<Node>, map<Ptr<Node>, uint64_t>> pairTxDelay;
-map<Ptr<Node>, map<Ptr<Node>, uint64_t>> pairBw;
-map<Ptr<Node>, map<Ptr<Node>, uint64_t>> pairBdp;
-map<Ptr<Node>, map<Ptr<Node>, uint64_t>> pairRtt;
+map<Ptr<Node>, map<Ptr<Node>, vector<Ptr<Node>>, NodeIdLess>, NodeIdLess> nextHop;
+map<Ptr<Node>, map<Ptr<Node>, uint64_t, NodeIdLess>, NodeIdLess> pairDelay;
+map<Ptr<Node>, map<Ptr<Node>, uint64_t, NodeIdLess>, NodeIdLess> pairTxDelay;
+map<Ptr<Node>, map<Ptr<Node>, uint64_t, NodeIdLess>, NodeIdLess> pairBw;
+map<Ptr<Node>, map<Ptr<Node>, uint64_t, NodeIdLess>, NodeIdLess> pairBdp;
+map<Ptr<Node>, map<Ptr<Node>, uint64_t, NodeIdLess>, NodeIdLess> pairRtt;
 
 // for uplink/Downlink monitoring at TOR switches (load balance performance)
 std::map<uint32_t, std::vector<uint32_t>> torId2UplinkIf;
 std::map<uint32_t, std::vector<uint32_t>> torId2DownlinkIf;
 
 // input files
-std::ifstream topof, flowf;
+std::ifstream flowf;
 NodeContainer n;                         // node container
 std::vector<Ipv4Address> serverAddress;  // server address
 
@@ -209,6 +268,62 @@ void ReadFlowInput() {
     }
 }
 
+/**
+ * @brief Fluid flows: bookkeeping for FCT output (keyed by flow index)
+ */
+struct FluidFlowRecord {
+    uint32_t src, dst, sport, dport;
+    uint64_t size;
+    Time startTime;
+};
+std::unordered_map<uint32_t, FluidFlowRecord> fluidFlows;
+
+void fluid_finish(FILE *fout, uint32_t idx) {
+    auto it = fluidFlows.find(idx);
+    assert(it != fluidFlows.end());
+    const FluidFlowRecord &f = it->second;
+    uint64_t base_rtt = pairRtt[n.Get(f.src)][n.Get(f.dst)];
+    uint64_t b = pairBw[n.Get(f.src)][n.Get(f.dst)];
+    uint64_t total_bytes = f.size + ((f.size - 1) / packet_payload_size + 1) *
+                                        (CustomHeader::GetStaticWholeHeaderSize() -
+                                         IntHeader::GetStaticSize());
+    uint64_t standalone_fct = base_rtt + total_bytes * 8000000000lu / b;
+    // same format as qp_finish, so post-processing treats both alike
+    fprintf(fout, "%u %u %u %u %lu %lu %lu %lu\n", f.src, f.dst, f.sport, f.dport, f.size,
+            f.startTime.GetTimeStep(), (Simulator::Now() - f.startTime).GetTimeStep(),
+            standalone_fct);
+    Settings::cnt_finished_flows++;
+    fflush(fout);
+    fluidFlows.erase(it);
+}
+
+/**
+ * @brief Start a flow at flow level: pin it to an ECMP path and hand it to the fluid model
+ */
+void StartFluidFlow(uint32_t src, uint32_t dst, uint32_t sport, uint32_t dport,
+                    uint64_t size) {
+    Ptr<Node> dstNode = n.Get(dst);
+    std::vector<Ptr<QbbNetDevice>> path;
+    uint32_t hash = src * 2654435761u ^ dst * 40503u ^ (sport << 16 | dport);
+    for (Ptr<Node> cur = n.Get(src); cur != dstNode;) {
+        auto &nexts = nextHop[cur][dstNode];
+        assert(!nexts.empty());
+        Ptr<Node> next = nexts[hash % nexts.size()];
+        path.push_back(DynamicCast<QbbNetDevice>(cur->GetDevice(nbr2if[cur][next].idx)));
+        hash = hash * 2654435761u + cur->GetId();
+        cur = next;
+    }
+
+    uint64_t wire_bytes = size + ((size - 1) / packet_payload_size + 1) *
+                                     (CustomHeader::GetStaticWholeHeaderSize() -
+                                      IntHeader::GetStaticSize());
+    FluidFlowRecord rec = {src, dst, sport, dport, size, Simulator::Now()};
+    fluidFlows[flow_input.idx] = rec;
+    fluidModel->AddFlow(flow_input.idx, wire_bytes, path,
+                        NanoSeconds(pairDelay[n.Get(src)][dstNode]),
+                        MakeBoundCallback(&fluid_finish, fct_output));
+}
+
 /**
  * Scheduling flows given in /config/L_XX....txt file
  */
@@ -269,6 +384,13 @@ void ScheduleFlowInputs(FILE *infile) {
             assert(false);
         }
 
+        if (fluid_flow_threshold > 0 && target_len >= fluid_flow_threshold) {
+            StartFluidFlow(src, dst, sport, dport, target_len);
+            flow_input.idx++;
+            ReadFlowInput();
+            continue;
+        }
+
         RdmaClientHelper clientHelper(
             pg, serverAddress[src], serverAddress[dst], sport, dport, target_len,
             has_win ? (global_t == 1 ? maxBdp : pairBdp[n.Get(src)][n.Get(dst)]) : 0,
@@ -334,10 +456,10 @@ void periodic_monitoring(FILE *fout_voq, FILE *fout_voq_detail, FILE *fout_uplin
 
             // monitor VOQ per destination IP <time, dstip, #VOQ, #Pkts>
             std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> dip_to_nvoq_npkt;
-            for (auto voq : swNode->m_mmu->m_conweaveRouting.GetVOQMap()) {
-                auto &nvoq_npkt = dip_to_nvoq_npkt[voq.second.getDIP()];
+            for (const auto &voq : swNode->m_mmu->m_conweaveRouting.GetVOQMap()) {
+                auto &nvoq_npkt = dip_to_nvoq_npkt[voq.second->getDIP()];
                 nvoq_npkt.first += 1;
-                nvoq_npkt.second += voq.second.getQueueSize();
+                nvoq_npkt.second += voq.second->getQueueSize();
             }
             for (auto x : dip_to_nvoq_npkt) {
                 fprintf(fout_voq_detail, "%lu,%u,%u,%u\n", now, x.first, x.second.first,
@@ -590,10 +712,10 @@ void CalculateRoute(Ptr<Node> host) {
     // queue for the BFS.
     vector<Ptr<Node>> q;
     // Distance from the host to each node.
-    map<Ptr<Node>, int> dis;
-    map<Ptr<Node>, uint64_t> delay;
-    map<Ptr<Node>, uint64_t> txDelay;
-    map<Ptr<Node>, uint64_t> bw;
+    map<Ptr<Node>, int, NodeIdLess> dis;
+    map<Ptr<Node>, uint64_t, NodeIdLess> delay;
+    map<Ptr<Node>, uint64_t, NodeIdLess> txDelay;
+    map<Ptr<Node>, uint64_t, NodeIdLess> bw;
     // init BFS.
     q.push_back(host);
     dis[host] = 0;
@@ -647,6 +769,58 @@ void CalculateRoutes(NodeContainer &n) {
     }
 }
 
+/**
+ * @brief Routes of CalculateRoutes in node ids, for the topology cache
+ */
+void ExportRoutes(TopologyRoutes &routes) {
+    for (auto &i : pairDelay) {
+        for (auto &j : i.second) {
+            TopologyRoutes::Entry e;
+            e.node = i.first->GetId();
+            e.host = j.first->GetId();
+            e.delay = j.second;
+            e.txDelay = pairTxDelay[i.first][j.first];
+            e.bw = pairBw[i.first][j.first];
+            auto nexts = nextHop[i.first].find(j.first);
+            if (nexts != nextHop[i.first].end()) {
+                for (auto next : nexts->second) e.nexts.push_back(next->GetId());
+            }
+            routes.entries.push_back(e);
+        }
+    }
+}
+void RestoreRoutes(NodeContainer &n, const TopologyRoutes &routes) {
+    for (auto &e : routes.entries) {
+        Ptr<Node> node = n.Get(e.node), host = n.Get(e.host);
+        pairDelay[node][host] = e.delay;
+        pairTxDelay[node][host] = e.txDelay;
+        pairBw[node][host] = e.bw;
+        if (e.nexts.empty()) continue;
+        vector<Ptr<Node>> &nexts = nextHop[node][host];
+        for (auto next : e.nexts) nexts.push_back(n.Get(next));
+    }
+}
+
+/**
+ * @brief ToR-to-ToR paths for the load balancers: DFS over the shortest-path DAG towards host
+ * dst (nextHop) from cur until the ToR of dst, any number of tiers. Each path is the list of
+ * egress ports from the source ToR.
+ */
+void EnumerateToRPaths(Ptr<Node> cur, Ptr<Node> dst, uint32_t dstToRId, vector<uint32_t> &ports,
+                       vector<vector<uint32_t>> &paths) {
+    auto nexts = nextHop[cur].find(dst);
+    if (nexts == nextHop[cur].end()) return;
+    for (auto next : nexts->second) {
+        ports.push_back(nbr2if[cur][next].idx);
+        if (next->GetId() == dstToRId) {
+            paths.push_back(ports);
+        } else if (next->GetNodeType() == 1) {  // never through a host
+            EnumerateToRPaths(next, dst, dstToRId, ports, paths);
+        }
+        ports.pop_back();
+    }
+}
+
 /**
  * @brief Set the Routing Entries object
  */
@@ -715,6 +889,283 @@ uint64_t get_nic_rate(NodeContainer &n) {
     return avg_nic_rate / n_servers;
 }
 
+struct RunStats {
+    uint64_t events;    // simulator events executed
+    Time simTime;       // simulated time at the end of the run
+    double setupS;      // wall time of the configuration, topology and routes
+    double runS;        // wall time of Simulator::Run
+    double destroyS;    // wall time of Simulator::Destroy
+};
+
+// one JSON object, so runs can be compared per commit (see `waf bench')
+void write_run_stats(const std::string &file, const RunStats &s) {
+    FILE *f = fopen(file.c_str(), "w");
+    if (f == NULL) {
+        std::cerr << "Cannot write the run statistics to " << file << std::endl;
+        return;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(f,
+            "{\"events\": %lu, \"nic_pkts\": %lu, \"switch_pkts\": %lu, \"flows\": %u, "
+            "\"finished_flows\": %u, \"sim_time_ns\": %ld, \"setup_s\": %.6f, "
+            "\"run_s\": %.6f, \"destroy_s\": %.6f, \"peak_rss_kb\": %ld, \"buffers\": %lu, "
+            "\"buffer_reallocs\": %lu}\n",
+            (unsigned long)s.events, (unsigned long)RdmaHw::nAllPkts,
+            (unsigned long)SwitchNode::nRxPkts, flow_num, (uint32_t)Settings::cnt_finished_flows,
+            (long)s.simTime.GetNanoSeconds(), s.setupS, s.runS, s.destroyS,
+            (long)usage.ru_maxrss, (unsigned long)Buffer::GetNBuffers(),
+            (unsigned long)Buffer::GetNReallocations());
+    fclose(f);
+}
+
+/**
+ * @brief sweep executor
+ *
+ * The parent loads the topology (and its routes, through TOPOLOGY_CACHE) once, then forks one
+ * worker per point, at most sweep_jobs at a time. A worker inherits the loaded topology
+ * copy-on-write and goes on as a single run with the point's parameters, so its output is that
+ * of the same config run alone. Workers start before any simulation object or random draw.
+ */
+struct SweepPoint {
+    uint32_t lbMode;
+    uint32_t ccMode;
+    std::string load;
+    uint32_t seed;
+    std::string name;  // subdirectory of sweep_output_dir
+    bool skipped;      // not a valid combination
+    pid_t pid;
+    int status;  // as from waitpid, -1: not run
+    std::chrono::steady_clock::time_point start;
+    double wallS;
+};
+
+template <typename T>
+void read_sweep_list(std::ifstream &conf, const char *key, std::vector<T> &values) {
+    int n;
+    conf >> n;
+    std::cerr << key << "\t\t\t";
+    values.resize(n);
+    for (int i = 0; i < n; i++) {
+        conf >> values[i];
+        std::cerr << ' ' << values[i];
+    }
+    std::cerr << '\n';
+}
+
+std::vector<SweepPoint> make_sweep_points() {
+    std::ostringstream configLoad;
+    configLoad << load;
+    std::vector<uint32_t> lbModes = sweep_lb_modes, ccModes = sweep_cc_modes,
+                          seeds = sweep_seeds;
+    std::vector<std::string> loads = sweep_loads;
+    if (lbModes.empty()) lbModes.push_back(lb_mode);
+    if (ccModes.empty()) ccModes.push_back(cc_mode);
+    if (loads.empty()) loads.push_back(configLoad.str());
+    if (seeds.empty()) seeds.push_back(random_seed);
+
+    std::vector<SweepPoint> points;
+    for (uint32_t lb : lbModes) {
+        for (uint32_t cc : ccModes) {
+            for (const std::string &l : loads) {
+                for (uint32_t seed : seeds) {
+                    SweepPoint p;
+                    p.lbMode = lb;
+                    p.ccMode = cc;
+                    p.load = l;
+                    p.seed = seed;
+                    std::ostringstream name;
+                    name << "lb" << lb << "_cc" << cc << "_load" << l << "_seed" << seed;
+                    p.name = name.str();
+                    p.skipped = (lb == 9 && cc != 1);  // ConWeave runs with DCQCN only
+                    p.pid = 0;
+                    p.status = -1;
+                    p.wallS = 0;
+                    points.push_back(p);
+                }
+            }
+        }
+    }
+    return points;
+}
+
+std::string sweep_output_path(const SweepPoint &p, const std::string &file) {
+    size_t slash = file.find_last_of('/');
+    return sweep_output_dir + "/" + p.name + "/" +
+           (slash == std::string::npos ? file : file.substr(slash + 1));
+}
+
+// in the worker: the point's parameters and output files, as if they were in the config
+void apply_sweep_point(const SweepPoint &p) {
+    lb_mode = p.lbMode;
+    if (!sweep_cc_modes.empty()) {
+        cc_mode = p.ccMode;
+        // window for HPCC and DCTCP, as run.py
+        has_win = var_win = (cc_mode == 3 || cc_mode == 8);
+    }
+    load = atof(p.load.c_str());
+    random_seed = p.seed;
+    size_t at = flow_file.find("{load}");
+    if (at != std::string::npos) flow_file.replace(at, strlen("{load}"), p.load);
+
+    std::string dir = sweep_output_dir + "/" + p.name;
+    mkdir(dir.c_str(), 0755);
+    std::string *outputs[] = {&flow_input_file,       &fct_output_file,   &pfc_output_file,
+                              &cnp_output_file,       &qlen_mon_file,     &voq_mon_file,
+                              &voq_mon_detail_file,   &uplink_mon_file,   &conn_mon_file,
+                              &est_error_output_file, &stats_output_file, &profile_trace_file};
+    for (std::string *file : outputs) {
+        if (!file->empty()) *file = sweep_output_path(p, *file);
+    }
+    std::string log = dir + "/log.txt";
+    if (freopen(log.c_str(), "w", stdout) == NULL || freopen(log.c_str(), "a", stderr) == NULL) {
+        exit(1);
+    }
+}
+
+struct FctSummary {
+    uint32_t flows;
+    double meanFctUs;
+    double meanSlowdown, p50Slowdown, p95Slowdown, p99Slowdown;
+};
+
+// the flows fctAnalysis.py counts as run.py calls it: started after the warm-up, finished
+// within 50 ms of the end of the flow generation; slowdown at least 1
+bool summarize_fct(const std::string &file, FctSummary &sum) {
+    std::ifstream in(file.c_str());
+    if (!in.is_open()) return false;
+    uint64_t begin = (uint64_t)((flowgen_start_time + sweep_fct_warmup) * 1e9);
+    uint64_t end = (uint64_t)(flowgen_stop_time * 1e9) + 50000000;
+    std::vector<double> slowdowns;
+    double fctSum = 0, slowdownSum = 0;
+    uint32_t sid, did, sport, dport;
+    uint64_t size, startTs, fct, standaloneFct;
+    while (in >> sid >> did >> sport >> dport >> size >> startTs >> fct >> standaloneFct) {
+        if (startTs <= begin || startTs + fct >= end) continue;
+        double slowdown = std::max(1.0, (double)fct / std::max(standaloneFct, (uint64_t)1));
+        slowdowns.push_back(slowdown);
+        fctSum += fct / 1000.0;
+        slowdownSum += slowdown;
+    }
+    sum.flows = slowdowns.size();
+    if (slowdowns.empty()) {
+        sum.meanFctUs = sum.meanSlowdown = sum.p50Slowdown = sum.p95Slowdown = sum.p99Slowdown = 0;
+        return true;
+    }
+    std::sort(slowdowns.begin(), slowdowns.end());
+    sum.meanFctUs = fctSum / slowdowns.size();
+    sum.meanSlowdown = slowdownSum / slowdowns.size();
+    sum.p50Slowdown = slowdowns[(size_t)(slowdowns.size() * 0.50)];
+    sum.p95Slowdown = slowdowns[(size_t)(slowdowns.size() * 0.95)];
+    sum.p99Slowdown = slowdowns[(size_t)(slowdowns.size() * 0.99)];
+    return true;
+}
+
+// one line per point, to stdout and sweep_output_dir/summary.txt; returns the failed points
+uint32_t print_sweep_summary(const std::vector<SweepPoint> &points) {
+    std::string file = sweep_output_dir + "/summary.txt";
+    FILE *out = fopen(file.c_str(), "w");
+    FILE *outs[] = {stdout, out};
+    uint32_t failed = 0;
+    for (FILE *f : outs) {
+        if (f == NULL) continue;
+        fprintf(f, "%-8s %-8s %-8s %-8s %-8s %8s %12s %9s %9s %9s %9s %9s\n", "lb_mode",
+                "cc_mode", "load", "seed", "status", "flows", "avg_fct_us", "avg_sd", "p50_sd",
+                "p95_sd", "p99_sd", "wall_s");
+    }
+    for (const SweepPoint &p : points) {
+        FctSummary sum;
+        std::string status;
+        if (p.skipped) {
+            status = "skipped";
+        } else if (p.status == -1 || !WIFEXITED(p.status) || WEXITSTATUS(p.status) != 0) {
+            status = "failed";
+            failed++;
+        } else if (!summarize_fct(sweep_output_path(p, fct_output_file), sum)) {
+            status = "no_fct";
+            failed++;
+        } else {
+            status = "ok";
+        }
+        for (FILE *f : outs) {
+            if (f == NULL) continue;
+            fprintf(f, "%-8u %-8u %-8s %-8u %-8s", p.lbMode, p.ccMode, p.load.c_str(), p.seed,
+                    status.c_str());
+            if (status == "ok") {
+                fprintf(f, " %8u %12.2f %9.3f %9.3f %9.3f %9.3f %9.1f\n", sum.flows,
+                        sum.meanFctUs, sum.meanSlowdown, sum.p50Slowdown, sum.p95Slowdown,
+                        sum.p99Slowdown, p.wallS);
+            } else {
+                fprintf(f, "\n");
+            }
+        }
+    }
+    if (out != NULL) fclose(out);
+    return failed;
+}
+
+/**
+ * Runs the sweep. Returns true in a worker, set up to go on as the single run of its point;
+ * false in the parent once every point finished, with the exit code of the sweep.
+ */
+bool run_sweep(TopologySpec &topo, TopologyRoutes &routes, uint64_t topoCacheKey, bool &topoCached,
+               int &exitCode) {
+    mkdir(sweep_output_dir.c_str(), 0755);
+    std::vector<SweepPoint> points = make_sweep_points();
+    uint32_t jobs = sweep_jobs;
+    if (jobs == 0) jobs = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    // on a cache miss, the first worker computes the routes and fills the cache for the others
+    bool fillCache = !topoCached && !topology_cache.empty();
+    std::cout << "Sweep of " << points.size() << " points, " << jobs << " at a time, to "
+              << sweep_output_dir << std::endl;
+
+    size_t next = 0, done = 0;
+    uint32_t running = 0;
+    while (next < points.size() || running > 0) {
+        while (next < points.size() && running < (fillCache ? 1 : jobs)) {
+            SweepPoint &p = points[next++];
+            if (p.skipped) continue;
+            fflush(stdout);
+            fflush(stderr);
+            p.start = std::chrono::steady_clock::now();
+            pid_t pid = fork();
+            if (pid == 0) {
+                apply_sweep_point(p);
+                return true;
+            } else if (pid < 0) {
+                std::cerr << "Cannot fork the worker of " << p.name << std::endl;
+                continue;
+            }
+            p.pid = pid;
+            running++;
+        }
+        if (running == 0) break;
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (SweepPoint &p : points) {
+            if (p.pid != pid) continue;
+            p.status = status;
+            p.wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - p.start)
+                          .count();
+            running--;
+            done++;
+            std::cout << "[" << done << "/" << points.size() << "] " << p.name
+                      << (WIFEXITED(status) && WEXITSTATUS(status) == 0 ? " done" : " FAILED")
+                      << " in " << p.wallS << " s" << std::endl;
+        }
+        if (fillCache) {
+            fillCache = false;
+            topoCached = TopologyCache::Load(topology_cache, topoCacheKey, topo, routes);
+        }
+    }
+    exitCode = print_sweep_summary(points) == 0 ? 0 : 1;
+    return false;
+}
+
 /************************************************************************/
 //                                                                      //
 //                                M A I N                               //
@@ -725,6 +1176,7 @@ int main(int argc, char *argv[]) {
     uint32_t *workload_cdf = nullptr;
     clock_t begint, endt;
     begint = clock();
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
 #ifndef PGO_TRAINING
     if (argc > 1)
 #else
@@ -1077,11 +1529,71 @@ int main(int argc, char *argv[]) {
                 conf >> v;
                 enable_irn = v;
                 std::cerr << "ENABLE_IRN\t\t" << enable_irn << "\n";
+            } else if (key.compare("FLUID_FLOW_THRESHOLD") == 0) {
+                conf >> fluid_flow_threshold;
+                std::cerr << "FLUID_FLOW_THRESHOLD\t\t" << fluid_flow_threshold << "\n";
+            } else if (key.compare("FLUID_MAX_LINK_SHARE") == 0) {
+                conf >> fluid_max_link_share;
+                std::cerr << "FLUID_MAX_LINK_SHARE\t\t" << fluid_max_link_share << "\n";
+            } else if (key.compare("NIC_PLACEMENT") == 0) {
+                conf >> nic_placement;
+                std::cerr << "NIC_PLACEMENT\t\t" << nic_placement << "\n";
+            } else if (key.compare("DCQCN_TIMER_TICK") == 0) {
+                conf >> dcqcn_timer_tick;
+                std::cerr << "DCQCN_TIMER_TICK\t\t" << dcqcn_timer_tick << "\n";
+            } else if (key.compare("MMU_CELL_SIZE") == 0) {
+                conf >> mmu_cell_size;
+                std::cerr << "MMU_CELL_SIZE\t\t" << mmu_cell_size << "\n";
+            } else if (key.compare("EGRESS_SCHED") == 0) {
+                conf >> egress_sched;
+                std::cerr << "EGRESS_SCHED\t\t" << egress_sched << "\n";
+            } else if (key.compare("EGRESS_WEIGHTS") == 0) {
+                conf >> egress_weights;
+                std::cerr << "EGRESS_WEIGHTS\t\t" << egress_weights << "\n";
+            } else if (key.compare("PFC_STORM_THRESHOLD") == 0) {
+                conf >> pfc_storm_threshold;
+                std::cerr << "PFC_STORM_THRESHOLD\t\t" << pfc_storm_threshold << "\n";
+            } else if (key.compare("PFC_DEADLOCK_CHECK_INTERVAL") == 0) {
+                conf >> pfc_deadlock_check_interval;
+                std::cerr << "PFC_DEADLOCK_CHECK_INTERVAL\t\t" << pfc_deadlock_check_interval
+                          << "\n";
+            } else if (key.compare("TOPOLOGY_CACHE") == 0) {
+                conf >> topology_cache;
+                std::cerr << "TOPOLOGY_CACHE\t\t\t" << topology_cache << "\n";
+            } else if (key.compare("PROFILE_TRACE_FILE") == 0) {
+                conf >> profile_trace_file;
+                std::cerr << "PROFILE_TRACE_FILE\t\t" << profile_trace_file << "\n";
+            } else if (key.compare("PROFILE_TRACE_RECORDS") == 0) {
+                conf >> profile_trace_records;
+                std::cerr << "PROFILE_TRACE_RECORDS\t\t" << profile_trace_records << "\n";
+            } else if (key.compare("STATS_OUTPUT_FILE") == 0) {
+                conf >> stats_output_file;
+                std::cerr << "STATS_OUTPUT_FILE\t\t" << stats_output_file << "\n";
+            } else if (key.compare("SIM_ARENA") == 0) {
+                conf >> sim_arena;
+                std::cerr << "SIM_ARENA\t\t\t" << sim_arena << "\n";
             } else if (key.compare("RANDOM_SEED") == 0) {
                 int v;
                 conf >> v;
                 random_seed = v;
                 std::cerr << "RANDOM_SEED\t\t\t" << random_seed << "\n";
+            } else if (key.compare("SWEEP_OUTPUT_DIR") == 0) {
+                conf >> sweep_output_dir;
+                std::cerr << "SWEEP_OUTPUT_DIR\t\t" << sweep_output_dir << "\n";
+            } else if (key.compare("SWEEP_FCT_WARMUP") == 0) {
+                conf >> sweep_fct_warmup;
+                std::cerr << "SWEEP_FCT_WARMUP\t\t" << sweep_fct_warmup << "\n";
+            } else if (key.compare("SWEEP_JOBS") == 0) {
+                conf >> sweep_jobs;
+                std::cerr << "SWEEP_JOBS\t\t\t" << sweep_jobs << "\n";
+            } else if (key.compare("SWEEP_LB_MODE") == 0) {
+                read_sweep_list(conf, "SWEEP_LB_MODE", sweep_lb_modes);
+            } else if (key.compare("SWEEP_CC_MODE") == 0) {
+                read_sweep_list(conf, "SWEEP_CC_MODE", sweep_cc_modes);
+            } else if (key.compare("SWEEP_LOAD") == 0) {
+                read_sweep_list(conf, "SWEEP_LOAD", sweep_loads);
+            } else if (key.compare("SWEEP_SEED") == 0) {
+                read_sweep_list(conf, "SWEEP_SEED", sweep_seeds);
             }
 
             fflush(stdout);
@@ -1096,6 +1608,42 @@ int main(int argc, char *argv[]) {
 
     /******************* READING CONFIG FILE IS DONE ***********************/
 
+    /**
+     * @brief open topology config, once for all the points of a sweep
+     */
+    TopologySpec topo;
+    TopologyRoutes cachedRoutes;
+    uint64_t topo_cache_key = 0;
+    bool topo_cached = false;
+    if (!topology_cache.empty()) {
+        // the routes depend on the packet size as well (txDelay)
+        if (!TopologyCache::SourceKey(topology_file, packet_payload_size, topo_cache_key)) {
+            NS_FATAL_ERROR("Cannot read the topology " << topology_file);
+        }
+        topo_cached = TopologyCache::Load(topology_cache, topo_cache_key, topo, cachedRoutes);
+        std::cout << "Topology cache " << topology_cache << (topo_cached ? ": hit" : ": miss")
+                  << std::endl;
+    }
+    if (!topo_cached) {
+        std::string err;
+        bool ok = TopologySpec::IsGeneratorSpec(topology_file)
+                      ? TopologySpec::Generate(topology_file, topo, &err)
+                      : topo.LoadFile(topology_file, &err);
+        if (!ok) {
+            NS_FATAL_ERROR("Topology: " << err);
+        }
+    }
+
+    /**
+     * @brief sweep: from here on, each worker is the single run of its point
+     */
+    if (!sweep_output_dir.empty()) {
+        int exitCode = 0;
+        if (!run_sweep(topo, cachedRoutes, topo_cache_key, topo_cached, exitCode)) {
+            return exitCode;
+        }
+    }
+
     /**
      * Activate ns3 logging
      */
@@ -1107,6 +1655,8 @@ int main(int argc, char *argv[]) {
     NS_LOG_INFO("Initialize random seed: " << random_seed);
     srand((unsigned)random_seed);
     SeedManager::SetSeed(random_seed);
+    // before the first event or packet: the arena is fixed at the first pooled allocation
+    GlobalValue::Bind("SimulationArena", BooleanValue(sim_arena));
 
     /**
      * @brief PFC/QCN setup
@@ -1116,6 +1666,19 @@ int main(int argc, char *argv[]) {
     Config::SetDefault("ns3::QbbNetDevice::QcnEnabled", BooleanValue(enable_qcn));
     Config::SetDefault("ns3::QbbNetDevice::DynamicThreshold", BooleanValue(dynamicth));
     Config::SetDefault("ns3::QbbNetDevice::QbbEnabled", BooleanValue(enable_pfc));
+    Config::SetDefault("ns3::BEgressQueue::SchedulingMode", StringValue(egress_sched));
+    Config::SetDefault("ns3::BEgressQueue::Weights", StringValue(egress_weights));
+    Config::SetDefault("ns3::PfcMonitor::StormThreshold",
+                       TimeValue(MicroSeconds(pfc_storm_threshold)));
+    Config::SetDefault("ns3::PfcMonitor::CheckInterval",
+                       TimeValue(MicroSeconds(pfc_deadlock_check_interval)));
+
+    {
+        std::string err;
+        if (!topo.SupportsLbMode(lb_mode, &err)) {
+            NS_FATAL_ERROR("Topology: " << err);
+        }
+    }
 
     if (cc_mode != 1 && lb_mode == 9) {
         std::cout << "Currently, ConWeave supports only DCQCN congestion control for RDMA. \nIf "
@@ -1137,12 +1700,11 @@ int main(int argc, char *argv[]) {
         IntHeader::mode = 5;
 
     /**
-     * @brief open topology config, input-flows config.
+     * @brief open input-flows config.
      */
-    topof.open(topology_file.c_str());
     flowf.open(flow_file.c_str());
-    uint32_t node_num, switch_num, link_num;
-    topof >> node_num >> switch_num >> link_num;
+    uint32_t node_num = topo.nNodes, switch_num = topo.GetNSwitches(),
+             link_num = topo.links.size();
     flowf >> flow_num;
 
     /*-------Parameter of Settings-------*/
@@ -1154,14 +1716,8 @@ int main(int argc, char *argv[]) {
     // Settings::MTU = packet_payload_size + 48;  // for simplicity
     /*------------------------------------*/
 
-    std::vector<uint32_t> node_type(node_num, 0);
-    for (uint32_t i = 0; i < switch_num; i++) {
-        uint32_t sid;
-        topof >> sid;
-        node_type[sid] = 1;
-    }
     for (uint32_t i = 0; i < node_num; i++) {
-        if (node_type[i] == 0)
+        if (!topo.isSwitch[i])
             n.Add(CreateObject<Node>());
         else {
             Ptr<SwitchNode> sw = CreateObject<SwitchNode>();
@@ -1199,15 +1755,16 @@ int main(int argc, char *argv[]) {
     rem->SetAttribute("ErrorUnit", StringValue("ERROR_UNIT_PACKET"));
 
     pfc_file = fopen(pfc_output_file.c_str(), "w");
+    pfcMonitor = CreateObject<PfcMonitor>();
 
     QbbHelper qbb;
     Ipv4AddressHelper ipv4;
     std::vector<std::pair<uint32_t, uint32_t>> link_pairs;  // src, dst link pairs
     for (uint32_t i = 0; i < link_num; i++) {
-        uint32_t src, dst;
-        std::string data_rate, link_delay;
-        double error_rate;
-        topof >> src >> dst >> data_rate >> link_delay >> error_rate;
+        const TopologyLink &link = topo.links[i];
+        uint32_t src = link.src, dst = link.dst;
+        const std::string &data_rate = link.rate, &link_delay = link.delay;
+        double error_rate = link.errorRate;
 
         /** ASSUME: fixed one-hop delay across network */
         assert(std::to_string(one_hop_delay) + "ns" == link_delay);
@@ -1235,17 +1792,19 @@ int main(int argc, char *argv[]) {
         // Assigne server IP
         // Note: this should be before the automatic assignment below (ipv4.Assign(d)),
         // because we want our IP to be the primary IP (first in the IP address list),
-        // so that the global routing is based on our IP
+        // so that the global routing is based on our IP.
+        // A host listed in several links is a multi-NIC (multi-rail) host: every NIC carries
+        // the same server IP, and RdmaHw spreads its QPs over them.
         NetDeviceContainer d = qbb.Install(snode, dnode);
         if (snode->GetNodeType() == 0) {
             Ptr<Ipv4> ipv4 = snode->GetObject<Ipv4>();
-            ipv4->AddInterface(d.Get(0));
-            ipv4->AddAddress(1, Ipv4InterfaceAddress(serverAddress[src], Ipv4Mask(0xff000000)));
+            uint32_t intf = ipv4->AddInterface(d.Get(0));
+            ipv4->AddAddress(intf, Ipv4InterfaceAddress(serverAddress[src], Ipv4Mask(0xff000000)));
         }
         if (dnode->GetNodeType() == 0) {
             Ptr<Ipv4> ipv4 = dnode->GetObject<Ipv4>();
-            ipv4->AddInterface(d.Get(1));
-            ipv4->AddAddress(1, Ipv4InterfaceAddress(serverAddress[dst], Ipv4Mask(0xff000000)));
+            uint32_t intf = ipv4->AddInterface(d.Get(1));
+            ipv4->AddAddress(intf, Ipv4InterfaceAddress(serverAddress[dst], Ipv4Mask(0xff000000)));
         }
 
         // used to create a graph of the topology
@@ -1271,6 +1830,9 @@ int main(int argc, char *argv[]) {
         ipv4.SetBase(ipstring, "255.255.255.0");
         ipv4.Assign(d);
 
+        pfcMonitor->AddDevice(DynamicCast<QbbNetDevice>(d.Get(0)));
+        pfcMonitor->AddDevice(DynamicCast<QbbNetDevice>(d.Get(1)));
+
         // setup PFC trace
         DynamicCast<QbbNetDevice>(d.Get(0))->TraceConnectWithoutContext(
             "QbbPfc", MakeBoundCallback(&get_pfc, pfc_file, DynamicCast<QbbNetDevice>(d.Get(0))));
@@ -1289,16 +1851,17 @@ int main(int argc, char *argv[]) {
                 printf("size of serverAddress: %lu", serverAddress.size());
                 NS_FATAL_ERROR("An end-host belongs to no link");
             }
+            Settings::AddHost(i, serverAddress[i].Get());
         }
-        Settings::hostId2IpMap[i] = serverAddress[i].Get();
-        Settings::hostIp2IdMap[serverAddress[i].Get()] = i;
     }
+    Settings::BuildHostIndex();
 
     // config switch
     for (uint32_t i = 0; i < node_num; i++) {
         if (n.Get(i)->GetNodeType() == 1) {  // is switch
             Ptr<SwitchNode> sw = DynamicCast<SwitchNode>(n.Get(i));
             uint32_t shift = 3;  // by default 1/8
+            sw->m_mmu->SetCellSize(mmu_cell_size);
             for (uint32_t j = 1; j < sw->GetNDevices(); j++) {
                 Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(sw->GetDevice(j));
                 // set ecn
@@ -1379,9 +1942,8 @@ int main(int argc, char *argv[]) {
         }
     }
     if (found_topo2bdpMap == false) {
-        std::cout << __FILE__ << "(" << __LINE__ << ")"
-                  << " ERROR - topo2bdpMap has no matched item with " << topology_file << std::endl;
-        assert(false);
+        std::cout << "topo2bdpMap has no item for " << topology_file
+                  << ", IRN BDP is the largest BDP of the topology" << std::endl;
     }
 
     // rdmaHw config
@@ -1416,6 +1978,8 @@ int main(int argc, char *argv[]) {
             rdmaHw->SetAttribute("IrnRtoHigh", TimeValue(MicroSeconds(320)));  // 1930
             rdmaHw->SetAttribute("IrnRtoLow", TimeValue(MicroSeconds(100)));   // 454
             rdmaHw->SetAttribute("IrnBdp", UintegerValue(irn_bdp_lookup));
+            rdmaHw->SetAttribute("NicPlacement", UintegerValue(nic_placement));
+            rdmaHw->SetAttribute("MlxTimerTick", TimeValue(NanoSeconds(dcqcn_timer_tick)));
             // Monitoring CNP Marking frequency of DCQCN
             if (cc_mode == 1) {
                 Simulator::Schedule(NanoSeconds(cnp_mon_start), &cnp_freq_monitoring, cnp_output,
@@ -1432,6 +1996,13 @@ int main(int argc, char *argv[]) {
             rdma->Init();
             rdma->TraceConnectWithoutContext("QpComplete",
                                              MakeBoundCallback(qp_finish, fct_output));
+            static bool footprint_reported = false;  // same CC on every host
+            if (!footprint_reported) {
+                footprint_reported = true;
+                std::cout << "QP FOOTPRINT (" << rdmaHw->m_cc->GetName()
+                          << "): " << sizeof(RdmaQueuePair) << " + "
+                          << rdmaHw->m_cc->GetQpStateSize() << " bytes" << std::endl;
+            }
         }
     }
 
@@ -1449,7 +2020,21 @@ int main(int argc, char *argv[]) {
     /**
      * @brief setup routing
      */
-    CalculateRoutes(n);
+    clock_t routeStart = clock();
+    if (topo_cached) {
+        RestoreRoutes(n, cachedRoutes);
+    } else {
+        CalculateRoutes(n);
+        if (!topology_cache.empty()) {
+            TopologyRoutes routes;
+            ExportRoutes(routes);
+            if (!TopologyCache::Save(topology_cache, topo_cache_key, topo, routes)) {
+                std::cerr << "Cannot write the topology cache " << topology_cache << std::endl;
+            }
+        }
+    }
+    std::cout << "Routes " << (topo_cached ? "restored" : "computed") << " in "
+              << (double)(clock() - routeStart) * 1000 / CLOCKS_PER_SEC << " ms" << std::endl;
     SetRoutingEntries();
 
     /**
@@ -1476,6 +2061,14 @@ int main(int argc, char *argv[]) {
         }
     }
     fprintf(stderr, "maxRtt: %lu, maxBdp: %lu\n", maxRtt, maxBdp);
+    if (!found_topo2bdpMap) {  // generated or new topology: IRN takes the largest BDP
+        irn_bdp_lookup = maxBdp;
+        for (uint32_t i = 0; i < node_num; i++) {
+            if (n.Get(i)->GetNodeType() != 0) continue;
+            n.Get(i)->GetObject<RdmaDriver>()->m_rdma->SetAttribute("IrnBdp",
+                                                                    UintegerValue(maxBdp));
+        }
+    }
     assert(maxBdp == irn_bdp_lookup);
 
     std::cout << "Configuring switches" << std::endl;
@@ -1507,152 +2100,71 @@ int main(int argc, char *argv[]) {
             if (probably_host->GetNodeType() == 0 && probably_switch->GetNodeType() == 1) {
                 Ptr<SwitchNode> sw = DynamicCast<SwitchNode>(probably_switch);
                 uint32_t hostIP = serverAddress[pair.first].Get();
-                Settings::hostIp2SwitchId[hostIP] = sw->GetId();  // hostIP -> connected switch's ID
+                Settings::SetHostToR(hostIP, sw->GetId());  // hostIP -> connected switch's ID
             }
         }
 
-        // Conga: m_congaFromLeafTable, m_congaToLeafTable, m_congaRoutingTable
+        // Conga: paths (AddPath)
         // Letflow: m_letflowRoutingTable
-        // Conweave: m_ConWeaveRoutingTable, m_rxToRId2BaseRTT
-        for (auto i = nextHop.begin(); i != nextHop.end(); i++) {  // every node
-            if (i->first->GetNodeType() == 1) {                    // switch
-                Ptr<Node> nodeSrc = i->first;
-                Ptr<SwitchNode> swSrc = DynamicCast<SwitchNode>(nodeSrc);  // switch
-                uint32_t swSrcId = swSrc->GetId();
-
-                if (swSrc->m_isToR) {
-                    // printf("--- ToR Switch %d\n", swSrcId);
-
-                    auto table1 = i->second;
-                    for (auto j = table1.begin(); j != table1.end(); j++) {
-                        Ptr<Node> dst = j->first;  // dst
-                        uint32_t dstIP = Settings::hostId2IpMap[dst->GetId()];
-                        uint32_t swDstId = Settings::hostIp2SwitchId[dstIP];  // Rx(dst)ToR
+        // Conweave: paths (AddPath), m_rxToRId2BaseRTT
+        // Paths are enumerated once per ToR pair, towards any one host of the destination ToR.
+        clock_t enumStart = clock();
+        uint32_t nToRPairs = 0, maxHops = 0;
+        uint64_t nPaths = 0, nPathPorts = 0;
+        for (auto &tor : idxNodeToR) {
+            Ptr<SwitchNode> swSrc = tor.second;
+            uint32_t swSrcId = swSrc->GetId();
+            std::set<uint32_t> dstToRs;
+            for (auto &entry : nextHop[swSrc]) {
+                Ptr<Node> dst = entry.first;
+                if (dst->GetNodeType() != 0) continue;
+                uint32_t swDstId = Settings::ToROfIp(Settings::IpOfHost(dst->GetId()));
+                if (swSrcId == swDstId || !dstToRs.insert(swDstId).second) {
+                    continue;  // same ToR, or this ToR pair is done
+                }
 
-                        if (swSrcId == swDstId) {
-                            continue;  // if in the same pod, then skip
+                vector<uint32_t> ports;
+                vector<vector<uint32_t>> paths;
+                EnumerateToRPaths(swSrc, dst, swDstId, ports, paths);
+                nToRPairs++;
+                for (auto &path : paths) {
+                    nPaths++;
+                    nPathPorts += path.size();
+                    maxHops = std::max(maxHops, (uint32_t)path.size());
+                    if (lb_mode == 3 || lb_mode == 6) {
+                        // CONGA/LetFlow path ids pack one 8-bit port per hop in 32 bits
+                        if (path.size() > 4 ||
+                            *std::max_element(path.begin(), path.end()) > UINT8_MAX) {
+                            NS_FATAL_ERROR("ToR " << swSrcId << " -> " << swDstId << ": a path of "
+                                                  << path.size()
+                                                  << " hops does not fit a CONGA/LetFlow path id");
                         }
-
-                        if (lb_mode == 3) {
-                            // initialize `m_congaFromLeafTable` and `m_congaToLeafTable`
-                            swSrc->m_mmu->m_congaRouting
-                                .m_congaFromLeafTable[swDstId];  // dynamically will be added in
-                                                                 // conga
-                            swSrc->m_mmu->m_congaRouting.m_congaToLeafTable[swDstId];
+                        uint8_t path_ports[4] = {0, 0, 0, 0};  // interface is always > 0
+                        for (uint32_t k = 0; k < path.size(); k++) {
+                            path_ports[k] = (uint8_t)path[k];
                         }
-
-                        // construct paths
-                        uint32_t pathId;
-                        uint8_t path_ports[4] = {0, 0, 0, 0};  // interface is always large than 0
-                        vector<Ptr<Node>> nexts1 = j->second;
-                        for (auto next1 : nexts1) {
-                            uint32_t outPort1 = nbr2if[nodeSrc][next1].idx;
-                            auto nexts2 = nextHop[next1][dst];
-                            if (nexts2.size() == 1 && nexts2[0]->GetId() == swDstId) {
-                                // this destination has 2-hop distance
-                                uint32_t outPort2 = nbr2if[next1][nexts2[0]].idx;
-                                // printf("[IntraPod-2hop] %d (%d)-> %d (%d) -> %d -> %d\n",
-                                // nodeSrc->GetId(), outPort1, next1->GetId(), outPort2,
-                                // nexts2[0]->GetId(), dst->GetId());
-                                path_ports[0] = (uint8_t)outPort1;
-                                path_ports[1] = (uint8_t)outPort2;
-                                pathId = *((uint32_t *)path_ports);
-                                if (lb_mode == 3) {
-                                    swSrc->m_mmu->m_congaRouting.m_congaRoutingTable[swDstId]
-                                        .insert(pathId);
-                                }
-                                if (lb_mode == 6) {
-                                    swSrc->m_mmu->m_letflowRouting.m_letflowRoutingTable[swDstId]
-                                        .insert(pathId);
-                                }
-                                if (lb_mode == 9) {
-                                    swSrc->m_mmu->m_conweaveRouting.m_ConWeaveRoutingTable[swDstId]
-                                        .insert(pathId);
-                                    swSrc->m_mmu->m_conweaveRouting.m_rxToRId2BaseRTT[swDstId] =
-                                        one_hop_delay * 4;
-                                }
-                                continue;
-                            }
-
-                            for (auto next2 : nexts2) {
-                                uint32_t outPort2 = nbr2if[next1][next2].idx;
-                                auto nexts3 = nextHop[next2][dst];
-                                if (nexts3.size() == 1 && nexts3[0]->GetId() == swDstId) {
-                                    // this destination has 3-hop distance
-                                    uint32_t outPort3 = nbr2if[next2][nexts3[0]].idx;
-                                    // printf("[IntraPod-3hop] %d (%d)-> %d (%d) -> %d (%d) -> %d ->
-                                    // %d\n", nodeSrc->GetId(), outPort1, next1->GetId(), outPort2,
-                                    // next2->GetId(), outPort3, nexts3[0]->GetId(), dst->GetId());
-                                    path_ports[0] = (uint8_t)outPort1;
-                                    path_ports[1] = (uint8_t)outPort2;
-                                    path_ports[2] = (uint8_t)outPort3;
-                                    pathId = *((uint32_t *)path_ports);
-                                    if (lb_mode == 3) {
-                                        swSrc->m_mmu->m_congaRouting.m_congaRoutingTable[swDstId]
-                                            .insert(pathId);
-                                    }
-                                    if (lb_mode == 6) {
-                                        swSrc->m_mmu->m_letflowRouting
-                                            .m_letflowRoutingTable[swDstId]
-                                            .insert(pathId);
-                                    }
-                                    if (lb_mode == 9) {
-                                        swSrc->m_mmu->m_conweaveRouting
-                                            .m_ConWeaveRoutingTable[swDstId]
-                                            .insert(pathId);
-                                        swSrc->m_mmu->m_conweaveRouting.m_rxToRId2BaseRTT[swDstId] =
-                                            one_hop_delay * 6;
-                                    }
-                                    continue;
-                                }
-
-                                for (auto next3 : nexts3) {
-                                    uint32_t outPort3 = nbr2if[next2][next3].idx;
-                                    auto nexts4 = nextHop[next3][dst];
-                                    if (nexts4.size() == 1 && nexts4[0]->GetId() == swDstId) {
-                                        // this destination has 4-hop distance
-                                        uint32_t outPort4 = nbr2if[next3][nexts4[0]].idx;
-                                        // printf("[IntraPod-4hop] %d (%d)-> %d (%d) -> %d (%d) ->
-                                        // %d (%d) -> %d -> %d\n", nodeSrc->GetId(), outPort1,
-                                        // next1->GetId(), outPort2, next2->GetId(), outPort3,
-                                        // next3->GetId(), outPort4, nexts4[0]->GetId(),
-                                        // dst->GetId());
-                                        path_ports[0] = (uint8_t)outPort1;
-                                        path_ports[1] = (uint8_t)outPort2;
-                                        path_ports[2] = (uint8_t)outPort3;
-                                        path_ports[3] = (uint8_t)outPort4;
-                                        pathId = *((uint32_t *)path_ports);
-                                        if (lb_mode == 3) {
-                                            swSrc->m_mmu->m_congaRouting
-                                                .m_congaRoutingTable[swDstId]
-                                                .insert(pathId);
-                                        }
-                                        if (lb_mode == 6) {
-                                            swSrc->m_mmu->m_letflowRouting
-                                                .m_letflowRoutingTable[swDstId]
-                                                .insert(pathId);
-                                        }
-                                        if (lb_mode == 9) {
-                                            swSrc->m_mmu->m_conweaveRouting
-                                                .m_ConWeaveRoutingTable[swDstId]
-                                                .insert(pathId);
-                                            swSrc->m_mmu->m_conweaveRouting
-                                                .m_rxToRId2BaseRTT[swDstId] = one_hop_delay * 8;
-                                        }
-                                        continue;
-                                    } else {
-                                        printf("Too large topology?\n");
-                                        assert(false);
-                                    }
-                                }
-                            }
+                        uint32_t pathId = *((uint32_t *)path_ports);
+                        if (lb_mode == 3) {
+                            swSrc->m_mmu->m_congaRouting.AddPath(swDstId, pathId);
+                        } else {
+                            swSrc->m_mmu->m_letflowRouting.m_letflowRoutingTable[swDstId].insert(
+                                pathId);
                         }
                     }
+                    if (lb_mode == 9) {
+                        swSrc->m_mmu->m_conweaveRouting.AddPath(swDstId, path);
+                        swSrc->m_mmu->m_conweaveRouting.m_rxToRId2BaseRTT[swDstId] =
+                            one_hop_delay * 2 * path.size();
+                    }
                 }
             }
         }
+        std::cout << "LB paths: " << nPaths << " paths of up to " << maxHops << " hops between "
+                  << nToRPairs << " ToR pairs (" << nPathPorts * sizeof(uint32_t)
+                  << " bytes of ports), tables built in "
+                  << (double)(clock() - enumStart) * 1000 / CLOCKS_PER_SEC << " ms" << std::endl;
 
-        // m_outPort2BitRateMap - only for Conga
+        // m_outPort2BitRate - only for Conga
         for (auto i = nextHop.begin(); i != nextHop.end(); i++) {  // every node
             if (i->first->GetNodeType() == 1) {                    // switch
                 Ptr<Node> node = i->first;
@@ -1662,8 +2174,8 @@ int main(int argc, char *argv[]) {
                 auto table = i->second;
                 for (auto j = table.begin(); j != table.end(); j++) {
                     Ptr<Node> dst = j->first;  // dst
-                    uint32_t dstIP = Settings::hostId2IpMap[dst->GetId()];
-                    uint32_t swDstId = Settings::hostIp2SwitchId[dstIP];
+                    uint32_t dstIP = Settings::IpOfHost(dst->GetId());
+                    uint32_t swDstId = Settings::ToROfIp(dstIP);
 
                     for (auto next : j->second) {
                         uint32_t outPort = nbr2if[node][next].idx;
@@ -1728,6 +2240,12 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (fluid_flow_threshold > 0) {
+        fluidModel = CreateObject<FluidFlowModel>();
+        fluidModel->SetAttribute("MaxLinkShare", DoubleValue(fluid_max_link_share));
+        NS_LOG_INFO("Fluid mode for flows >= " << fluid_flow_threshold << " bytes");
+    }
+
     flow_input.idx = 0;
     port_per_host = new uint16_t[node_num - switch_num];
     if (flow_num > 0) {
@@ -1736,7 +2254,6 @@ int main(int argc, char *argv[]) {
         Simulator::Schedule(Seconds(0), &ScheduleFlowInputs, flow_input_stream);
     }
 
-    topof.close();
 
     // schedule link down
     if (link_down_time > 0) {
@@ -1790,13 +2307,52 @@ int main(int argc, char *argv[]) {
     Simulator::Schedule(Seconds(flowgen_start_time),
                         &stop_simulation_middle);  // check every 100us
     Simulator::Stop(Seconds(flowgen_stop_time + 10.0));
+    pfcMonitor->Start();
+    if (profile_trace_file != "") {
+        if (!SimProfiler::IsEnabled()) {
+            std::cerr << "PROFILE_TRACE_FILE ignored: configure with --enable-sim-profiler"
+                      << std::endl;
+        }
+        SimProfiler::EnableTrace(profile_trace_records);
+    }
+    RunStats stats;
+    std::chrono::steady_clock::time_point wallRun = std::chrono::steady_clock::now();
+    stats.setupS = std::chrono::duration<double>(wallRun - wallStart).count();
     Simulator::Run();
+    std::chrono::steady_clock::time_point wallEnd = std::chrono::steady_clock::now();
+    stats.runS = std::chrono::duration<double>(wallEnd - wallRun).count();
+    stats.events = Simulator::GetEventCount();
+    stats.simTime = Simulator::Now();
+    pfcMonitor->Report(std::cout);
+    std::cout << "PACKET BUFFERS: " << Buffer::GetNBuffers() << " created, "
+              << (double)Buffer::GetNReallocations() / std::max(Buffer::GetNBuffers(), (uint64_t)1)
+              << " reallocations and "
+              << (double)Buffer::GetNAllocations() / std::max(Buffer::GetNBuffers(), (uint64_t)1)
+              << " allocations per buffer" << std::endl;
+    SimProfiler::Report(std::cout);
+    if (SimulationArena::IsEnabled()) {
+        SimulationArena::Report(std::cout);
+    }
+    if (profile_trace_file != "" && SimProfiler::IsEnabled() &&
+        !SimProfiler::WriteTrace(profile_trace_file)) {
+        std::cerr << "Cannot write the profile trace to " << profile_trace_file << std::endl;
+    }
 
     /*-----------------------------------------------------------------------------*/
     /*----- we don't need below. Just we can enforce to close this simulation. -----*/
     /*-----------------------------------------------------------------------------*/
     Simulator::Destroy();
+    stats.destroyS =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - wallEnd).count();
+    if (stats_output_file != "") {
+        write_run_stats(stats_output_file, stats);
+    }
     NS_LOG_INFO("Total number of packets: " << RdmaHw::nAllPkts);
+    NS_LOG_INFO("QP migrations after link changes: " << RdmaHw::nQpMigrations);
+    if (fluid_flow_threshold > 0) {
+        NS_LOG_INFO("Fluid flows: " << FluidFlowModel::nFluidFlows
+                                    << ", rate reallocations: " << FluidFlowModel::nReallocations);
+    }
     NS_LOG_INFO("Done.");
     endt = clock();
     std::cerr << (double)(endt - begint) / CLOCKS_PER_SEC << "\n";
@@ -28,7 +28,9 @@
 #include "attribute.h"
 #include "attribute-helper.h"
 #include "simple-ref-count.h"
+#include <new>
 #include <typeinfo>
+#include <type_traits>
 
 namespace ns3 {
 
@@ -87,6 +89,49 @@ public:
    * \return true if we are equal
    */
   virtual bool IsEqual (Ptr<const CallbackImplBase> other) const = 0;
+  /**
+   * Copy construct this implementation in place
+   *
+   * \param storage the inline buffer of a Callback
+   * \return the copy
+   */
+  virtual CallbackImplBase *CopyTo (void *storage) const = 0;
+
+  static const size_t INLINE_SIZE = 48; //!< bytes of the inline buffer of a Callback
+  /** The inline buffer of a Callback, aligned for pointers and doubles */
+  union Storage {
+    void *pointer;                      //!< for alignment
+    double real;                        //!< for alignment
+    uint64_t integer;                   //!< for alignment
+    char bytes[INLINE_SIZE];            //!< the implementation
+  };
+  /** Whether an IMPL is built in the inline buffer of a Callback */
+  template <typename IMPL>
+  struct Fits : std::integral_constant<bool, (sizeof (IMPL) <= INLINE_SIZE
+                                              && alignof (IMPL) <= alignof (Storage))> {};
+protected:
+  /**
+   * Implement CopyTo for an IMPL that fits in the inline buffer
+   * \param impl the implementation to copy
+   * \param storage the inline buffer of a Callback
+   * \return the copy
+   */
+  template <typename IMPL>
+  static CallbackImplBase *CopyInline (const IMPL &impl, void *storage, std::true_type)
+  {
+    return new (storage) IMPL (impl);
+  }
+  /**
+   * Implement CopyTo for an IMPL that lives on the heap: it is shared
+   * \param impl the implementation to share
+   * \return impl, with one more reference
+   */
+  template <typename IMPL>
+  static CallbackImplBase *CopyInline (const IMPL &impl, void *, std::false_type)
+  {
+    impl.Ref ();
+    return const_cast<IMPL *> (&impl);
+  }
 };
 
 /**
@@ -189,6 +234,10 @@ public:
   FunctorCallbackImpl (T const &functor)
     : m_functor (functor) {}
   virtual ~FunctorCallbackImpl () {}
+  /** \copydoc CallbackImplBase::CopyTo */
+  virtual CallbackImplBase *CopyTo (void *storage) const {
+    return CallbackImplBase::CopyInline (*this, storage, CallbackImplBase::Fits<FunctorCallbackImpl> ());
+  }
   /**
    * Functor with varying numbers of arguments
    * @{
@@ -336,6 +385,10 @@ public:
   MemPtrCallbackImpl (OBJ_PTR const&objPtr, MEM_PTR memPtr)
     : m_objPtr (objPtr), m_memPtr (memPtr) {}
   virtual ~MemPtrCallbackImpl () {}
+  /** \copydoc CallbackImplBase::CopyTo */
+  virtual CallbackImplBase *CopyTo (void *storage) const {
+    return CallbackImplBase::CopyInline (*this, storage, CallbackImplBase::Fits<MemPtrCallbackImpl> ());
+  }
   /**
    * Functor with varying numbers of arguments
    * @{
@@ -485,6 +538,10 @@ public:
   BoundFunctorCallbackImpl (FUNCTOR functor, ARG a)
     : m_functor (functor), m_a (a) {}
   virtual ~BoundFunctorCallbackImpl () {}
+  /** \copydoc CallbackImplBase::CopyTo */
+  virtual CallbackImplBase *CopyTo (void *storage) const {
+    return CallbackImplBase::CopyInline (*this, storage, CallbackImplBase::Fits<BoundFunctorCallbackImpl> ());
+  }
   /**
    * Functor with varying numbers of arguments
    * @{
@@ -620,6 +677,10 @@ public:
   TwoBoundFunctorCallbackImpl (FUNCTOR functor, ARG1 arg1, ARG2 arg2)
     : m_functor (functor), m_a1 (arg1), m_a2 (arg2) {}
   virtual ~TwoBoundFunctorCallbackImpl () {}
+  /** \copydoc CallbackImplBase::CopyTo */
+  virtual CallbackImplBase *CopyTo (void *storage) const {
+    return CallbackImplBase::CopyInline (*this, storage, CallbackImplBase::Fits<TwoBoundFunctorCallbackImpl> ());
+  }
   /**
    * Functor with varying numbers of arguments
    * @{
@@ -743,6 +804,10 @@ public:
   ThreeBoundFunctorCallbackImpl (FUNCTOR functor, ARG1 arg1, ARG2 arg2, ARG3 arg3)
     : m_functor (functor), m_a1 (arg1), m_a2 (arg2), m_a3 (arg3) {}
   virtual ~ThreeBoundFunctorCallbackImpl () {}
+  /** \copydoc CallbackImplBase::CopyTo */
+  virtual CallbackImplBase *CopyTo (void *storage) const {
+    return CallbackImplBase::CopyInline (*this, storage, CallbackImplBase::Fits<ThreeBoundFunctorCallbackImpl> ());
+  }
   /**
    * Functor with varying numbers of arguments
    * @{
@@ -840,19 +905,135 @@ private:
  * \ingroup callback
  * Base class for Callback class.
  * Provides pimpl abstraction.
+ *
+ * An implementation of up to INLINE_SIZE bytes (a function, a member
+ * function with its object, or a function with up to three bound
+ * pointer-sized arguments) is built in a buffer inside the Callback and
+ * copied with it, so making, copying and destroying such a Callback does
+ * not allocate. A larger implementation is allocated on the heap and
+ * shared by reference count.
  */
 class CallbackBase {
 public:
-  CallbackBase () : m_impl () {}
-  /** \return the impl pointer */
-  Ptr<CallbackImplBase> GetImpl (void) const { return m_impl; }
+  CallbackBase () : m_impl (0) {}
+  /**
+   * Copy constructor
+   * \param o the Callback to copy
+   */
+  CallbackBase (const CallbackBase &o) : m_impl (0) { CopyFrom (o); }
+  ~CallbackBase () { Clear (); }
+  /**
+   * Assignment
+   * \param o the Callback to copy
+   * \return this Callback
+   */
+  CallbackBase &operator = (const CallbackBase &o)
+  {
+    if (this != &o)
+      {
+        Clear ();
+        CopyFrom (o);
+      }
+    return *this;
+  }
+  /**
+   * \return the impl pointer
+   *
+   * \internal
+   * The implementation may live inside this Callback: the Ptr must not
+   * outlive it.
+   */
+  Ptr<CallbackImplBase> GetImpl (void) const { return Ptr<CallbackImplBase> (m_impl); }
+  /** \return the impl pointer, without taking a reference */
+  CallbackImplBase *PeekImpl (void) const { return m_impl; }
+
+  static const size_t INLINE_SIZE = CallbackImplBase::INLINE_SIZE; //!< bytes of the inline buffer
 protected:
   /**
-   * Construct from a pimpl
-   * \param impl the CallbackImplBase Ptr
+   * Construct from a heap pimpl, taking a reference
+   * \param impl the CallbackImplBase pointer
    */
-  CallbackBase (Ptr<CallbackImplBase> impl) : m_impl (impl) {}
-  Ptr<CallbackImplBase> m_impl;         //!< the pimpl
+  explicit CallbackBase (CallbackImplBase *impl) : m_impl (impl)
+  {
+    if (m_impl != 0)
+      {
+        m_impl->Ref ();
+      }
+  }
+  /**
+   * Build the implementation, inline if it fits
+   * \param args the arguments of the IMPL constructor
+   */
+  template <typename IMPL, typename... ARGS>
+  void Construct (ARGS const &... args)
+  {
+    Clear ();
+    m_impl = DoConstruct<IMPL> (CallbackImplBase::Fits<IMPL> (), args...);
+  }
+  /** Destroy the inline implementation, or drop the reference */
+  void Clear (void)
+  {
+    if (m_impl == 0)
+      {
+        return;
+      }
+    if (IsInline ())
+      {
+        m_impl->~CallbackImplBase ();
+      }
+    else
+      {
+        m_impl->Unref ();
+      }
+    m_impl = 0;
+  }
+  /**
+   * Copy an inline implementation, share a heap one
+   * \param o the Callback to copy, this one being null
+   */
+  void CopyFrom (const CallbackBase &o)
+  {
+    if (o.m_impl == 0)
+      {
+        return;
+      }
+    if (o.IsInline ())
+      {
+        m_impl = o.m_impl->CopyTo (&m_storage);
+      }
+    else
+      {
+        m_impl = o.m_impl;
+        m_impl->Ref ();
+      }
+  }
+  /**
+   * \param args the arguments of the IMPL constructor
+   * \return the implementation, built in m_storage
+   */
+  template <typename IMPL, typename... ARGS>
+  CallbackImplBase *DoConstruct (std::true_type, ARGS const &... args)
+  {
+    return new (&m_storage) IMPL (args...);
+  }
+  /**
+   * \param args the arguments of the IMPL constructor
+   * \return the implementation, built on the heap
+   */
+  template <typename IMPL, typename... ARGS>
+  CallbackImplBase *DoConstruct (std::false_type, ARGS const &... args)
+  {
+    return new IMPL (args...);
+  }
+  /** \return true if the implementation lives in m_storage */
+  bool IsInline (void) const
+  {
+    const char *p = reinterpret_cast<const char *> (m_impl);
+    return p >= m_storage.bytes && p < m_storage.bytes + INLINE_SIZE;
+  }
+  typedef CallbackImplBase::Storage Storage; //!< the inline buffer
+  CallbackImplBase *m_impl;             //!< the pimpl, in m_storage or on the heap
+  Storage m_storage;                    //!< the inline implementation
 
   /**
    * \param mangled the mangled string
@@ -932,8 +1113,9 @@ public:
    */
   template <typename FUNCTOR>
   Callback (FUNCTOR const &functor, bool, bool) 
-    : CallbackBase (Create<FunctorCallbackImpl<FUNCTOR,R,T1,T2,T3,T4,T5,T6,T7,T8,T9> > (functor))
-  {}
+  {
+    this->template Construct<FunctorCallbackImpl<FUNCTOR,R,T1,T2,T3,T4,T5,T6,T7,T8,T9> > (functor);
+  }
 
   /**
    * Construct a member function pointer call back.
@@ -943,8 +1125,9 @@ public:
    */
   template <typename OBJ_PTR, typename MEM_PTR>
   Callback (OBJ_PTR const &objPtr, MEM_PTR memPtr)
-    : CallbackBase (Create<MemPtrCallbackImpl<OBJ_PTR,MEM_PTR,R,T1,T2,T3,T4,T5,T6,T7,T8,T9> > (objPtr, memPtr))
-  {}
+  {
+    this->template Construct<MemPtrCallbackImpl<OBJ_PTR,MEM_PTR,R,T1,T2,T3,T4,T5,T6,T7,T8,T9> > (objPtr, memPtr);
+  }
 
   /**
    * Construct from a CallbackImpl pointer
@@ -952,9 +1135,22 @@ public:
    * \param impl the CallbackImpl Ptr
    */
   Callback (Ptr<CallbackImpl<R,T1,T2,T3,T4,T5,T6,T7,T8,T9> > const &impl)
-    : CallbackBase (impl)
+    : CallbackBase (PeekPointer (impl))
   {}
 
+  /**
+   * Construct from a CallbackImpl built in place, inline if it fits
+   *
+   * \param args the arguments of the IMPL constructor
+   * \return the callback
+   */
+  template <typename IMPL, typename... ARGS>
+  static Callback FromImpl (ARGS const &... args) {
+    Callback cb;
+    cb.template Construct<IMPL> (args...);
+    return cb;
+  }
+
   /**
    * Bind the first arguments
    *
@@ -963,12 +1159,10 @@ public:
    */
   template <typename T>
   Callback<R,T2,T3,T4,T5,T6,T7,T8,T9> Bind (T a) {
-    Ptr<CallbackImpl<R,T2,T3,T4,T5,T6,T7,T8,T9,empty> > impl =
-      Ptr<CallbackImpl<R,T2,T3,T4,T5,T6,T7,T8,T9,empty> > (
-        new BoundFunctorCallbackImpl<
-          Callback<R,T1,T2,T3,T4,T5,T6,T7,T8,T9>,
-          R,T1,T2,T3,T4,T5,T6,T7,T8,T9> (*this, a), false);
-    return Callback<R,T2,T3,T4,T5,T6,T7,T8,T9> (impl);
+    return Callback<R,T2,T3,T4,T5,T6,T7,T8,T9>::template FromImpl<
+      BoundFunctorCallbackImpl<
+        Callback<R,T1,T2,T3,T4,T5,T6,T7,T8,T9>,
+        R,T1,T2,T3,T4,T5,T6,T7,T8,T9> > (*this, a);
   }
 
   /**
@@ -980,12 +1174,10 @@ public:
    */
   template <typename TX1, typename TX2>
   Callback<R,T3,T4,T5,T6,T7,T8,T9> TwoBind (TX1 a1, TX2 a2) {
-    Ptr<CallbackImpl<R,T3,T4,T5,T6,T7,T8,T9,empty,empty> > impl =
-      Ptr<CallbackImpl<R,T3,T4,T5,T6,T7,T8,T9,empty,empty> > (
-        new TwoBoundFunctorCallbackImpl<
-          Callback<R,T1,T2,T3,T4,T5,T6,T7,T8,T9>,
-          R,T1,T2,T3,T4,T5,T6,T7,T8,T9> (*this, a1, a2), false);
-    return Callback<R,T3,T4,T5,T6,T7,T8,T9> (impl);
+    return Callback<R,T3,T4,T5,T6,T7,T8,T9>::template FromImpl<
+      TwoBoundFunctorCallbackImpl<
+        Callback<R,T1,T2,T3,T4,T5,T6,T7,T8,T9>,
+        R,T1,T2,T3,T4,T5,T6,T7,T8,T9> > (*this, a1, a2);
   }
 
   /**
@@ -998,12 +1190,10 @@ public:
    */
   template <typename TX1, typename TX2, typename TX3>
   Callback<R,T4,T5,T6,T7,T8,T9> ThreeBind (TX1 a1, TX2 a2, TX3 a3) {
-    Ptr<CallbackImpl<R,T4,T5,T6,T7,T8,T9,empty,empty,empty> > impl =
-      Ptr<CallbackImpl<R,T4,T5,T6,T7,T8,T9,empty,empty,empty> > (
-        new ThreeBoundFunctorCallbackImpl<
-          Callback<R,T1,T2,T3,T4,T5,T6,T7,T8,T9>,
-          R,T1,T2,T3,T4,T5,T6,T7,T8,T9> (*this, a1, a2, a3), false);
-    return Callback<R,T4,T5,T6,T7,T8,T9> (impl);
+    return Callback<R,T4,T5,T6,T7,T8,T9>::template FromImpl<
+      ThreeBoundFunctorCallbackImpl<
+        Callback<R,T1,T2,T3,T4,T5,T6,T7,T8,T9>,
+        R,T1,T2,T3,T4,T5,T6,T7,T8,T9> > (*this, a1, a2, a3);
   }
 
   /**
@@ -1016,7 +1206,7 @@ public:
   }
   /** Discard the implementation, set it to null */
   void Nullify (void) {
-    m_impl = 0;
+    Clear ();
   }
 
   /**
@@ -1145,7 +1335,7 @@ public:
    * \return true if other can be dynamic_cast to my type
    */
   bool CheckType (const CallbackBase & other) const {
-    return DoCheckType (other.GetImpl ());
+    return DoCheckType (other.PeekImpl ());
   }
   /**
    * Adopt the other's implementation, if type compatible
@@ -1153,21 +1343,21 @@ public:
    * \param other Callback
    */
   void Assign (const CallbackBase &other) {
-    DoAssign (other.GetImpl ());
+    DoAssign (other);
   }
 private:
   /** \return the pimpl pointer */
   CallbackImpl<R,T1,T2,T3,T4,T5,T6,T7,T8,T9> *DoPeekImpl (void) const {
-    return static_cast<CallbackImpl<R,T1,T2,T3,T4,T5,T6,T7,T8,T9> *> (PeekPointer (m_impl));
+    return static_cast<CallbackImpl<R,T1,T2,T3,T4,T5,T6,T7,T8,T9> *> (m_impl);
   }
   /**
    * Check for compatible types
    *
-   * \param other Callback Ptr
+   * \param other CallbackImplBase pointer
    * \return true if other can be dynamic_cast to my type
    */
-  bool DoCheckType (Ptr<const CallbackImplBase> other) const {
-    if (other != 0 && dynamic_cast<const CallbackImpl<R,T1,T2,T3,T4,T5,T6,T7,T8,T9> *> (PeekPointer (other)) != 0)
+  bool DoCheckType (const CallbackImplBase *other) const {
+    if (other != 0 && dynamic_cast<const CallbackImpl<R,T1,T2,T3,T4,T5,T6,T7,T8,T9> *> (other) != 0)
       {
         return true;
       }
@@ -1183,16 +1373,16 @@ private:
   /**
    * Adopt the other's implementation, if type compatible
    *
-   * \param other Callback Ptr to adopt from
+   * \param other Callback to adopt from
    */
-  void DoAssign (Ptr<const CallbackImplBase> other) {
-    if (!DoCheckType (other))
+  void DoAssign (const CallbackBase &other) {
+    if (!DoCheckType (other.PeekImpl ()))
       {
         NS_FATAL_ERROR ("Incompatible types. (feed to \"c++filt -t\" if needed)" << std::endl <<
-                        "got=" << Demangle ( typeid (*other).name () ) << std::endl <<
+                        "got=" << Demangle ( typeid (*other.PeekImpl ()).name () ) << std::endl <<
                         "expected=" << Demangle ( typeid (CallbackImpl<R,T1,T2,T3,T4,T5,T6,T7,T8,T9> *).name () ));
       }
-    m_impl = const_cast<CallbackImplBase *> (PeekPointer (other));
+    CallbackBase::operator = (other);
   }
 };
 
@@ -1461,65 +1651,47 @@ Callback<R,T1,T2,T3,T4,T5,T6,T7,T8,T9> MakeNullCallback (void) {
  */   
 template <typename R, typename TX, typename ARG>
 Callback<R> MakeBoundCallback (R (*fnPtr)(TX), ARG a1) {
-  Ptr<CallbackImpl<R,empty,empty,empty,empty,empty,empty,empty,empty,empty> > impl =
-    Create<BoundFunctorCallbackImpl<R (*)(TX),R,TX,empty,empty,empty,empty,empty,empty,empty,empty> >(fnPtr, a1);
-  return Callback<R> (impl);
+  return Callback<R>::template FromImpl<BoundFunctorCallbackImpl<R (*)(TX),R,TX,empty,empty,empty,empty,empty,empty,empty,empty> > (fnPtr, a1);
 }
 template <typename R, typename TX, typename ARG, 
           typename T1>
 Callback<R,T1> MakeBoundCallback (R (*fnPtr)(TX,T1), ARG a1) {
-  Ptr<CallbackImpl<R,T1,empty,empty,empty,empty,empty,empty,empty,empty> > impl =
-    Create<BoundFunctorCallbackImpl<R (*)(TX,T1),R,TX,T1,empty,empty,empty,empty,empty,empty,empty> > (fnPtr, a1);
-  return Callback<R,T1> (impl);
+  return Callback<R,T1>::template FromImpl<BoundFunctorCallbackImpl<R (*)(TX,T1),R,TX,T1,empty,empty,empty,empty,empty,empty,empty> > (fnPtr, a1);
 }
 template <typename R, typename TX, typename ARG, 
           typename T1, typename T2>
 Callback<R,T1,T2> MakeBoundCallback (R (*fnPtr)(TX,T1,T2), ARG a1) {
-  Ptr<CallbackImpl<R,T1,T2,empty,empty,empty,empty,empty,empty,empty> > impl =
-    Create<BoundFunctorCallbackImpl<R (*)(TX,T1,T2),R,TX,T1,T2,empty,empty,empty,empty,empty,empty> > (fnPtr, a1);
-  return Callback<R,T1,T2> (impl);
+  return Callback<R,T1,T2>::template FromImpl<BoundFunctorCallbackImpl<R (*)(TX,T1,T2),R,TX,T1,T2,empty,empty,empty,empty,empty,empty> > (fnPtr, a1);
 }
 template <typename R, typename TX, typename ARG,
           typename T1, typename T2,typename T3>
 Callback<R,T1,T2,T3> MakeBoundCallback (R (*fnPtr)(TX,T1,T2,T3), ARG a1) {
-  Ptr<CallbackImpl<R,T1,T2,T3,empty,empty,empty,empty,empty,empty> > impl =
-    Create<BoundFunctorCallbackImpl<R (*)(TX,T1,T2,T3),R,TX,T1,T2,T3,empty,empty,empty,empty,empty> > (fnPtr, a1);
-  return Callback<R,T1,T2,T3> (impl);
+  return Callback<R,T1,T2,T3>::template FromImpl<BoundFunctorCallbackImpl<R (*)(TX,T1,T2,T3),R,TX,T1,T2,T3,empty,empty,empty,empty,empty> > (fnPtr, a1);
 }
 template <typename R, typename TX, typename ARG,
           typename T1, typename T2,typename T3,typename T4>
 Callback<R,T1,T2,T3,T4> MakeBoundCallback (R (*fnPtr)(TX,T1,T2,T3,T4), ARG a1) {
-  Ptr<CallbackImpl<R,T1,T2,T3,T4,empty,empty,empty,empty,empty> > impl =
-    Create<BoundFunctorCallbackImpl<R (*)(TX,T1,T2,T3,T4),R,TX,T1,T2,T3,T4,empty,empty,empty,empty> > (fnPtr, a1);
-  return Callback<R,T1,T2,T3,T4> (impl);
+  return Callback<R,T1,T2,T3,T4>::template FromImpl<BoundFunctorCallbackImpl<R (*)(TX,T1,T2,T3,T4),R,TX,T1,T2,T3,T4,empty,empty,empty,empty> > (fnPtr, a1);
 }
 template <typename R, typename TX, typename ARG,
           typename T1, typename T2,typename T3,typename T4,typename T5>
 Callback<R,T1,T2,T3,T4,T5> MakeBoundCallback (R (*fnPtr)(TX,T1,T2,T3,T4,T5), ARG a1) {
-  Ptr<CallbackImpl<R,T1,T2,T3,T4,T5,empty,empty,empty,empty> > impl =
-    Create<BoundFunctorCallbackImpl<R (*)(TX,T1,T2,T3,T4,T5),R,TX,T1,T2,T3,T4,T5,empty,empty,empty> > (fnPtr, a1);
-  return Callback<R,T1,T2,T3,T4,T5> (impl);
+  return Callback<R,T1,T2,T3,T4,T5>::template FromImpl<BoundFunctorCallbackImpl<R (*)(TX,T1,T2,T3,T4,T5),R,TX,T1,T2,T3,T4,T5,empty,empty,empty> > (fnPtr, a1);
 }
 template <typename R, typename TX, typename ARG,
           typename T1, typename T2,typename T3,typename T4,typename T5, typename T6>
 Callback<R,T1,T2,T3,T4,T5,T6> MakeBoundCallback (R (*fnPtr)(TX,T1,T2,T3,T4,T5,T6), ARG a1) {
-  Ptr<CallbackImpl<R,T1,T2,T3,T4,T5,T6,empty,empty,empty> > impl =
-    Create<BoundFunctorCallbackImpl<R (*)(TX,T1,T2,T3,T4,T5,T6),R,TX,T1,T2,T3,T4,T5,T6,empty,empty> > (fnPtr, a1);
-  return Callback<R,T1,T2,T3,T4,T5,T6> (impl);
+  return Callback<R,T1,T2,T3,T4,T5,T6>::template FromImpl<BoundFunctorCallbackImpl<R (*)(TX,T1,T2,T3,T4,T5,T6),R,TX,T1,T2,T3,T4,T5,T6,empty,empty> > (fnPtr, a1);
 }
 template <typename R, typename TX, typename ARG,
           typename T1, typename T2,typename T3,typename T4,typename T5, typename T6, typename T7>
 Callback<R,T1,T2,T3,T4,T5,T6,T7> MakeBoundCallback (R (*fnPtr)(TX,T1,T2,T3,T4,T5,T6,T7), ARG a1) {
-  Ptr<CallbackImpl<R,T1,T2,T3,T4,T5,T6,T7,empty,empty> > impl =
-    Create<BoundFunctorCallbackImpl<R (*)(TX,T1,T2,T3,T4,T5,T6,T7),R,TX,T1,T2,T3,T4,T5,T6,T7,empty> > (fnPtr, a1);
-  return Callback<R,T1,T2,T3,T4,T5,T6,T7> (impl);
+  return Callback<R,T1,T2,T3,T4,T5,T6,T7>::template FromImpl<BoundFunctorCallbackImpl<R (*)(TX,T1,T2,T3,T4,T5,T6,T7),R,TX,T1,T2,T3,T4,T5,T6,T7,empty> > (fnPtr, a1);
 }
 template <typename R, typename TX, typename ARG,
           typename T1, typename T2,typename T3,typename T4,typename T5, typename T6, typename T7, typename T8>
 Callback<R,T1,T2,T3,T4,T5,T6,T7,T8> MakeBoundCallback (R (*fnPtr)(TX,T1,T2,T3,T4,T5,T6,T7,T8), ARG a1) {
-  Ptr<CallbackImpl<R,T1,T2,T3,T4,T5,T6,T7,T8,empty> > impl =
-    Create<BoundFunctorCallbackImpl<R (*)(TX,T1,T2,T3,T4,T5,T6,T7,T8),R,TX,T1,T2,T3,T4,T5,T6,T7,T8> > (fnPtr, a1);
-  return Callback<R,T1,T2,T3,T4,T5,T6,T7,T8> (impl);
+  return Callback<R,T1,T2,T3,T4,T5,T6,T7,T8>::template FromImpl<BoundFunctorCallbackImpl<R (*)(TX,T1,T2,T3,T4,T5,T6,T7,T8),R,TX,T1,T2,T3,T4,T5,T6,T7,T8> > (fnPtr, a1);
 }
 /**@}*/
 
@@ -1532,58 +1704,42 @@ Callback<R,T1,T2,T3,T4,T5,T6,T7,T8> MakeBoundCallback (R (*fnPtr)(TX,T1,T2,T3,T4
  */
 template <typename R, typename TX1, typename TX2, typename ARG1, typename ARG2>
 Callback<R> MakeBoundCallback (R (*fnPtr)(TX1,TX2), ARG1 a1, ARG2 a2) {
-  Ptr<CallbackImpl<R,empty,empty,empty,empty,empty,empty,empty,empty,empty> > impl =
-    Create<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2),R,TX1,TX2,empty,empty,empty,empty,empty,empty,empty> >(fnPtr, a1, a2);
-  return Callback<R> (impl);
+  return Callback<R>::template FromImpl<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2),R,TX1,TX2,empty,empty,empty,empty,empty,empty,empty> > (fnPtr, a1, a2);
 }
 template <typename R, typename TX1, typename TX2, typename ARG1, typename ARG2,
           typename T1>
 Callback<R,T1> MakeBoundCallback (R (*fnPtr)(TX1,TX2,T1), ARG1 a1, ARG2 a2) {
-  Ptr<CallbackImpl<R,T1,empty,empty,empty,empty,empty,empty,empty,empty> > impl =
-    Create<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1),R,TX1,TX2,T1,empty,empty,empty,empty,empty,empty> > (fnPtr, a1, a2);
-  return Callback<R,T1> (impl);
+  return Callback<R,T1>::template FromImpl<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1),R,TX1,TX2,T1,empty,empty,empty,empty,empty,empty> > (fnPtr, a1, a2);
 }
 template <typename R, typename TX1, typename TX2, typename ARG1, typename ARG2,
           typename T1, typename T2>
 Callback<R,T1,T2> MakeBoundCallback (R (*fnPtr)(TX1,TX2,T1,T2), ARG1 a1, ARG2 a2) {
-  Ptr<CallbackImpl<R,T1,T2,empty,empty,empty,empty,empty,empty,empty> > impl =
-    Create<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1,T2),R,TX1,TX2,T1,T2,empty,empty,empty,empty,empty> > (fnPtr, a1, a2);
-  return Callback<R,T1,T2> (impl);
+  return Callback<R,T1,T2>::template FromImpl<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1,T2),R,TX1,TX2,T1,T2,empty,empty,empty,empty,empty> > (fnPtr, a1, a2);
 }
 template <typename R, typename TX1, typename TX2, typename ARG1, typename ARG2,
           typename T1, typename T2,typename T3>
 Callback<R,T1,T2,T3> MakeBoundCallback (R (*fnPtr)(TX1,TX2,T1,T2,T3), ARG1 a1, ARG2 a2) {
-  Ptr<CallbackImpl<R,T1,T2,T3,empty,empty,empty,empty,empty,empty> > impl =
-    Create<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1,T2,T3),R,TX1,TX2,T1,T2,T3,empty,empty,empty,empty> > (fnPtr, a1, a2);
-  return Callback<R,T1,T2,T3> (impl);
+  return Callback<R,T1,T2,T3>::template FromImpl<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1,T2,T3),R,TX1,TX2,T1,T2,T3,empty,empty,empty,empty> > (fnPtr, a1, a2);
 }
 template <typename R, typename TX1, typename TX2, typename ARG1, typename ARG2,
           typename T1, typename T2,typename T3,typename T4>
 Callback<R,T1,T2,T3,T4> MakeBoundCallback (R (*fnPtr)(TX1,TX2,T1,T2,T3,T4), ARG1 a1, ARG2 a2) {
-  Ptr<CallbackImpl<R,T1,T2,T3,T4,empty,empty,empty,empty,empty> > impl =
-    Create<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1,T2,T3,T4),R,TX1,TX2,T1,T2,T3,T4,empty,empty,empty> > (fnPtr, a1, a2);
-  return Callback<R,T1,T2,T3,T4> (impl);
+  return Callback<R,T1,T2,T3,T4>::template FromImpl<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1,T2,T3,T4),R,TX1,TX2,T1,T2,T3,T4,empty,empty,empty> > (fnPtr, a1, a2);
 }
 template <typename R, typename TX1, typename TX2, typename ARG1, typename ARG2,
           typename T1, typename T2,typename T3,typename T4,typename T5>
 Callback<R,T1,T2,T3,T4,T5> MakeBoundCallback (R (*fnPtr)(TX1,TX2,T1,T2,T3,T4,T5), ARG1 a1, ARG2 a2) {
-  Ptr<CallbackImpl<R,T1,T2,T3,T4,T5,empty,empty,empty,empty> > impl =
-    Create<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1,T2,T3,T4,T5),R,TX1,TX2,T1,T2,T3,T4,T5,empty,empty> > (fnPtr, a1, a2);
-  return Callback<R,T1,T2,T3,T4,T5> (impl);
+  return Callback<R,T1,T2,T3,T4,T5>::template FromImpl<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1,T2,T3,T4,T5),R,TX1,TX2,T1,T2,T3,T4,T5,empty,empty> > (fnPtr, a1, a2);
 }
 template <typename R, typename TX1, typename TX2, typename ARG1, typename ARG2,
           typename T1, typename T2,typename T3,typename T4,typename T5, typename T6>
 Callback<R,T1,T2,T3,T4,T5,T6> MakeBoundCallback (R (*fnPtr)(TX1,TX2,T1,T2,T3,T4,T5,T6), ARG1 a1, ARG2 a2) {
-  Ptr<CallbackImpl<R,T1,T2,T3,T4,T5,T6,empty,empty,empty> > impl =
-    Create<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1,T2,T3,T4,T5,T6),R,TX1,TX2,T1,T2,T3,T4,T5,T6,empty> > (fnPtr, a1, a2);
-  return Callback<R,T1,T2,T3,T4,T5,T6> (impl);
+  return Callback<R,T1,T2,T3,T4,T5,T6>::template FromImpl<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1,T2,T3,T4,T5,T6),R,TX1,TX2,T1,T2,T3,T4,T5,T6,empty> > (fnPtr, a1, a2);
 }
 template <typename R, typename TX1, typename TX2, typename ARG1, typename ARG2,
           typename T1, typename T2,typename T3,typename T4,typename T5, typename T6, typename T7>
 Callback<R,T1,T2,T3,T4,T5,T6,T7> MakeBoundCallback (R (*fnPtr)(TX1,TX2,T1,T2,T3,T4,T5,T6,T7), ARG1 a1, ARG2 a2) {
-  Ptr<CallbackImpl<R,T1,T2,T3,T4,T5,T6,T7,empty,empty> > impl =
-    Create<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1,T2,T3,T4,T5,T6,T7),R,TX1,TX2,T1,T2,T3,T4,T5,T6,T7> > (fnPtr, a1, a2);
-  return Callback<R,T1,T2,T3,T4,T5,T6,T7> (impl);
+  return Callback<R,T1,T2,T3,T4,T5,T6,T7>::template FromImpl<TwoBoundFunctorCallbackImpl<R (*)(TX1,TX2,T1,T2,T3,T4,T5,T6,T7),R,TX1,TX2,T1,T2,T3,T4,T5,T6,T7> > (fnPtr, a1, a2);
 }
 /**@}*/
 
@@ -1597,51 +1753,37 @@ Callback<R,T1,T2,T3,T4,T5,T6,T7> MakeBoundCallback (R (*fnPtr)(TX1,TX2,T1,T2,T3,
  */
 template <typename R, typename TX1, typename TX2, typename TX3, typename ARG1, typename ARG2, typename ARG3>
 Callback<R> MakeBoundCallback (R (*fnPtr)(TX1,TX2,TX3), ARG1 a1, ARG2 a2, ARG3 a3) {
-  Ptr<CallbackImpl<R,empty,empty,empty,empty,empty,empty,empty,empty,empty> > impl =
-    Create<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3),R,TX1,TX2,TX3,empty,empty,empty,empty,empty,empty> >(fnPtr, a1, a2, a3);
-  return Callback<R> (impl);
+  return Callback<R>::template FromImpl<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3),R,TX1,TX2,TX3,empty,empty,empty,empty,empty,empty> > (fnPtr, a1, a2, a3);
 }
 template <typename R, typename TX1, typename TX2, typename TX3, typename ARG1, typename ARG2, typename ARG3,
           typename T1>
 Callback<R,T1> MakeBoundCallback (R (*fnPtr)(TX1,TX2,TX3,T1), ARG1 a1, ARG2 a2, ARG3 a3) {
-  Ptr<CallbackImpl<R,T1,empty,empty,empty,empty,empty,empty,empty,empty> > impl =
-    Create<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3,T1),R,TX1,TX2,TX3,T1,empty,empty,empty,empty,empty> > (fnPtr, a1, a2, a3);
-  return Callback<R,T1> (impl);
+  return Callback<R,T1>::template FromImpl<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3,T1),R,TX1,TX2,TX3,T1,empty,empty,empty,empty,empty> > (fnPtr, a1, a2, a3);
 }
 template <typename R, typename TX1, typename TX2, typename TX3, typename ARG1, typename ARG2, typename ARG3,
           typename T1, typename T2>
 Callback<R,T1,T2> MakeBoundCallback (R (*fnPtr)(TX1,TX2,TX3,T1,T2), ARG1 a1, ARG2 a2, ARG3 a3) {
-  Ptr<CallbackImpl<R,T1,T2,empty,empty,empty,empty,empty,empty,empty> > impl =
-    Create<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3,T1,T2),R,TX1,TX2,TX3,T1,T2,empty,empty,empty,empty> > (fnPtr, a1, a2, a3);
-  return Callback<R,T1,T2> (impl);
+  return Callback<R,T1,T2>::template FromImpl<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3,T1,T2),R,TX1,TX2,TX3,T1,T2,empty,empty,empty,empty> > (fnPtr, a1, a2, a3);
 }
 template <typename R, typename TX1, typename TX2, typename TX3, typename ARG1, typename ARG2, typename ARG3,
           typename T1, typename T2,typename T3>
 Callback<R,T1,T2,T3> MakeBoundCallback (R (*fnPtr)(TX1,TX2,TX3,T1,T2,T3), ARG1 a1, ARG2 a2, ARG3 a3) {
-  Ptr<CallbackImpl<R,T1,T2,T3,empty,empty,empty,empty,empty,empty> > impl =
-    Create<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3,T1,T2,T3),R,TX1,TX2,TX3,T1,T2,T3,empty,empty,empty> > (fnPtr, a1, a2, a3);
-  return Callback<R,T1,T2,T3> (impl);
+  return Callback<R,T1,T2,T3>::template FromImpl<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3,T1,T2,T3),R,TX1,TX2,TX3,T1,T2,T3,empty,empty,empty> > (fnPtr, a1, a2, a3);
 }
 template <typename R, typename TX1, typename TX2, typename TX3, typename ARG1, typename ARG2, typename ARG3,
           typename T1, typename T2,typename T3,typename T4>
 Callback<R,T1,T2,T3,T4> MakeBoundCallback (R (*fnPtr)(TX1,TX2,TX3,T1,T2,T3,T4), ARG1 a1, ARG2 a2, ARG3 a3) {
-  Ptr<CallbackImpl<R,T1,T2,T3,T4,empty,empty,empty,empty,empty> > impl =
-    Create<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3,T1,T2,T3,T4),R,TX1,TX2,TX3,T1,T2,T3,T4,empty,empty> > (fnPtr, a1, a2, a3);
-  return Callback<R,T1,T2,T3,T4> (impl);
+  return Callback<R,T1,T2,T3,T4>::template FromImpl<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3,T1,T2,T3,T4),R,TX1,TX2,TX3,T1,T2,T3,T4,empty,empty> > (fnPtr, a1, a2, a3);
 }
 template <typename R, typename TX1, typename TX2, typename TX3, typename ARG1, typename ARG2, typename ARG3,
           typename T1, typename T2,typename T3,typename T4,typename T5>
 Callback<R,T1,T2,T3,T4,T5> MakeBoundCallback (R (*fnPtr)(TX1,TX2,TX3,T1,T2,T3,T4,T5), ARG1 a1, ARG2 a2, ARG3 a3) {
-  Ptr<CallbackImpl<R,T1,T2,T3,T4,T5,empty,empty,empty,empty> > impl =
-    Create<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3,T1,T2,T3,T4,T5),R,TX1,TX2,TX3,T1,T2,T3,T4,T5,empty> > (fnPtr, a1, a2, a3);
-  return Callback<R,T1,T2,T3,T4,T5> (impl);
+  return Callback<R,T1,T2,T3,T4,T5>::template FromImpl<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3,T1,T2,T3,T4,T5),R,TX1,TX2,TX3,T1,T2,T3,T4,T5,empty> > (fnPtr, a1, a2, a3);
 }
 template <typename R, typename TX1, typename TX2, typename TX3, typename ARG1, typename ARG2, typename ARG3,
           typename T1, typename T2,typename T3,typename T4,typename T5, typename T6>
 Callback<R,T1,T2,T3,T4,T5,T6> MakeBoundCallback (R (*fnPtr)(TX1,TX2,TX3,T1,T2,T3,T4,T5,T6), ARG1 a1, ARG2 a2, ARG3 a3) {
-  Ptr<CallbackImpl<R,T1,T2,T3,T4,T5,T6,empty,empty,empty> > impl =
-    Create<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3,T1,T2,T3,T4,T5,T6),R,TX1,TX2,TX3,T1,T2,T3,T4,T5,T6> > (fnPtr, a1, a2, a3);
-  return Callback<R,T1,T2,T3,T4,T5,T6> (impl);
+  return Callback<R,T1,T2,T3,T4,T5,T6>::template FromImpl<ThreeBoundFunctorCallbackImpl<R (*)(TX1,TX2,TX3,T1,T2,T3,T4,T5,T6),R,TX1,TX2,TX3,T1,T2,T3,T4,T5,T6> > (fnPtr, a1, a2, a3);
 }
 /**@}*/
 
@@ -27,6 +27,8 @@
 #include "pointer.h"
 #include "assert.h"
 #include "log.h"
+#include "sim-profiler.h"
+#include "simulation-arena.h"
 
 #include <cmath>
 
@@ -61,10 +63,10 @@ DefaultSimulatorImpl::DefaultSimulatorImpl ()
   m_uid = 4;
   // before ::Run is entered, the m_currentUid will be zero
   m_currentUid = 0;
+  m_eventCount = 0;
   m_currentTs = 0;
   m_currentContext = 0xffffffff;
   m_unscheduledEvents = 0;
-  m_eventsWithContextEmpty = true;
 #if HAVE_PTHREAD_H
   m_main = SystemThread::Self();
 #endif
@@ -85,6 +87,13 @@ DefaultSimulatorImpl::DoDispose (void)
       next.impl->Unref ();
     }
   m_events = 0;
+  m_eventsWithContextBatch.clear ();
+  m_eventsWithContext.PopAll (m_eventsWithContextBatch);
+  for (size_t i = 0; i < m_eventsWithContextBatch.size (); i++)
+    {
+      m_eventsWithContextBatch[i].event->Unref ();
+    }
+  m_eventsWithContextBatch.clear ();
   SimulatorImpl::DoDispose ();
 }
 void
@@ -139,7 +148,14 @@ DefaultSimulatorImpl::ProcessOneEvent (void)
   m_currentTs = next.key.m_ts;
   m_currentContext = next.key.m_context;
   m_currentUid = next.key.m_uid;
+  m_eventCount++;
+#ifdef NS3_SIM_PROFILER
+  uint64_t start = SimProfiler::ReadClock ();
   next.impl->Invoke ();
+  SimProfiler::AddEvent (typeid (*next.impl), SimProfiler::ReadClock () - start);
+#else
+  next.impl->Invoke ();
+#endif
   next.impl->Unref ();
 
   ProcessEventsWithContext ();
@@ -154,33 +170,26 @@ DefaultSimulatorImpl::IsFinished (void) const
 void
 DefaultSimulatorImpl::ProcessEventsWithContext (void)
 {
-  if (m_eventsWithContextEmpty)
+  if (m_eventsWithContext.IsEmpty ())
     {
       return;
     }
 
-  // swap queues
-  EventsWithContext eventsWithContext;
-  {
-#ifdef HAVE_PTHREAD_H 
-    CriticalSection cs (m_eventsWithContextMutex);
-#endif
-    m_eventsWithContext.swap(eventsWithContext);
-    m_eventsWithContextEmpty = true;
-  }
-  while (!eventsWithContext.empty ())
+  m_eventsWithContextBatch.clear ();
+  m_eventsWithContext.PopAll (m_eventsWithContextBatch);
+  for (size_t i = 0; i < m_eventsWithContextBatch.size (); i++)
     {
-       EventWithContext event = eventsWithContext.front ();
-       eventsWithContext.pop_front ();
-       Scheduler::Event ev;
-       ev.impl = event.event;
-       ev.key.m_ts = m_currentTs + event.timestamp;
-       ev.key.m_context = event.context;
-       ev.key.m_uid = m_uid;
-       m_uid++;
-       m_unscheduledEvents++;
-       m_events->Insert (ev);
+      const EventWithContext &event = m_eventsWithContextBatch[i];
+      Scheduler::Event ev;
+      ev.impl = event.event;
+      ev.key.m_ts = m_currentTs + event.timestamp;
+      ev.key.m_context = event.context;
+      ev.key.m_uid = m_uid;
+      m_uid++;
+      m_unscheduledEvents++;
+      m_events->Insert (ev);
     }
+  m_eventsWithContextBatch.clear ();
 }
 
 void
@@ -263,15 +272,16 @@ DefaultSimulatorImpl::ScheduleWithContext (uint32_t context, Time const &time, E
     }
   else
     {
+      // the event was made on this thread, from pools that only the main thread may use
+      if (SimulationArena::IsEnabled ())
+        {
+          NS_FATAL_ERROR ("ScheduleWithContext from another thread with SimulationArena enabled");
+        }
       EventWithContext ev;
       ev.context = context;
       ev.timestamp = time.GetTimeStep ();
       ev.event = event;
-      {
-        CriticalSection cs (m_eventsWithContextMutex);
-        m_eventsWithContext.push_back(ev);
-        m_eventsWithContextEmpty = false;
-      }
+      m_eventsWithContext.Push (ev);
     }
 }
 #else
@@ -431,4 +441,10 @@ DefaultSimulatorImpl::GetContext (void) const
   return m_currentContext;
 }
 
+uint64_t
+DefaultSimulatorImpl::GetEventCount (void) const
+{
+  return m_eventCount;
+}
+
 } // namespace ns3
@@ -24,14 +24,15 @@
 #include "simulator-impl.h"
 #include "scheduler.h"
 #include "event-impl.h"
+#include "mpsc-queue.h"
 #if HAVE_PTHREAD_H
 #include "system-thread.h"
-#include "ns3/system-mutex.h"
 #endif
 
 #include "ptr.h"
 
 #include <list>
+#include <vector>
 
 namespace ns3 {
 
@@ -64,6 +65,7 @@ public:
   virtual void SetScheduler (ObjectFactory schedulerFactory);
   virtual uint32_t GetSystemId (void) const; 
   virtual uint32_t GetContext (void) const;
+  virtual uint64_t GetEventCount (void) const;
 
 private:
   virtual void DoDispose (void);
@@ -75,12 +77,10 @@ private:
     uint64_t timestamp;
     EventImpl *event;
   };
-  typedef std::list<struct EventWithContext> EventsWithContext;
-  EventsWithContext m_eventsWithContext;
-  bool m_eventsWithContextEmpty;
-#ifdef HAVE_PTHREAD_H 
-  SystemMutex m_eventsWithContextMutex;
-#endif
+  // pushed by the other threads without a lock, drained by the main thread
+  // after each event
+  MpscQueue<EventWithContext> m_eventsWithContext;
+  std::vector<EventWithContext> m_eventsWithContextBatch;
 
   typedef std::list<EventId> DestroyEvents;
   DestroyEvents m_destroyEvents;
@@ -91,6 +91,7 @@ private:
   uint32_t m_currentUid;
   uint64_t m_currentTs;
   uint32_t m_currentContext;
+  uint64_t m_eventCount;
   // number of events that have been inserted but not yet scheduled,
   // not counting the "destroy" events; this is used for validation
   int m_unscheduledEvents;
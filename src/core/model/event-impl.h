@@ -22,6 +22,7 @@
 
 #include <stdint.h>
 #include "simple-ref-count.h"
+#include "simulation-arena.h"
 
 namespace ns3 {
 
@@ -41,6 +42,7 @@ class EventImpl : public SimpleRefCount<EventImpl>
 public:
   EventImpl ();
   virtual ~EventImpl () = 0;
+  NS_SLAB_POOLED (EventImpl);
   /**
    * Called by the simulation engine to notify the event that it has expired.
    */
@@ -0,0 +1,113 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup core
+ * \brief Lock-free queue from any number of threads to one consumer thread.
+ *
+ * Producers push onto a linked stack with one compare-and-swap; the
+ * consumer takes the whole stack with one exchange and reverses it, so
+ * items come out in the order their pushes took effect. Nodes are never
+ * popped one at a time, so the stack has no ABA problem. IsEmpty is a
+ * single relaxed load, cheap enough for the consumer to call after every
+ * event.
+ */
+template <typename T>
+class MpscQueue
+{
+public:
+  MpscQueue ()
+    : m_head (0)
+  {
+  }
+  ~MpscQueue ()
+  {
+    Node *node = m_head.exchange (0, std::memory_order_acquire);
+    while (node != 0)
+      {
+        Node *next = node->next;
+        delete node;
+        node = next;
+      }
+  }
+
+  /**
+   * Add item; any thread
+   * \param item the item
+   */
+  void Push (const T &item)
+  {
+    Node *node = new Node;
+    node->item = item;
+    node->next = m_head.load (std::memory_order_relaxed);
+    while (!m_head.compare_exchange_weak (node->next, node,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed))
+      {
+      }
+  }
+  /**
+   * \return true if nothing was pushed since the last PopAll; a hint when
+   * called by a producer
+   */
+  bool IsEmpty (void) const
+  {
+    return m_head.load (std::memory_order_relaxed) == 0;
+  }
+  /**
+   * Append all the items to items, oldest first; consumer thread only
+   * \param items where to append
+   */
+  void PopAll (std::vector<T> &items)
+  {
+    Node *node = m_head.exchange (0, std::memory_order_acquire);
+    size_t first = items.size ();
+    while (node != 0)
+      {
+        Node *next = node->next;
+        items.push_back (node->item);
+        delete node;
+        node = next;
+      }
+    std::reverse (items.begin () + first, items.end ());
+  }
+
+private:
+  MpscQueue (const MpscQueue &);
+  MpscQueue &operator = (const MpscQueue &);
+
+  struct Node
+  {
+    T item;
+    Node *next;
+  };
+  std::atomic<Node *> m_head;
+};
+
+} // namespace ns3
+
+#endif /* MPSC_QUEUE_H */
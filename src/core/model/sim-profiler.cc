@@ -0,0 +1,370 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sim-profiler.h"
+#include "fatal-error.h"
+
+#include <cxxabi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+SimProfiler::Entry SimProfiler::g_entries[SimProfiler::MAX_ENTRIES];
+uint32_t SimProfiler::g_nEntries = 0;
+
+namespace {
+
+const uint32_t kBuckets = 40;  // log2 of ns
+
+struct EventStats
+{
+  uint64_t ticks;
+  uint64_t count;
+  uint64_t hist[kBuckets];
+};
+
+struct Record
+{
+  uint64_t start;
+  uint64_t end;
+  uint32_t id;                  // timer id, or MAX_ENTRIES for an event
+  const std::type_info *type;   // of the event
+};
+
+// clock origin, to convert ticks into wall time
+struct Origin
+{
+  Origin ()
+    : ticks (SimProfiler::ReadClock ()),
+      wall (std::chrono::steady_clock::now ())
+  {
+  }
+  uint64_t ticks;
+  std::chrono::steady_clock::time_point wall;
+} g_origin;
+
+std::unordered_map<const std::type_info *, EventStats> g_events;
+std::vector<Record> g_records;
+uint32_t g_maxRecords = 0;
+
+// ticks per ns since the origin
+double
+TicksPerNs (void)
+{
+  uint64_t ticks = SimProfiler::ReadClock () - g_origin.ticks;
+  double ns = std::chrono::duration_cast<std::chrono::nanoseconds> (
+      std::chrono::steady_clock::now () - g_origin.wall).count ();
+  return ns > 0 && ticks > 0 ? ticks / ns : 1.0;
+}
+
+std::string
+Demangle (const std::type_info *type)
+{
+  int status = 0;
+  char *name = abi::__cxa_demangle (type->name (), 0, 0, &status);
+  if (name == 0)
+    {
+      return type->name ();
+    }
+  std::string retval = name;
+  free (name);
+  return retval;
+}
+
+// "void (ns3::QbbNetDevice::*)()" for an event made by MakeEvent of that function
+std::string
+EventName (const std::type_info *type)
+{
+  std::string name = Demangle (type);
+  size_t i = name.find ("MakeEvent");
+  if (i == std::string::npos)
+    {
+      return name;
+    }
+  // skip the template arguments, then keep the first function argument
+  int depth = 0;
+  for (i += strlen ("MakeEvent"); i < name.size (); i++)
+    {
+      depth += name[i] == '<' ? 1 : name[i] == '>' ? -1 : 0;
+      if (depth == 0 && name[i] == '(')
+        {
+          break;
+        }
+    }
+  size_t start = ++i;
+  for (depth = 0; i < name.size (); i++)
+    {
+      char c = name[i];
+      depth += (c == '<' || c == '(') ? 1 : (c == '>' || c == ')') ? -1 : 0;
+      if (depth < 0 || (depth == 0 && c == ','))
+        {
+          break;
+        }
+    }
+  return i > start ? name.substr (start, i - start) : name;
+}
+
+std::string
+Category (const char *name)
+{
+  const char *slash = strchr (name, '/');
+  return slash != 0 ? std::string (name, slash - name) : std::string (name);
+}
+
+// JSON string body
+std::string
+Escape (const std::string &s)
+{
+  std::string retval;
+  for (size_t i = 0; i < s.size (); i++)
+    {
+      if (s[i] == '"' || s[i] == '\\')
+        {
+          retval += '\\';
+        }
+      retval += s[i];
+    }
+  return retval;
+}
+
+} // anonymous namespace
+
+bool
+SimProfiler::IsEnabled (void)
+{
+#ifdef NS3_SIM_PROFILER
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint32_t
+SimProfiler::Register (const char *name)
+{
+  for (uint32_t i = 0; i < g_nEntries; i++)
+    {
+      if (strcmp (g_entries[i].name, name) == 0)
+        {
+          return i;
+        }
+    }
+  if (g_nEntries == MAX_ENTRIES)
+    {
+      NS_FATAL_ERROR ("SimProfiler: more than " << MAX_ENTRIES << " timers and counters");
+    }
+  g_entries[g_nEntries].name = name;
+  return g_nEntries++;
+}
+
+void
+SimProfiler::EndScope (uint32_t id, uint64_t start)
+{
+  uint64_t end = ReadClock ();
+  g_entries[id].ticks += end - start;
+  g_entries[id].count++;
+  if (g_records.size () < g_maxRecords)
+    {
+      Record r = { start, end, id, 0 };
+      g_records.push_back (r);
+    }
+}
+
+void
+SimProfiler::AddEvent (const std::type_info &type, uint64_t ticks)
+{
+  EventStats &stats = g_events[&type];
+  stats.ticks += ticks;
+  stats.count++;
+  // bucket of the duration, assuming ~1 tick per ns; rescaled in Report
+  uint32_t bucket = 0;
+  for (uint64_t t = ticks; t > 1 && bucket < kBuckets - 1; t >>= 1)
+    {
+      bucket++;
+    }
+  stats.hist[bucket]++;
+  if (g_records.size () < g_maxRecords)
+    {
+      uint64_t end = ReadClock ();
+      Record r = { end - ticks, end, MAX_ENTRIES, &type };
+      g_records.push_back (r);
+    }
+}
+
+void
+SimProfiler::EnableTrace (uint32_t maxRecords)
+{
+  g_maxRecords = maxRecords;
+  g_records.reserve (std::min (maxRecords, (uint32_t)(1 << 20)));
+}
+
+bool
+SimProfiler::WriteTrace (const std::string &file)
+{
+  std::ofstream os (file.c_str ());
+  if (!os.good ())
+    {
+      return false;
+    }
+  double ticksPerUs = TicksPerNs () * 1000;
+  std::map<const std::type_info *, std::string> names;
+  os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::endl;
+  os << std::fixed << std::setprecision (3);
+  for (size_t i = 0; i < g_records.size (); i++)
+    {
+      const Record &r = g_records[i];
+      std::string name, cat;
+      if (r.id == MAX_ENTRIES)
+        {
+          if (names.find (r.type) == names.end ())
+            {
+              names[r.type] = Escape (EventName (r.type));
+            }
+          name = names[r.type];
+          cat = "event";
+        }
+      else
+        {
+          name = Escape (g_entries[r.id].name);
+          cat = Escape (Category (g_entries[r.id].name));
+        }
+      os << (i > 0 ? ",\n" : "") << "{\"name\":\"" << name << "\",\"cat\":\"" << cat
+         << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+         << (r.start - g_origin.ticks) / ticksPerUs
+         << ",\"dur\":" << (r.end - r.start) / ticksPerUs << "}";
+    }
+  os << std::endl << "]}" << std::endl;
+  return os.good ();
+}
+
+void
+SimProfiler::Report (std::ostream &os, uint32_t maxEventTypes)
+{
+  if (!IsEnabled ())
+    {
+      return;
+    }
+  double ticksPerNs = TicksPerNs ();
+  double wallMs = std::chrono::duration_cast<std::chrono::microseconds> (
+      std::chrono::steady_clock::now () - g_origin.wall).count () / 1000.0;
+  std::ios::fmtflags flags = os.flags ();
+  os << std::fixed << std::setprecision (1);
+  os << "Profile: " << wallMs << " ms of wall time, " << ticksPerNs << " ticks/ns" << std::endl;
+
+  std::map<std::string, uint64_t> categories;
+  os << std::left << std::setw (32) << "timer" << std::right << std::setw (12) << "calls"
+     << std::setw (12) << "ms" << std::setw (10) << "ns/call" << std::setw (8) << "%"
+     << std::endl;
+  for (uint32_t i = 0; i < g_nEntries; i++)
+    {
+      const Entry &e = g_entries[i];
+      if (e.ticks == 0)
+        {
+          continue;
+        }
+      double ms = e.ticks / ticksPerNs / 1e6;
+      os << std::left << std::setw (32) << e.name << std::right << std::setw (12) << e.count
+         << std::setw (12) << ms << std::setw (10) << ms * 1e6 / std::max (e.count, (uint64_t)1)
+         << std::setw (8) << 100 * ms / wallMs << std::endl;
+      categories[Category (e.name)] += e.ticks;
+    }
+  for (std::map<std::string, uint64_t>::iterator i = categories.begin ();
+       i != categories.end (); i++)
+    {
+      double ms = i->second / ticksPerNs / 1e6;
+      os << std::left << std::setw (32) << (i->first + " (all)") << std::right << std::setw (12)
+         << "" << std::setw (12) << ms << std::setw (10) << "" << std::setw (8)
+         << 100 * ms / wallMs << std::endl;
+    }
+
+  os << std::left << std::setw (32) << "counter" << std::right << std::setw (12) << "count"
+     << std::endl;
+  for (uint32_t i = 0; i < g_nEntries; i++)
+    {
+      const Entry &e = g_entries[i];
+      if (e.ticks == 0 && e.count > 0)
+        {
+          os << std::left << std::setw (32) << e.name << std::right << std::setw (12) << e.count
+             << std::endl;
+        }
+    }
+
+  // event types by total time
+  std::vector<std::pair<uint64_t, const std::type_info *> > order;
+  uint64_t eventTicks = 0;
+  for (std::unordered_map<const std::type_info *, EventStats>::iterator i = g_events.begin ();
+       i != g_events.end (); i++)
+    {
+      order.push_back (std::make_pair (i->second.ticks, i->first));
+      eventTicks += i->second.ticks;
+    }
+  std::sort (order.rbegin (), order.rend ());
+  if (!order.empty ())
+    {
+      os << "events: " << eventTicks / ticksPerNs / 1e6 << " ms in " << order.size ()
+         << " event types, the " << std::min ((size_t)maxEventTypes, order.size ())
+         << " most expensive (p50/p99: upper bound of the power-of-2 bucket, in ns):"
+         << std::endl;
+    }
+  for (size_t k = 0; k < order.size () && k < maxEventTypes; k++)
+    {
+      const EventStats &stats = g_events[order[k].second];
+      uint64_t p50 = 0, p99 = 0, seen = 0;
+      for (uint32_t b = 0; b < kBuckets; b++)
+        {
+          seen += stats.hist[b];
+          uint64_t bound = (uint64_t)((2ull << b) / ticksPerNs);
+          if (p50 == 0 && seen * 2 >= stats.count)
+            {
+              p50 = bound;
+            }
+          if (p99 == 0 && seen * 100 >= stats.count * 99)
+            {
+              p99 = bound;
+            }
+        }
+      double ms = stats.ticks / ticksPerNs / 1e6;
+      os << std::setw (12) << stats.count << std::setw (12) << ms << std::setw (8)
+         << 100 * ms / wallMs << "%" << std::setw (8) << p50 << std::setw (8) << p99 << "  "
+         << EventName (order[k].second) << std::endl;
+    }
+  os.flags (flags);
+}
+
+void
+SimProfiler::Reset (void)
+{
+  for (uint32_t i = 0; i < g_nEntries; i++)
+    {
+      g_entries[i].ticks = 0;
+      g_entries[i].count = 0;
+    }
+  g_events.clear ();
+  g_records.clear ();
+}
+
+} // namespace ns3
@@ -0,0 +1,170 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SIM_PROFILER_H
+#define SIM_PROFILER_H
+
+#include "ns3/core-config.h"
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+
+#if defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/**
+ * \ingroup core
+ * \defgroup simprofiler Simulation profiler
+ *
+ * Where the wall time of a run goes: scoped timers and counters placed on
+ * the packet path, and the time spent in every type of event run by the
+ * default simulator. Built only with `waf configure --enable-sim-profiler'
+ * (which defines NS3_SIM_PROFILER in core-config.h); otherwise
+ * NS_PROFILE_SCOPE and NS_PROFILE_COUNT expand to nothing.
+ *
+ * Names are "<category>/<what>", e.g. "lb/conweave" or "cc/hpcc ack";
+ * the report sums timers per category (switch, lb, cc, nic, queue). Scopes
+ * nest, so the time of an inner scope is also part of the outer one.
+ */
+
+#ifdef NS3_SIM_PROFILER
+
+#define NS_PROFILE_CAT2(a, b) a ## b
+#define NS_PROFILE_CAT(a, b) NS_PROFILE_CAT2 (a, b)
+
+/**
+ * \ingroup simprofiler
+ * Time the rest of the enclosing scope under name.
+ */
+#define NS_PROFILE_SCOPE(name)                                          \
+  static const uint32_t NS_PROFILE_CAT (ns_profile_id_, __LINE__) =     \
+    ns3::SimProfiler::Register (name);                                  \
+  ns3::SimProfilerScope NS_PROFILE_CAT (ns_profile_scope_, __LINE__)    \
+    (NS_PROFILE_CAT (ns_profile_id_, __LINE__))
+
+/**
+ * \ingroup simprofiler
+ * Add n to the counter name.
+ */
+#define NS_PROFILE_COUNT(name, n)                                       \
+  do                                                                    \
+    {                                                                   \
+      static const uint32_t ns_profile_id = ns3::SimProfiler::Register (name); \
+      ns3::SimProfiler::AddCount (ns_profile_id, n);                    \
+    }                                                                   \
+  while (false)
+
+#else /* NS3_SIM_PROFILER */
+
+#define NS_PROFILE_SCOPE(name)
+#define NS_PROFILE_COUNT(name, n)
+
+#endif /* NS3_SIM_PROFILER */
+
+namespace ns3 {
+
+/**
+ * \ingroup simprofiler
+ * \brief Process-wide store of the profiler timers, counters and event times.
+ */
+class SimProfiler
+{
+public:
+  // whether the profiler was compiled in
+  static bool IsEnabled (void);
+
+  // CPU timestamp counter (ns where there is none)
+  static inline uint64_t ReadClock (void);
+
+  // id of the timer/counter name, registered on first use
+  static uint32_t Register (const char *name);
+  static inline void AddCount (uint32_t id, uint64_t n);
+  static void EndScope (uint32_t id, uint64_t start);
+  // time of one event, keyed by the type of its EventImpl: the signature of
+  // the function MakeEvent binds, so same-signature targets share a row
+  static void AddEvent (const std::type_info &type, uint64_t ticks);
+
+  // keep up to maxRecords scopes and events for WriteTrace
+  static void EnableTrace (uint32_t maxRecords);
+  // Chrome trace event format, loads in chrome://tracing and ui.perfetto.dev
+  static bool WriteTrace (const std::string &file);
+  // timers per name and category, counters, and the most expensive event types
+  static void Report (std::ostream &os, uint32_t maxEventTypes = 20);
+  static void Reset (void);
+
+  static const uint32_t MAX_ENTRIES = 256;
+
+private:
+  struct Entry
+  {
+    const char *name;
+    uint64_t ticks;
+    uint64_t count;
+  };
+  static Entry g_entries[MAX_ENTRIES];
+  static uint32_t g_nEntries;
+};
+
+/**
+ * \ingroup simprofiler
+ * \brief Times its lifetime, see NS_PROFILE_SCOPE.
+ */
+class SimProfilerScope
+{
+public:
+  explicit SimProfilerScope (uint32_t id)
+    : m_id (id),
+      m_start (SimProfiler::ReadClock ())
+  {
+  }
+  ~SimProfilerScope ()
+  {
+    SimProfiler::EndScope (m_id, m_start);
+  }
+
+private:
+  uint32_t m_id;
+  uint64_t m_start;
+};
+
+uint64_t
+SimProfiler::ReadClock (void)
+{
+#if defined (__x86_64__) || defined (__i386__)
+  return __rdtsc ();
+#else
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+void
+SimProfiler::AddCount (uint32_t id, uint64_t n)
+{
+  g_entries[id].count += n;
+}
+
+} // namespace ns3
+
+#endif /* SIM_PROFILER_H */
@@ -0,0 +1,235 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "simulation-arena.h"
+#include "boolean.h"
+#include "global-value.h"
+#include "log.h"
+
+#include <cxxabi.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+NS_LOG_COMPONENT_DEFINE ("SimulationArena");
+
+namespace ns3 {
+
+static GlobalValue g_simulationArena ("SimulationArena",
+                                      "Allocate events, packets, queue pairs and flowlets "
+                                      "from slab pools (read once, at the first allocation). "
+                                      "Single-threaded runs only",
+                                      BooleanValue (false),
+                                      MakeBooleanChecker ());
+
+int SimulationArena::g_enabled = -1;
+
+namespace {
+
+const uint32_t kAlign = 16;
+const uint32_t kSizeClasses = SimulationArena::MAX_SIZE / kAlign;
+
+// never destroyed, like the pools
+std::vector<SlabPool *> &
+Pools (void)
+{
+  static std::vector<SlabPool *> *pools = new std::vector<SlabPool *> ();
+  return *pools;
+}
+
+SlabPool *
+SizeClass (size_t size)
+{
+  static SlabPool *classes[kSizeClasses] = { 0 };
+  uint32_t i = (size + kAlign - 1) / kAlign - 1;
+  if (classes[i] == 0)
+    {
+      std::ostringstream name;
+      name << "arena/" << (i + 1) * kAlign;
+      classes[i] = new SlabPool (name.str (), (i + 1) * kAlign);
+    }
+  return classes[i];
+}
+
+} // anonymous namespace
+
+SlabPool::SlabPool (const std::string &name, uint32_t objectSize)
+  : m_name (name),
+    m_objectSize ((objectSize + kAlign - 1) / kAlign * kAlign),
+    m_free (0),
+    m_allocs (0),
+    m_live (0),
+    m_peakLive (0)
+{
+  SimulationArena::Register (this);
+}
+
+void
+SlabPool::Grow (void)
+{
+  // a chunk of CHUNK_SIZE bytes, or one slot if larger; malloc aligns it to 16
+  uint32_t n = std::max (SimulationArena::CHUNK_SIZE / m_objectSize, 1u);
+  char *chunk = static_cast<char *> (malloc ((size_t)n * m_objectSize));
+  if (chunk == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  m_chunks.push_back (chunk);
+  for (uint32_t i = n; i-- > 0;)
+    {
+      FreeSlot *slot = reinterpret_cast<FreeSlot *> (chunk + (size_t)i * m_objectSize);
+      slot->next = m_free;
+      m_free = slot;
+    }
+}
+
+bool
+SlabPool::Release (void)
+{
+  if (m_live > 0)
+    {
+      return false;
+    }
+  for (size_t i = 0; i < m_chunks.size (); i++)
+    {
+      free (m_chunks[i]);
+    }
+  m_chunks.clear ();
+  m_free = 0;
+  return true;
+}
+
+SlabPoolStats
+SlabPool::GetStats (void) const
+{
+  SlabPoolStats stats;
+  stats.name = m_name;
+  stats.objectSize = m_objectSize;
+  stats.allocs = m_allocs;
+  stats.live = m_live;
+  stats.peakLive = m_peakLive;
+  stats.chunkBytes = (uint64_t)m_chunks.size ()
+    * std::max (SimulationArena::CHUNK_SIZE / m_objectSize, 1u) * m_objectSize;
+  return stats;
+}
+
+bool
+SimulationArena::ReadEnabled (void)
+{
+  BooleanValue value;
+  g_simulationArena.GetValue (value);
+  NS_LOG_INFO ("simulation arena " << (value.Get () ? "enabled" : "disabled"));
+  return value.Get ();
+}
+
+void *
+SimulationArena::Allocate (size_t size)
+{
+  if (size == 0 || size > MAX_SIZE)
+    {
+      return ::operator new (size);
+    }
+  return SizeClass (size)->Allocate ();
+}
+
+void
+SimulationArena::Deallocate (void *p, size_t size)
+{
+  if (size == 0 || size > MAX_SIZE)
+    {
+      ::operator delete (p);
+      return;
+    }
+  SizeClass (size)->Deallocate (p);
+}
+
+void
+SimulationArena::Release (void)
+{
+  if (g_enabled <= 0)
+    {
+      return;
+    }
+  std::vector<SlabPool *> &pools = Pools ();
+  for (size_t i = 0; i < pools.size (); i++)
+    {
+      if (!pools[i]->Release ())
+        {
+          SlabPoolStats stats = pools[i]->GetStats ();
+          NS_LOG_INFO ("pool " << stats.name << " kept: " << stats.live << " live objects");
+        }
+    }
+}
+
+std::vector<SlabPoolStats>
+SimulationArena::GetStats (void)
+{
+  std::vector<SlabPoolStats> stats;
+  std::vector<SlabPool *> &pools = Pools ();
+  for (size_t i = 0; i < pools.size (); i++)
+    {
+      stats.push_back (pools[i]->GetStats ());
+    }
+  return stats;
+}
+
+void
+SimulationArena::Report (std::ostream &os)
+{
+  std::vector<SlabPoolStats> stats = GetStats ();
+  std::ios::fmtflags flags = os.flags ();
+  os << std::left << std::setw (32) << "pool" << std::right << std::setw (6) << "size"
+     << std::setw (12) << "allocs" << std::setw (10) << "live" << std::setw (10) << "peak"
+     << std::setw (10) << "KB" << std::endl;
+  for (size_t i = 0; i < stats.size (); i++)
+    {
+      const SlabPoolStats &s = stats[i];
+      if (s.allocs == 0)
+        {
+          continue;
+        }
+      os << std::left << std::setw (32) << s.name << std::right << std::setw (6)
+         << s.objectSize << std::setw (12) << s.allocs << std::setw (10) << s.live
+         << std::setw (10) << s.peakLive << std::setw (10) << s.chunkBytes / 1024 << std::endl;
+    }
+  os.flags (flags);
+}
+
+void
+SimulationArena::Register (SlabPool *pool)
+{
+  Pools ().push_back (pool);
+}
+
+std::string
+SimulationArena::GetTypeName (const char *name)
+{
+  int status = 0;
+  char *demangled = abi::__cxa_demangle (name, 0, 0, &status);
+  if (demangled == 0)
+    {
+      return name;
+    }
+  std::string retval = demangled;
+  free (demangled);
+  return retval;
+}
+
+} // namespace ns3
@@ -0,0 +1,250 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SIMULATION_ARENA_H
+#define SIMULATION_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+/**
+ * \ingroup core
+ * \defgroup arena Simulation arena
+ *
+ * Slab pools for the objects a run creates and destroys by the million
+ * (events, packets, queue pairs, flowlets). A class opts in with
+ * NS_SLAB_POOLED in its public section; its objects then come from a pool
+ * of fixed-size slots carved out of large chunks, and a freed object goes
+ * back on the free list of its pool. Subclasses of different size, e.g.
+ * the EventImpl made by each MakeEvent, share pools of 16-byte size
+ * classes.
+ *
+ * The pools are used only if the global value "SimulationArena" is true
+ * when the first pooled object is allocated (it is read once, then fixed
+ * for the process); otherwise the objects are allocated with the global
+ * operator new as before. The pools are not thread-safe: do not enable the
+ * arena with the realtime or the distributed simulator.
+ *
+ * Nor with other threads that schedule events through
+ * Simulator::ScheduleWithContext: MakeEvent builds the event, and any packet
+ * it carries, from the pools on the calling thread.
+ * DefaultSimulatorImpl stops with a fatal error when an event arrives from
+ * another thread while the arena is enabled.
+ *
+ * Simulator::Destroy releases the chunks of every pool with no live
+ * object in bulk.
+ */
+
+/**
+ * \ingroup arena
+ * Allocate the objects of type from a slab pool when the arena is enabled.
+ * Put in the public section of type.
+ */
+#define NS_SLAB_POOLED(type)                                            \
+  static void *operator new (size_t size)                               \
+  {                                                                     \
+    return ns3::SlabAllocator<type>::Allocate (size);                   \
+  }                                                                     \
+  static void operator delete (void *p, size_t size)                    \
+  {                                                                     \
+    ns3::SlabAllocator<type>::Deallocate (p, size);                     \
+  }
+
+namespace ns3 {
+
+/**
+ * \ingroup arena
+ * \brief Counters of one pool.
+ */
+struct SlabPoolStats
+{
+  std::string name;     // type, or "arena/<size>" for a size class
+  uint32_t objectSize;  // bytes per slot, a multiple of 16
+  uint64_t allocs;      // objects allocated so far
+  uint64_t live;        // objects not freed yet
+  uint64_t peakLive;
+  uint64_t chunkBytes;  // memory held by the pool
+};
+
+/**
+ * \ingroup arena
+ * \brief Fixed-size slots in chunks, with a free list.
+ */
+class SlabPool
+{
+public:
+  SlabPool (const std::string &name, uint32_t objectSize);
+
+  inline void *Allocate (void);
+  inline void Deallocate (void *p);
+  // free all the chunks if no object is live; false otherwise
+  bool Release (void);
+  SlabPoolStats GetStats (void) const;
+
+private:
+  struct FreeSlot
+  {
+    FreeSlot *next;
+  };
+  void Grow (void);
+
+  std::string m_name;
+  uint32_t m_objectSize;
+  FreeSlot *m_free;
+  std::vector<void *> m_chunks;
+  uint64_t m_allocs;
+  uint64_t m_live;
+  uint64_t m_peakLive;
+};
+
+/**
+ * \ingroup arena
+ * \brief The pools of the process: the switch, the size classes, release and stats.
+ */
+class SimulationArena
+{
+public:
+  // whether the pools are used; "SimulationArena" is read on the first call
+  static inline bool IsEnabled (void);
+  // objects of any size, from the pool of their size class (global new above MAX_SIZE)
+  static void *Allocate (size_t size);
+  static void Deallocate (void *p, size_t size);
+  // free the chunks of every pool with no live object, called by Simulator::Destroy
+  static void Release (void);
+  static std::vector<SlabPoolStats> GetStats (void);
+  // one line per pool that was used
+  static void Report (std::ostream &os);
+
+  static void Register (SlabPool *pool);
+  // readable name of a type_info name
+  static std::string GetTypeName (const char *name);
+
+  static const uint32_t MAX_SIZE = 512;  // largest size class
+  static const uint32_t CHUNK_SIZE = 256 * 1024;
+
+private:
+  static bool ReadEnabled (void);
+  static int g_enabled;  // -1 until read
+};
+
+/**
+ * \ingroup arena
+ * \brief The slab pool of the objects of type T, see NS_SLAB_POOLED.
+ */
+template <typename T>
+class SlabAllocator
+{
+public:
+  static void *Allocate (size_t size);
+  static void Deallocate (void *p, size_t size);
+
+private:
+  static SlabPool *GetPool (void);
+};
+
+void *
+SlabPool::Allocate (void)
+{
+  if (m_free == 0)
+    {
+      Grow ();
+    }
+  FreeSlot *slot = m_free;
+  m_free = slot->next;
+  m_allocs++;
+  if (++m_live > m_peakLive)
+    {
+      m_peakLive = m_live;
+    }
+  return slot;
+}
+
+void
+SlabPool::Deallocate (void *p)
+{
+  FreeSlot *slot = static_cast<FreeSlot *> (p);
+  slot->next = m_free;
+  m_free = slot;
+  m_live--;
+}
+
+bool
+SimulationArena::IsEnabled (void)
+{
+  if (g_enabled < 0)
+    {
+      g_enabled = ReadEnabled ();
+    }
+  return g_enabled;
+}
+
+template <typename T>
+void *
+SlabAllocator<T>::Allocate (size_t size)
+{
+  if (!SimulationArena::IsEnabled ())
+    {
+      return ::operator new (size);
+    }
+  if (size != sizeof (T))
+    {
+      return SimulationArena::Allocate (size);  // a subclass
+    }
+  return GetPool ()->Allocate ();
+}
+
+template <typename T>
+void
+SlabAllocator<T>::Deallocate (void *p, size_t size)
+{
+  if (p == 0)
+    {
+      return;
+    }
+  if (!SimulationArena::IsEnabled ())
+    {
+      ::operator delete (p);
+    }
+  else if (size != sizeof (T))
+    {
+      SimulationArena::Deallocate (p, size);
+    }
+  else
+    {
+      GetPool ()->Deallocate (p);
+    }
+}
+
+template <typename T>
+SlabPool *
+SlabAllocator<T>::GetPool (void)
+{
+  // never destroyed: objects may be freed by static destructors
+  static SlabPool *pool =
+    new SlabPool (SimulationArena::GetTypeName (typeid (T).name ()), sizeof (T));
+  return pool;
+}
+
+} // namespace ns3
+
+#endif /* SIMULATION_ARENA_H */
@@ -23,6 +23,7 @@
 #include "scheduler.h"
 #include "map-scheduler.h"
 #include "event-impl.h"
+#include "simulation-arena.h"
 
 #include "ptr.h"
 #include "string.h"
@@ -137,6 +138,7 @@ Simulator::Destroy (void)
   (*pimpl)->Destroy ();
   (*pimpl)->Unref ();
   *pimpl = 0;
+  SimulationArena::Release ();
 }
 
 void
@@ -302,6 +304,12 @@ Simulator::GetContext (void)
   return GetImpl ()->GetContext ();
 }
 
+uint64_t
+Simulator::GetEventCount (void)
+{
+  return GetImpl ()->GetEventCount ();
+}
+
 uint32_t
 Simulator::GetSystemId (void)
 {
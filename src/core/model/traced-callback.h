@@ -22,8 +22,32 @@
 #define TRACED_CALLBACK_H
 
 #include <list>
+#include <vector>
+#include "ns3/core-config.h"
 #include "callback.h"
 
+/**
+ * \ingroup tracing
+ * Fire the per-packet trace source trace with the parenthesized args,
+ * e.g. NS_PACKET_TRACE (m_traceDequeue, (p, qIndex)), only if a sink is
+ * connected, so that the arguments are not built for nobody. The sites
+ * are compiled out when the build is configured with --packet-traces=no,
+ * the default of the release profile.
+ */
+#ifdef NS3_NO_PACKET_TRACES
+#define NS_PACKET_TRACE(trace, args) do { } while (false)
+#else
+#define NS_PACKET_TRACE(trace, args)                                    \
+  do                                                                    \
+    {                                                                   \
+      if (!(trace).IsEmpty ())                                          \
+        {                                                               \
+          (trace) args;                                                 \
+        }                                                               \
+    }                                                                   \
+  while (false)
+#endif
+
 namespace ns3 {
 
 /**
@@ -78,6 +102,11 @@ public:
    * of the TracedCallback::Connect method.
    */
   void Disconnect (const CallbackBase & callback, std::string path);
+  /**
+   * \returns true if no callback is connected, so that callers can skip
+   * building the arguments of a trace nobody listens to; see NS_PACKET_TRACE.
+   */
+  bool IsEmpty (void) const { return m_callbackList.empty (); }
   void operator() (void) const;
   void operator() (T1 a1) const;
   void operator() (T1 a1, T2 a2) const;
@@ -89,7 +118,7 @@ public:
   void operator() (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5, T6 a6, T7 a7, T8 a8) const;
 
 private:
-  typedef std::list<Callback<void,T1,T2,T3,T4,T5,T6,T7,T8> > CallbackList;
+  typedef std::vector<Callback<void,T1,T2,T3,T4,T5,T6,T7,T8> > CallbackList;
   CallbackList m_callbackList;
 };
 
@@ -169,10 +198,10 @@ template<typename T1, typename T2,
 void 
 TracedCallback<T1,T2,T3,T4,T5,T6,T7,T8>::operator() (void) const
 {
-  for (typename CallbackList::const_iterator i = m_callbackList.begin ();
-       i != m_callbackList.end (); i++)
+  // by index: a sink may connect another one
+  for (size_t i = 0; i < m_callbackList.size (); i++)
     {
-      (*i)();
+      m_callbackList[i] ();
     }
 }
 template<typename T1, typename T2, 
@@ -182,10 +211,10 @@ template<typename T1, typename T2,
 void 
 TracedCallback<T1,T2,T3,T4,T5,T6,T7,T8>::operator() (T1 a1) const
 {
-  for (typename CallbackList::const_iterator i = m_callbackList.begin ();
-       i != m_callbackList.end (); i++)
+  // by index: a sink may connect another one
+  for (size_t i = 0; i < m_callbackList.size (); i++)
     {
-      (*i)(a1);
+      m_callbackList[i] (a1);
     }
 }
 template<typename T1, typename T2, 
@@ -195,10 +224,10 @@ template<typename T1, typename T2,
 void 
 TracedCallback<T1,T2,T3,T4,T5,T6,T7,T8>::operator() (T1 a1, T2 a2) const
 {
-  for (typename CallbackList::const_iterator i = m_callbackList.begin ();
-       i != m_callbackList.end (); i++)
+  // by index: a sink may connect another one
+  for (size_t i = 0; i < m_callbackList.size (); i++)
     {
-      (*i)(a1, a2);
+      m_callbackList[i] (a1, a2);
     }
 }
 template<typename T1, typename T2, 
@@ -208,10 +237,10 @@ template<typename T1, typename T2,
 void 
 TracedCallback<T1,T2,T3,T4,T5,T6,T7,T8>::operator() (T1 a1, T2 a2, T3 a3) const
 {
-  for (typename CallbackList::const_iterator i = m_callbackList.begin ();
-       i != m_callbackList.end (); i++)
+  // by index: a sink may connect another one
+  for (size_t i = 0; i < m_callbackList.size (); i++)
     {
-      (*i)(a1, a2, a3);
+      m_callbackList[i] (a1, a2, a3);
     }
 }
 template<typename T1, typename T2, 
@@ -221,10 +250,10 @@ template<typename T1, typename T2,
 void 
 TracedCallback<T1,T2,T3,T4,T5,T6,T7,T8>::operator() (T1 a1, T2 a2, T3 a3, T4 a4) const
 {
-  for (typename CallbackList::const_iterator i = m_callbackList.begin ();
-       i != m_callbackList.end (); i++)
+  // by index: a sink may connect another one
+  for (size_t i = 0; i < m_callbackList.size (); i++)
     {
-      (*i)(a1, a2, a3, a4);
+      m_callbackList[i] (a1, a2, a3, a4);
     }
 }
 template<typename T1, typename T2, 
@@ -234,10 +263,10 @@ template<typename T1, typename T2,
 void 
 TracedCallback<T1,T2,T3,T4,T5,T6,T7,T8>::operator() (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5) const
 {
-  for (typename CallbackList::const_iterator i = m_callbackList.begin ();
-       i != m_callbackList.end (); i++)
+  // by index: a sink may connect another one
+  for (size_t i = 0; i < m_callbackList.size (); i++)
     {
-      (*i)(a1, a2, a3, a4, a5);
+      m_callbackList[i] (a1, a2, a3, a4, a5);
     }
 }
 template<typename T1, typename T2, 
@@ -247,10 +276,10 @@ template<typename T1, typename T2,
 void 
 TracedCallback<T1,T2,T3,T4,T5,T6,T7,T8>::operator() (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5, T6 a6) const
 {
-  for (typename CallbackList::const_iterator i = m_callbackList.begin ();
-       i != m_callbackList.end (); i++)
+  // by index: a sink may connect another one
+  for (size_t i = 0; i < m_callbackList.size (); i++)
     {
-      (*i)(a1, a2, a3, a4, a5, a6);
+      m_callbackList[i] (a1, a2, a3, a4, a5, a6);
     }
 }
 template<typename T1, typename T2, 
@@ -260,10 +289,10 @@ template<typename T1, typename T2,
 void 
 TracedCallback<T1,T2,T3,T4,T5,T6,T7,T8>::operator() (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5, T6 a6, T7 a7) const
 {
-  for (typename CallbackList::const_iterator i = m_callbackList.begin ();
-       i != m_callbackList.end (); i++)
+  // by index: a sink may connect another one
+  for (size_t i = 0; i < m_callbackList.size (); i++)
     {
-      (*i)(a1, a2, a3, a4, a5, a6, a7);
+      m_callbackList[i] (a1, a2, a3, a4, a5, a6, a7);
     }
 }
 template<typename T1, typename T2, 
@@ -273,10 +302,10 @@ template<typename T1, typename T2,
 void 
 TracedCallback<T1,T2,T3,T4,T5,T6,T7,T8>::operator() (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5, T6 a6, T7 a7, T8 a8) const
 {
-  for (typename CallbackList::const_iterator i = m_callbackList.begin ();
-       i != m_callbackList.end (); i++)
+  // by index: a sink may connect another one
+  for (size_t i = 0; i < m_callbackList.size (); i++)
     {
-      (*i)(a1, a2, a3, a4, a5, a6, a7, a8);
+      m_callbackList[i] (a1, a2, a3, a4, a5, a6, a7, a8);
     }
 }
 
@@ -18,6 +18,7 @@
 
 #include "ns3/test.h"
 #include "ns3/callback.h"
+#include "ns3/traced-callback.h"
 #include <stdint.h>
 
 namespace ns3 {
@@ -556,6 +557,253 @@ MakeCallbackTemplatesTestCase::DoRun (void)
   that.CheckParentalRights ();
 }
 
+// ===========================================================================
+// Test copying inline and heap Callbacks
+// ===========================================================================
+class CopyCallbackTestCase : public TestCase
+{
+public:
+  CopyCallbackTestCase ();
+  virtual ~CopyCallbackTestCase () {}
+
+  void Target1 (int a) { m_sum += a; }
+  void Target2 (int a, int b) { m_sum += a * b; }
+
+private:
+  virtual void DoRun (void);
+
+  int m_sum;
+};
+
+/**
+ * \param cb the Callback
+ * \return true if the implementation of cb lives inside cb
+ */
+static bool
+CallbackIsInline (const CallbackBase &cb)
+{
+  const char *p = reinterpret_cast<const char *> (cb.PeekImpl ());
+  const char *begin = reinterpret_cast<const char *> (&cb);
+  return p >= begin && p < begin + sizeof (cb);
+}
+
+CopyCallbackTestCase::CopyCallbackTestCase ()
+  : TestCase ("Check copy and assignment of inline and heap Callbacks")
+{
+}
+
+void
+CopyCallbackTestCase::DoRun (void)
+{
+  m_sum = 0;
+
+  //
+  // A member function with its object fits the inline buffer: a copy gets
+  // its own implementation, equal to the original.
+  //
+  Callback<void, int> inlineCopy;
+  Callback<void, int> inlineAssigned;
+  {
+    Callback<void, int> orig = MakeCallback (&CopyCallbackTestCase::Target1, this);
+    NS_TEST_ASSERT_MSG_EQ (CallbackIsInline (orig), true, "Member function callback not inline");
+
+    Callback<void, int> copy (orig);
+    NS_TEST_ASSERT_MSG_EQ (CallbackIsInline (copy), true, "Copy of an inline callback not inline");
+    bool shared = copy.PeekImpl () == orig.PeekImpl ();
+    NS_TEST_ASSERT_MSG_EQ (shared, false, "Copy of an inline callback shares the implementation");
+    NS_TEST_ASSERT_MSG_EQ (copy.IsEqual (orig), true, "Copy of an inline callback not equal to it");
+    NS_TEST_ASSERT_MSG_EQ (orig.IsEqual (copy), true, "Inline callback not equal to its copy");
+
+    inlineAssigned = orig;
+    NS_TEST_ASSERT_MSG_EQ (CallbackIsInline (inlineAssigned), true, "Assigned inline callback not inline");
+    NS_TEST_ASSERT_MSG_EQ (inlineAssigned.IsEqual (orig), true, "Assigned inline callback not equal");
+    inlineCopy = copy;
+  }
+  // the originals are gone
+  inlineCopy (1);
+  inlineAssigned (2);
+  NS_TEST_ASSERT_MSG_EQ (m_sum, 3, "Copies of an inline callback did not outlive it");
+
+  Callback<void, int> other = MakeCallback (&CopyCallbackTestCase::Target2, this).Bind (1);
+  NS_TEST_ASSERT_MSG_EQ (inlineCopy.IsEqual (other), false, "Different callbacks compare equal");
+
+  //
+  // Binding an argument to a Callback wraps the whole Callback, which does
+  // not fit the inline buffer: copies share the heap implementation.
+  //
+  Callback<void, int> heapCopy;
+  Callback<void, int> heapAssigned;
+  {
+    Callback<void, int, int> two = MakeCallback (&CopyCallbackTestCase::Target2, this);
+    Callback<void, int> orig = two.Bind (10);
+    NS_TEST_ASSERT_MSG_EQ (CallbackIsInline (orig), false, "Bound Callback unexpectedly inline");
+    uint32_t refs = orig.PeekImpl ()->GetReferenceCount ();
+
+    Callback<void, int> copy (orig);
+    NS_TEST_ASSERT_MSG_EQ (CallbackIsInline (copy), false, "Copy of a heap callback inline");
+    bool shared = copy.PeekImpl () == orig.PeekImpl ();
+    NS_TEST_ASSERT_MSG_EQ (shared, true, "Copy of a heap callback does not share the implementation");
+    NS_TEST_ASSERT_MSG_EQ (orig.PeekImpl ()->GetReferenceCount (), refs + 1, "Copy took no reference");
+    NS_TEST_ASSERT_MSG_EQ (copy.IsEqual (orig), true, "Copy of a heap callback not equal to it");
+
+    heapAssigned = orig;
+    NS_TEST_ASSERT_MSG_EQ (orig.PeekImpl ()->GetReferenceCount (), refs + 2, "Assignment took no reference");
+    heapCopy = copy;
+  }
+  NS_TEST_ASSERT_MSG_EQ (heapCopy.PeekImpl ()->GetReferenceCount (), 2, "References of the originals not dropped");
+  m_sum = 0;
+  heapCopy (1);
+  heapAssigned (2);
+  NS_TEST_ASSERT_MSG_EQ (m_sum, 30, "Copies of a heap callback did not outlive it");
+
+  //
+  // Self-assignment keeps the callback; assignment across the two kinds
+  // releases the old implementation.
+  //
+  Callback<void, int> &inlineAlias = inlineCopy;
+  inlineCopy = inlineAlias;
+  Callback<void, int> &heapAlias = heapCopy;
+  heapCopy = heapAlias;
+  NS_TEST_ASSERT_MSG_EQ (CallbackIsInline (inlineCopy), true, "Self-assigned inline callback not inline");
+  NS_TEST_ASSERT_MSG_EQ (heapCopy.PeekImpl ()->GetReferenceCount (), 2, "Self-assignment changed the references");
+  m_sum = 0;
+  inlineCopy (1);
+  heapCopy (1);
+  NS_TEST_ASSERT_MSG_EQ (m_sum, 11, "Self-assignment broke a callback");
+
+  heapAssigned = inlineCopy;
+  NS_TEST_ASSERT_MSG_EQ (CallbackIsInline (heapAssigned), true, "Inline callback assigned over a heap one not inline");
+  NS_TEST_ASSERT_MSG_EQ (heapCopy.PeekImpl ()->GetReferenceCount (), 1, "Assignment did not drop the reference");
+  inlineAssigned = heapCopy;
+  NS_TEST_ASSERT_MSG_EQ (CallbackIsInline (inlineAssigned), false, "Heap callback assigned over an inline one inline");
+  m_sum = 0;
+  heapAssigned (1);
+  inlineAssigned (1);
+  NS_TEST_ASSERT_MSG_EQ (m_sum, 11, "Assignment across kinds broke a callback");
+}
+
+// ===========================================================================
+// Test Assign and CheckType, directly and through CallbackValue
+// ===========================================================================
+class AssignCallbackTestCase : public TestCase
+{
+public:
+  AssignCallbackTestCase ();
+  virtual ~AssignCallbackTestCase () {}
+
+  void Target (int a) { m_sum += a; }
+
+private:
+  virtual void DoRun (void);
+
+  int m_sum;
+};
+
+AssignCallbackTestCase::AssignCallbackTestCase ()
+  : TestCase ("Check Assign and CheckType through CallbackValue")
+{
+}
+
+void
+AssignCallbackTestCase::DoRun (void)
+{
+  m_sum = 0;
+  Callback<void, int> cb = MakeCallback (&AssignCallbackTestCase::Target, this);
+  Callback<void, int> sameType;
+  Callback<void, double> otherType;
+
+  NS_TEST_ASSERT_MSG_EQ (sameType.CheckType (cb), true, "CheckType rejects the same signature");
+  NS_TEST_ASSERT_MSG_EQ (otherType.CheckType (cb), false, "CheckType accepts another signature");
+  NS_TEST_ASSERT_MSG_EQ (otherType.CheckType (sameType), true, "CheckType rejects a null callback");
+  sameType.Assign (cb);
+  NS_TEST_ASSERT_MSG_EQ (sameType.IsEqual (cb), true, "Assign did not copy the callback");
+
+  CallbackValue value (cb);
+  Callback<void, int> got;
+  NS_TEST_ASSERT_MSG_EQ (value.GetAccessor (got), true, "CallbackValue rejects the same signature");
+  NS_TEST_ASSERT_MSG_EQ (got.IsEqual (cb), true, "CallbackValue returned another callback");
+  NS_TEST_ASSERT_MSG_EQ (value.GetAccessor (otherType), false, "CallbackValue accepts another signature");
+  NS_TEST_ASSERT_MSG_EQ (otherType.IsNull (), true, "Rejected CallbackValue changed the callback");
+
+  // the value holds its own copy: it outlives the callback it was set from
+  Ptr<AttributeValue> copy;
+  {
+    Callback<void, int> scoped = MakeCallback (&AssignCallbackTestCase::Target, this);
+    CallbackValue scopedValue;
+    scopedValue.Set (scoped);
+    copy = scopedValue.Copy ();
+  }
+  Callback<void, int> fromCopy;
+  NS_TEST_ASSERT_MSG_EQ (DynamicCast<CallbackValue> (copy)->GetAccessor (fromCopy), true,
+                         "Copied CallbackValue rejects the same signature");
+  got (1);
+  fromCopy (2);
+  NS_TEST_ASSERT_MSG_EQ (m_sum, 3, "Callback from a CallbackValue not invoked");
+}
+
+// ===========================================================================
+// Test TracedCallback Connect and Disconnect with inline sinks
+// ===========================================================================
+class TracedInlineCallbackTestCase : public TestCase
+{
+public:
+  TracedInlineCallbackTestCase ();
+  virtual ~TracedInlineCallbackTestCase () {}
+
+  void Sink (int a) { m_sum += a; }
+  void OtherSink (int a) { m_sum += 10 * a; }
+  void ContextSink (std::string context, int a) { m_sum += 100 * a; m_context = context; }
+
+private:
+  virtual void DoRun (void);
+
+  int m_sum;
+  std::string m_context;
+};
+
+TracedInlineCallbackTestCase::TracedInlineCallbackTestCase ()
+  : TestCase ("Check TracedCallback Connect and Disconnect with inline sinks")
+{
+}
+
+void
+TracedInlineCallbackTestCase::DoRun (void)
+{
+  m_sum = 0;
+  TracedCallback<int> trace;
+  Callback<void, int> sink = MakeCallback (&TracedInlineCallbackTestCase::Sink, this);
+  Callback<void, int> otherSink = MakeCallback (&TracedInlineCallbackTestCase::OtherSink, this);
+  NS_TEST_ASSERT_MSG_EQ (CallbackIsInline (sink), true, "Sink not inline");
+
+  // the list copies the sinks as it grows
+  trace.ConnectWithoutContext (sink);
+  trace.ConnectWithoutContext (otherSink);
+  trace.ConnectWithoutContext (sink);
+  trace.Connect (MakeCallback (&TracedInlineCallbackTestCase::ContextSink, this), "/a");
+  trace (1);
+  NS_TEST_ASSERT_MSG_EQ (m_sum, 112, "Connected sinks not all invoked");
+  NS_TEST_ASSERT_MSG_EQ (m_context, "/a", "Context not passed to the sink");
+
+  // an equal copy disconnects every connection of the sink
+  Callback<void, int> sinkCopy = sink;
+  trace.DisconnectWithoutContext (sinkCopy);
+  m_sum = 0;
+  trace (1);
+  NS_TEST_ASSERT_MSG_EQ (m_sum, 110, "Sink still connected");
+
+  trace.Disconnect (MakeCallback (&TracedInlineCallbackTestCase::ContextSink, this), "/b");
+  m_sum = 0;
+  trace (1);
+  NS_TEST_ASSERT_MSG_EQ (m_sum, 110, "Sink with another context disconnected");
+
+  trace.Disconnect (MakeCallback (&TracedInlineCallbackTestCase::ContextSink, this), "/a");
+  trace.DisconnectWithoutContext (otherSink);
+  NS_TEST_ASSERT_MSG_EQ (trace.IsEmpty (), true, "Sinks left connected");
+  m_sum = 0;
+  trace (1);
+  NS_TEST_ASSERT_MSG_EQ (m_sum, 0, "Disconnected sink invoked");
+}
+
 // ===========================================================================
 // The Test Suite that glues all of the Test Cases together.
 // ===========================================================================
@@ -573,6 +821,9 @@ CallbackTestSuite::CallbackTestSuite ()
   AddTestCase (new MakeBoundCallbackTestCase);
   AddTestCase (new NullifyCallbackTestCase);
   AddTestCase (new MakeCallbackTemplatesTestCase);
+  AddTestCase (new CopyCallbackTestCase);
+  AddTestCase (new AssignCallbackTestCase);
+  AddTestCase (new TracedInlineCallbackTestCase);
 }
 
 static CallbackTestSuite CallbackTestSuite;
@@ -47,6 +47,9 @@ namespace ns3 {
 
 
 uint32_t Buffer::g_recommendedStart = 0;
+uint64_t Buffer::g_nBuffers = 0;
+uint64_t Buffer::g_nReallocations = 0;
+uint64_t Buffer::g_nAllocations = 0;
 #ifdef BUFFER_FREE_LIST
 /* The following macros are pretty evil but they are needed to allow us to
  * keep track of 3 possible states for the g_freeList variable:
@@ -71,7 +74,6 @@ uint32_t Buffer::g_recommendedStart = 0;
 #define IS_INITIALIZED(x) (!IS_UNINITIALIZED (x) && !IS_DESTROYED (x))
 #define DESTROYED ((Buffer::FreeList*)MAGIC_DESTROYED)
 #define UNINITIALIZED ((Buffer::FreeList*)0)
-uint32_t Buffer::g_maxSize = 0;
 Buffer::FreeList *Buffer::g_freeList = 0;
 struct Buffer::LocalStaticDestructor Buffer::g_localStaticDestructor;
 
@@ -79,59 +81,72 @@ Buffer::LocalStaticDestructor::~LocalStaticDestructor(void)
 {
   if (IS_INITIALIZED (g_freeList))
     {
-      for (Buffer::FreeList::iterator i = g_freeList->begin ();
-           i != g_freeList->end (); i++)
+      for (uint32_t sizeClass = 0; sizeClass < N_SIZE_CLASSES; sizeClass++)
         {
-          Buffer::Deallocate (*i);
+          FreeList &freeList = g_freeList[sizeClass];
+          for (Buffer::FreeList::iterator i = freeList.begin ();
+               i != freeList.end (); i++)
+            {
+              Buffer::Deallocate (*i);
+            }
         }
-      delete g_freeList;
+      delete [] g_freeList;
       g_freeList = DESTROYED;
     }
 }
 
+uint32_t
+Buffer::GetSizeClass (uint32_t size)
+{
+  if (size <= (1U << MIN_SIZE_CLASS_SHIFT))
+    {
+      return 0;
+    }
+  // ceil (log2 (size)) - MIN_SIZE_CLASS_SHIFT
+  return 32 - __builtin_clz (size - 1) - MIN_SIZE_CLASS_SHIFT;
+}
+
 void
 Buffer::Recycle (struct Buffer::Data *data)
 {
   NS_ASSERT (data->m_count == 0);
-  NS_ASSERT (!IS_UNINITIALIZED (g_freeList));
-  g_maxSize = std::max (g_maxSize, data->m_size);
-  /* feed into free list */
-  if (data->m_size < g_maxSize ||
-      IS_DESTROYED (g_freeList) ||
-      g_freeList->size () > 1000)
+  uint32_t sizeClass = GetSizeClass (data->m_size);
+  /* feed into the free list of its size class, without limit: the lists
+   * hold at most the peak number of buffers of each class
+   */
+  if (sizeClass >= N_SIZE_CLASSES ||
+      data->m_size != (1U << (sizeClass + MIN_SIZE_CLASS_SHIFT)) ||
+      !IS_INITIALIZED (g_freeList))
     {
       Buffer::Deallocate (data);
     }
   else
     {
-      NS_ASSERT (IS_INITIALIZED (g_freeList));
-      g_freeList->push_back (data);
+      g_freeList[sizeClass].push_back (data);
     }
 }
 
 Buffer::Data *
 Buffer::Create (uint32_t dataSize)
 {
-  /* try to find a buffer correctly sized. */
+  uint32_t sizeClass = GetSizeClass (dataSize);
+  if (sizeClass >= N_SIZE_CLASSES)
+    {
+      return Buffer::Allocate (dataSize);
+    }
   if (IS_UNINITIALIZED (g_freeList))
     {
-      g_freeList = new Buffer::FreeList ();
+      g_freeList = new Buffer::FreeList [N_SIZE_CLASSES];
     }
-  else if (IS_INITIALIZED (g_freeList))
+  else if (IS_INITIALIZED (g_freeList) && !g_freeList[sizeClass].empty ())
     {
-      while (!g_freeList->empty ()) 
-        {
-          struct Buffer::Data *data = g_freeList->back ();
-          g_freeList->pop_back ();
-          if (data->m_size >= dataSize) 
-            {
-              data->m_count = 1;
-              return data;
-            }
-          Buffer::Deallocate (data);
-        }
+      struct Buffer::Data *data = g_freeList[sizeClass].back ();
+      g_freeList[sizeClass].pop_back ();
+      data->m_count = 1;
+      return data;
     }
-  struct Buffer::Data *data = Buffer::Allocate (dataSize);
+  /* round up to the size class, so that it can be recycled */
+  struct Buffer::Data *data = Buffer::Allocate (1U << (sizeClass + MIN_SIZE_CLASS_SHIFT));
   NS_ASSERT (data->m_count == 1);
   return data;
 }
@@ -159,6 +174,7 @@ Buffer::Allocate (uint32_t reqSize)
     }
   NS_ASSERT (reqSize >= 1);
   uint32_t size = reqSize - 1 + sizeof (struct Buffer::Data);
+  g_nAllocations++;
   uint8_t *b = new uint8_t [size];
   struct Buffer::Data *data = reinterpret_cast<struct Buffer::Data*>(b);
   data->m_size = reqSize;
@@ -195,6 +211,30 @@ Buffer::Buffer (uint32_t dataSize, bool initialize)
     }
 }
 
+Buffer::Buffer (uint32_t dataSize, uint32_t headroom)
+{
+  NS_LOG_FUNCTION (this << dataSize << headroom);
+  Initialize (dataSize, headroom);
+}
+
+uint64_t
+Buffer::GetNBuffers (void)
+{
+  return g_nBuffers;
+}
+
+uint64_t
+Buffer::GetNReallocations (void)
+{
+  return g_nReallocations;
+}
+
+uint64_t
+Buffer::GetNAllocations (void)
+{
+  return g_nAllocations;
+}
+
 bool
 Buffer::CheckInternalState (void) const
 {
@@ -231,9 +271,16 @@ Buffer::CheckInternalState (void) const
 void
 Buffer::Initialize (uint32_t zeroSize)
 {
-  NS_LOG_FUNCTION (this << zeroSize);
-  m_data = Buffer::Create (0);
-  m_start = std::min (m_data->m_size, g_recommendedStart);
+  Initialize (zeroSize, g_recommendedStart);
+}
+
+void
+Buffer::Initialize (uint32_t zeroSize, uint32_t headroom)
+{
+  NS_LOG_FUNCTION (this << zeroSize << headroom);
+  g_nBuffers++;
+  m_data = Buffer::Create (headroom);
+  m_start = headroom;
   m_maxZeroAreaStart = m_start;
   m_zeroAreaStart = m_start;
   m_zeroAreaEnd = m_zeroAreaStart + zeroSize;
@@ -315,6 +362,7 @@ Buffer::AddAtStart (uint32_t start)
   else
     {
       uint32_t newSize = GetInternalSize () + start;
+      g_nReallocations++;
       struct Buffer::Data *newData = Buffer::Create (newSize);
       memcpy (newData->m_data + start, m_data->m_data + m_start, GetInternalSize ());
       m_data->m_count--;
@@ -368,6 +416,7 @@ Buffer::AddAtEnd (uint32_t end)
   else
     {
       uint32_t newSize = GetInternalSize () + end;
+      g_nReallocations++;
       struct Buffer::Data *newData = Buffer::Create (newSize);
       memcpy (newData->m_data, m_data->m_data + m_start, GetInternalSize ());
       m_data->m_count--;
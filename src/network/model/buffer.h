@@ -25,7 +25,7 @@
 #include <ostream>
 #include "ns3/assert.h"
 
-#define noBUFFER_FREE_LIST 1
+#define BUFFER_FREE_LIST 1
 
 namespace ns3 {
 
@@ -37,10 +37,12 @@ namespace ns3 {
  * This represents a buffer of bytes. Its size is
  * automatically adjusted to hold any data prepended
  * or appended by the user. Its implementation is optimized
- * to ensure that the number of buffer resizes is minimized,
- * by creating new Buffers of the maximum size ever used.
- * The correct maximum size is learned at runtime during use by 
- * recording the maximum size of each packet.
+ * to ensure that the number of buffer resizes is minimized:
+ * a new Buffer reserves room at the start for the largest
+ * header stack ever prepended, as learned at runtime, or for
+ * the headroom given to its constructor when the caller knows
+ * its header stack. The real byte buffers are recycled through
+ * free lists, one per power-of-two size class.
  *
  * \internal
  * The implementation of the Buffer class uses a COW (Copy On Write)
@@ -530,7 +532,30 @@ private:
   Buffer ();
   Buffer (uint32_t dataSize);
   Buffer (uint32_t dataSize, bool initialize);
+  /**
+   * \param dataSize the size of the zero area
+   * \param headroom the bytes to reserve in front of the zero area: data
+   *        of up to that size can then be added at the start without
+   *        reallocating the buffer
+   */
+  Buffer (uint32_t dataSize, uint32_t headroom);
   ~Buffer ();
+
+  /**
+   * \returns the number of buffers created so far (copies excluded)
+   */
+  static uint64_t GetNBuffers (void);
+  /**
+   * \returns the number of times so far a buffer moved its bytes to a new,
+   * larger real byte buffer because it had no room left at the start or
+   * at the end
+   */
+  static uint64_t GetNReallocations (void);
+  /**
+   * \returns the number of real byte buffers allocated so far, that is,
+   * not taken from a free list
+   */
+  static uint64_t GetNAllocations (void);
 private:
   /**
    * This data structure is variable-sized through its last member whose size
@@ -572,6 +597,7 @@ private:
   void TransformIntoRealBuffer (void) const;
   bool CheckInternalState (void) const;
   void Initialize (uint32_t zeroSize);
+  void Initialize (uint32_t zeroSize, uint32_t headroom);
   uint32_t GetInternalSize (void) const;
   uint32_t GetInternalEnd (void) const;
   static void Recycle (struct Buffer::Data *data);
@@ -598,6 +624,10 @@ private:
    */
   static uint32_t g_recommendedStart;
 
+  static uint64_t g_nBuffers;
+  static uint64_t g_nReallocations;
+  static uint64_t g_nAllocations;
+
   /* offset to the start of the virtual zero area from the start 
    * of m_data->m_data
    */
@@ -616,12 +646,17 @@ private:
   uint32_t m_end;
 
 #ifdef BUFFER_FREE_LIST
+  /* real byte buffers of 32 << i bytes are recycled in g_freeList[i];
+   * larger ones are freed
+   */
+  static const uint32_t MIN_SIZE_CLASS_SHIFT = 5;
+  static const uint32_t N_SIZE_CLASSES = 12;
   typedef std::vector<struct Buffer::Data*> FreeList;
   struct LocalStaticDestructor 
   {
     ~LocalStaticDestructor ();
   };
-  static uint32_t g_maxSize;
+  static uint32_t GetSizeClass (uint32_t size);
   static FreeList *g_freeList;
   static struct LocalStaticDestructor g_localStaticDestructor;
 #endif
@@ -36,6 +36,7 @@ bool PacketMetadata::m_enableChecking = false;
 bool PacketMetadata::m_metadataSkipped = false;
 uint32_t PacketMetadata::m_maxSize = 0;
 uint16_t PacketMetadata::m_chunkUid = 0;
+struct PacketMetadata::Data *PacketMetadata::m_empty = 0;
 PacketMetadata::DataFreeList PacketMetadata::m_freeList;
 
 PacketMetadata::DataFreeList::~DataFreeList ()
@@ -337,6 +337,7 @@ public:
 
 
   static struct PacketMetadata::Data *Create (uint32_t size);
+  static inline struct PacketMetadata::Data *ShareEmpty (void);
   static void Recycle (struct PacketMetadata::Data *data);
   static struct PacketMetadata::Data *Allocate (uint32_t n);
   static void Deallocate (struct PacketMetadata::Data *data);
@@ -353,6 +354,10 @@ public:
   static uint32_t m_maxSize;
   static uint16_t m_chunkUid;
 
+  // shared by all the packets while m_enable is false, so that they do
+  // not allocate; never freed
+  static struct Data *m_empty;
+
   struct Data *m_data;
   /**
      head -(next)-> tail
@@ -369,14 +374,31 @@ public:
 
 namespace ns3 {
 
+struct PacketMetadata::Data *
+PacketMetadata::ShareEmpty (void)
+{
+  if (m_empty == 0)
+    {
+      // no room and a count never back to zero: a packet that adds
+      // metadata to it copies it first
+      m_empty = PacketMetadata::Allocate (10);
+      m_empty->m_size = 0;
+    }
+  m_empty->m_count++;
+  return m_empty;
+}
+
 PacketMetadata::PacketMetadata (uint64_t uid, uint32_t size)
-  : m_data (PacketMetadata::Create (10)),
+  : m_data (m_enable ? PacketMetadata::Create (10) : PacketMetadata::ShareEmpty ()),
     m_head (0xffff),
     m_tail (0xffff),
     m_used (0),
     m_packetUid (uid)
 {
-  memset (m_data->m_data, 0xff, 4);
+  if (m_enable)
+    {
+      memset (m_data->m_data, 0xff, 4);
+    }
   if (size > 0)
     {
       DoAddHeader (0, size);
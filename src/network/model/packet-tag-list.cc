@@ -28,104 +28,140 @@ NS_LOG_COMPONENT_DEFINE ("PacketTagList");
 
 namespace ns3 {
 
-#ifdef USE_FREE_LIST
+namespace {
+// blocks of 64, 128, 256 and 512 bytes are recycled, without limit as in
+// Buffer: the lists hold at most the peak number of blocks of each class.
+// A free block starts with a pointer to the next free block of its class.
+const uint32_t kSizeClasses = 4;
+void *g_free[kSizeClasses];
+// set once the static destructors of this file ran: blocks freed later,
+// by packets that outlive them, go back to the heap
+bool g_freeDestroyed;
+}
 
-struct PacketTagList::TagData *PacketTagList::g_free = 0;
-uint32_t PacketTagList::g_nfree = 0;
+struct PacketTagList::LocalStaticDestructor PacketTagList::g_localStaticDestructor;
 
-struct PacketTagList::TagData *
-PacketTagList::AllocData (void) const
+PacketTagList::LocalStaticDestructor::~LocalStaticDestructor (void)
+{
+  for (uint32_t sizeClass = 0; sizeClass < kSizeClasses; sizeClass++)
+    {
+      while (g_free[sizeClass] != 0)
+        {
+          void *block = g_free[sizeClass];
+          g_free[sizeClass] = *static_cast<void **> (block);
+          ::operator delete (block);
+        }
+    }
+  g_freeDestroyed = true;
+}
+
+struct PacketTagList::TagBlock *
+PacketTagList::AllocBlock (uint32_t capacity)
 {
-  NS_LOG_FUNCTION (g_nfree);
-  struct PacketTagList::TagData *retval;
-  if (g_free != 0) 
+  uint32_t size = sizeof (struct TagBlock) + capacity;
+  uint32_t sizeClass = 0;
+  while (sizeClass < kSizeClasses && (64u << sizeClass) < size)
     {
-      retval = g_free;
-      g_free = g_free->m_next;
-      g_nfree--;
-    } 
-  else 
+      sizeClass++;
+    }
+  struct TagBlock *block;
+  if (sizeClass < kSizeClasses)
     {
-      retval = new struct PacketTagList::TagData ();
+      size = 64u << sizeClass;
+      if (g_free[sizeClass] != 0)
+        {
+          block = static_cast<struct TagBlock *> (g_free[sizeClass]);
+          g_free[sizeClass] = *static_cast<void **> (g_free[sizeClass]);
+        }
+      else
+        {
+          block = static_cast<struct TagBlock *> (::operator new (size));
+        }
     }
-  return retval;
+  else
+    {
+      block = static_cast<struct TagBlock *> (::operator new (size));
+    }
+  NS_LOG_FUNCTION (capacity << block);
+  block->count = 1;
+  block->used = 0;
+  block->capacity = size - sizeof (struct TagBlock);
+  block->sizeClass = sizeClass;
+  return block;
 }
 
 void
-PacketTagList::FreeData (struct TagData *data) const
+PacketTagList::FreeBlock (struct TagBlock *block)
 {
-  NS_LOG_FUNCTION (g_nfree << data);
-  if (g_nfree > 1000) 
+  NS_LOG_FUNCTION (block);
+  NS_ASSERT (block->count == 0);
+  uint32_t sizeClass = block->sizeClass;
+  if (sizeClass < kSizeClasses && !g_freeDestroyed)
     {
-      delete data;
+      *reinterpret_cast<void **> (block) = g_free[sizeClass];
+      g_free[sizeClass] = block;
       return;
     }
-  g_nfree++;
-  data->next = g_free;
-  data->tid = TypeId ();
-  g_free = data;
-}
-#else
-struct PacketTagList::TagData *
-PacketTagList::AllocData (void) const
-{
-  NS_LOG_FUNCTION_NOARGS ();
-  struct PacketTagList::TagData *retval;
-  retval = new struct PacketTagList::TagData ();
-  return retval;
+  ::operator delete (block);
 }
 
-void
-PacketTagList::FreeData (struct TagData *data) const
+struct PacketTagList::TagData *
+PacketTagList::Find (TypeId tid) const
 {
-  NS_LOG_FUNCTION (data);
-  delete data;
+  if (m_block == 0)
+    {
+      return 0;
+    }
+  uint8_t *cur = Entries (m_block);
+  uint8_t *end = cur + m_block->used;
+  while (cur < end)
+    {
+      struct TagData *data = reinterpret_cast<struct TagData *> (cur);
+      if (data->tid == tid)
+        {
+          return data;
+        }
+      cur += EntrySize (data->size);
+    }
+  return 0;
 }
-#endif
 
 bool
 PacketTagList::Remove (Tag &tag)
 {
   NS_LOG_FUNCTION (this << tag.GetInstanceTypeId ());
-  TypeId tid = tag.GetInstanceTypeId ();
-  bool found = false;
-  for (struct TagData *cur = m_next; cur != 0; cur = cur->next) 
+  struct TagData *data = Find (tag.GetInstanceTypeId ());
+  if (data == 0) 
     {
-      if (cur->tid == tid) 
-        {
-          found = true;
-          tag.Deserialize (TagBuffer (cur->data, cur->data+PACKET_TAG_MAX_SIZE));
-        }
+      return false;
     }
-  if (!found) 
+  tag.Deserialize (TagBuffer (data->data, data->data + data->size));
+  uint32_t entrySize = EntrySize (data->size);
+  uint32_t used = m_block->used - entrySize;
+  if (used == 0)
     {
-      return false;
+      RemoveAll ();
+      return true;
     }
-  struct TagData *start = 0;
-  struct TagData **prevNext = &start;
-  for (struct TagData *cur = m_next; cur != 0; cur = cur->next) 
+  uint8_t *entries = Entries (m_block);
+  uint8_t *start = reinterpret_cast<uint8_t *> (data);
+  uint32_t before = start - entries;
+  uint32_t after = used - before;
+  if (m_block->count > 1)
     {
-      if (cur->tid == tid) 
-        {
-          /**
-           * XXX
-           * Note: I believe that we could optimize this to
-           * avoid copying each TagData located after the target id
-           * and just link the already-copied list to the next tag.
-           */
-          continue;
-        }
-      struct TagData *copy = AllocData ();
-      copy->tid = cur->tid;
-      copy->count = 1;
-      copy->next = 0;
-      memcpy (copy->data, cur->data, PACKET_TAG_MAX_SIZE);
-      *prevNext = copy;
-      prevNext = &copy->next;
+      // shared with a copy of the packet: leave the block to the copies
+      struct TagBlock *block = AllocBlock (used);
+      memcpy (Entries (block), entries, before);
+      memcpy (Entries (block) + before, start + entrySize, after);
+      block->used = used;
+      RemoveAll ();
+      m_block = block;
+    }
+  else
+    {
+      memmove (start, start + entrySize, after);
+      m_block->used = used;
     }
-  *prevNext = 0;
-  RemoveAll ();
-  m_next = start;
   return true;
 }
 
@@ -133,44 +169,69 @@ void
 PacketTagList::Add (const Tag &tag) const
 {
   NS_LOG_FUNCTION (this << tag.GetInstanceTypeId ());
+  TypeId tid = tag.GetInstanceTypeId ();
   // ensure this id was not yet added
-  for (struct TagData *cur = m_next; cur != 0; cur = cur->next) 
+  NS_ASSERT (Find (tid) == 0);
+  uint32_t size = tag.GetSerializedSize ();
+  NS_ASSERT (size <= PACKET_TAG_MAX_SIZE);
+  uint32_t used = m_block != 0 ? m_block->used : 0;
+  uint32_t entrySize = EntrySize (size);
+  struct TagBlock *block = m_block;
+  // the newest tag goes first, as in the former linked list
+  if (block == 0 || block->count > 1 || used + entrySize > block->capacity)
+    {
+      // copy on write, or move to a larger block
+      block = AllocBlock (used + entrySize);
+      if (used > 0)
+        {
+          memcpy (Entries (block) + entrySize, Entries (m_block), used);
+        }
+      PacketTagList *self = const_cast<PacketTagList *> (this);
+      self->RemoveAll ();
+      self->m_block = block;
+    }
+  else
     {
-      NS_ASSERT (cur->tid != tag.GetInstanceTypeId ());
+      memmove (Entries (block) + entrySize, Entries (block), used);
     }
-  struct TagData *head = AllocData ();
-  head->count = 1;
-  head->next = 0;
-  head->tid = tag.GetInstanceTypeId ();
-  head->next = m_next;
-  NS_ASSERT (tag.GetSerializedSize () <= PACKET_TAG_MAX_SIZE);
-  tag.Serialize (TagBuffer (head->data, head->data+tag.GetSerializedSize ()));
-
-  const_cast<PacketTagList *> (this)->m_next = head;
+  struct TagData *data = reinterpret_cast<struct TagData *> (Entries (block));
+  data->tid = tid;
+  data->size = size;
+  tag.Serialize (TagBuffer (data->data, data->data + size));
+  block->used = used + entrySize;
 }
 
 bool
 PacketTagList::Peek (Tag &tag) const
 {
   NS_LOG_FUNCTION (this << tag.GetInstanceTypeId ());
-  TypeId tid = tag.GetInstanceTypeId ();
-  for (struct TagData *cur = m_next; cur != 0; cur = cur->next) 
+  struct TagData *data = Find (tag.GetInstanceTypeId ());
+  if (data == 0)
     {
-      if (cur->tid == tid) 
-        {
-          /* found tag */
-          tag.Deserialize (TagBuffer (cur->data, cur->data+PACKET_TAG_MAX_SIZE));
-          return true;
-        }
+      /* no tag found */
+      return false;
     }
-  /* no tag found */
-  return false;
+  tag.Deserialize (TagBuffer (data->data, data->data + data->size));
+  return true;
 }
 
 const struct PacketTagList::TagData *
 PacketTagList::Head (void) const
 {
-  return m_next;
+  return m_block != 0 ? reinterpret_cast<struct TagData *> (Entries (m_block)) : 0;
+}
+
+const struct PacketTagList::TagData *
+PacketTagList::End (void) const
+{
+  return m_block != 0 ? reinterpret_cast<struct TagData *> (Entries (m_block) + m_block->used)
+                      : 0;
+}
+
+uint32_t
+PacketTagList::GetAllocatedSize (void) const
+{
+  return m_block != 0 ? sizeof (struct TagBlock) + m_block->capacity : 0;
 }
 
 } // namespace ns3
@@ -36,14 +36,24 @@ class Tag;
  */
 #define PACKET_TAG_MAX_SIZE 512
 
+/**
+ * The packet tags of a packet, stored back to back in a single block:
+ * each tag takes 4 bytes (type id and size) plus its serialized size
+ * rounded up to 4, so the usual handful of small tags fits in one or two
+ * cache lines. Blocks come in a few size classes recycled through free
+ * lists, released at exit, and grow by moving to the next class.
+ *
+ * The block is shared by the copies of a packet (copy on write): Add,
+ * Remove and RemoveAll change it in place only when this list is its
+ * only user, and work on a private copy otherwise.
+ */
 class PacketTagList 
 {
 public:
   struct TagData {
-    uint8_t data[PACKET_TAG_MAX_SIZE];
-    struct TagData *next;
     TypeId tid;
-    uint32_t count;
+    uint16_t size;   // serialized size of the tag
+    uint8_t data[4]; // size bytes, padded to a multiple of 4
   };
 
   inline PacketTagList ();
@@ -56,18 +66,36 @@ public:
   bool Peek (Tag &tag) const;
   inline void RemoveAll (void);
 
+  // the tags, newest first: iterate from Head to End with Next
   const struct PacketTagList::TagData *Head (void) const;
+  const struct PacketTagList::TagData *End (void) const;
+  static inline const struct PacketTagList::TagData *Next (const struct TagData *data);
+
+  // bytes of tag storage this list holds (shared with its copies)
+  uint32_t GetAllocatedSize (void) const;
 
 private:
+  struct TagBlock {
+    uint32_t count;     // lists sharing the block
+    uint32_t used;      // bytes of TagData
+    uint32_t capacity;  // bytes available for TagData
+    uint32_t sizeClass; // free list of the block, or the number of classes if none
+    // TagData follow
+  };
 
-  bool Remove (TypeId tid);
-  struct PacketTagList::TagData *AllocData (void) const;
-  void FreeData (struct TagData *data) const;
+  static inline uint32_t EntrySize (uint32_t tagSize);
+  static inline uint8_t *Entries (struct TagBlock *block);
+  struct TagData *Find (TypeId tid) const;
+  static struct TagBlock *AllocBlock (uint32_t capacity);
+  static void FreeBlock (struct TagBlock *block);
 
-  static struct PacketTagList::TagData *g_free;
-  static uint32_t g_nfree;
+  struct LocalStaticDestructor
+  {
+    ~LocalStaticDestructor ();
+  };
+  static struct LocalStaticDestructor g_localStaticDestructor;
 
-  struct TagData *m_next;
+  struct TagBlock *m_block;
 };
 
 } // namespace ns3
@@ -79,16 +107,16 @@ private:
 namespace ns3 {
 
 PacketTagList::PacketTagList ()
-  : m_next ()
+  : m_block (0)
 {
 }
 
 PacketTagList::PacketTagList (PacketTagList const &o)
-  : m_next (o.m_next)
+  : m_block (o.m_block)
 {
-  if (m_next != 0)
+  if (m_block != 0)
     {
-      m_next->count++;
+      m_block->count++;
     }
 }
 
@@ -96,15 +124,15 @@ PacketTagList &
 PacketTagList::operator = (PacketTagList const &o)
 {
   // self assignment
-  if (m_next == o.m_next) 
+  if (m_block == o.m_block) 
     {
       return *this;
     }
   RemoveAll ();
-  m_next = o.m_next;
-  if (m_next != 0) 
+  m_block = o.m_block;
+  if (m_block != 0) 
     {
-      m_next->count++;
+      m_block->count++;
     }
   return *this;
 }
@@ -117,25 +145,34 @@ PacketTagList::~PacketTagList ()
 void
 PacketTagList::RemoveAll (void)
 {
-  struct TagData *prev = 0;
-  for (struct TagData *cur = m_next; cur != 0; cur = cur->next) 
+  if (m_block != 0)
     {
-      cur->count--;
-      if (cur->count > 0) 
-        {
-          break;
-        }
-      if (prev != 0) 
+      m_block->count--;
+      if (m_block->count == 0)
         {
-          FreeData (prev);
+          FreeBlock (m_block);
         }
-      prev = cur;
-    }
-  if (prev != 0) 
-    {
-      FreeData (prev);
+      m_block = 0;
     }
-  m_next = 0;
+}
+
+uint32_t
+PacketTagList::EntrySize (uint32_t tagSize)
+{
+  return 4 + ((tagSize + 3) & ~3u);
+}
+
+uint8_t *
+PacketTagList::Entries (struct TagBlock *block)
+{
+  return reinterpret_cast<uint8_t *> (block + 1);
+}
+
+const struct PacketTagList::TagData *
+PacketTagList::Next (const struct TagData *data)
+{
+  return reinterpret_cast<const struct TagData *> (
+    reinterpret_cast<const uint8_t *> (data) + EntrySize (data->size));
 }
 
 } // namespace ns3
@@ -81,21 +81,23 @@ ByteTagIterator::ByteTagIterator (ByteTagList::Iterator i)
 }
 
 
-PacketTagIterator::PacketTagIterator (const struct PacketTagList::TagData *head)
-  : m_current (head)
+PacketTagIterator::PacketTagIterator (const struct PacketTagList::TagData *head,
+                                      const struct PacketTagList::TagData *end)
+  : m_current (head),
+    m_end (end)
 {
 }
 bool
 PacketTagIterator::HasNext (void) const
 {
-  return m_current != 0;
+  return m_current != m_end;
 }
 PacketTagIterator::Item
 PacketTagIterator::Next (void)
 {
   NS_ASSERT (HasNext ());
   const struct PacketTagList::TagData *prev = m_current;
-  m_current = m_current->next;
+  m_current = PacketTagList::Next (m_current);
   return PacketTagIterator::Item (prev);
 }
 
@@ -112,7 +114,7 @@ void
 PacketTagIterator::Item::GetTag (Tag &tag) const
 {
   NS_ASSERT (tag.GetInstanceTypeId () == m_data->tid);
-  tag.Deserialize (TagBuffer ((uint8_t*)m_data->data, (uint8_t*)m_data->data+PACKET_TAG_MAX_SIZE));
+  tag.Deserialize (TagBuffer ((uint8_t*)m_data->data, (uint8_t*)m_data->data+m_data->size));
 }
 
 
@@ -182,6 +184,15 @@ Packet::Packet (uint32_t size)
 {
   m_globalUid++;
 }
+Packet::Packet (uint32_t size, uint32_t headroom)
+  : m_buffer (size, headroom),
+    m_byteTagList (),
+    m_packetTagList (),
+    m_metadata (static_cast<uint64_t> (Simulator::GetSystemId ()) << 32 | m_globalUid, size),
+    m_nixVector (0)
+{
+  m_globalUid++;
+}
 Packet::Packet (uint8_t const *buffer, uint32_t size, bool magic)
   : m_buffer (0, false),
     m_byteTagList (),
@@ -544,6 +555,9 @@ Packet::Print (std::ostream &os) const
 PacketMetadata::ItemIterator 
 Packet::BeginItem (void) const
 {
+  NS_ASSERT_MSG (PacketMetadata::IsEnabled (),
+                 "Packet::BeginItem needs the packet metadata, which is disabled by default: "
+                 "call Packet::EnablePrinting () before any packet is created");
   return m_metadata.BeginItem (m_buffer);
 }
 
@@ -888,7 +902,7 @@ Packet::PrintPacketTags (std::ostream &os) const
 PacketTagIterator 
 Packet::GetPacketTagIterator (void) const
 {
-  return PacketTagIterator (m_packetTagList.Head ());
+  return PacketTagIterator (m_packetTagList.Head (), m_packetTagList.End ());
 }
 
 std::ostream& operator<< (std::ostream& os, const Packet &packet)
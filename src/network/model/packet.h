@@ -34,6 +34,7 @@
 #include "ns3/assert.h"
 #include "ns3/ptr.h"
 #include "ns3/deprecated.h"
+#include "ns3/simulation-arena.h"
 
 namespace ns3 {
 
@@ -152,8 +153,10 @@ private:
   Item Next (void);
 private:
   friend class Packet;
-  PacketTagIterator (const struct PacketTagList::TagData *head);
+  PacketTagIterator (const struct PacketTagList::TagData *head,
+                     const struct PacketTagList::TagData *end);
   const struct PacketTagList::TagData *m_current;
+  const struct PacketTagList::TagData *m_end;
 };
 
 /**
@@ -208,6 +211,7 @@ private:
 class Packet : public SimpleRefCount<Packet>
 {
 public:
+  NS_SLAB_POOLED (Packet);
 
 
 	//yibo
@@ -241,6 +245,16 @@ public:
    * \param size the size of the zero-filled payload
    */
   Packet (uint32_t size);
+  /**
+   * Create a packet with a zero-filled payload, as Packet (size), and
+   * room in front of it for the headers the caller will add: headers
+   * of up to headroom bytes in total are added without reallocating
+   * the buffer.
+   *
+   * \param size the size of the zero-filled payload
+   * \param headroom the total size of the headers to be added
+   */
+  Packet (uint32_t size, uint32_t headroom);
   /**
    * Create a new packet from the serialized buffer. This new packet 
    * is identical to the serialized packet contained in the buffer 
@@ -424,9 +438,9 @@ public:
 
   /**
    * \returns an iterator which points to the first 'item'
-   * stored in this buffer. Note that this iterator will point
-   * to an empty array of items if you don't call EnablePrinting
-   * or EnableChecking before.
+   * stored in this buffer. The metadata is disabled by default:
+   * call EnablePrinting or EnableChecking before any packet is
+   * created, or this asserts.
    *
    * \sa EnablePrinting EnableChecking
    */
@@ -0,0 +1,216 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <unordered_map>
+
+#include "ns3/test.h"
+#include "ns3/broadcom-egress-queue.h"
+#include "ns3/flow-id-num-tag.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/enum.h"
+
+namespace ns3 {
+
+extern std::unordered_map<unsigned, Time> acc_pause_time;
+
+// queue index of each packet dequeued, until the queue is empty
+static std::vector<uint32_t>
+DrainOrder (Ptr<BEgressQueue> queue, bool paused[], uint32_t n = 1000000)
+{
+  std::vector<uint32_t> order;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      Ptr<Packet> p = queue->DequeueRR (paused);
+      if (p == 0)
+        {
+          break;
+        }
+      order.push_back (queue->GetLastQueue ());
+    }
+  return order;
+}
+
+class BEgressQueueOrderTestCase : public TestCase
+{
+public:
+  BEgressQueueOrderTestCase ();
+  virtual void DoRun (void);
+};
+
+BEgressQueueOrderTestCase::BEgressQueueOrderTestCase ()
+  : TestCase ("Round robin and strict priority order of the broadcom egress queue")
+{
+}
+
+void
+BEgressQueueOrderTestCase::DoRun (void)
+{
+  bool paused[BEgressQueue::qCnt] = {0};
+  Ptr<BEgressQueue> queue = CreateObject<BEgressQueue> ();
+
+  // FIFO within a queue, across ring growth
+  std::vector<Ptr<Packet> > sent;
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      sent.push_back (Create<Packet> (100));
+      queue->Enqueue (sent.back (), 3);
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNBytes (3), 100 * 100, "bytes of queue 3");
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      Ptr<Packet> p = queue->DequeueRR (paused);
+      NS_TEST_EXPECT_MSG_EQ (p->GetUid (), sent[i]->GetUid (), "packet " << i << " out of order");
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNBytesTotal (), 0, "queue should be empty");
+
+  // RR: queue 0 first, then one packet per queue in turn, paused queues skipped
+  for (uint32_t q = 1; q <= 3; q++)
+    {
+      queue->Enqueue (Create<Packet> (100), q);
+      queue->Enqueue (Create<Packet> (100), q);
+    }
+  queue->Enqueue (Create<Packet> (100), 0);
+  paused[2] = true;
+  std::vector<uint32_t> order = DrainOrder (queue, paused);
+  uint32_t rr[] = {0, 1, 3, 1, 3};
+  NS_TEST_ASSERT_MSG_EQ (order.size (), 5, "paused queue 2 should hold its packets");
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (order[i], rr[i], "RR order at " << i);
+    }
+  paused[2] = false;
+  order = DrainOrder (queue, paused);
+  NS_TEST_EXPECT_MSG_EQ (order.size (), 2, "queue 2 after resume");
+
+  // SP: the lowest index wins
+  queue->SetAttribute ("SchedulingMode", StringValue ("SP"));
+  for (uint32_t q = 7; q >= 1; q--)
+    {
+      queue->Enqueue (Create<Packet> (100), q);
+      queue->Enqueue (Create<Packet> (100), q);
+    }
+  order = DrainOrder (queue, paused);
+  NS_TEST_ASSERT_MSG_EQ (order.size (), 14, "SP should send every packet");
+  for (uint32_t i = 0; i < 14; i++)
+    {
+      NS_TEST_EXPECT_MSG_EQ (order[i], i / 2 + 1, "SP order at " << i);
+    }
+}
+
+class BEgressQueueWeightTestCase : public TestCase
+{
+public:
+  BEgressQueueWeightTestCase (std::string mode);
+  virtual void DoRun (void);
+
+private:
+  std::string m_mode;
+};
+
+BEgressQueueWeightTestCase::BEgressQueueWeightTestCase (std::string mode)
+  : TestCase ("Weighted share of the broadcom egress queue in " + mode + " mode"),
+    m_mode (mode)
+{
+}
+
+void
+BEgressQueueWeightTestCase::DoRun (void)
+{
+  bool paused[BEgressQueue::qCnt] = {0};
+  Ptr<BEgressQueue> queue = CreateObject<BEgressQueue> ();
+  queue->SetAttribute ("SchedulingMode", StringValue (m_mode));
+  queue->SetAttribute ("Weights", StringValue ("1,1,3,4"));
+  NS_TEST_EXPECT_MSG_EQ (queue->GetWeight (3), 4, "weight of queue 3");
+  NS_TEST_EXPECT_MSG_EQ (queue->GetWeight (5), 1, "missing weights default to 1");
+
+  // backlogged queues 1..3 with different packet sizes: bytes sent follow 1:3:4
+  const uint32_t size[] = {0, 1000, 400, 1500};
+  for (uint32_t i = 0; i < 3000; i++)
+    {
+      for (uint32_t q = 1; q <= 3; q++)
+        {
+          queue->Enqueue (Create<Packet> (size[q]), q);
+        }
+    }
+  uint64_t bytes[4] = {0};
+  for (uint32_t i = 0; i < 4000; i++)
+    {
+      Ptr<Packet> p = queue->DequeueRR (paused);
+      bytes[queue->GetLastQueue ()] += p->GetSize ();
+    }
+  NS_TEST_EXPECT_MSG_EQ_TOL (bytes[2] / (double)bytes[1], 3, 0.1, "share of queue 2 vs 1");
+  NS_TEST_EXPECT_MSG_EQ_TOL (bytes[3] / (double)bytes[1], 4, 0.1, "share of queue 3 vs 1");
+
+  // a paused queue gives its share to the others and keeps its packets
+  paused[3] = true;
+  uint32_t before = queue->GetNBytes (3);
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      queue->DequeueRR (paused);
+      NS_TEST_EXPECT_MSG_NE (queue->GetLastQueue (), 3, "paused queue was served");
+    }
+  NS_TEST_EXPECT_MSG_EQ (queue->GetNBytes (3), before, "paused queue lost packets");
+}
+
+class BEgressQueuePauseTestCase : public TestCase
+{
+public:
+  BEgressQueuePauseTestCase ();
+  virtual void DoRun (void);
+};
+
+BEgressQueuePauseTestCase::BEgressQueuePauseTestCase ()
+  : TestCase ("PFC pause time of the broadcom egress queue is charged to the head flow")
+{
+}
+
+void
+BEgressQueuePauseTestCase::DoRun (void)
+{
+  Ptr<BEgressQueue> queue = CreateObject<BEgressQueue> ();
+  Ptr<Packet> p = Create<Packet> (100);
+  FlowIDNUMTag fit;
+  fit.SetId (4242);
+  p->AddPacketTag (fit);
+  queue->Enqueue (p, 3);
+  acc_pause_time.erase (4242);
+
+  Simulator::Schedule (MicroSeconds (10), &BEgressQueue::NotifyPaused, queue, 3);
+  Simulator::Schedule (MicroSeconds (25), &BEgressQueue::NotifyResumed, queue, 3);
+  Simulator::Schedule (MicroSeconds (30), &BEgressQueue::NotifyPaused, queue, 3);
+  Simulator::Schedule (MicroSeconds (32), &BEgressQueue::NotifyResumed, queue, 3);
+  Simulator::Run ();
+  Simulator::Destroy ();
+  NS_TEST_EXPECT_MSG_EQ (acc_pause_time[4242], MicroSeconds (17), "accumulated pause time");
+}
+
+static class BEgressQueueTestSuite : public TestSuite
+{
+public:
+  BEgressQueueTestSuite ()
+    : TestSuite ("broadcom-egress-queue", UNIT)
+  {
+    AddTestCase (new BEgressQueueOrderTestCase ());
+    AddTestCase (new BEgressQueueWeightTestCase ("DWRR"));
+    AddTestCase (new BEgressQueueWeightTestCase ("WFQ"));
+    AddTestCase (new BEgressQueuePauseTestCase ());
+  }
+} g_bEgressQueueTestSuite;
+
+} // namespace ns3
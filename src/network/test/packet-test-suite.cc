@@ -18,6 +18,7 @@
  * Author: Mathieu Lacage <mathieu.lacage@sophia.inria.fr>
  */
 #include "ns3/packet.h"
+#include "ns3/packet-tag-list.h"
 #include "ns3/test.h"
 #include <string>
 #include <stdarg.h>
@@ -436,6 +437,128 @@ PacketTest::DoRun (void)
   }
 }
 //-----------------------------------------------------------------------------
+class PacketTagListTest : public TestCase
+{
+public:
+  PacketTagListTest ();
+  virtual void DoRun (void);
+private:
+  template <int N>
+  bool Intact (const PacketTagList &list);
+  void CheckOrder (const PacketTagList &list, const char *file, int line, uint32_t n, ...);
+};
+
+PacketTagListTest::PacketTagListTest ()
+  : TestCase ("PacketTagList blocks") {
+}
+
+template <int N>
+bool
+PacketTagListTest::Intact (const PacketTagList &list)
+{
+  ATestTag<N> tag;
+  return list.Peek (tag) && !tag.m_error;
+}
+
+void
+PacketTagListTest::CheckOrder (const PacketTagList &list, const char *file, int line, uint32_t n, ...)
+{
+  va_list ap;
+  va_start (ap, n);
+  const struct PacketTagList::TagData *cur = list.Head ();
+  for (uint32_t k = 0; k < n; ++k)
+    {
+      uint32_t N = va_arg (ap, uint32_t);
+      bool hasNext = cur != list.End ();
+      NS_TEST_EXPECT_MSG_EQ_INTERNAL (hasNext, true, "too few tags", file, line);
+      if (!hasNext)
+        {
+          break;
+        }
+      std::ostringstream oss;
+      oss << "anon::ATestTag<" << N << ">";
+      NS_TEST_EXPECT_MSG_EQ_INTERNAL (cur->tid.GetName (), oss.str (), "tag order", file, line);
+      cur = PacketTagList::Next (cur);
+    }
+  va_end (ap);
+  bool atEnd = cur == list.End ();
+  NS_TEST_EXPECT_MSG_EQ_INTERNAL (atEnd, true, "too many tags", file, line);
+}
+
+#define CHECK_ORDER(list, n, ...)                       \
+  CheckOrder (list, __FILE__, __LINE__, n, __VA_ARGS__)
+
+void
+PacketTagListTest::DoRun (void)
+{
+  // a block holds 16 bytes of header, then 4 bytes plus the padded tag per
+  // entry: each Add below outgrows the block and moves to the next class
+  PacketTagList list;
+  NS_TEST_EXPECT_MSG_EQ (list.GetAllocatedSize (), 0, "empty list holds a block");
+  list.Add (ATestTag<20> ());
+  NS_TEST_EXPECT_MSG_EQ (list.GetAllocatedSize (), 64, "first tag not in a 64-byte block");
+  list.Add (ATestTag<21> ());
+  NS_TEST_EXPECT_MSG_EQ (list.GetAllocatedSize (), 128, "did not grow past 64 bytes");
+  list.Add (ATestTag<60> ());
+  NS_TEST_EXPECT_MSG_EQ (list.GetAllocatedSize (), 256, "did not grow past 128 bytes");
+  list.Add (ATestTag<200> ());
+  NS_TEST_EXPECT_MSG_EQ (list.GetAllocatedSize (), 512, "did not grow past 256 bytes");
+  NS_TEST_EXPECT_MSG_EQ (Intact<20> (list), true, "tag lost or damaged while growing");
+  NS_TEST_EXPECT_MSG_EQ (Intact<21> (list), true, "tag lost or damaged while growing");
+  NS_TEST_EXPECT_MSG_EQ (Intact<60> (list), true, "tag lost or damaged while growing");
+  NS_TEST_EXPECT_MSG_EQ (Intact<200> (list), true, "tag lost or damaged while growing");
+  CHECK_ORDER (list, 4, 200, 60, 21, 20);
+
+  // in place, with room left in the block
+  list.Add (ATestTag<1> ());
+  NS_TEST_EXPECT_MSG_EQ (list.GetAllocatedSize (), 512, "moved with room left");
+  CHECK_ORDER (list, 5, 1, 200, 60, 21, 20);
+
+  // removing from a shared block leaves the other copy alone
+  PacketTagList copy = list;
+  ATestTag<60> removed;
+  NS_TEST_EXPECT_MSG_EQ (copy.Remove (removed), true, "shared tag not removed");
+  NS_TEST_EXPECT_MSG_EQ (removed.m_error, false, "removed tag damaged");
+  NS_TEST_EXPECT_MSG_EQ (copy.Remove (removed), false, "tag removed twice");
+  NS_TEST_EXPECT_MSG_EQ (Intact<60> (list), true, "removal reached the other copy");
+  CHECK_ORDER (list, 5, 1, 200, 60, 21, 20);
+  CHECK_ORDER (copy, 4, 1, 200, 21, 20);
+  NS_TEST_EXPECT_MSG_EQ (Intact<20> (copy), true, "tag damaged by the removal");
+  NS_TEST_EXPECT_MSG_EQ (Intact<200> (copy), true, "tag damaged by the removal");
+
+  // and in place once unshared
+  ATestTag<200> removedInPlace;
+  NS_TEST_EXPECT_MSG_EQ (copy.Remove (removedInPlace), true, "tag not removed");
+  CHECK_ORDER (copy, 3, 1, 21, 20);
+  CHECK_ORDER (list, 5, 1, 200, 60, 21, 20);
+  NS_TEST_EXPECT_MSG_EQ (Intact<21> (copy), true, "tag damaged by the removal");
+
+  // adding to a shared block copies it first
+  PacketTagList other = copy;
+  other.Add (ATestTag<2> ());
+  CHECK_ORDER (other, 4, 2, 1, 21, 20);
+  CHECK_ORDER (copy, 3, 1, 21, 20);
+
+  // the packet iterator lists the same tags, newest first
+  Packet p;
+  p.AddPacketTag (ATestTag<10> ());
+  p.AddPacketTag (ATestTag<11> ());
+  p.AddPacketTag (ATestTag<12> ());
+  PacketTagIterator i = p.GetPacketTagIterator ();
+  for (uint32_t n = 12; n >= 10; --n)
+    {
+      NS_TEST_EXPECT_MSG_EQ (i.HasNext (), true, "too few packet tags");
+      if (!i.HasNext ())
+        {
+          break;
+        }
+      std::ostringstream oss;
+      oss << "anon::ATestTag<" << n << ">";
+      NS_TEST_EXPECT_MSG_EQ (i.Next ().GetTypeId ().GetName (), oss.str (), "packet tag order");
+    }
+  NS_TEST_EXPECT_MSG_EQ (i.HasNext (), false, "too many packet tags");
+}
+//-----------------------------------------------------------------------------
 class PacketTestSuite : public TestSuite
 {
 public:
@@ -446,6 +569,7 @@ PacketTestSuite::PacketTestSuite ()
   : TestSuite ("packet", UNIT)
 {
   AddTestCase (new PacketTest);
+  AddTestCase (new PacketTagListTest);
 }
 
 static PacketTestSuite g_packetTestSuite;
@@ -18,20 +18,21 @@
 #include "broadcom-egress-queue.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 #include <unordered_map>
 
-#include "drop-tail-queue.h"
 #include "ns3/double.h"
 #include "ns3/enum.h"
 #include "ns3/flow-id-num-tag.h"
 #include "ns3/log.h"
 #include "ns3/simulator.h"
+#include "ns3/string.h"
 #include "ns3/uinteger.h"
 
-#define MAP_KEY_EXISTS(map, key) (((map).find(key) != (map).end()))
-
 NS_LOG_COMPONENT_DEFINE("BEgressQueue");
 
 namespace ns3 {
@@ -40,19 +41,36 @@ std::unordered_map<unsigned, Time> acc_pause_time;  // global
 
 NS_OBJECT_ENSURE_REGISTERED(BEgressQueue);
 
+static const uint32_t kAllQueues = (1u << BEgressQueue::qCnt) - 1;
+static const uint64_t kWfqScale = 1 << 16;  // finish tags in bytes * kWfqScale / weight
+
 TypeId BEgressQueue::GetTypeId(void) {
-    static TypeId tid = TypeId("ns3::BEgressQueue")
-                            .SetParent<Queue>()
-                            .AddConstructor<BEgressQueue>()
-                            .AddAttribute("MaxBytes",
-                                          "The maximum number of bytes accepted by this BEgressQueue.",
-                                          DoubleValue(1000.0 * 1024 * 1024),
-                                          MakeDoubleAccessor(&BEgressQueue::m_maxBytes),
-                                          MakeDoubleChecker<double>())
-                            .AddTraceSource("BeqEnqueue", "Enqueue a packet in the BEgressQueue. Multiple queue",
-                                            MakeTraceSourceAccessor(&BEgressQueue::m_traceBeqEnqueue))
-                            .AddTraceSource("BeqDequeue", "Dequeue a packet in the BEgressQueue. Multiple queue",
-                                            MakeTraceSourceAccessor(&BEgressQueue::m_traceBeqDequeue));
+    static TypeId tid =
+        TypeId("ns3::BEgressQueue")
+            .SetParent<Queue>()
+            .AddConstructor<BEgressQueue>()
+            .AddAttribute("MaxBytes", "The maximum number of bytes accepted by this BEgressQueue.",
+                          DoubleValue(1000.0 * 1024 * 1024),
+                          MakeDoubleAccessor(&BEgressQueue::m_maxBytes),
+                          MakeDoubleChecker<double>())
+            .AddAttribute("SchedulingMode",
+                          "Scheduling of queues 1..qCnt-1 (queue 0 is always served first)",
+                          EnumValue(EGRESS_RR), MakeEnumAccessor(&BEgressQueue::m_mode),
+                          MakeEnumChecker(EGRESS_RR, "RR", EGRESS_SP, "SP", EGRESS_DWRR, "DWRR",
+                                          EGRESS_WFQ, "WFQ"))
+            .AddAttribute("Quantum", "DWRR quantum in bytes per round for a queue of weight 1",
+                          UintegerValue(1500), MakeUintegerAccessor(&BEgressQueue::m_quantum),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("Weights",
+                          "DWRR/WFQ weights of the queues, comma separated from queue 0 "
+                          "(missing entries are 1)",
+                          StringValue("1"),
+                          MakeStringAccessor(&BEgressQueue::SetWeights, &BEgressQueue::GetWeights),
+                          MakeStringChecker())
+            .AddTraceSource("BeqEnqueue", "Enqueue a packet in the BEgressQueue. Multiple queue",
+                            MakeTraceSourceAccessor(&BEgressQueue::m_traceBeqEnqueue))
+            .AddTraceSource("BeqDequeue", "Dequeue a packet in the BEgressQueue. Multiple queue",
+                            MakeTraceSourceAccessor(&BEgressQueue::m_traceBeqDequeue));
 
     return tid;
 }
@@ -61,9 +79,18 @@ BEgressQueue::BEgressQueue() : Queue() {
     NS_LOG_FUNCTION_NOARGS();
     m_bytesInQueueTotal = 0;
     m_rrlast = 0;
-    for (uint32_t i = 0; i < fCnt; i++) {
+    m_qlast = 0;
+    m_nonEmpty = 0;
+    m_mode = EGRESS_RR;
+    m_quantum = 1500;
+    m_virtualTime = 0;
+    for (uint32_t i = 0; i < qCnt; i++) {
         m_bytesInQueue[i] = 0;
-        m_queues.push_back(CreateObject<DropTailQueue>());
+        m_queues[i].head = 0;
+        m_queues[i].count = 0;
+        m_weight[i] = 1;
+        m_deficit[i] = 0;
+        m_lastFinish[i] = 0;
     }
 }
 
@@ -71,12 +98,49 @@ BEgressQueue::~BEgressQueue() {
     NS_LOG_FUNCTION_NOARGS();
 }
 
+void BEgressQueue::Push(uint32_t qIndex, Ptr<Packet> p) {
+    SubQueue &q = m_queues[qIndex];
+    uint32_t cap = q.slot.size();
+    if (q.count == cap) {
+        // unroll the ring into a buffer twice as large
+        std::vector<Slot> grown(cap ? 2 * cap : 16);
+        for (uint32_t i = 0; i < cap; i++) grown[i] = q.slot[(q.head + i) & (cap - 1)];
+        q.slot.swap(grown);
+        q.head = 0;
+        cap = q.slot.size();
+    }
+    Slot &s = q.slot[(q.head + q.count) & (cap - 1)];
+    s.p = p;
+    if (m_mode == EGRESS_WFQ) {
+        uint64_t start = std::max(m_virtualTime, m_lastFinish[qIndex]);
+        s.finish = start + p->GetSize() * kWfqScale / m_weight[qIndex];
+        m_lastFinish[qIndex] = s.finish;
+    }
+    q.count++;
+    m_nonEmpty |= 1u << qIndex;
+}
+
+Ptr<Packet> BEgressQueue::Pop(uint32_t qIndex) {
+    SubQueue &q = m_queues[qIndex];
+    Slot &s = q.slot[q.head];
+    Ptr<Packet> p = s.p;
+    s.p = 0;
+    if (m_mode == EGRESS_WFQ && qIndex != 0) m_virtualTime = s.finish;
+    q.head = (q.head + 1) & (q.slot.size() - 1);
+    if (--q.count == 0) {
+        m_nonEmpty &= ~(1u << qIndex);
+        m_deficit[qIndex] = 0;
+    }
+    return p;
+}
+
 bool BEgressQueue::DoEnqueue(Ptr<Packet> p, uint32_t qIndex) {
     NS_LOG_FUNCTION(this << p);
+    NS_ASSERT(qIndex < qCnt);
 
     if (m_bytesInQueueTotal + p->GetSize() < m_maxBytes)  // infinite queue
     {
-        m_queues[qIndex]->Enqueue(p);
+        Push(qIndex, p);
         m_bytesInQueueTotal += p->GetSize();
         m_bytesInQueue[qIndex] += p->GetSize();
     } else {
@@ -86,6 +150,40 @@ bool BEgressQueue::DoEnqueue(Ptr<Packet> p, uint32_t qIndex) {
     return true;
 }
 
+uint32_t BEgressQueue::SelectQueue(uint32_t eligible) {
+    switch (m_mode) {
+        case EGRESS_SP:
+            return __builtin_ctz(eligible);
+        case EGRESS_DWRR: {
+            // keep serving the current queue while its deficit covers the head packet,
+            // otherwise give the next eligible queue its quantum
+            uint32_t q = m_rrlast;
+            if ((eligible >> q) & 1 && m_deficit[q] >= Head(q).p->GetSize()) return q;
+            while (true) {
+                uint32_t next = (q + 1) % qCnt;
+                uint32_t rot = ((eligible >> next) | (eligible << (qCnt - next))) & kAllQueues;
+                q = (next + __builtin_ctz(rot)) % qCnt;
+                m_deficit[q] += m_quantum * m_weight[q];
+                if (m_deficit[q] >= Head(q).p->GetSize()) return q;
+            }
+        }
+        case EGRESS_WFQ: {
+            uint32_t best = __builtin_ctz(eligible);
+            for (uint32_t rest = eligible & (eligible - 1); rest; rest &= rest - 1) {
+                uint32_t q = __builtin_ctz(rest);
+                if (Head(q).finish < Head(best).finish) best = q;
+            }
+            return best;
+        }
+        default: {
+            // first eligible queue after the last one served, round robin
+            uint32_t next = (m_rrlast + 1) % qCnt;
+            uint32_t rot = ((eligible >> next) | (eligible << (qCnt - next))) & kAllQueues;
+            return (next + __builtin_ctz(rot)) % qCnt;
+        }
+    }
+}
+
 Ptr<Packet>
 BEgressQueue::DoDequeueRR(bool paused[])  // this is for switch only
 {
@@ -95,67 +193,32 @@ BEgressQueue::DoDequeueRR(bool paused[])  // this is for switch only
         NS_LOG_LOGIC("Queue empty");
         return 0;
     }
-    bool found = false;
     uint32_t qIndex;
-
-    if (m_queues[0]->GetNPackets() > 0)  // 0 is the highest priority
-    {
-        found = true;
+    if (m_nonEmpty & 1) {  // 0 is the highest priority
         qIndex = 0;
     } else {
-        if (!found) {
-            for (qIndex = 1; qIndex <= qCnt; qIndex++) {
-                bool cond1 = !paused[(qIndex + m_rrlast) % qCnt];
-                bool cond2 = m_queues[(qIndex + m_rrlast) % qCnt]->GetNPackets() > 0;  // round robin
-
-                if (!cond1 && cond2) {
-                    // Packet could be scheduled by RR, but could not be scheduled because of PAUSE
-                    FlowIDNUMTag fit;
-                    Ptr<Packet> p = ConstCast<Packet, const Packet>(m_queues[(qIndex + m_rrlast) % qCnt]->Peek());
-                    if (p->PeekPacketTag(fit)) {
-                        unsigned flowid = static_cast<unsigned>(fit.GetId());
-                        if (!MAP_KEY_EXISTS(current_pause_time, flowid))
-                            current_pause_time[flowid] = Simulator::Now();
-                    }
-                } else if (cond1 && cond2) {
-                    found = true;
-                    break;
-                }
-            }
-            qIndex = (qIndex + m_rrlast) % qCnt;
+        uint32_t pausedMask = 0;
+        for (uint32_t i = 1; i < qCnt; i++) pausedMask |= (uint32_t)paused[i] << i;
+        uint32_t eligible = m_nonEmpty & ~pausedMask;
+        if (eligible == 0) {
+            NS_LOG_LOGIC("Nothing can be sent");
+            return 0;
         }
+        qIndex = SelectQueue(eligible);
     }
-    if (found) {
-        Ptr<Packet> p = m_queues[qIndex]->Dequeue();
-
-        // Check if the flow has been blocked by PFC
-        if (p) {
-            FlowIDNUMTag fit;
-            if (p->PeekPacketTag(fit)) {
-                unsigned flowid = static_cast<unsigned>(fit.GetId());
-                if (MAP_KEY_EXISTS(current_pause_time, flowid)) {
-                    Time tdiff = Simulator::Now() - current_pause_time[flowid];
-                    if (!MAP_KEY_EXISTS(acc_pause_time, flowid))
-                        acc_pause_time[flowid] = Seconds(0);
-                    acc_pause_time[flowid] = acc_pause_time[flowid] + tdiff;
-                    current_pause_time.erase(flowid);
-                }
-            }
-        }
 
-        m_traceBeqDequeue(p, qIndex);
-        m_bytesInQueueTotal -= p->GetSize();
-        m_bytesInQueue[qIndex] -= p->GetSize();
-        if (qIndex != 0) {
-            m_rrlast = qIndex;
-        }
-        m_qlast = qIndex;
-        NS_LOG_LOGIC("Popped " << p);
-        NS_LOG_LOGIC("Number bytes " << m_bytesInQueueTotal);
-        return p;
+    Ptr<Packet> p = Pop(qIndex);
+    if (m_mode == EGRESS_DWRR) m_deficit[qIndex] -= std::min(m_deficit[qIndex], p->GetSize());
+    NS_PACKET_TRACE(m_traceBeqDequeue, (p, qIndex));
+    m_bytesInQueueTotal -= p->GetSize();
+    m_bytesInQueue[qIndex] -= p->GetSize();
+    if (qIndex != 0) {
+        m_rrlast = qIndex;
     }
-    NS_LOG_LOGIC("Nothing can be sent");
-    return 0;
+    m_qlast = qIndex;
+    NS_LOG_LOGIC("Popped " << p);
+    NS_LOG_LOGIC("Number bytes " << m_bytesInQueueTotal);
+    return p;
 }
 
 bool BEgressQueue::Enqueue(Ptr<Packet> p, uint32_t qIndex) {
@@ -166,8 +229,8 @@ bool BEgressQueue::Enqueue(Ptr<Packet> p, uint32_t qIndex) {
     bool retval = DoEnqueue(p, qIndex);
     if (retval) {
         NS_LOG_LOGIC("m_traceEnqueue (p)");
-        m_traceEnqueue(p);
-        m_traceBeqEnqueue(p, qIndex);
+        NS_PACKET_TRACE(m_traceEnqueue, (p));
+        NS_PACKET_TRACE(m_traceBeqEnqueue, (p, qIndex));
 
         uint32_t size = p->GetSize();
         m_nBytes += size;
@@ -189,18 +252,55 @@ BEgressQueue::DequeueRR(bool paused[]) {
         m_nBytes -= packet->GetSize();
         m_nPackets--;
         NS_LOG_LOGIC("m_traceDequeue (packet)");
-        m_traceDequeue(packet);
+        NS_PACKET_TRACE(m_traceDequeue, (packet));
     }
     return packet;
 }
 
+void BEgressQueue::NotifyPaused(uint32_t qIndex) {
+    m_pauseStart[qIndex] = Simulator::Now();
+}
+
+void BEgressQueue::NotifyResumed(uint32_t qIndex) {
+    // the flow at the head of the queue was the one blocked by PFC
+    if (m_queues[qIndex].count == 0) return;
+    FlowIDNUMTag fit;
+    if (Head(qIndex).p->PeekPacketTag(fit)) {
+        unsigned flowid = static_cast<unsigned>(fit.GetId());
+        acc_pause_time[flowid] += Simulator::Now() - m_pauseStart[qIndex];
+    }
+}
+
+void BEgressQueue::SetWeight(uint32_t qIndex, uint32_t weight) {
+    NS_ASSERT_MSG(qIndex < qCnt && weight > 0, "BEgressQueue: bad weight for queue " << qIndex);
+    m_weight[qIndex] = weight;
+}
+
+uint32_t BEgressQueue::GetWeight(uint32_t qIndex) const { return m_weight[qIndex]; }
+
+void BEgressQueue::SetWeights(std::string weights) {
+    std::istringstream iss(weights);
+    std::string w;
+    for (uint32_t i = 0; i < qCnt; i++) {
+        uint32_t v = 1;
+        if (std::getline(iss, w, ',')) v = atoi(w.c_str());
+        SetWeight(i, v);
+    }
+}
+
+std::string BEgressQueue::GetWeights(void) const {
+    std::ostringstream oss;
+    for (uint32_t i = 0; i < qCnt; i++) oss << (i ? "," : "") << m_weight[i];
+    return oss.str();
+}
+
 bool BEgressQueue::DoEnqueue(Ptr<Packet> p)  // for compatiability
 {
     std::cout << "Warning: Call Broadcom queues without priority\n";
     uint32_t qIndex = 0;
     NS_LOG_FUNCTION(this << p);
     if (m_bytesInQueueTotal + p->GetSize() < m_maxBytes) {
-        m_queues[qIndex]->Enqueue(p);
+        Push(qIndex, p);
         m_bytesInQueueTotal += p->GetSize();
         m_bytesInQueue[qIndex] += p->GetSize();
     } else {
@@ -220,12 +320,12 @@ BEgressQueue::DoPeek(void) const  // DoPeek doesn't work for multiple queues!!
 {
     std::cout << "Warning: Call Broadcom queues without priority\n";
     NS_LOG_FUNCTION(this);
-    if (m_bytesInQueueTotal == 0) {
+    if (m_bytesInQueueTotal == 0 || m_queues[0].count == 0) {
         NS_LOG_LOGIC("Queue empty");
         return 0;
     }
-    NS_LOG_LOGIC("Number bytes " << m_bytesInQueue);
-    return m_queues[0]->Peek();
+    NS_LOG_LOGIC("Number bytes " << m_bytesInQueueTotal);
+    return Head(0).p;
 }
 
 uint32_t
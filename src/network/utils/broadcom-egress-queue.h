@@ -19,22 +19,37 @@
 #ifndef BROADCOM_EGRESS_H
 #define BROADCOM_EGRESS_H
 
-#include <queue>
-#include <unordered_map>
+#include <string>
+#include <vector>
 #include "ns3/packet.h"
 #include "queue.h"
-#include "drop-tail-queue.h"
-#include "ns3/point-to-point-net-device.h"
-#include "ns3/event-id.h"
+#include "ns3/nstime.h"
 
 namespace ns3 {
 
 	class TraceContainer;
 
+	/**
+	 * Egress port with qCnt priority queues, kept as inline rings of packets.
+	 *
+	 * The scheduler works on a bitmask of queues that are non-empty and not paused by
+	 * PFC. Queue 0 (PFC, CNP, ACK) is always served first; the other queues are served
+	 * by the SchedulingMode of the port:
+	 *  - RR: round robin, one packet per turn (the original behaviour)
+	 *  - SP: strict priority, a lower index wins
+	 *  - DWRR: deficit weighted round robin, Quantum * weight bytes per round
+	 *  - WFQ: self-clocked weighted fair queueing on per-packet finish tags
+	 */
 	class BEgressQueue : public Queue {
 	public:
+		enum SchedulingMode {
+			EGRESS_RR = 0,
+			EGRESS_SP,
+			EGRESS_DWRR,
+			EGRESS_WFQ
+		};
+
 		static TypeId GetTypeId(void);
-		static const unsigned fCnt = 128; //max number of queues, 128 for NICs
 		static const unsigned qCnt = 8; //max number of queues, 8 for switches
 		BEgressQueue();
 		virtual ~BEgressQueue();
@@ -44,24 +59,57 @@ namespace ns3 {
 		uint32_t GetNBytesTotal() const;
 		uint32_t GetLastQueue();
 
+		// DWRR/WFQ share of queue qIndex, relative to the other queues (default 1)
+		void SetWeight(uint32_t qIndex, uint32_t weight);
+		uint32_t GetWeight(uint32_t qIndex) const;
+		void SetWeights(std::string weights); // comma separated, from queue 0
+		std::string GetWeights(void) const;
+
+		// PFC pause of queue qIndex by the downstream port starts/ends. The pause time is
+		// charged to the flow at the head of the queue when the queue resumes.
+		void NotifyPaused(uint32_t qIndex);
+		void NotifyResumed(uint32_t qIndex);
+
 		TracedCallback<Ptr<const Packet>, uint32_t> m_traceBeqEnqueue;
 		TracedCallback<Ptr<const Packet>, uint32_t> m_traceBeqDequeue;
-		
-		std::unordered_map<int32_t, Time> current_pause_time;
 
 	private:
+		struct Slot {
+			Ptr<Packet> p;
+			uint64_t finish; // WFQ finish tag
+		};
+		// ring of packets, the capacity is a power of two and only grows
+		struct SubQueue {
+			std::vector<Slot> slot;
+			uint32_t head;
+			uint32_t count;
+		};
+
 		bool DoEnqueue(Ptr<Packet> p, uint32_t qIndex);
 		Ptr<Packet> DoDequeueRR(bool paused[]);
+		uint32_t SelectQueue(uint32_t eligible);
+		void Push(uint32_t qIndex, Ptr<Packet> p);
+		Ptr<Packet> Pop(uint32_t qIndex);
+		const Slot &Head(uint32_t qIndex) const { return m_queues[qIndex].slot[m_queues[qIndex].head]; }
 		//for compatibility
 		virtual bool DoEnqueue(Ptr<Packet> p);
 		virtual Ptr<Packet> DoDequeue(void);
 		virtual Ptr<const Packet> DoPeek(void) const;
 		double m_maxBytes; //total bytes limit
-		uint32_t m_bytesInQueue[fCnt];
+		uint32_t m_bytesInQueue[qCnt];
 		uint32_t m_bytesInQueueTotal;
 		uint32_t m_rrlast;
 		uint32_t m_qlast;
-		std::vector<Ptr<Queue> > m_queues; // uc queues
+		SubQueue m_queues[qCnt];
+		uint32_t m_nonEmpty; // bit q: queue q has packets
+
+		SchedulingMode m_mode;
+		uint32_t m_quantum; // DWRR bytes per round for weight 1
+		uint32_t m_weight[qCnt];
+		uint32_t m_deficit[qCnt]; // DWRR
+		uint64_t m_lastFinish[qCnt]; // WFQ
+		uint64_t m_virtualTime; // WFQ, finish tag of the last packet sent
+		Time m_pauseStart[qCnt];
 	};
 
 } // namespace ns3
@@ -81,6 +81,8 @@ public:
 	}
 };
 
+struct IntHopBatch;
+
 class IntHeader{
 public:
 	static const uint32_t maxHop = 5;
@@ -101,8 +103,54 @@ public:
 	void Serialize (Buffer::Iterator start) const;
 	uint32_t Deserialize (Buffer::Iterator start);
 	uint64_t GetTs(void);
+
+	// unpack all hops against the previously stored ones into b (one pass, no per-hop branches)
+	void UnpackDeltas(const IntHop prev[], IntHopBatch &b) const;
+};
+
+/**
+ * Structure-of-arrays view of one INT feedback, used by the HPCC fast path.
+ * Only the first n slots are filled; the loops have no data-dependent branches.
+ */
+struct IntHopBatch{
+	uint32_t n;
+	uint64_t tau[IntHeader::maxHop];	// time delta, ns
+	uint64_t bytes[IntHeader::maxHop];	// tx bytes delta
+	uint32_t qlen[IntHeader::maxHop];	// current qlen, bytes
+	uint32_t qlenMin[IntHeader::maxHop];	// min(current, previous) qlen, bytes
+	double lineRate[IntHeader::maxHop];	// bps
+	double u[IntHeader::maxHop];		// normalized utilization
+
+	// u = txRate / lineRate + qlenMin * maxRate / lineRate / win, same op order as the per-hop code
+	void ComputeUtilization(uint64_t maxRate, uint32_t win);
 };
 
+// inlined: called once per ACK from RdmaHw::UpdateRateHp
+inline void IntHeader::UnpackDeltas(const IntHop prev[], IntHopBatch &b) const{
+	const uint64_t timeMask = (1lu << IntHop::timeWidth) - 1;
+	const uint64_t bytesMask = (1lu << IntHop::bytesWidth) - 1;
+	const uint64_t unit = (uint64_t)IntHop::byteUnit * IntHop::multi;
+	const uint32_t qunit = IntHop::qlenUnit * IntHop::multi;
+	b.n = nhop < maxHop ? nhop : maxHop;
+	for (uint32_t i = 0; i < b.n; i++){
+		// counters wrap around, so the delta is simply taken modulo the field width
+		b.tau[i] = ((uint64_t)hop[i].time - prev[i].time) & timeMask;
+		b.bytes[i] = (((uint64_t)hop[i].bytes - prev[i].bytes) & bytesMask) * unit;
+		uint32_t cur = hop[i].qlen, old = prev[i].qlen;
+		b.qlen[i] = cur * qunit;
+		b.qlenMin[i] = (cur < old ? cur : old) * qunit;
+		b.lineRate[i] = (double)IntHop::lineRateValues[hop[i].lineRate];
+	}
+}
+
+inline void IntHopBatch::ComputeUtilization(uint64_t maxRate, uint32_t win){
+	for (uint32_t i = 0; i < n; i++){
+		double duration = tau[i] * 1e-9;
+		double txRate = bytes[i] * 8 / duration;
+		u[i] = txRate / lineRate[i] + (double)qlenMin[i] * maxRate / lineRate[i] / win;
+	}
+}
+
 }
 
 #endif /* INT_HEADER_H */
@@ -70,7 +70,7 @@ Queue::Enqueue (Ptr<Packet> p)
   if (retval)
     {
       NS_LOG_LOGIC ("m_traceEnqueue (p)");
-      m_traceEnqueue (p);
+      NS_PACKET_TRACE (m_traceEnqueue, (p));
 
       uint32_t size = p->GetSize ();
       m_nBytes += size;
@@ -101,7 +101,7 @@ Queue::Dequeue (void)
       m_nPackets--;
 
       NS_LOG_LOGIC ("m_traceDequeue (packet)");
-      m_traceDequeue (packet);
+      NS_PACKET_TRACE (m_traceDequeue, (packet));
     }
   return packet;
 }
@@ -199,7 +199,7 @@ Queue::Drop (Ptr<Packet> p)
   m_nTotalDroppedBytes += p->GetSize ();
 
   NS_LOG_LOGIC ("m_traceDrop (p)");
-  m_traceDrop (p);
+  NS_PACKET_TRACE (m_traceDrop, (p));
 }
 
 } // namespace ns3
@@ -0,0 +1,544 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "topology-spec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+namespace ns3 {
+
+namespace {
+
+// whitespace separated tokens, with the line each one came from
+class TokenReader {
+   public:
+    explicit TokenReader(std::istream &is) : m_is(is), m_line(0), m_pos(0) {}
+
+    bool Next(std::string &tok) {
+        while (true) {
+            while (m_pos < m_buf.size() && isspace((unsigned char)m_buf[m_pos])) m_pos++;
+            if (m_pos < m_buf.size()) break;
+            if (!std::getline(m_is, m_buf)) return false;
+            m_line++;
+            m_pos = 0;
+        }
+        size_t end = m_pos;
+        while (end < m_buf.size() && !isspace((unsigned char)m_buf[end])) end++;
+        tok = m_buf.substr(m_pos, end - m_pos);
+        m_pos = end;
+        return true;
+    }
+    bool NextUint(uint32_t &v) {
+        std::string tok;
+        if (!Next(tok) || tok.empty() || tok.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        v = strtoul(tok.c_str(), 0, 10);
+        return true;
+    }
+    uint32_t GetLine() const { return m_line; }
+
+   private:
+    std::istream &m_is;
+    std::string m_buf;
+    uint32_t m_line;
+    size_t m_pos;
+};
+
+bool Fail(std::string *err, const std::string &msg) {
+    if (err) *err = msg;
+    return false;
+}
+
+std::string LineMsg(uint32_t line, const std::string &msg) {
+    std::ostringstream oss;
+    oss << "line " << line << ": " << msg;
+    return oss.str();
+}
+
+// number followed by one of the units, scaled by its factor
+bool ParseWithUnit(const std::string &s, const char *const units[], const double factors[],
+                   uint32_t nUnits, uint64_t &v) {
+    char *end;
+    double x = strtod(s.c_str(), &end);
+    if (end == s.c_str() || x < 0) return false;
+    std::string unit(end);
+    for (uint32_t i = 0; i < nUnits; i++) {
+        if (unit == units[i]) {
+            v = (uint64_t)(x * factors[i] + 0.5);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string DelayString(uint64_t delayNs) {
+    std::ostringstream oss;
+    oss << delayNs << "ns";
+    return oss.str();
+}
+
+// key=value pairs after "<kind>:"
+bool ParseParams(const std::string &s, std::map<std::string, std::string> &params,
+                 std::string *err) {
+    std::istringstream iss(s);
+    std::string kv;
+    while (std::getline(iss, kv, ',')) {
+        if (kv.empty()) continue;
+        size_t eq = kv.find('=');
+        if (eq == std::string::npos || eq == 0) return Fail(err, "bad generator parameter " + kv);
+        params[kv.substr(0, eq)] = kv.substr(eq + 1);
+    }
+    return true;
+}
+
+// positive decimal integer with nothing after it
+bool ParseCount(const std::map<std::string, std::string> &params, const char *name,
+                uint32_t &v, std::string *err) {
+    const std::string &s = params.find(name)->second;
+    if (s.empty() || s.size() > 9 || s.find_first_not_of("0123456789") != std::string::npos ||
+        (v = strtoul(s.c_str(), 0, 10)) == 0) {
+        return Fail(err, std::string("bad ") + name + " " + s + ", expected a positive integer");
+    }
+    return true;
+}
+
+}  // namespace
+
+bool TopologySpec::ParseRate(const std::string &s, uint64_t &bps) {
+    static const char *const units[] = {"bps", "Kbps", "kbps", "Mbps", "Gbps", "Tbps"};
+    static const double factors[] = {1, 1e3, 1e3, 1e6, 1e9, 1e12};
+    return ParseWithUnit(s, units, factors, 6, bps);
+}
+
+bool TopologySpec::ParseDelay(const std::string &s, uint64_t &ns) {
+    static const char *const units[] = {"ns", "us", "ms", "s"};
+    static const double factors[] = {1, 1e3, 1e6, 1e9};
+    return ParseWithUnit(s, units, factors, 4, ns);
+}
+
+uint32_t TopologySpec::GetNSwitches() const {
+    return std::count(isSwitch.begin(), isSwitch.end(), 1);
+}
+
+bool TopologySpec::Load(std::istream &is, std::string *err) {
+    TokenReader tr(is);
+    uint32_t nSwitch, nLink;
+    if (!tr.NextUint(nNodes) || !tr.NextUint(nSwitch) || !tr.NextUint(nLink)) {
+        return Fail(err, LineMsg(tr.GetLine(), "expected <nodes> <switches> <links>"));
+    }
+    if (nSwitch > nNodes) {
+        return Fail(err, LineMsg(tr.GetLine(), "more switches than nodes"));
+    }
+    isSwitch.assign(nNodes, 0);
+    for (uint32_t i = 0; i < nSwitch; i++) {
+        uint32_t id;
+        if (!tr.NextUint(id)) {
+            return Fail(err, LineMsg(tr.GetLine(), "expected a switch id"));
+        }
+        if (id >= nNodes || isSwitch[id]) {
+            std::ostringstream oss;
+            oss << "switch id " << id << (id >= nNodes ? " out of range" : " listed twice");
+            return Fail(err, LineMsg(tr.GetLine(), oss.str()));
+        }
+        isSwitch[id] = 1;
+    }
+    links.clear();
+    links.reserve(nLink);
+    std::vector<uint32_t> lines;  // of each link
+    for (uint32_t i = 0; i < nLink; i++) {
+        TopologyLink link;
+        std::string error;
+        if (!tr.NextUint(link.src) || !tr.NextUint(link.dst) || !tr.Next(link.rate) ||
+            !tr.Next(link.delay) || !tr.Next(error)) {
+            std::ostringstream oss;
+            oss << "link " << i << " of " << nLink
+                << ": expected <src> <dst> <rate> <delay> <error>";
+            return Fail(err, LineMsg(tr.GetLine(), oss.str()));
+        }
+        if (!ParseRate(link.rate, link.bps)) {
+            return Fail(err, LineMsg(tr.GetLine(), "bad rate " + link.rate));
+        }
+        if (!ParseDelay(link.delay, link.delayNs)) {
+            return Fail(err, LineMsg(tr.GetLine(), "bad delay " + link.delay));
+        }
+        char *end;
+        link.errorRate = strtod(error.c_str(), &end);
+        if (*end != '\0') {
+            return Fail(err, LineMsg(tr.GetLine(), "bad error rate " + error));
+        }
+        links.push_back(link);
+        lines.push_back(tr.GetLine());
+    }
+    std::string msg;
+    uint32_t bad;
+    if (!Validate(&msg, &bad)) {
+        return Fail(err, bad < lines.size() ? LineMsg(lines[bad], msg) : msg);
+    }
+    return true;
+}
+
+bool TopologySpec::LoadFile(const std::string &file, std::string *err) {
+    std::ifstream is(file.c_str());
+    if (!is) return Fail(err, "cannot open " + file);
+    if (!Load(is, err)) {
+        if (err) *err = file + ": " + *err;
+        return false;
+    }
+    return true;
+}
+
+void TopologySpec::Write(std::ostream &os) const {
+    os << nNodes << " " << GetNSwitches() << " " << links.size() << "\n";
+    bool first = true;
+    for (uint32_t i = 0; i < nNodes; i++) {
+        if (!isSwitch[i]) continue;
+        os << (first ? "" : " ") << i;
+        first = false;
+    }
+    os << "\n";
+    for (auto &l : links) {
+        os << l.src << " " << l.dst << " " << l.rate << " " << l.delay << " " << l.errorRate
+           << "\n";
+    }
+}
+
+bool TopologySpec::Validate(std::string *err, uint32_t *badLink) const {
+    if (badLink) *badLink = links.size();
+    if (isSwitch.size() != nNodes) return Fail(err, "node types do not match the node count");
+    std::set<std::pair<uint32_t, uint32_t> > seen;
+    std::vector<uint8_t> attached(nNodes, 0);
+    for (uint32_t i = 0; i < links.size(); i++) {
+        const TopologyLink &l = links[i];
+        if (badLink) *badLink = i;
+        std::ostringstream oss;
+        oss << "link " << l.src << " - " << l.dst << ": ";
+        if (l.src >= nNodes || l.dst >= nNodes) return Fail(err, oss.str() + "node out of range");
+        if (l.src == l.dst) return Fail(err, oss.str() + "self loop");
+        if (!isSwitch[l.src] && !isSwitch[l.dst]) {
+            return Fail(err, oss.str() + "hosts attach to switches only");
+        }
+        if (!seen.insert(std::make_pair(std::min(l.src, l.dst), std::max(l.src, l.dst))).second) {
+            return Fail(err, oss.str() + "parallel link");
+        }
+        if (l.bps == 0) return Fail(err, oss.str() + "zero rate");
+        if (l.delayNs == 0) return Fail(err, oss.str() + "zero delay");
+        if (!(l.errorRate >= 0 && l.errorRate <= 1)) {
+            return Fail(err, oss.str() + "error rate not in [0, 1]");
+        }
+        attached[l.src] = attached[l.dst] = 1;
+    }
+    if (badLink) *badLink = links.size();
+    for (uint32_t i = 0; i < nNodes; i++) {
+        if (!isSwitch[i] && !attached[i]) {
+            std::ostringstream oss;
+            oss << "host " << i << " belongs to no link";
+            return Fail(err, oss.str());
+        }
+    }
+    return true;
+}
+
+bool TopologySpec::SupportsLbMode(uint32_t lbMode, std::string *err) const {
+    if (lbMode != 3 && lbMode != 6 && lbMode != 9) return true;
+    std::vector<uint32_t> nics(nNodes, 0);
+    for (auto &l : links) {
+        nics[l.src]++;
+        nics[l.dst]++;
+    }
+    for (uint32_t i = 0; i < nNodes; i++) {
+        if (!isSwitch[i] && nics[i] > 1) {
+            std::ostringstream oss;
+            oss << "lb_mode " << lbMode << " keeps one ToR per host, but host " << i << " has "
+                << nics[i] << " NICs (multi-plane or multi-rail topology)";
+            return Fail(err, oss.str());
+        }
+    }
+    return true;
+}
+
+void TopologySpec::AddLink(uint32_t src, uint32_t dst, const std::string &rate, uint64_t delayNs) {
+    TopologyLink l;
+    l.src = src;
+    l.dst = dst;
+    l.rate = rate;
+    l.delay = DelayString(delayNs);
+    ParseRate(rate, l.bps);
+    l.delayNs = delayNs;
+    l.errorRate = 0;
+    links.push_back(l);
+}
+
+TopologySpec TopologySpec::LeafSpine(uint32_t nLeaf, uint32_t nSpine, uint32_t hostsPerLeaf,
+                                     const std::string &hostRate, const std::string &fabricRate,
+                                     uint64_t delayNs, uint32_t nPlane) {
+    TopologySpec t;
+    uint32_t nHost = nLeaf * hostsPerLeaf;
+    t.nNodes = nHost + nPlane * (nLeaf + nSpine);
+    t.isSwitch.assign(t.nNodes, 1);
+    std::fill(t.isSwitch.begin(), t.isSwitch.begin() + nHost, 0);
+    for (uint32_t p = 0; p < nPlane; p++) {
+        uint32_t leaf0 = nHost + p * (nLeaf + nSpine), spine0 = leaf0 + nLeaf;
+        for (uint32_t h = 0; h < nHost; h++) {
+            t.AddLink(h, leaf0 + h / hostsPerLeaf, hostRate, delayNs);
+        }
+        for (uint32_t l = 0; l < nLeaf; l++) {
+            for (uint32_t s = 0; s < nSpine; s++) {
+                t.AddLink(leaf0 + l, spine0 + s, fabricRate, delayNs);
+            }
+        }
+    }
+    return t;
+}
+
+TopologySpec TopologySpec::FatTree(uint32_t k, uint32_t os, const std::string &rate,
+                                   uint64_t delayNs) {
+    TopologySpec t;
+    uint32_t half = k / 2;
+    uint32_t nToR = half * k, nAgg = half * k, nCore = half * half;
+    uint32_t hostsPerToR = half * os, nHost = nToR * hostsPerToR;
+    uint32_t tor0 = nHost, agg0 = tor0 + nToR, core0 = agg0 + nAgg;
+    t.nNodes = core0 + nCore;
+    t.isSwitch.assign(t.nNodes, 1);
+    std::fill(t.isSwitch.begin(), t.isSwitch.begin() + nHost, 0);
+    for (uint32_t h = 0; h < nHost; h++) {
+        t.AddLink(h, tor0 + h / hostsPerToR, rate, delayNs);
+    }
+    for (uint32_t pod = 0; pod < k; pod++) {
+        for (uint32_t j = 0; j < half; j++) {
+            for (uint32_t a = 0; a < half; a++) {
+                t.AddLink(tor0 + pod * half + j, agg0 + pod * half + a, rate, delayNs);
+            }
+        }
+    }
+    for (uint32_t pod = 0; pod < k; pod++) {
+        for (uint32_t a = 0; a < half; a++) {
+            for (uint32_t c = 0; c < half; c++) {
+                t.AddLink(agg0 + pod * half + a, core0 + a * half + c, rate, delayNs);
+            }
+        }
+    }
+    return t;
+}
+
+bool TopologySpec::IsGeneratorSpec(const std::string &spec) {
+    return spec.compare(0, 11, "leaf_spine:") == 0 || spec.compare(0, 9, "fat_tree:") == 0;
+}
+
+bool TopologySpec::Generate(const std::string &spec, TopologySpec &topo, std::string *err) {
+    size_t colon = spec.find(':');
+    std::string kind = spec.substr(0, colon);
+    std::map<std::string, std::string> p;
+    if (kind == "leaf_spine") {
+        p["leaves"] = "8";
+        p["spines"] = "8";
+        p["hosts"] = "16";
+        p["rate"] = "100Gbps";
+        p["uplink"] = "";  // same as rate
+        p["delay"] = "1000";
+        p["planes"] = "1";
+    } else if (kind == "fat_tree") {
+        p["k"] = "8";
+        p["os"] = "2";
+        p["rate"] = "100Gbps";
+        p["delay"] = "1000";
+    } else {
+        return Fail(err, "unknown topology generator " + kind);
+    }
+    size_t nDefaults = p.size();
+    if (colon != std::string::npos && !ParseParams(spec.substr(colon + 1), p, err)) return false;
+    if (p.size() != nDefaults) return Fail(err, "unknown parameter in " + spec);
+
+    uint64_t bps, delay;
+    if (!ParseRate(p["rate"], bps)) return Fail(err, "bad rate " + p["rate"]);
+    // a bare number is in ns
+    std::string delayStr = p["delay"];
+    if (!delayStr.empty() && delayStr.find_first_not_of("0123456789") == std::string::npos) {
+        delayStr += "ns";
+    }
+    if (!ParseDelay(delayStr, delay)) return Fail(err, "bad delay " + p["delay"]);
+    if (kind == "leaf_spine") {
+        std::string uplink = p["uplink"].empty() ? p["rate"] : p["uplink"];
+        if (!ParseRate(uplink, bps)) return Fail(err, "bad uplink rate " + uplink);
+        uint32_t nLeaf, nSpine, nHost, nPlane;
+        if (!ParseCount(p, "leaves", nLeaf, err) || !ParseCount(p, "spines", nSpine, err) ||
+            !ParseCount(p, "hosts", nHost, err) || !ParseCount(p, "planes", nPlane, err)) {
+            return false;
+        }
+        topo = LeafSpine(nLeaf, nSpine, nHost, p["rate"], uplink, delay, nPlane);
+    } else {
+        uint32_t k, os;
+        if (!ParseCount(p, "k", k, err) || !ParseCount(p, "os", os, err)) return false;
+        if (k % 2) return Fail(err, "fat_tree: k must be even");
+        topo = FatTree(k, os, p["rate"], delay);
+    }
+    if (topo.nNodes == topo.GetNSwitches()) return Fail(err, spec + ": no hosts");
+    return topo.Validate(err);
+}
+
+/*------------------------------------- TopologyCache -------------------------------------*/
+
+static const char kCacheMagic[8] = {'N', 'S', '3', 'T', 'O', 'P', 'O', '1'};
+
+uint64_t TopologyCache::Hash(const void *data, size_t size, uint64_t seed) {
+    // FNV-1a
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        seed ^= p[i];
+        seed *= 1099511628211ull;
+    }
+    return seed;
+}
+
+bool TopologyCache::SourceKey(const std::string &topology, uint64_t extra, uint64_t &key) {
+    std::string bytes = topology;
+    if (!TopologySpec::IsGeneratorSpec(topology)) {
+        std::ifstream is(topology.c_str(), std::ios::binary);
+        if (!is) return false;
+        std::ostringstream oss;
+        oss << is.rdbuf();
+        bytes = oss.str();
+    }
+    key = Hash(bytes.data(), bytes.size());
+    key = Hash(&extra, sizeof(extra), key);
+    return true;
+}
+
+namespace {
+
+template <typename T>
+void Put(std::ostream &os, const T &v) {
+    os.write((const char *)&v, sizeof(v));
+}
+void PutString(std::ostream &os, const std::string &s) {
+    Put<uint32_t>(os, s.size());
+    os.write(s.data(), s.size());
+}
+template <typename T>
+bool Get(std::istream &is, T &v) {
+    return (bool)is.read((char *)&v, sizeof(v));
+}
+bool GetString(std::istream &is, std::string &s) {
+    uint32_t n;
+    if (!Get(is, n) || n > (1u << 16)) return false;
+    s.resize(n);
+    return n == 0 || (bool)is.read(&s[0], n);
+}
+
+}  // namespace
+
+bool TopologyCache::Save(const std::string &file, uint64_t key, const TopologySpec &topo,
+                         const TopologyRoutes &routes) {
+    // written aside and renamed, so that concurrent runs never read a partial cache
+    std::string tmp = file + ".tmp";
+    {
+        std::ofstream os(tmp.c_str(), std::ios::binary);
+        if (!os) return false;
+        os.write(kCacheMagic, sizeof(kCacheMagic));
+        Put(os, key);
+        Put(os, topo.nNodes);
+        os.write((const char *)topo.isSwitch.data(), topo.nNodes);
+        Put<uint32_t>(os, topo.links.size());
+        for (auto &l : topo.links) {
+            Put(os, l.src);
+            Put(os, l.dst);
+            PutString(os, l.rate);
+            PutString(os, l.delay);
+            Put(os, l.bps);
+            Put(os, l.delayNs);
+            Put(os, l.errorRate);
+        }
+        Put<uint64_t>(os, routes.entries.size());
+        for (auto &e : routes.entries) {
+            Put(os, e.node);
+            Put(os, e.host);
+            Put(os, e.delay);
+            Put(os, e.txDelay);
+            Put(os, e.bw);
+            Put<uint32_t>(os, e.nexts.size());
+            os.write((const char *)e.nexts.data(), e.nexts.size() * sizeof(uint32_t));
+        }
+        if (!os) return false;
+    }
+    return rename(tmp.c_str(), file.c_str()) == 0;
+}
+
+bool TopologyCache::Load(const std::string &file, uint64_t key, TopologySpec &topo,
+                         TopologyRoutes &routes) {
+    std::ifstream is(file.c_str(), std::ios::binary | std::ios::ate);
+    if (!is) return false;
+    // every count is bounded by what the file can hold, so a damaged file is a miss, not an
+    // allocation of whatever its bytes say
+    uint64_t size = is.tellg();
+    is.seekg(0);
+    char magic[sizeof(kCacheMagic)];
+    uint64_t fileKey;
+    if (!is.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), kCacheMagic) ||
+        !Get(is, fileKey) || fileKey != key) {
+        return false;
+    }
+    // filled aside, and only handed out once all of it is read and checked
+    TopologySpec t;
+    TopologyRoutes r;
+    uint32_t nLink;
+    if (!Get(is, t.nNodes) || t.nNodes > size) return false;
+    t.isSwitch.resize(t.nNodes);
+    if (!is.read((char *)t.isSwitch.data(), t.nNodes) || !Get(is, nLink)) return false;
+    for (auto sw : t.isSwitch) {
+        if (sw > 1) return false;
+    }
+    const uint64_t kMinLink = 2 * 4 + 2 * 4 + 3 * 8;  // ids, string lengths, bps/delay/error
+    if (nLink > size / kMinLink) return false;
+    t.links.resize(nLink);
+    for (auto &l : t.links) {
+        if (!Get(is, l.src) || !Get(is, l.dst) || !GetString(is, l.rate) ||
+            !GetString(is, l.delay) || !Get(is, l.bps) || !Get(is, l.delayNs) ||
+            !Get(is, l.errorRate)) {
+            return false;
+        }
+    }
+    if (!t.Validate(0)) return false;  // link ends in range
+    uint64_t nEntry;
+    const uint64_t kMinEntry = 2 * 4 + 3 * 8 + 4;  // node, host, delays and bw, next count
+    if (!Get(is, nEntry) || nEntry > size / kMinEntry) return false;
+    r.entries.resize(nEntry);
+    for (auto &e : r.entries) {
+        uint32_t nNext;
+        if (!Get(is, e.node) || !Get(is, e.host) || !Get(is, e.delay) || !Get(is, e.txDelay) ||
+            !Get(is, e.bw) || !Get(is, nNext) || nNext > t.nNodes) {
+            return false;
+        }
+        if (e.node >= t.nNodes || e.host >= t.nNodes || t.isSwitch[e.host]) return false;
+        e.nexts.resize(nNext);
+        if (nNext && !is.read((char *)e.nexts.data(), nNext * sizeof(uint32_t))) return false;
+        for (auto next : e.nexts) {
+            if (next >= t.nNodes) return false;
+        }
+    }
+    std::swap(topo, t);
+    std::swap(routes, r);
+    return true;
+}
+
+}  // namespace ns3
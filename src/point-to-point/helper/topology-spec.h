@@ -0,0 +1,141 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __TOPOLOGY_SPEC_H__
+#define __TOPOLOGY_SPEC_H__
+
+#include <stdint.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+struct TopologyLink {
+    uint32_t src;
+    uint32_t dst;
+    std::string rate;   // as given, e.g. "100Gbps"
+    std::string delay;  // as given, e.g. "1000ns"
+    uint64_t bps;
+    uint64_t delayNs;
+    double errorRate;
+};
+
+/**
+ * @brief Nodes and links of a simulated fabric, before any ns-3 object is created.
+ *
+ * The text format is the one of the files in config/:
+ *   <nodes> <switches> <links>
+ *   <switch id> ... (one per switch)
+ *   <src> <dst> <rate> <delay> <error rate>   (one per link)
+ * Anything after the last link is ignored. Links may have different rates. Hosts attach to
+ * switches only; a host listed in several links is a multi-NIC (multi-rail) host.
+ *
+ * Generators build the usual fabrics from a spec string (see Generate), and TopologyCache
+ * keeps a built topology with its routes in a binary file.
+ */
+class TopologySpec {
+   public:
+    TopologySpec() : nNodes(0) {}
+
+    uint32_t nNodes;
+    std::vector<uint8_t> isSwitch;  // per node
+    std::vector<TopologyLink> links;
+
+    uint32_t GetNSwitches() const;
+
+    // false, with the offending line in err, if the text is malformed or fails Validate
+    bool Load(std::istream &is, std::string *err);
+    bool LoadFile(const std::string &file, std::string *err);
+    void Write(std::ostream &os) const;
+
+    // node ids in range, no self/parallel/host-to-host links, every host attached,
+    // rates and delays > 0, error rates in [0, 1]. badLink: index of the link at fault, or
+    // the number of links if the fault is not a link
+    bool Validate(std::string *err, uint32_t *badLink = 0) const;
+
+    // The ToR-to-ToR load balancers (lb_mode 3: CONGA, 6: LetFlow, 9: ConWeave) keep one ToR
+    // per host IP, so they need single-NIC hosts. false, with the reason in err, otherwise
+    bool SupportsLbMode(uint32_t lbMode, std::string *err) const;
+
+    // hosts [0, leaves * hostsPerLeaf), then the leaves and spines of plane 0, plane 1, ...
+    // Every host has one NIC per plane, so nPlane > 1 rules out lb_mode 3, 6 and 9.
+    static TopologySpec LeafSpine(uint32_t nLeaf, uint32_t nSpine, uint32_t hostsPerLeaf,
+                                  const std::string &hostRate, const std::string &fabricRate,
+                                  uint64_t delayNs, uint32_t nPlane = 1);
+    // k-ary fat-tree with k/2 * os hosts per ToR (os: oversubscription), numbered as
+    // config/fat_topology_gen.py does
+    static TopologySpec FatTree(uint32_t k, uint32_t os, const std::string &rate, uint64_t delayNs);
+
+    /**
+     * @brief Whether a TOPOLOGY_FILE value names a generator instead of a file:
+     *   leaf_spine:leaves=8,spines=8,hosts=16,rate=100Gbps,uplink=100Gbps,delay=1000,planes=1
+     *   fat_tree:k=8,os=2,rate=100Gbps,delay=1000
+     * Omitted keys take the values above. The delay is in ns unless it has a unit (e.g. 1us),
+     * counts are positive integers.
+     */
+    static bool IsGeneratorSpec(const std::string &spec);
+    static bool Generate(const std::string &spec, TopologySpec &topo, std::string *err);
+
+    static bool ParseRate(const std::string &s, uint64_t &bps);
+    static bool ParseDelay(const std::string &s, uint64_t &ns);
+
+   private:
+    void AddLink(uint32_t src, uint32_t dst, const std::string &rate, uint64_t delayNs);
+};
+
+/**
+ * @brief Shortest-path routes towards every host, in node ids: what the simulation script
+ * computes with one BFS per host, kept so that a cached run can skip it.
+ */
+struct TopologyRoutes {
+    struct Entry {
+        uint32_t node;
+        uint32_t host;
+        uint64_t delay;    // ns, node to host
+        uint64_t txDelay;  // ns, serialization of one packet on every hop
+        uint64_t bw;       // bottleneck bps
+        std::vector<uint32_t> nexts;  // next hops from node towards host, in ECMP order
+    };
+    std::vector<Entry> entries;
+};
+
+/**
+ * @brief Binary cache of a TopologySpec and its TopologyRoutes.
+ *
+ * The key identifies what the content was built from (the topology text or generator spec,
+ * and whatever else the routes depend on); a cache built from another key is not used.
+ */
+class TopologyCache {
+   public:
+    static uint64_t Hash(const void *data, size_t size, uint64_t seed = 14695981039346656037ull);
+    // key of a topology file (its bytes) or generator spec (the string), mixed with extra
+    static bool SourceKey(const std::string &topology, uint64_t extra, uint64_t &key);
+
+    static bool Save(const std::string &file, uint64_t key, const TopologySpec &topo,
+                     const TopologyRoutes &routes);
+    // false, leaving topo and routes as they were, if the file is missing, was built from
+    // another key, or is truncated or damaged (counts it cannot hold, node ids out of range)
+    static bool Load(const std::string &file, uint64_t key, TopologySpec &topo,
+                     TopologyRoutes &routes);
+};
+
+}  // namespace ns3
+
+#endif /* __TOPOLOGY_SPEC_H__ */
@@ -20,6 +20,8 @@
 
 #include "ns3/conga-routing.h"
 
+#include <algorithm>
+
 #include "assert.h"
 #include "ns3/assert.h"
 #include "ns3/event-id.h"
@@ -29,6 +31,7 @@
 #include "ns3/object.h"
 #include "ns3/packet.h"
 #include "ns3/settings.h"
+#include "ns3/sim-profiler.h"
 #include "ns3/simulator.h"
 
 NS_LOG_COMPONENT_DEFINE("CongaRouting");
@@ -93,6 +96,7 @@ CongaRouting::CongaRouting() {
     m_flowletTimeout = Time(MicroSeconds(100));
     m_quantizeBit = 3;
     m_alpha = 0.2;
+    m_dreStarted = false;
 }
 
 // it defines flowlet's 64bit key (order does not matter)
@@ -129,18 +133,40 @@ void CongaRouting::SetSwitchInfo(bool isToR, uint32_t switch_id) {
 }
 
 void CongaRouting::SetLinkCapacity(uint32_t outPort, uint64_t bitRate) {
-    auto it = m_outPort2BitRateMap.find(outPort);
-    if (it != m_outPort2BitRateMap.end()) {
+    if (outPort >= m_outPort2BitRate.size()) {
+        m_outPort2BitRate.resize(outPort + 1, 0);
+    }
+    if (m_outPort2BitRate[outPort] != 0) {
         // already exists, then check matching
-        NS_ASSERT_MSG(it->second == bitRate,
+        NS_ASSERT_MSG(m_outPort2BitRate[outPort] == bitRate,
                       "bitrate already exists, but inconsistent with new input");
     } else {
-        m_outPort2BitRateMap[outPort] = bitRate;
+        m_outPort2BitRate[outPort] = bitRate;
+    }
+}
+
+void CongaRouting::AddPath(uint32_t dstToRId, uint32_t pathId) {
+    if (dstToRId >= m_congaRoutingTable.size()) {
+        m_congaRoutingTable.resize(dstToRId + 1);
+        m_congaFromLeafTable.resize(dstToRId + 1);
+        m_congaToLeafTable.resize(dstToRId + 1);
     }
+    std::vector<uint32_t>& paths = m_congaRoutingTable[dstToRId];
+    auto it = std::lower_bound(paths.begin(), paths.end(), pathId);
+    if (it != paths.end() && *it == pathId) {
+        return;  // known path
+    }
+    OutpathInfo outpathInfo;
+    outpathInfo._ce = 0;  // no info means good
+    outpathInfo._updateTime = Seconds(0);
+    m_congaToLeafTable[dstToRId].insert(m_congaToLeafTable[dstToRId].begin() + (it - paths.begin()),
+                                        outpathInfo);
+    paths.insert(it, pathId);
 }
 
 /* CongaRouting's main function */
 void CongaRouting::RouteInput(Ptr<Packet> p, CustomHeader ch) {
+    NS_PROFILE_SCOPE("lb/conga");
     // Packet arrival time
     Time now = Simulator::Now();
 
@@ -154,11 +180,10 @@ void CongaRouting::RouteInput(Ptr<Packet> p, CustomHeader ch) {
     }
     assert(ch.l3Prot == 0x11 && "Only supports UDP data packets");
 
-    // Turn on DRE event scheduler if it is not running
-    if (!m_dreEvent.IsRunning()) {
-        NS_LOG_FUNCTION("Conga routing restarts dre event scheduling, Switch:" << m_switch_id
-                                                                               << now);
-        m_dreEvent = Simulator::Schedule(m_dreTime, &CongaRouting::DreEvent, this);
+    // DRE periods start with the first packet
+    if (!m_dreStarted) {
+        NS_LOG_FUNCTION("Conga routing starts dre periods, Switch:" << m_switch_id << now);
+        StartDre();
     }
 
     // Turn on aging event scheduler if it is not running
@@ -168,12 +193,10 @@ void CongaRouting::RouteInput(Ptr<Packet> p, CustomHeader ch) {
     }
 
     // get srcToRId, dstToRId
-    assert(Settings::hostIp2SwitchId.find(ch.sip) !=
-           Settings::hostIp2SwitchId.end());  // Misconfig of Settings::hostIp2SwitchId - sip"
-    assert(Settings::hostIp2SwitchId.find(ch.dip) !=
-           Settings::hostIp2SwitchId.end());  // Misconfig of Settings::hostIp2SwitchId - dip"
-    uint32_t srcToRId = Settings::hostIp2SwitchId[ch.sip];
-    uint32_t dstToRId = Settings::hostIp2SwitchId[ch.dip];
+    uint32_t srcToRId = Settings::ToROfIp(ch.sip);
+    uint32_t dstToRId = Settings::ToROfIp(ch.dip);
+    assert(srcToRId != Settings::INVALID_ID);  // Misconfig of Settings host index - sip
+    assert(dstToRId != Settings::INVALID_ID);  // Misconfig of Settings host index - dip
 
     /** FILTER: Quickly filter intra-pod traffic */
     if (srcToRId == dstToRId) {  // do normal routing (only one path)
@@ -194,17 +217,16 @@ void CongaRouting::RouteInput(Ptr<Packet> p, CustomHeader ch) {
     if (m_isToR) {     // ToR switch
         if (!found) {  // sender-side
             /*---- add piggyback info to CongaTag ----*/
-            auto fbItr = m_congaFromLeafTable.find(dstToRId);
-            NS_ASSERT_MSG(fbItr != m_congaFromLeafTable.end(),
+            NS_ASSERT_MSG(dstToRId < m_congaFromLeafTable.size(),
                           "dstToRId cannot be found in FromLeafTable");
-            auto innerFbItr = (fbItr->second).begin();
-            if (!(fbItr->second).empty()) {
-                std::advance(innerFbItr,
-                             rand() % (fbItr->second).size());  // uniformly-random feedback
+            const std::vector<FeedbackInfo>& feedbacks = m_congaFromLeafTable[dstToRId];
+            if (!feedbacks.empty()) {
+                const FeedbackInfo& fb =
+                    feedbacks[rand() % feedbacks.size()];  // uniformly-random feedback
                 // set values to new CongaTag
-                congaTag.SetHopCount(0);                       // hopCount
-                congaTag.SetFbPathId(innerFbItr->first);       // path
-                congaTag.SetFbMetric(innerFbItr->second._ce);  // ce
+                congaTag.SetHopCount(0);          // hopCount
+                congaTag.SetFbPathId(fb._pathId);  // path
+                congaTag.SetFbMetric(fb._ce);      // ce
             } else {
                 // empty (nothing to feedback) then set a dummy
                 congaTag.SetHopCount(0);           // hopCount
@@ -305,36 +327,14 @@ void CongaRouting::RouteInput(Ptr<Packet> p, CustomHeader ch) {
         }
         /*---- receiver-side ----*/
         // update CongaToLeaf table
-        auto toLeafItr = m_congaToLeafTable.find(srcToRId);
-        assert(toLeafItr != m_congaToLeafTable.end() && "Cannot find srcToRId from ToLeafTable");
-        auto innerToLeafItr = (toLeafItr->second).find(congaTag.GetFbPathId());
+        assert(srcToRId < m_congaToLeafTable.size() && "Cannot find srcToRId from ToLeafTable");
         if (congaTag.GetFbPathId() != CONGA_NULL &&
-            congaTag.GetFbMetric() != CONGA_NULL) {             // if valid feedback
-            if (innerToLeafItr == (toLeafItr->second).end()) {  // no feedback so far, then create
-                OutpathInfo outpathInfo;
-                outpathInfo._ce = congaTag.GetFbMetric();
-                outpathInfo._updateTime = now;
-                (toLeafItr->second)[congaTag.GetFbPathId()] = outpathInfo;
-            } else {  // update statistics
-                (innerToLeafItr->second)._ce = congaTag.GetFbMetric();
-                (innerToLeafItr->second)._updateTime = now;
-            }
+            congaTag.GetFbMetric() != CONGA_NULL) {  // if valid feedback
+            UpdateToLeaf(srcToRId, congaTag.GetFbPathId(), congaTag.GetFbMetric());
         }
 
         // update CongaFromLeaf table
-        auto fromLeafItr = m_congaFromLeafTable.find(srcToRId);
-        assert(fromLeafItr != m_congaFromLeafTable.end() &&
-               "Cannot find srcToRId from FromLeafTable");
-        auto innerfromLeafItr = (fromLeafItr->second).find(congaTag.GetPathId());
-        if (innerfromLeafItr == (fromLeafItr->second).end()) {  // no data sent so far, then create
-            FeedbackInfo feedbackInfo;
-            feedbackInfo._ce = congaTag.GetCe();
-            feedbackInfo._updateTime = now;
-            (fromLeafItr->second)[congaTag.GetPathId()] = feedbackInfo;
-        } else {  // update feedback
-            (innerfromLeafItr->second)._ce = congaTag.GetCe();
-            (innerfromLeafItr->second)._updateTime = now;
-        }
+        UpdateFromLeaf(srcToRId, congaTag.GetPathId(), congaTag.GetCe());
 
         // remove congaTag from header
         p->RemovePacketTag(congaTag);
@@ -375,71 +375,112 @@ void CongaRouting::RouteInput(Ptr<Packet> p, CustomHeader ch) {
 
 // minimize the maximum link utilization
 uint32_t CongaRouting::GetBestPath(uint32_t dstToRId, uint32_t nSample) {
-    auto pathItr = m_congaRoutingTable.find(dstToRId);
-    assert(pathItr != m_congaRoutingTable.end() && "Cannot find dstToRId from ToLeafTable");
-    std::set<uint32_t>::iterator innerPathItr = pathItr->second.begin();
-    if (pathItr->second.size() >= nSample) {  // exception handling
-        std::advance(innerPathItr, rand() % (pathItr->second.size() - nSample + 1));
+    assert(dstToRId < m_congaRoutingTable.size() && "Cannot find dstToRId from ToLeafTable");
+    const std::vector<uint32_t>& paths = m_congaRoutingTable[dstToRId];
+    const std::vector<OutpathInfo>& pathInfo = m_congaToLeafTable[dstToRId];  // remote congestion
+    uint32_t first = 0;
+    if (paths.size() >= nSample) {  // exception handling
+        first = rand() % (paths.size() - nSample + 1);
     } else {
-        nSample = pathItr->second.size();
+        nSample = paths.size();
         // std::cout << "WARNING - Conga's number of path sampling is higher than available paths.
         // Enforced to reduce nSample:" << nSample << std::endl;
     }
 
-    // path info for remote congestion, <pathId -> pathInfo>
-    auto pathInfoMap = m_congaToLeafTable[dstToRId];
+    // congestion of the sampled paths, maximum of (local, remote)
+    m_congestion.resize(nSample);
+    for (uint32_t i = 0; i < nSample; i++) {
+        uint32_t outPort = GetOutPortFromPath(paths[first + i], 0);  // outPort (TxToR)
+        uint32_t X = GetLocalDre(outPort);
+        uint32_t localCongestion = X ? QuantizingX(outPort, X) : 0;
+        m_congestion[i] = std::max(localCongestion, pathInfo[first + i]._ce);
+    }
 
-    // get min-max path
-    std::vector<uint32_t> candidatePaths;
+    // get min-max path, randomly among the equally good ones
     uint32_t minCongestion = CONGA_NULL;
     for (uint32_t i = 0; i < nSample; i++) {
-        // get info of path
-        uint32_t pathId = *innerPathItr;
-        auto innerPathInfo = pathInfoMap.find(pathId);
-
-        // no info means good
-        uint32_t localCongestion = 0;
-        uint32_t remoteCongestion = 0;
-
-        auto outPort = GetOutPortFromPath(pathId, 0);  // outPort from pathId (TxToR)
-
-        // local congestion -> get Port Util and quantize it
-        auto innerDre = m_DreMap.find(outPort);
-        if (innerDre != m_DreMap.end()) {
-            localCongestion = QuantizingX(outPort, innerDre->second);
+        minCongestion = std::min(minCongestion, m_congestion[i]);
+    }
+    uint32_t nCandidates = 0;
+    for (uint32_t i = 0; i < nSample; i++) {
+        nCandidates += (m_congestion[i] == minCongestion);
+    }
+    assert(nCandidates > 0 && "candidatePaths has no entry");
+    uint32_t pick = rand() % nCandidates;
+    for (uint32_t i = 0;; i++) {
+        if (m_congestion[i] == minCongestion && pick-- == 0) {
+            return paths[first + i];
         }
+    }
+}
 
-        // remote congestion
-        if (innerPathInfo != pathInfoMap.end()) {
-            remoteCongestion = innerPathInfo->second._ce;
-        }
+void CongaRouting::UpdateToLeaf(uint32_t dstToRId, uint32_t pathId, uint32_t ce) {
+    const std::vector<uint32_t>& paths = m_congaRoutingTable[dstToRId];
+    auto it = std::lower_bound(paths.begin(), paths.end(), pathId);
+    if (it == paths.end() || *it != pathId) {
+        return;  // not one of our paths, never sampled
+    }
+    OutpathInfo& outpathInfo = m_congaToLeafTable[dstToRId][it - paths.begin()];
+    outpathInfo._ce = ce;
+    outpathInfo._updateTime = Simulator::Now();
+}
 
-        // get maximum of congestion (local, remote)
-        uint32_t CurrCongestion = std::max(localCongestion, remoteCongestion);
+static bool FeedbackBefore(const FeedbackInfo& feedbackInfo, uint32_t pathId) {
+    return feedbackInfo._pathId < pathId;
+}
 
-        // filter the best path
-        if (minCongestion > CurrCongestion) {
-            minCongestion = CurrCongestion;
-            candidatePaths.clear();
-            candidatePaths.push_back(pathId);  // best
-        } else if (minCongestion == CurrCongestion) {
-            candidatePaths.push_back(pathId);  // equally good
-        }
-        std::advance(innerPathItr, 1);
+void CongaRouting::UpdateFromLeaf(uint32_t srcToRId, uint32_t pathId, uint32_t ce) {
+    assert(srcToRId < m_congaFromLeafTable.size() && "Cannot find srcToRId from FromLeafTable");
+    std::vector<FeedbackInfo>& feedbacks = m_congaFromLeafTable[srcToRId];
+    auto it = std::lower_bound(feedbacks.begin(), feedbacks.end(), pathId, FeedbackBefore);
+    if (it == feedbacks.end() || it->_pathId != pathId) {  // no data sent so far, then create
+        FeedbackInfo feedbackInfo;
+        feedbackInfo._pathId = pathId;
+        it = feedbacks.insert(it, feedbackInfo);
     }
-    assert(candidatePaths.size() > 0 && "candidatePaths has no entry");
-    return candidatePaths[rand() % candidatePaths.size()];  // randomly choose the best path
+    it->_ce = ce;
+    it->_updateTime = Simulator::Now();
 }
 
-uint32_t CongaRouting::UpdateLocalDre(Ptr<Packet> p, CustomHeader ch, uint32_t outPort) {
-    uint32_t X = m_DreMap[outPort];
+uint32_t CongaRouting::UpdateLocalDre(Ptr<Packet> p, const CustomHeader& ch, uint32_t outPort) {
+    if (outPort >= m_dre.size()) {
+        m_dre.resize(outPort + 1, 0);
+        m_dreDecays.resize(outPort + 1, 0);
+    }
+    uint32_t X = GetLocalDre(outPort);
     uint32_t newX = X + p->GetSize();
     // NS_LOG_FUNCTION("Old X" << X << "New X" << newX << "outPort" << outPort << "Switch" <<
     // m_switch_id << Simulator::Now());
-    m_DreMap[outPort] = newX;
+    m_dre[outPort] = newX;
     return newX;
 }
 
+void CongaRouting::StartDre() {
+    if (!m_dreStarted) {
+        m_dreStarted = true;
+        m_dreStart = Simulator::Now();
+    }
+}
+
+/**
+ * DRE decays by (1 - alpha) every m_dreTime since the first packet. Instead of a periodic
+ * event over all ports, the periods elapsed since the last access are applied when the DRE
+ * of a port is read, with the same rounding.
+ */
+uint32_t CongaRouting::GetLocalDre(uint32_t outPort) {
+    if (outPort >= m_dre.size()) {
+        return 0;
+    }
+    uint64_t decays =
+        m_dreStarted ? (Simulator::Now() - m_dreStart).GetTimeStep() / m_dreTime.GetTimeStep() : 0;
+    uint32_t& X = m_dre[outPort];
+    for (uint64_t d = m_dreDecays[outPort]; d < decays && X > 0; d++) {
+        X = X * (1 - m_alpha);
+    }
+    m_dreDecays[outPort] = decays;
+    return X;
+}
+
 uint32_t CongaRouting::GetOutPortFromPath(const uint32_t& path, const uint32_t& hopCount) {
     return ((uint8_t*)&path)[hopCount];
 }
@@ -450,9 +491,9 @@ void CongaRouting::SetOutPortToPath(uint32_t& path, const uint32_t& hopCount,
 }
 
 uint32_t CongaRouting::QuantizingX(uint32_t outPort, uint32_t X) {
-    auto it = m_outPort2BitRateMap.find(outPort);
-    assert(it != m_outPort2BitRateMap.end() && "Cannot find bitrate of interface");
-    uint64_t bitRate = it->second;
+    assert(outPort < m_outPort2BitRate.size() && m_outPort2BitRate[outPort] != 0 &&
+           "Cannot find bitrate of interface");
+    uint64_t bitRate = m_outPort2BitRate[outPort];
     double ratio = static_cast<double>(X * 8) / (bitRate * m_dreTime.GetSeconds() / m_alpha);
     uint32_t quantX = static_cast<uint32_t>(ratio * std::pow(2, m_quantizeBit));
     if (quantX > 3) {
@@ -474,49 +515,33 @@ void CongaRouting::DoDispose() {
     for (auto i : m_flowletTable) {
         delete (i.second);
     }
-    m_dreEvent.Cancel();
     m_agingEvent.Cancel();
 }
 
-void CongaRouting::DreEvent() {
-    std::map<uint32_t, uint32_t>::iterator itr = m_DreMap.begin();
-    for (; itr != m_DreMap.end(); ++itr) {
-        uint32_t newX = itr->second * (1 - m_alpha);
-        itr->second = newX;
-    }
-    NS_LOG_FUNCTION(Simulator::Now());
-    m_dreEvent = Simulator::Schedule(m_dreTime, &CongaRouting::DreEvent, this);
-}
-
 void CongaRouting::AgingEvent() {
     auto now = Simulator::Now();
-    auto itr = m_congaToLeafTable.begin();  // always non-empty
-    for (; itr != m_congaToLeafTable.end(); ++itr) {
-        auto innerItr = (itr->second).begin();
-        for (; innerItr != (itr->second).end(); ++innerItr) {
-            if (now - (innerItr->second)._updateTime > m_agingTime) {
-                (innerItr->second)._ce = 0;
+    for (auto& outpaths : m_congaToLeafTable) {
+        for (auto& outpathInfo : outpaths) {
+            if (now - outpathInfo._updateTime > m_agingTime) {
+                outpathInfo._ce = 0;
             }
         }
     }
 
-    auto itr2 = m_congaFromLeafTable.begin();
-    while (itr2 != m_congaFromLeafTable.end()) {
-        auto innerItr2 = (itr2->second).begin();
-        while (innerItr2 != (itr2->second).end()) {
-            if (now - (innerItr2->second)._updateTime > m_agingTime) {
-                innerItr2 = (itr2->second).erase(innerItr2);
-            } else {
-                ++innerItr2;
+    for (auto& feedbacks : m_congaFromLeafTable) {
+        auto keep = feedbacks.begin();
+        for (auto itr2 = feedbacks.begin(); itr2 != feedbacks.end(); ++itr2) {
+            if (now - itr2->_updateTime <= m_agingTime) {
+                *keep++ = *itr2;
             }
         }
-        ++itr2;
+        feedbacks.erase(keep, feedbacks.end());
     }
 
     auto itr3 = m_flowletTable.begin();
     while (itr3 != m_flowletTable.end()) {
         if (now - ((itr3->second)->_activeTime) > m_agingTime) {
-            // delete(itr3->second); // delete pointer
+            delete (itr3->second);
             itr3 = m_flowletTable.erase(itr3);
         } else {
             ++itr3;
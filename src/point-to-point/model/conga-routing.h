@@ -44,6 +44,7 @@ namespace ns3 {
 const uint32_t CONGA_NULL = UINT32_MAX;
 
 struct FeedbackInfo {
+    uint32_t _pathId;
     uint32_t _ce;
     Time _updateTime;
 };
@@ -107,9 +108,13 @@ class CongaRouting : public Object {
 
     /* main function */
     void RouteInput(Ptr<Packet> p, CustomHeader ch);
-    uint32_t UpdateLocalDre(Ptr<Packet> p, CustomHeader ch, uint32_t outPort);
+    uint32_t UpdateLocalDre(Ptr<Packet> p, const CustomHeader& ch, uint32_t outPort);
+    void StartDre();                                     // DRE periods start now (first packet)
+    uint32_t GetLocalDre(uint32_t outPort);              // DRE of outPort, decayed up to now
     uint32_t QuantizingX(uint32_t outPort, uint32_t X);  // X is bytes here and we quantizing it to 0 - 2^Q
     uint32_t GetBestPath(uint32_t dstTorId, uint32_t nSample);
+    void UpdateToLeaf(uint32_t dstToRId, uint32_t pathId, uint32_t ce);    // feedback of our path
+    void UpdateFromLeaf(uint32_t srcToRId, uint32_t pathId, uint32_t ce);  // CE of a path to us
     virtual void DoDispose();
 
     /* SET functions */
@@ -117,17 +122,16 @@ class CongaRouting : public Object {
     void SetSwitchInfo(bool isToR, uint32_t switch_id);
     void SetLinkCapacity(uint32_t outPort, uint64_t bitRate);
 
-    // periodic events
-    EventId m_dreEvent;
+    // periodic events (DRE decays when it is read, see GetLocalDre)
     EventId m_agingEvent;
-    void DreEvent();
     void AgingEvent();
 
-    // topological info (should be initialized in the beginning)
-    std::map<uint32_t, std::set<uint32_t> > m_congaRoutingTable;                 // routing table (ToRId -> pathId) (stable)
-    std::map<uint32_t, std::map<uint32_t, FeedbackInfo> > m_congaFromLeafTable;  // ToRId -> <pathId -> FeedbackInfo> (aged)
-    std::map<uint32_t, std::map<uint32_t, OutpathInfo> > m_congaToLeafTable;     // ToRId -> <pathId -> OutpathInfo> (aged)
-    std::map<uint32_t, uint64_t> m_outPort2BitRateMap;                           // outPort -> link bitrate (bps) (stable)
+    // topological info (should be initialized in the beginning), indexed by ToRId
+    void AddPath(uint32_t dstToRId, uint32_t pathId);
+    std::vector<std::vector<uint32_t> > m_congaRoutingTable;        // routing table (ToRId -> sorted pathIds) (stable)
+    std::vector<std::vector<FeedbackInfo> > m_congaFromLeafTable;  // ToRId -> FeedbackInfo sorted by pathId (aged)
+    std::vector<std::vector<OutpathInfo> > m_congaToLeafTable;     // ToRId -> OutpathInfo of each path of the routing table (aged)
+    std::vector<uint64_t> m_outPort2BitRate;                       // outPort -> link bitrate (bps), 0: unknown (stable)
 
     /*-----CALLBACK------*/
     void DoSwitchSend(Ptr<Packet> p, CustomHeader& ch, uint32_t outDev,
@@ -158,7 +162,11 @@ class CongaRouting : public Object {
     double m_alpha;          // dre algorithm (e.g., 0.2)
 
     // local
-    std::map<uint32_t, uint32_t> m_DreMap;        // outPort -> DRE (at SrcToR)
+    std::vector<uint32_t> m_dre;       // outPort -> DRE (at SrcToR), decayed m_dreDecays[outPort] times
+    std::vector<uint64_t> m_dreDecays;  // outPort -> number of m_dreTime periods applied to m_dre
+    bool m_dreStarted;                  // DRE periods start with the first packet
+    Time m_dreStart;
+    std::vector<uint32_t> m_congestion;           // GetBestPath scratch, per sampled path
     std::map<uint64_t, Flowlet*> m_flowletTable;  // QpKey -> Flowlet (at SrcToR)
 };
 
@@ -38,6 +38,7 @@
 #include "ns3/qbb-header.h"
 #include "ns3/random-variable.h"
 #include "ns3/settings.h"
+#include "ns3/sim-profiler.h"
 #include "ns3/simulator.h"
 #include "ns3/udp-header.h"
 
@@ -167,11 +168,14 @@ uint64_t ConWeaveRouting::m_nOutOfOrderPkts = 0;
 uint64_t ConWeaveRouting::m_nFlushVOQTotal = 0;
 uint64_t ConWeaveRouting::m_nFlushVOQByTail = 0;
 std::vector<uint32_t> ConWeaveRouting::m_historyVOQSize;
+std::vector<conweavePathInfo> ConWeaveRouting::m_pathInfo;
+std::vector<uint32_t> ConWeaveRouting::m_pathPorts;
 
 // functions
 ConWeaveRouting::ConWeaveRouting() {
     m_isToR = false;
     m_switch_id = (uint32_t)-1;
+    m_voqVolume = 0;
 
     // set constants
     m_extraReplyDeadline = MicroSeconds(4);       // 1 hop of 50KB / 100Gbps = 4us
@@ -181,7 +185,6 @@ ConWeaveRouting::ConWeaveRouting() {
     m_pathPauseTime = MicroSeconds(8);            // 100KB queue, 100Gbps -> 8us
     m_pathAwareRerouting = true;                  // enable path-aware rerouting
     m_agingTime = MilliSeconds(2);                // 2ms
-    m_conweavePathTable.resize(65536);            // initialize table size
 }
 
 ConWeaveRouting::~ConWeaveRouting() {}
@@ -193,12 +196,63 @@ TypeId ConWeaveRouting::GetTypeId(void) {
 }
 
 uint32_t ConWeaveRouting::GetOutPortFromPath(const uint32_t &path, const uint32_t &hopCount) {
-    return ((uint8_t *)&path)[hopCount];
+    assert(path < m_pathInfo.size() && hopCount < m_pathInfo[path]._nHops);
+    return m_pathPorts[m_pathInfo[path]._offset + hopCount];
 }
 
-void ConWeaveRouting::SetOutPortToPath(uint32_t &path, const uint32_t &hopCount,
-                                       const uint32_t &outPort) {
-    ((uint8_t *)&path)[hopCount] = outPort;
+/**
+ * @brief Order of the former pathIds, which packed outPort[i] into byte i of a uint32_t:
+ * the last hop is the most significant. Keeping it keeps the random path choices of a run.
+ */
+static bool PathBefore(const uint32_t *a, uint32_t nA, const uint32_t *b, uint32_t nB) {
+    for (uint32_t i = std::max(nA, nB); i-- > 0;) {
+        uint32_t portA = i < nA ? a[i] : 0;
+        uint32_t portB = i < nB ? b[i] : 0;
+        if (portA != portB) return portA < portB;
+    }
+    return false;
+}
+
+uint32_t ConWeaveRouting::AddPath(uint32_t dstToRId, const std::vector<uint32_t> &outPorts) {
+    assert(!outPorts.empty());
+    if (dstToRId >= m_pathSets.size()) m_pathSets.resize(dstToRId + 1);
+    conweavePathSet &pathSet = m_pathSets[dstToRId];
+
+    // position in the path set, or the pathId if the path is known already
+    uint32_t index = 0;
+    for (; index < pathSet._pathIds.size(); index++) {
+        const conweavePathInfo &info = m_pathInfo[pathSet._pathIds[index]];
+        const uint32_t *ports = &m_pathPorts[info._offset];
+        if (PathBefore(&outPorts[0], outPorts.size(), ports, info._nHops)) break;
+        if (!PathBefore(ports, info._nHops, &outPorts[0], outPorts.size())) {
+            return pathSet._pathIds[index];
+        }
+    }
+
+    conweavePathInfo info;
+    info._offset = m_pathPorts.size();
+    info._nHops = outPorts.size();
+    info._dstToRId = dstToRId;
+    uint32_t pathId = m_pathInfo.size();
+    m_pathInfo.push_back(info);
+    m_pathPorts.insert(m_pathPorts.end(), outPorts.begin(), outPorts.end());
+
+    pathSet._pathIds.insert(pathSet._pathIds.begin() + index, pathId);
+    for (uint32_t i = index; i < pathSet._pathIds.size(); i++) {
+        m_pathInfo[pathSet._pathIds[i]]._index = i;
+    }
+    pathSet._invalidTime.assign(pathSet._pathIds.size(), CW_MIN_TIME);
+    pathSet._invalidMask.assign((pathSet._pathIds.size() + 63) / 64, 0);
+    return pathId;
+}
+
+bool ConWeaveRouting::IsGoodPath(conweavePathSet &pathSet, uint32_t index, Time now) {
+    uint64_t &word = pathSet._invalidMask[index / 64];
+    uint64_t bit = (uint64_t)1 << (index % 64);
+    if (!(word & bit)) return true;
+    if (pathSet._invalidTime[index] > now) return false;  // ECN marked
+    word &= ~bit;                                          // NOTIFY expired
+    return true;
 }
 
 uint64_t ConWeaveRouting::GetFlowKey(uint32_t ip1, uint32_t ip2, uint16_t port1, uint16_t port2) {
@@ -263,7 +317,8 @@ void ConWeaveRouting::SendReply(Ptr<Packet> p, CustomHeader &ch, uint32_t flagRe
     seqh.SetIntHeader(ch.udp.ih);
 
     Ptr<Packet> replyP = Create<Packet>(
-        std::max(64 - 14 - 20 - (int)seqh.GetSerializedSize(), 0));  // at least 64 Bytes
+        std::max(64 - 14 - 20 - (int)seqh.GetSerializedSize(), 0),  // at least 64 Bytes
+        seqh.GetSerializedSize() + 20 + PppHeader::GetStaticSize());  // qbbHeader, IPv4, PPP
     replyP->AddHeader(seqh);                                         // qbbHeader
 
     // ACK-like packet, no L4 header
@@ -321,7 +376,8 @@ void ConWeaveRouting::SendNotify(Ptr<Packet> p, CustomHeader &ch, uint32_t pathI
     seqh.SetIntHeader(ch.udp.ih);
 
     Ptr<Packet> fbP = Create<Packet>(
-        std::max(64 - 14 - 20 - (int)seqh.GetSerializedSize(), 0));  // at least 64 Bytes
+        std::max(64 - 14 - 20 - (int)seqh.GetSerializedSize(), 0),  // at least 64 Bytes
+        seqh.GetSerializedSize() + 20 + PppHeader::GetStaticSize());  // qbbHeader, IPv4, PPP
     fbP->AddHeader(seqh);                                            // qbbHeader
 
     // ACK-like packet, no L4 header
@@ -361,6 +417,7 @@ void ConWeaveRouting::SendNotify(Ptr<Packet> p, CustomHeader &ch, uint32_t pathI
 
 /** MAIN: Every SLB packet is hijacked to this function at switches */
 void ConWeaveRouting::RouteInput(Ptr<Packet> p, CustomHeader &ch) {
+    NS_PROFILE_SCOPE("lb/conweave");
     // Packet arrival time
     Time now = Simulator::Now();
 
@@ -371,12 +428,10 @@ void ConWeaveRouting::RouteInput(Ptr<Packet> p, CustomHeader &ch) {
     }
 
     // get srcToRId, dstToRId
-    assert(Settings::hostIp2SwitchId.find(ch.sip) !=
-           Settings::hostIp2SwitchId.end());  // Misconfig of Settings::hostIp2SwitchId - sip
-    assert(Settings::hostIp2SwitchId.find(ch.dip) !=
-           Settings::hostIp2SwitchId.end());  // Misconfig of Settings::hostIp2SwitchId - dip
-    uint32_t srcToRId = Settings::hostIp2SwitchId[ch.sip];
-    uint32_t dstToRId = Settings::hostIp2SwitchId[ch.dip];
+    uint32_t srcToRId = Settings::ToROfIp(ch.sip);
+    uint32_t dstToRId = Settings::ToROfIp(ch.dip);
+    assert(srcToRId != Settings::INVALID_ID);  // Misconfig of Settings host index - sip
+    assert(dstToRId != Settings::INVALID_ID);  // Misconfig of Settings host index - dip
 
     /** FILTER: Quickly filter intra-pod traffic */
     if (srcToRId == dstToRId) {  // do normal routing (only one path)
@@ -523,51 +578,36 @@ void ConWeaveRouting::RouteInput(Ptr<Packet> p, CustomHeader &ch) {
             /**
              * PATH: sample 2 ports and choose a good port
              */
-            std::set<uint32_t> pathSet = m_ConWeaveRoutingTable[dstToRId];  // pathSet to RxToR
+            assert(dstToRId < m_pathSets.size());
+            conweavePathSet &pathSet = m_pathSets[dstToRId];  // pathSet to RxToR
+            uint32_t nPaths = pathSet._pathIds.size();
             uint32_t initPath =
-                *(std::next(pathSet.begin(),
-                            rand() % pathSet.size()));  // to initialize (empty: CW_DEFAULT_32BIT)
+                pathSet._pathIds[rand() % nPaths];  // to initialize (empty: CW_DEFAULT_32BIT)
+            (void)initPath;
 
             if (m_pathAwareRerouting) {
                 /* path-aware decision */
-                uint32_t randPath1 = *(std::next(pathSet.begin(), rand() % pathSet.size()));
-                uint32_t randPath2 = *(std::next(pathSet.begin(), rand() % pathSet.size()));
-                const auto pathEntry1 =
-                    m_conweavePathTable[DoHash((uint8_t *)&randPath1, 4, m_switch_id) %
-                                        m_conweavePathTable.size()];
-                const auto pathEntry2 =
-                    m_conweavePathTable[DoHash((uint8_t *)&randPath2, 4, m_switch_id) %
-                                        m_conweavePathTable.size()];
-                bool goodPath1 = true;
-                bool goodPath2 = true;
-
-                if (pathEntry1._pathId == randPath1 &&
-                    pathEntry1._invalidTime > now) {  // ECN marked
-                    goodPath1 = false;
-                }
-                if (pathEntry2._pathId == randPath2 &&
-                    pathEntry2._invalidTime > now) {  // ECN marked
-                    goodPath2 = false;
-                }
+                uint32_t randIndex1 = rand() % nPaths;
+                uint32_t randIndex2 = rand() % nPaths;
 
-                if (goodPath1 == true) {
+                if (IsGoodPath(pathSet, randIndex1, now)) {
                     tx_md.foundGoodPath = true;
-                    tx_md.goodPath = randPath1;
+                    tx_md.goodPath = pathSet._pathIds[randIndex1];
                     // SLB_LOG(PARSE_FIVE_TUPLE(ch) << "--> First trial has good path");
-                } else if (goodPath2 == true) {
+                } else if (IsGoodPath(pathSet, randIndex2, now)) {
                     tx_md.foundGoodPath = true;
-                    tx_md.goodPath = randPath2;
+                    tx_md.goodPath = pathSet._pathIds[randIndex2];
                     // SLB_LOG(PARSE_FIVE_TUPLE(ch) << "--> Second trial has good path");
                 } else {
                     assert(tx_md.foundGoodPath == false);
-                    tx_md.goodPath = randPath1;  // random path (unused)
+                    tx_md.goodPath = pathSet._pathIds[randIndex1];  // random path (unused)
                     // SLB_LOG(PARSE_FIVE_TUPLE(ch) << "--> Cannot find good path, so use current
                     // path");
                 }
             } else {
                 /* random path selection */
                 tx_md.foundGoodPath = true;
-                tx_md.goodPath = *(std::next(pathSet.begin(), rand() % pathSet.size()));
+                tx_md.goodPath = pathSet._pathIds[rand() % nPaths];
             }
 
             /** PATH: update and get current path */
@@ -852,11 +892,11 @@ void ConWeaveRouting::RouteInput(Ptr<Packet> p, CustomHeader &ch) {
                             (rx_md.timeExpectedToFlush > now.GetNanoSeconds())
                                 ? (rx_md.timeExpectedToFlush - now.GetNanoSeconds())
                                 : 0;
-                        voq->second.RescheduleFlush(
+                        voq->second->RescheduleFlush(
                             NanoSeconds(rx_md.timeExpectedToFlush)); /* new deadline */
                         SLB_LOG(PARSE_FIVE_TUPLE(ch)
                                 << "--> Phase 0 while OoO"
-                                << ",VOQ size:" << voq->second.getQueueSize() + 1
+                                << ",VOQ size:" << voq->second->getQueueSize() + 1
                                 << ",NextFlushTime:" << NanoSeconds(rx_md.timeExpectedToFlush)
                                 << "(TxTimegap:" << rx_md.timegapAtTx
                                 << ",Phase0 Tx:" << rx_md.phase0TxTime
@@ -871,12 +911,12 @@ void ConWeaveRouting::RouteInput(Ptr<Packet> p, CustomHeader &ch) {
                             assert(voq != m_voqMap.end());  // sanity check
                             SLB_LOG(PARSE_FIVE_TUPLE(ch)
                                     << "--> SUBSEQ OoO"
-                                    << ",VOQ size:" << voq->second.getQueueSize() + 1
+                                    << ",VOQ size:" << voq->second->getQueueSize() + 1
                                     << ",No New Deadline Update");
 
                         } else { /* new out-of-order */
                             rxEntry._reordering = true;
-                            ConWeaveVOQ &voq = m_voqMap[rx_md.pkt_flowkey];
+                            ConWeaveVOQ &voq = *NewVOQ(rx_md.pkt_flowkey);
 
                             rx_md.timeExpectedToFlush =
                                 (rx_md.timeExpectedToFlush > now.GetNanoSeconds())
@@ -885,11 +925,6 @@ void ConWeaveRouting::RouteInput(Ptr<Packet> p, CustomHeader &ch) {
                             voq.Set(rx_md.pkt_flowkey, ch.dip,
                                     NanoSeconds(rx_md.timeExpectedToFlush),
                                     m_extraVOQFlushTime); /* new deadline */
-                            voq.m_deleteCallback = MakeCallback(&ConWeaveRouting::DeleteVOQ, this);
-                            voq.m_CallbackByVOQFlush =
-                                MakeCallback(&ConWeaveRouting::CallbackByVOQFlush, this);
-                            voq.m_switchSendToDevCallback =
-                                MakeCallback(&ConWeaveRouting::DoSwitchSendToDev, this);
                             SLB_LOG(PARSE_FIVE_TUPLE(ch)
                                     << "--> FIRST OoO"
                                     << ",VOQ size:" << voq.getQueueSize() + 1
@@ -929,7 +964,8 @@ void ConWeaveRouting::RouteInput(Ptr<Packet> p, CustomHeader &ch) {
                  * ENQUEUE: enqueue the packet
                  */
                 if (rx_md.flagEnqueue) {
-                    m_voqMap[rx_md.pkt_flowkey].Enqueue(p);
+                    m_voqMap[rx_md.pkt_flowkey]->Enqueue(p, ch);
+                    m_voqVolume++;
                     m_nOutOfOrderPkts++;
                     return;
                 }
@@ -992,18 +1028,19 @@ void ConWeaveRouting::RouteInput(Ptr<Packet> p, CustomHeader &ch) {
                 if (foundConWeaveNotifyTag) {  // Received NOTIFY (from ECN)
                     conweaveTxMeta tx_md;
                     auto congestedPathId = conweaveNotifyTag.GetPathId();
-                    auto &pathEntry =
-                        m_conweavePathTable[DoHash((uint8_t *)&congestedPathId, 4, m_switch_id) %
-                                            m_conweavePathTable.size()];
+                    assert(congestedPathId < m_pathInfo.size());
+                    const conweavePathInfo &info = m_pathInfo[congestedPathId];
+                    conweavePathSet &pathSet = m_pathSets[info._dstToRId];
+                    assert(pathSet._pathIds[info._index] == congestedPathId);  // our path
                     SLB_LOG(PARSE_REVERSE_FIVE_TUPLE(ch)
                             << "[TxToR/GotNOTIFY] Sw(" << m_switch_id
                             << ") =-*=-*=-*=-*=-*=-*=-=-*>>> pathId:" << congestedPathId);
 
                     /**
-                     * UPDATE: if entry is expired, overwrite not to use the congested path
+                     * UPDATE: do not use the congested path for a while
                      */
-                    pathEntry._pathId = congestedPathId;
-                    pathEntry._invalidTime = now + m_pathPauseTime;
+                    pathSet._invalidTime[info._index] = now + m_pathPauseTime;
+                    pathSet._invalidMask[info._index / 64] |= (uint64_t)1 << (info._index % 64);
                     return;  // drop this NOTIFY
                 }
             }
@@ -1089,7 +1126,28 @@ void ConWeaveRouting::DoSwitchSendToDev(Ptr<Packet> p, CustomHeader &ch) {
 }
 
 // used for callback in VOQ
-void ConWeaveRouting::DeleteVOQ(uint64_t flowkey) { m_voqMap.erase(flowkey); }
+ConWeaveVOQ *ConWeaveRouting::NewVOQ(uint64_t flowkey) {
+    ConWeaveVOQ *voq;
+    if (m_voqFree.empty()) {
+        m_voqSlab.emplace_back();
+        voq = &m_voqSlab.back();
+        voq->m_deleteCallback = MakeCallback(&ConWeaveRouting::DeleteVOQ, this);
+        voq->m_CallbackByVOQFlush = MakeCallback(&ConWeaveRouting::CallbackByVOQFlush, this);
+        voq->m_switchSendToDevCallback = MakeCallback(&ConWeaveRouting::DoSwitchSendToDev, this);
+    } else {
+        voq = m_voqFree.back();
+        m_voqFree.pop_back();
+    }
+    m_voqMap[flowkey] = voq;
+    return voq;
+}
+
+void ConWeaveRouting::DeleteVOQ(uint64_t flowkey) {
+    auto voq = m_voqMap.find(flowkey);
+    assert(voq != m_voqMap.end());
+    m_voqFree.push_back(voq->second);
+    m_voqMap.erase(voq);
+}
 
 void ConWeaveRouting::CallbackByVOQFlush(uint64_t flowkey, uint32_t voqSize) {
     SLB_LOG(
@@ -1097,6 +1155,7 @@ void ConWeaveRouting::CallbackByVOQFlush(uint64_t flowkey, uint32_t voqSize) {
         << flowkey << ",VOQ size:" << voqSize << "#################");  // debugging
 
     m_historyVOQSize.push_back(voqSize);  // statistics - track VOQ size
+    m_voqVolume -= voqSize;
     // update RxEntry
     auto &rxEntry = m_conweaveRxTable[flowkey];  // flowcut entry
     assert(rxEntry._flowkey == flowkey);         // sanity check
@@ -1114,14 +1173,6 @@ void ConWeaveRouting::SetSwitchSendToDevCallback(SwitchSendToDevCallback switchS
     m_switchSendToDevCallback = switchSendToDevCallback;
 }
 
-uint32_t ConWeaveRouting::GetVolumeVOQ() {
-    uint32_t nTotalPkts = 0;
-    for (auto voq : m_voqMap) {
-        nTotalPkts += voq.second.getQueueSize();
-    }
-    return nTotalPkts;
-}
-
 void ConWeaveRouting::AgingEvent() {
     auto now = Simulator::Now();
 
@@ -21,6 +21,7 @@
 #ifndef __CONWEAVE_ROUTING_H__
 #define __CONWEAVE_ROUTING_H__
 
+#include <deque>
 #include <iostream>
 #include <map>
 #include <queue>
@@ -101,17 +102,20 @@ struct conweaveRxState {
     bool _reordering = false;     /* For VOQ */
 };
 
+/* a path of the store shared by all switches (pathId = its index), see AddPath() */
 struct conweavePathInfo {
-    uint32_t _pathId = 0;
-    Time _invalidTime = CW_MIN_TIME;
+    uint32_t _offset = 0;   /* its first outPort in ConWeaveRouting::m_pathPorts */
+    uint32_t _nHops = 0;    /* number of outPorts */
+    uint32_t _dstToRId = 0; /* RxToR the path leads to */
+    uint32_t _index = 0;    /* position in the TxToR's conweavePathSet */
 };
 
-struct find_conweavePathInfo {
-    uint32_t _pathId;
-    find_conweavePathInfo(uint32_t pathId) : _pathId(pathId) {}
-    bool operator()(const conweavePathInfo& p) const { return p._pathId == _pathId; }
+/* paths from a TxToR to one RxToR */
+struct conweavePathSet {
+    std::vector<uint32_t> _pathIds;     /* ordered as the former std::set<pathId> */
+    std::vector<Time> _invalidTime;     /* NOTIFY (ECN) -> do not use the path before that */
+    std::vector<uint64_t> _invalidMask; /* bit i: path i got a NOTIFY, check _invalidTime[i] */
 };
-// it = std::find_if( pathVec.begin(), pathVec.end(), conweavePathInfo(pathId));
 
 // follow PISA metadata concept
 struct conweaveTxMeta {
@@ -274,9 +278,9 @@ class ConWeaveNotifyTag : public Tag {
 /**
  * @brief ConWeave object is created for each ToR Switch
  * -- path <-> outPort transformation --
- * uint8_t pathp[4] = {uint8_t[port0], uint8_t[port1], uint8_t[port2], uint8_t[port3]}
- * uint32_t path = *((uint32_t*) pathp);
- * (uint8_t*)&path[0] -> port0
+ * A pathId indexes m_pathInfo, a store of the outPorts of every path shared by all switches,
+ * so a path can have any number of hops and any port number.
+ * m_pathPorts[m_pathInfo[path]._offset + hop] -> outPort at hop
  */
 
 class ConWeaveRouting : public Object {
@@ -293,16 +297,20 @@ class ConWeaveRouting : public Object {
     static uint32_t GetOutPortFromPath(
         const uint32_t& path,
         const uint32_t& hopCount);  // decode outPort from path, given a hop's order
-    static void SetOutPortToPath(uint32_t& path, const uint32_t& hopCount,
-                                 const uint32_t& outPort);  // encode outPort to path
+    static uint32_t GetPathHopCount(const uint32_t& path) { return m_pathInfo[path]._nHops; }
+
+    /* path */
+    uint32_t AddPath(uint32_t dstToRId,
+                     const std::vector<uint32_t>& outPorts);  // register a path, get its pathId
+    const conweavePathSet& GetPathSet(uint32_t dstToRId) const { return m_pathSets[dstToRId]; }
 
     /* key */
     static uint64_t GetFlowKey(uint32_t ip1, uint32_t ip2, uint16_t port1,
                                uint16_t port2);                             // hashkey (4-tuple)
     static uint32_t DoHash(const uint8_t* key, size_t len, uint32_t seed);  // hash function
     uint32_t GetNumVOQ() { return (uint32_t)m_voqMap.size(); }
-    uint32_t GetVolumeVOQ();
-    const std::unordered_map<uint64_t, ConWeaveVOQ>& GetVOQMap() { return m_voqMap; }
+    uint32_t GetVolumeVOQ() { return m_voqVolume; }
+    const std::unordered_map<uint64_t, ConWeaveVOQ*>& GetVOQMap() { return m_voqMap; }
 
     /* main function */
     void SendReply(Ptr<Packet> p, CustomHeader& ch, uint32_t flagReply, uint32_t pkt_epoch);
@@ -332,10 +340,7 @@ class ConWeaveRouting : public Object {
         SwitchSendToDevCallback switchSendToDevCallback);  // set callback
 
     /* topological info (should be initialized in the beginning) */
-    std::map<uint32_t, std::set<uint32_t> >
-        m_ConWeaveRoutingTable;                      // <RxToRId -> set<pathId> > just for reference
     std::map<uint32_t, uint64_t> m_rxToRId2BaseRTT;  // RxToRId -> BaseRTT between TORs(fixed)
-    std::vector<conweavePathInfo> m_conweavePathTable;  // pathInfo table
 
     /* statistics (logging) */
     static uint64_t m_nReplyInitSent;      // number of reply sent
@@ -368,12 +373,22 @@ class ConWeaveRouting : public Object {
     bool m_pathAwareRerouting;
     Time m_agingTime;  // aging time (e.g., 2ms)
 
+    // paths, added by AddPath()
+    bool IsGoodPath(conweavePathSet& pathSet, uint32_t index, Time now);
+    std::vector<conweavePathSet> m_pathSets;           // RxToRId -> paths to the RxToR
+    static std::vector<conweavePathInfo> m_pathInfo;  // pathId -> path
+    static std::vector<uint32_t> m_pathPorts;         // outPorts of all paths, back to back
+
     // local
     std::map<uint64_t, conweaveTxState> m_conweaveTxTable;  // flowkey -> TxToR's stateful table
     std::map<uint64_t, conweaveRxState> m_conweaveRxTable;  // flowkey -> RxToR's stateful table
 
     // VOQ (voq.m_deleteCallback = MakeCallback(&ConWeaveRouting::deleteVoq, this); )
-    std::unordered_map<uint64_t, ConWeaveVOQ> m_voqMap;  // flowkey -> FIFO Queue
+    ConWeaveVOQ* NewVOQ(uint64_t flowkey);
+    std::unordered_map<uint64_t, ConWeaveVOQ*> m_voqMap;  // flowkey -> FIFO Queue
+    std::deque<ConWeaveVOQ> m_voqSlab;     // every VOQ ever used, their addresses never change
+    std::vector<ConWeaveVOQ*> m_voqFree;   // flushed VOQs of the slab, ready for reuse
+    uint32_t m_voqVolume;                  // packets in all VOQs
 
     static uint64_t debug_time;
 };
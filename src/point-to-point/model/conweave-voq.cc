@@ -31,10 +31,33 @@ NS_LOG_COMPONENT_DEFINE("ConWeaveVOQ");
 
 namespace ns3 {
 
-ConWeaveVOQ::ConWeaveVOQ() {}
-ConWeaveVOQ::~ConWeaveVOQ() {}
+ConWeaveVOQ::ConWeaveVOQ() : m_flowkey(0), m_dip(0), m_head(0), m_tail(0), m_size(0) {}
+ConWeaveVOQ::~ConWeaveVOQ() {
+    while (m_head) {
+        Node *next = m_head->next;
+        FreeNode(m_head);
+        m_head = next;
+    }
+}
 
 std::vector<int> ConWeaveVOQ::m_flushEstErrorhistory; // instantiate static variable
+std::deque<ConWeaveVOQ::Node> ConWeaveVOQ::m_nodeSlab;
+std::vector<ConWeaveVOQ::Node *> ConWeaveVOQ::m_nodeFree;
+
+ConWeaveVOQ::Node *ConWeaveVOQ::AllocNode() {
+    if (m_nodeFree.empty()) {
+        m_nodeSlab.push_back(Node());
+        return &m_nodeSlab.back();
+    }
+    Node *node = m_nodeFree.back();
+    m_nodeFree.pop_back();
+    return node;
+}
+
+void ConWeaveVOQ::FreeNode(Node *node) {
+    node->pkt = 0;  // release the packet now, not when the node is reused
+    m_nodeFree.push_back(node);
+}
 
 void ConWeaveVOQ::Set(uint64_t flowkey, uint32_t dip, Time timeToFlush, Time extraVOQFlushTime) {
     m_flowkey = flowkey;
@@ -43,26 +66,40 @@ void ConWeaveVOQ::Set(uint64_t flowkey, uint32_t dip, Time timeToFlush, Time ext
     RescheduleFlush(timeToFlush);
 }
 
-void ConWeaveVOQ::Enqueue(Ptr<Packet> pkt) { m_FIFO.push(pkt); }
+void ConWeaveVOQ::Enqueue(Ptr<Packet> pkt, const CustomHeader &ch) {
+    Node *node = AllocNode();
+    node->pkt = pkt;
+    node->ch = ch;
+    node->next = 0;
+    if (m_tail) {
+        m_tail->next = node;
+    } else {
+        m_head = node;
+    }
+    m_tail = node;
+    m_size++;
+}
 
 void ConWeaveVOQ::FlushAllImmediately() {
     m_CallbackByVOQFlush(
-        m_flowkey,
-        (uint32_t)m_FIFO.size()); /** IMPORTANT: set RxEntry._reordering = false at flushing */
-    while (!m_FIFO.empty()) {     // for all VOQ pkts
-        Ptr<Packet> pkt = m_FIFO.front();  // get packet
-        CustomHeader ch(CustomHeader::L2_Header | CustomHeader::L3_Header |
-                        CustomHeader::L4_Header);
-        pkt->PeekHeader(ch);
-        m_switchSendToDevCallback(pkt, ch);  // SlbRouting::DoSwitchSendToDev
-        m_FIFO.pop();                        // remove this element
+        m_flowkey, m_size); /** IMPORTANT: set RxEntry._reordering = false at flushing */
+
+    // detach the whole chain, the VOQ is empty by the time it goes back to the routing
+    Node *node = m_head;
+    m_head = m_tail = 0;
+    m_size = 0;
+    while (node) {  // for all VOQ pkts
+        Node *next = node->next;
+        m_switchSendToDevCallback(node->pkt, node->ch);  // SlbRouting::DoSwitchSendToDev
+        FreeNode(node);
+        node = next;
     }
     m_deleteCallback(m_flowkey);  // delete this from SlbRouting::m_voqMap
 }
 
 void ConWeaveVOQ::EnforceFlushAll() {
     SLB_LOG(
-        "--> *** Finish this epoch by Timeout Enforcement - ConWeaveVOQ Size:" << m_FIFO.size());
+        "--> *** Finish this epoch by Timeout Enforcement - ConWeaveVOQ Size:" << m_size);
     ConWeaveRouting::m_nFlushVOQTotal += 1;  // statistics
     m_checkFlushEvent.Cancel();               // cancel the next schedule
     FlushAllImmediately();                    // flush VOQ immediately
@@ -89,8 +126,8 @@ void ConWeaveVOQ::RescheduleFlush(Time timeToFlush) {
     m_checkFlushEvent = Simulator::Schedule(timeToFlush, &ConWeaveVOQ::EnforceFlushAll, this);
 }
 
-bool ConWeaveVOQ::CheckEmpty() { return m_FIFO.empty(); }
+bool ConWeaveVOQ::CheckEmpty() const { return m_size == 0; }
 
-uint32_t ConWeaveVOQ::getQueueSize() { return (uint32_t)m_FIFO.size(); }
+uint32_t ConWeaveVOQ::getQueueSize() const { return m_size; }
 
 }  // namespace ns3
\ No newline at end of file
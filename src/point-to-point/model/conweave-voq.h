@@ -21,8 +21,8 @@
 #ifndef __CONWEAVE_VOQ_H__
 #define __CONWEAVE_VOQ_H__
 
+#include <deque>
 #include <map>
-#include <queue>
 #include <unordered_map>
 #include <vector>
 
@@ -43,6 +43,10 @@ namespace ns3 {
 /**
  * @brief Virtual Output Queue, implemented in FIFO
  * One additional feature - Timer for flushing and destroying by itself.
+ *
+ * The FIFO is an intrusive list of nodes from a pool shared by all VOQs, each node keeping
+ * the packet with its CustomHeader parsed at enqueue, so a flush sends the chain without
+ * copying or re-parsing anything.
  */
 class ConWeaveVOQ {
     friend class ConWeaveRouting;
@@ -53,21 +57,36 @@ class ConWeaveVOQ {
 
     // functions
     void Set(uint64_t flowkey, uint32_t dip, Time timeToFlush, Time extraVOQFlushTime);  // setup
-    void Enqueue(Ptr<Packet> pkt);           // enqueue pkt FIFO
+    void Enqueue(Ptr<Packet> pkt, const CustomHeader &ch);  // enqueue pkt FIFO
     void FlushAllImmediately();              // flush all immediately (for scheduling)
     void EnforceFlushAll();                  // enforce to flush the queue by timeout (makes OoO)
     void RescheduleFlush(Time timeToFlush);  // reschedule timeout to flush
-    bool CheckEmpty();                       // check empty
-    uint32_t getQueueSize();                 // get queue size
-    uint32_t getDIP() { return m_dip; };
+    bool CheckEmpty() const;                 // check empty
+    uint32_t getQueueSize() const;           // get queue size
+    uint32_t getDIP() const { return m_dip; };
 
     // logging
     static std::vector<int> m_flushEstErrorhistory;
 
    private:
-    uint64_t m_flowkey;               // flowkey (voqMap's key)
-    uint32_t m_dip;                   // destination ip (for monitoring)
-    std::queue<Ptr<Packet> > m_FIFO;  // per-flow FIFO queue
+    ConWeaveVOQ(const ConWeaveVOQ &);  // owns its nodes, not copyable
+    ConWeaveVOQ &operator=(const ConWeaveVOQ &);
+
+    struct Node {
+        Ptr<Packet> pkt;
+        CustomHeader ch;  // parsed once, at enqueue
+        Node *next;
+    };
+    static Node *AllocNode();
+    static void FreeNode(Node *node);
+    static std::deque<Node> m_nodeSlab;     // never shrinks, so nodes do not move
+    static std::vector<Node *> m_nodeFree;  // free nodes of the slab
+
+    uint64_t m_flowkey;  // flowkey (voqMap's key)
+    uint32_t m_dip;      // destination ip (for monitoring)
+    Node *m_head;        // per-flow FIFO queue
+    Node *m_tail;
+    uint32_t m_size;
     EventId m_checkFlushEvent;  // check flush schedule is on-going (will be false once the queue
                                 // starts flushing)
     Time m_extraVOQFlushTime; // extra flush time (for network uncertainty) -- for debugging
@@ -0,0 +1,208 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/fluid-flow-model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "ns3/assert.h"
+#include "ns3/double.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+NS_LOG_COMPONENT_DEFINE("FluidFlowModel");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED(FluidFlowModel);
+
+uint64_t FluidFlowModel::nFluidFlows = 0;
+uint64_t FluidFlowModel::nReallocations = 0;
+
+TypeId FluidFlowModel::GetTypeId(void) {
+    static TypeId tid =
+        TypeId("ns3::FluidFlowModel")
+            .SetParent<Object>()
+            .AddConstructor<FluidFlowModel>()
+            .AddAttribute("MaxLinkShare",
+                          "Fraction of each link capacity that fluid flows may occupy. The rest "
+                          "is always left to packet-level traffic, so it must stay below 1.",
+                          DoubleValue(0.9), MakeDoubleAccessor(&FluidFlowModel::m_maxLinkShare),
+                          MakeDoubleChecker<double>(0.0, 0.99));
+    return tid;
+}
+
+FluidFlowModel::FluidFlowModel() : m_maxLinkShare(0.9) {}
+FluidFlowModel::~FluidFlowModel() {}
+
+void FluidFlowModel::DoDispose() {
+    m_completionEvent.Cancel();
+    for (auto &link : m_links) {
+        link.dev = 0;
+    }
+    m_flows.clear();
+    Object::DoDispose();
+}
+
+uint32_t FluidFlowModel::GetLinkIdx(Ptr<QbbNetDevice> dev) {
+    auto it = m_linkIdx.find(PeekPointer(dev));
+    if (it != m_linkIdx.end()) {
+        return it->second;
+    }
+    Link link;
+    link.dev = dev;
+    link.capacity = (uint64_t)(dev->GetDataRate().GetBitRate() * m_maxLinkShare);
+    link.load = 0;
+    m_links.push_back(link);
+    m_linkIdx[PeekPointer(dev)] = m_links.size() - 1;
+    return m_links.size() - 1;
+}
+
+void FluidFlowModel::AddFlow(uint32_t id, uint64_t bytes,
+                             const std::vector<Ptr<QbbNetDevice> > &path, Time propDelay,
+                             FluidFlowDoneCallback cb) {
+    NS_ASSERT_MSG(!path.empty(), "Fluid flow needs at least one link");
+    Advance();
+
+    Flow flow;
+    flow.id = id;
+    flow.remaining = (double)bytes;
+    flow.rate = 0;
+    flow.propDelay = propDelay;
+    flow.cb = cb;
+    for (auto &dev : path) {
+        flow.links.push_back(GetLinkIdx(dev));
+    }
+    m_flows.push_back(flow);
+    nFluidFlows++;
+
+    Reallocate();
+    ScheduleNextCompletion();
+}
+
+uint64_t FluidFlowModel::GetFlowRate(uint32_t id) const {
+    for (const auto &flow : m_flows) {
+        if (flow.id == id) return flow.rate;
+    }
+    return 0;
+}
+
+uint64_t FluidFlowModel::GetLinkLoad(Ptr<QbbNetDevice> dev) const {
+    auto it = m_linkIdx.find(PeekPointer(dev));
+    return it == m_linkIdx.end() ? 0 : m_links[it->second].load;
+}
+
+void FluidFlowModel::Advance() {
+    Time now = Simulator::Now();
+    double dt = (now - m_lastUpdate).GetSeconds();
+    m_lastUpdate = now;
+    if (dt <= 0) return;
+    for (auto &flow : m_flows) {
+        flow.remaining -= flow.rate * dt / 8;
+    }
+}
+
+void FluidFlowModel::Reallocate() {
+    nReallocations++;
+
+    // progressive filling: repeatedly saturate the link with the smallest fair share
+    std::vector<double> residual(m_links.size());
+    std::vector<uint32_t> nUnfrozen(m_links.size(), 0);
+    for (uint32_t i = 0; i < m_links.size(); i++) {
+        residual[i] = (double)m_links[i].capacity;
+    }
+    for (auto &flow : m_flows) {
+        flow.rate = 0;
+        for (uint32_t l : flow.links) nUnfrozen[l]++;
+    }
+
+    std::vector<bool> frozen(m_flows.size(), false);
+    uint32_t nLeft = m_flows.size();
+    while (nLeft > 0) {
+        double share = std::numeric_limits<double>::max();
+        uint32_t bottleneck = 0;
+        for (uint32_t i = 0; i < m_links.size(); i++) {
+            if (nUnfrozen[i] == 0) continue;
+            double s = std::max(residual[i], 0.0) / nUnfrozen[i];
+            if (s < share) {
+                share = s;
+                bottleneck = i;
+            }
+        }
+        NS_ASSERT(share != std::numeric_limits<double>::max());
+
+        for (uint32_t f = 0; f < m_flows.size(); f++) {
+            if (frozen[f]) continue;
+            auto &links = m_flows[f].links;
+            if (std::find(links.begin(), links.end(), bottleneck) == links.end()) continue;
+            m_flows[f].rate = (uint64_t)share;
+            frozen[f] = true;
+            nLeft--;
+            for (uint32_t l : links) {
+                residual[l] -= share;
+                nUnfrozen[l]--;
+            }
+        }
+    }
+
+    // push the aggregate fluid load to the devices
+    for (auto &link : m_links) link.load = 0;
+    for (const auto &flow : m_flows) {
+        for (uint32_t l : flow.links) m_links[l].load += flow.rate;
+    }
+    for (auto &link : m_links) {
+        link.dev->SetFluidRate(link.load);
+    }
+}
+
+void FluidFlowModel::ScheduleNextCompletion() {
+    m_completionEvent.Cancel();
+    double minNs = std::numeric_limits<double>::max();
+    for (const auto &flow : m_flows) {
+        if (flow.rate == 0) continue;
+        double ns = std::max(flow.remaining, 0.0) * 8e9 / flow.rate;
+        minNs = std::min(minNs, ns);
+    }
+    if (minNs == std::numeric_limits<double>::max()) return;
+    m_completionEvent = Simulator::Schedule(NanoSeconds((uint64_t)std::ceil(minNs)),
+                                            &FluidFlowModel::CompletionEvent, this);
+}
+
+void FluidFlowModel::CompletionEvent() {
+    Advance();
+    auto it = m_flows.begin();
+    while (it != m_flows.end()) {
+        if (it->remaining < 1.0) {  // sub-byte residue is rounding error
+            NS_LOG_DEBUG("Fluid flow " << it->id << " done at " << Simulator::Now());
+            Simulator::Schedule(it->propDelay, &FluidFlowModel::NotifyDone, it->cb, it->id);
+            it = m_flows.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    Reallocate();
+    ScheduleNextCompletion();
+}
+
+void FluidFlowModel::NotifyDone(FluidFlowDoneCallback cb, uint32_t id) {
+    if (!cb.IsNull()) cb(id);
+}
+
+}  // namespace ns3
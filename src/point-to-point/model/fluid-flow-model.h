@@ -0,0 +1,105 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __FLUID_FLOW_MODEL_H__
+#define __FLUID_FLOW_MODEL_H__
+
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/callback.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/qbb-net-device.h"
+
+namespace ns3 {
+
+/**
+ * @brief Flow-level (fluid) model for large background flows.
+ *
+ * Flows registered here are never packetized. Each one is pinned to a path of egress
+ * devices and gets a max-min fair rate over those links (progressive filling), which is
+ * recomputed only when a fluid flow starts or finishes. The aggregate fluid rate of each
+ * link is pushed to its QbbNetDevice, which then serializes packet-level traffic at the
+ * residual capacity, so switch queues (BEgressQueue/SwitchMmu) and CC loops still see the
+ * background load.
+ */
+class FluidFlowModel : public Object {
+   public:
+    // invoked with the flow id when the last byte reaches the receiver
+    typedef Callback<void, uint32_t> FluidFlowDoneCallback;
+
+    static TypeId GetTypeId(void);
+    FluidFlowModel();
+    ~FluidFlowModel();
+
+    /**
+     * @param id identifier returned to the done callback
+     * @param bytes bytes on the wire (payload + headers)
+     * @param path egress devices from the sender NIC to the last switch port
+     * @param propDelay one-way propagation delay added to the completion time
+     */
+    void AddFlow(uint32_t id, uint64_t bytes, const std::vector<Ptr<QbbNetDevice> > &path,
+                 Time propDelay, FluidFlowDoneCallback cb);
+
+    uint32_t GetNActiveFlows() const { return m_flows.size(); }
+    uint64_t GetFlowRate(uint32_t id) const;  // current rate in bps (0 if unknown)
+    uint64_t GetLinkLoad(Ptr<QbbNetDevice> dev) const;  // aggregate fluid rate in bps
+
+    // statistics
+    static uint64_t nFluidFlows;
+    static uint64_t nReallocations;
+
+   protected:
+    virtual void DoDispose(void);
+
+   private:
+    struct Link {
+        Ptr<QbbNetDevice> dev;
+        uint64_t capacity;  // bps usable by fluid flows (after m_maxLinkShare)
+        uint64_t load;      // current aggregate fluid rate, bps
+    };
+    struct Flow {
+        uint32_t id;
+        double remaining;  // bytes
+        uint64_t rate;     // bps
+        std::vector<uint32_t> links;
+        Time propDelay;
+        FluidFlowDoneCallback cb;
+    };
+
+    uint32_t GetLinkIdx(Ptr<QbbNetDevice> dev);
+    void Advance();     // drain every flow by rate * (now - m_lastUpdate)
+    void Reallocate();  // max-min fair share over all links, then update devices
+    void ScheduleNextCompletion();
+    void CompletionEvent();
+    static void NotifyDone(FluidFlowDoneCallback cb, uint32_t id);
+
+    double m_maxLinkShare;  // fraction of a link the fluid flows may occupy
+    std::vector<Link> m_links;
+    std::unordered_map<const QbbNetDevice *, uint32_t> m_linkIdx;
+    std::vector<Flow> m_flows;
+    Time m_lastUpdate;
+    EventId m_completionEvent;
+};
+
+}  // namespace ns3
+
+#endif
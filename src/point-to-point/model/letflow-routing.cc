@@ -30,6 +30,7 @@
 #include "ns3/object.h"
 #include "ns3/packet.h"
 #include "ns3/settings.h"
+#include "ns3/sim-profiler.h"
 #include "ns3/simulator.h"
 
 NS_LOG_COMPONENT_DEFINE("LetflowRouting");
@@ -108,6 +109,7 @@ void LetflowRouting::SetSwitchInfo(bool isToR, uint32_t switch_id) {
 
 /* LetflowRouting's main function */
 uint32_t LetflowRouting::RouteInput(Ptr<Packet> p, CustomHeader ch) {
+    NS_PROFILE_SCOPE("lb/letflow");
     // Packet arrival time
     Time now = Simulator::Now();
 
@@ -118,10 +120,10 @@ uint32_t LetflowRouting::RouteInput(Ptr<Packet> p, CustomHeader ch) {
     }
 
     // get srcToRId, dstToRId
-    assert(Settings::hostIp2SwitchId.find(ch.sip) != Settings::hostIp2SwitchId.end());  // Misconfig of Settings::hostIp2SwitchId - sip"
-    assert(Settings::hostIp2SwitchId.find(ch.dip) != Settings::hostIp2SwitchId.end());  // Misconfig of Settings::hostIp2SwitchId - dip"
-    uint32_t srcToRId = Settings::hostIp2SwitchId[ch.sip];
-    uint32_t dstToRId = Settings::hostIp2SwitchId[ch.dip];
+    uint32_t srcToRId = Settings::ToROfIp(ch.sip);
+    uint32_t dstToRId = Settings::ToROfIp(ch.dip);
+    assert(srcToRId != Settings::INVALID_ID);  // Misconfig of Settings host index - sip
+    assert(dstToRId != Settings::INVALID_ID);  // Misconfig of Settings host index - dip
 
     // it should be not in the same pod
     NS_ASSERT_MSG(srcToRId != dstToRId, "Should not be in the same pod");
@@ -277,6 +279,7 @@ void LetflowRouting::AgingEvent() {
     auto itr = m_flowletTable.begin();
     while (itr != m_flowletTable.end()) {
         if (now - ((itr->second)->_activeTime) > m_agingTime) {
+            delete (itr->second);
             itr = m_flowletTable.erase(itr);
         } else {
             ++itr;
@@ -0,0 +1,178 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/pfc-monitor.h"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+#include "ns3/channel.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+
+NS_LOG_COMPONENT_DEFINE("PfcMonitor");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED(PfcMonitor);
+
+TypeId PfcMonitor::GetTypeId(void) {
+    static TypeId tid =
+        TypeId("ns3::PfcMonitor")
+            .SetParent<Object>()
+            .AddConstructor<PfcMonitor>()
+            .AddAttribute("StormThreshold",
+                          "A pause lasting this long makes its port-priority a pause storm, and "
+                          "an edge of the wait-for graph of the deadlock check.",
+                          TimeValue(MilliSeconds(1)),
+                          MakeTimeAccessor(&PfcMonitor::m_stormThreshold), MakeTimeChecker())
+            .AddAttribute("CheckInterval", "Interval of the deadlock checks, 0 to disable them.",
+                          TimeValue(Seconds(0)), MakeTimeAccessor(&PfcMonitor::m_checkInterval),
+                          MakeTimeChecker());
+    return tid;
+}
+
+PfcMonitor::PfcMonitor() : m_stormThreshold(MilliSeconds(1)), m_checkInterval(Seconds(0)) {}
+PfcMonitor::~PfcMonitor() {}
+
+void PfcMonitor::DoDispose() {
+    m_checkEvent.Cancel();
+    m_devs.clear();
+    Object::DoDispose();
+}
+
+uint32_t PfcMonitor::GetPeerNode(Ptr<QbbNetDevice> dev) const {
+    Ptr<Channel> ch = dev->GetChannel();
+    if (ch == 0) return dev->GetNode()->GetId();
+    for (uint32_t i = 0; i < ch->GetNDevices(); i++) {
+        if (ch->GetDevice(i) != dev) return ch->GetDevice(i)->GetNode()->GetId();
+    }
+    return dev->GetNode()->GetId();
+}
+
+void PfcMonitor::AddDevice(Ptr<QbbNetDevice> dev) {
+    m_devs.push_back(dev);
+    m_peers.push_back(GetPeerNode(dev));
+}
+
+void PfcMonitor::Start() {
+    if (m_checkInterval.IsStrictlyPositive()) {
+        m_checkEvent = Simulator::Schedule(m_checkInterval, &PfcMonitor::PeriodicCheck, this);
+    }
+}
+
+void PfcMonitor::PeriodicCheck() {
+    CheckDeadlock();
+    m_checkEvent = Simulator::Schedule(m_checkInterval, &PfcMonitor::PeriodicCheck, this);
+}
+
+void PfcMonitor::CheckDeadlock() {
+    Time now = Simulator::Now();
+    for (uint32_t q = 0; q < QbbNetDevice::qCnt; q++) {
+        // node -> nodes it waits for on priority q
+        std::map<uint32_t, std::vector<uint32_t> > waitFor;
+        for (uint32_t i = 0; i < m_devs.size(); i++) {
+            if (!m_devs[i]->IsPaused(q)) continue;
+            if (now - m_devs[i]->GetPauseStats(q).since < m_stormThreshold) continue;
+            waitFor[m_devs[i]->GetNode()->GetId()].push_back(m_peers[i]);
+        }
+        if (waitFor.empty()) continue;
+
+        // iterative DFS, a back edge to a node on the stack closes a cycle
+        std::map<uint32_t, int> color;  // 0: new, 1: on stack, 2: done
+        for (auto &root : waitFor) {
+            if (color[root.first] != 0) continue;
+            std::vector<std::pair<uint32_t, uint32_t> > stack;  // node, next edge
+            stack.push_back(std::make_pair(root.first, 0));
+            color[root.first] = 1;
+            while (!stack.empty()) {
+                uint32_t u = stack.back().first;
+                const std::vector<uint32_t> &next = waitFor[u];
+                if (stack.back().second == next.size()) {
+                    color[u] = 2;
+                    stack.pop_back();
+                    continue;
+                }
+                uint32_t v = next[stack.back().second++];
+                if (color[v] == 0) {
+                    color[v] = 1;
+                    stack.push_back(std::make_pair(v, 0));
+                } else if (color[v] == 1) {
+                    Deadlock d;
+                    d.time = now;
+                    d.qIndex = q;
+                    size_t k = stack.size();
+                    while (stack[k - 1].first != v) k--;
+                    for (; k - 1 < stack.size(); k++) d.nodes.push_back(stack[k - 1].first);
+                    std::rotate(d.nodes.begin(),
+                                std::min_element(d.nodes.begin(), d.nodes.end()), d.nodes.end());
+                    std::vector<uint32_t> key(1, q);
+                    key.insert(key.end(), d.nodes.begin(), d.nodes.end());
+                    if (m_seen.insert(key).second) {
+                        NS_LOG_WARN("PFC deadlock on priority " << q << " at " << now);
+                        m_deadlocks.push_back(d);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void PfcMonitor::Report(std::ostream &os) const {
+    Time now = Simulator::Now();
+    uint64_t nPause = 0;
+    uint32_t nPortPrio = 0;
+    Time total;
+    std::vector<std::string> storms;
+    for (uint32_t i = 0; i < m_devs.size(); i++) {
+        for (uint32_t q = 0; q < QbbNetDevice::qCnt; q++) {
+            const QbbNetDevice::PauseStats &ps = m_devs[i]->GetPauseStats(q);
+            if (ps.nPause == 0) continue;
+            // the interval still open at the end of the run counts as well
+            Time open = m_devs[i]->IsPaused(q) ? now - ps.since : Time(0);
+            Time longest = std::max(ps.longest, open);
+            nPause += ps.nPause;
+            nPortPrio++;
+            total += ps.total + open;
+            if (longest >= m_stormThreshold) {
+                std::ostringstream oss;
+                oss << "PFC storm: node " << m_devs[i]->GetNode()->GetId() << " dev "
+                    << m_devs[i]->GetIfIndex() << " -> node " << m_peers[i] << " prio " << q
+                    << ": " << ps.nPause << " pauses, " << (ps.total + open).GetMicroSeconds()
+                    << " us paused, longest " << longest.GetMicroSeconds() << " us"
+                    << (open.IsStrictlyPositive() ? " (still paused)" : "");
+                storms.push_back(oss.str());
+            }
+        }
+    }
+    os << "PFC: " << nPause << " pauses on " << nPortPrio << " port-priorities, "
+       << total.GetMicroSeconds() << " us paused in total, " << storms.size()
+       << " storms (>= " << m_stormThreshold.GetMicroSeconds() << " us), "
+       << m_deadlocks.size() << " deadlocks" << std::endl;
+    for (auto &s : storms) os << s << std::endl;
+    for (auto &d : m_deadlocks) {
+        os << "PFC deadlock at " << d.time.GetMicroSeconds() << " us, prio " << d.qIndex
+           << ": node";
+        for (auto n : d.nodes) os << " " << n << " ->";
+        os << " " << d.nodes[0] << std::endl;
+    }
+}
+
+}  // namespace ns3
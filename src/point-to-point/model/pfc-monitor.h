@@ -0,0 +1,81 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PFC_MONITOR_H__
+#define __PFC_MONITOR_H__
+
+#include <ostream>
+#include <set>
+#include <vector>
+
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/qbb-net-device.h"
+
+namespace ns3 {
+
+/**
+ * @brief Pause storm and PFC deadlock report over the QbbNetDevices of a topology.
+ *
+ * The devices keep their own pause/resume intervals per priority (QbbNetDevice::PauseStats),
+ * so the monitor costs nothing while the simulation runs unless a deadlock check interval
+ * is set. A port-priority is a storm if one of its pauses lasted StormThreshold or more.
+ * Each check builds, per priority, the wait-for graph of nodes whose port towards a
+ * neighbour has been paused for StormThreshold or more, and reports its cycles as
+ * (potential) PFC deadlocks.
+ */
+class PfcMonitor : public Object {
+   public:
+    static TypeId GetTypeId(void);
+    PfcMonitor();
+    ~PfcMonitor();
+
+    void AddDevice(Ptr<QbbNetDevice> dev);
+    void Start(void);  // periodic deadlock checks, if CheckInterval > 0
+    void CheckDeadlock(void);
+    void Report(std::ostream &os) const;
+
+    uint32_t GetNDeadlocks() const { return m_deadlocks.size(); }
+
+   protected:
+    virtual void DoDispose(void);
+
+   private:
+    struct Deadlock {
+        Time time;                    // first detection
+        uint32_t qIndex;
+        std::vector<uint32_t> nodes;  // cycle of node ids, starting at the lowest
+    };
+
+    void PeriodicCheck(void);
+    uint32_t GetPeerNode(Ptr<QbbNetDevice> dev) const;
+
+    std::vector<Ptr<QbbNetDevice> > m_devs;
+    std::vector<uint32_t> m_peers;  // node at the other end of m_devs[i]
+    Time m_stormThreshold;
+    Time m_checkInterval;
+    EventId m_checkEvent;
+    std::vector<Deadlock> m_deadlocks;
+    std::set<std::vector<uint32_t> > m_seen;  // qIndex followed by the cycle
+};
+
+}  // namespace ns3
+
+#endif /* __PFC_MONITOR_H__ */
@@ -104,7 +104,7 @@ QbbChannel::TransmitStart (
                                   m_link[wire].m_dst, p);
 
   // Call the tx anim callback on the net device
-  m_txrxQbb (p, src, m_link[wire].m_dst, txTime, txTime + m_delay);
+  NS_PACKET_TRACE (m_txrxQbb, (p, src, m_link[wire].m_dst, txTime, txTime + m_delay));
   return true;
 }
 
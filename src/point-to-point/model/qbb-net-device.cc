@@ -51,6 +51,7 @@
 #include "ns3/rdma-hw.h"
 #include "ns3/seq-ts-header.h"
 #include "ns3/settings.h"
+#include "ns3/sim-profiler.h"
 #include "ns3/simulator.h"
 #include "ns3/udp-header.h"
 #include "ns3/uinteger.h"
@@ -61,7 +62,6 @@ NS_LOG_COMPONENT_DEFINE("QbbNetDevice");
 
 namespace ns3 {
 
-extern std::unordered_map<unsigned, Time> acc_pause_time;
 
 // uint32_t RdmaEgressQueue::ack_q_idx = 3; // 3: Middle priority
 uint32_t RdmaEgressQueue::ack_q_idx = 0; // 0: high priority
@@ -90,14 +90,14 @@ Ptr<Packet> RdmaEgressQueue::DequeueQindex(int qIndex) {
     if (qIndex == -1) {  // high prio
         Ptr<Packet> p = m_ackQ->Dequeue();
         m_qlast = -1;
-        m_traceRdmaDequeue(p, 0);
+        NS_PACKET_TRACE(m_traceRdmaDequeue, (p, 0));
         return p;
     }
     if (qIndex >= 0) {  // qp
         Ptr<Packet> p = m_rdmaGetNxtPkt(m_qpGrp->Get(qIndex));
         m_rrlast = qIndex;
         m_qlast = qIndex;
-        m_traceRdmaDequeue(p, m_qpGrp->Get(qIndex)->m_pg);
+        NS_PACKET_TRACE(m_traceRdmaDequeue, (p, m_qpGrp->Get(qIndex)->m_pg));
         return p;
     }
     return 0;
@@ -126,26 +126,19 @@ int RdmaEgressQueue::GetNextQindex(bool paused[]) {
             if (m_qpGrp->Get((qIndex + m_rrlast) % fcount)->m_nextAvail.GetTimeStep() >
                 Simulator::Now().GetTimeStep()) {
                 // not available now
-            } else {
+            } else if (qp->stat.pfcBlockedSince < 0) {
                 // blocked by PFC
-                int32_t flowid = m_qpGrp->Get((qIndex + m_rrlast) % fcount)->m_flow_id;
-                if (!MAP_KEY_EXISTS(current_pause_time, flowid))
-                    current_pause_time[flowid] = Simulator::Now();
+                qp->stat.pfcBlockedSince = Simulator::Now().GetTimeStep();
             }
         } else if (cond1 && cond2) {
             if (m_qpGrp->Get((qIndex + m_rrlast) % fcount)->m_nextAvail.GetTimeStep() >
                 Simulator::Now().GetTimeStep())  // not available now
                 continue;
             // Check if the flow has been blocked by PFC
-            {
-                int32_t flowid = m_qpGrp->Get((qIndex + m_rrlast) % fcount)->m_flow_id;
-                if (MAP_KEY_EXISTS(current_pause_time, flowid)) {
-                    Time tdiff = Simulator::Now() - current_pause_time[flowid];
-                    if (!MAP_KEY_EXISTS(acc_pause_time, flowid))
-                        acc_pause_time[flowid] = Seconds(0);
-                    acc_pause_time[flowid] = acc_pause_time[flowid] + tdiff;
-                    current_pause_time.erase(flowid);
-                }
+            if (qp->stat.pfcBlockedSince >= 0) {
+                qp->stat.pfcBlockedTime +=
+                    Simulator::Now().GetTimeStep() - qp->stat.pfcBlockedSince;
+                qp->stat.pfcBlockedSince = -1;
             }
             return (qIndex + m_rrlast) % fcount;
         }
@@ -171,14 +164,14 @@ void RdmaEgressQueue::RecoverQueue(uint32_t i) {
 }
 
 void RdmaEgressQueue::EnqueueHighPrioQ(Ptr<Packet> p) {
-    m_traceRdmaEnqueue(p, 0);
+    NS_PACKET_TRACE(m_traceRdmaEnqueue, (p, 0));
     m_ackQ->Enqueue(p);
 }
 
-void RdmaEgressQueue::CleanHighPrio(TracedCallback<Ptr<const Packet>, uint32_t> dropCb) {
+void RdmaEgressQueue::CleanHighPrio(const TracedCallback<Ptr<const Packet>, uint32_t> &dropCb) {
     while (m_ackQ->GetNPackets() > 0) {
         Ptr<Packet> p = m_ackQ->Dequeue();
-        dropCb(p, 0);
+        NS_PACKET_TRACE(dropCb, (p, 0));
     }
 }
 
@@ -229,9 +222,12 @@ QbbNetDevice::QbbNetDevice() {
     m_ecn_source = new std::vector<ECNAccount>;
     for (uint32_t i = 0; i < qCnt; i++) {
         m_paused[i] = false;
+        m_pauseStats[i].nPause = 0;
     }
 
     m_rdmaEQ = CreateObject<RdmaEgressQueue>();
+    m_fluidBps = 0;
+    m_txTimeBps = 0;
 }
 
 QbbNetDevice::~QbbNetDevice() { NS_LOG_FUNCTION(this); }
@@ -247,12 +243,13 @@ void QbbNetDevice::TransmitComplete(void) {
     NS_ASSERT_MSG(m_txMachineState == BUSY, "Must be BUSY if transmitting");
     m_txMachineState = READY;
     NS_ASSERT_MSG(m_currentPkt != 0, "QbbNetDevice::TransmitComplete(): m_currentPkt zero");
-    m_phyTxEndTrace(m_currentPkt);
+    NS_PACKET_TRACE(m_phyTxEndTrace, (m_currentPkt));
     m_currentPkt = 0;
     DequeueAndTransmit();
 }
 
 void QbbNetDevice::DequeueAndTransmit(void) {
+    NS_PROFILE_SCOPE("queue/dequeue");
     NS_LOG_FUNCTION(this);
     if (!m_linkUp) return;                 // if link is down, return
     if (m_txMachineState == BUSY) return;  // Quit if channel busy
@@ -262,7 +259,7 @@ void QbbNetDevice::DequeueAndTransmit(void) {
         if (qIndex != -1024) {
             if (qIndex == -1) {  // high prio
                 p = m_rdmaEQ->DequeueQindex(qIndex);
-                m_traceDequeue(p, 0);
+                NS_PACKET_TRACE(m_traceDequeue, (p, 0));
                 TransmitStart(p);
                 return;
             }
@@ -271,7 +268,7 @@ void QbbNetDevice::DequeueAndTransmit(void) {
             p = m_rdmaEQ->DequeueQindex(qIndex);
 
             // transmit
-            m_traceQpDequeue(p, lastQp);
+            NS_PACKET_TRACE(m_traceQpDequeue, (p, lastQp));
             TransmitStart(p);
 
             // update for the next avail time
@@ -296,13 +293,8 @@ void QbbNetDevice::DequeueAndTransmit(void) {
     } else {                               // switch, doesn't care about qcn, just send
         p = m_queue->DequeueRR(m_paused);  // this is round-robin
         if (p != 0) {
-            m_snifferTrace(p);
-            m_promiscSnifferTrace(p);
-            Ipv4Header h;
-            Ptr<Packet> packet = p->Copy();
-            uint16_t protocol = 0;
-            ProcessHeader(packet, protocol);
-            packet->RemoveHeader(h);
+            NS_PACKET_TRACE(m_snifferTrace, (p));
+            NS_PACKET_TRACE(m_promiscSnifferTrace, (p));
             FlowIdTag t;
             uint32_t qIndex = m_queue->GetLastQueue();
             if (qIndex == 0) {  // this is a pause or cnp, send it immediately!
@@ -312,7 +304,7 @@ void QbbNetDevice::DequeueAndTransmit(void) {
                 m_node->SwitchNotifyDequeue(m_ifIndex, qIndex, p);
                 p->RemovePacketTag(t);
             }
-            m_traceDequeue(p, qIndex);
+            NS_PACKET_TRACE(m_traceDequeue, (p, qIndex));
             TransmitStart(p);
             return;
         } else {  // No queue can deliver any packet
@@ -341,6 +333,11 @@ void QbbNetDevice::Resume(unsigned qIndex) {
     NS_LOG_FUNCTION(this << qIndex);
     NS_ASSERT_MSG(m_paused[qIndex], "Must be PAUSEd");
     m_paused[qIndex] = false;
+    PauseStats &ps = m_pauseStats[qIndex];
+    Time interval = Simulator::Now() - ps.since;
+    ps.total += interval;
+    if (interval > ps.longest) ps.longest = interval;
+    if (m_queue) m_queue->NotifyResumed(qIndex);
     NS_LOG_INFO("Node " << m_node->GetId() << " dev " << m_ifIndex << " queue " << qIndex
                         << " resumed at " << Simulator::Now().GetSeconds());
     DequeueAndTransmit();
@@ -348,8 +345,9 @@ void QbbNetDevice::Resume(unsigned qIndex) {
 
 void QbbNetDevice::Receive(Ptr<Packet> packet) {
     NS_LOG_FUNCTION(this << packet);
+    NS_PROFILE_COUNT("queue/rx packets", 1);
     if (!m_linkUp) {
-        m_traceDrop(packet, 0);
+        NS_PACKET_TRACE(m_traceDrop, (packet, 0));
         return;
     }
 
@@ -358,11 +356,11 @@ void QbbNetDevice::Receive(Ptr<Packet> packet) {
         // If we have an error model and it indicates that it is time to lose a
         // corrupted packet, don't forward this packet up, let it go.
         //
-        m_phyRxDropTrace(packet);
+        NS_PACKET_TRACE(m_phyRxDropTrace, (packet));
         return;
     }
 
-    m_macRxTrace(packet);
+    NS_PACKET_TRACE(m_macRxTrace, (packet));
     CustomHeader ch(CustomHeader::L2_Header | CustomHeader::L3_Header | CustomHeader::L4_Header);
     ch.getInt = 1;  // parse INT header
     packet->PeekHeader(ch);
@@ -372,6 +370,11 @@ void QbbNetDevice::Receive(Ptr<Packet> packet) {
         // std::cerr << "PFC!!" << std::endl;
         if (ch.pfc.time > 0) {
             m_tracePfc(1);
+            if (!m_paused[qIndex]) {
+                m_pauseStats[qIndex].nPause++;
+                m_pauseStats[qIndex].since = Simulator::Now();
+                if (m_queue) m_queue->NotifyPaused(qIndex);
+            }
             m_paused[qIndex] = true;
             Simulator::Cancel(m_resumeEvt[qIndex]);
             m_resumeEvt[qIndex] =
@@ -401,8 +404,8 @@ bool QbbNetDevice::Send(Ptr<Packet> packet, const Address &dest, uint16_t protoc
 }
 
 bool QbbNetDevice::SwitchSend(uint32_t qIndex, Ptr<Packet> packet, CustomHeader &ch) {
-    m_macTxTrace(packet);
-    m_traceEnqueue(packet, qIndex);
+    NS_PACKET_TRACE(m_macTxTrace, (packet));
+    NS_PACKET_TRACE(m_traceEnqueue, (packet, qIndex));
     m_queue->Enqueue(packet, qIndex);
     DequeueAndTransmit();
     return true;
@@ -410,8 +413,11 @@ bool QbbNetDevice::SwitchSend(uint32_t qIndex, Ptr<Packet> packet, CustomHeader
 
 uint32_t QbbNetDevice::SendPfc(uint32_t qIndex, uint32_t type) {
     if (!m_qbbEnabled) return 0;
-    Ptr<Packet> p = Create<Packet>(0);
+    NS_PROFILE_COUNT("queue/pfc frames", 1);
     PauseHeader pauseh((type == 0 ? m_pausetime : 0), m_queue->GetNBytes(qIndex), qIndex);
+    // headroom for the pause header, IPv4 (20) and PPP
+    Ptr<Packet> p =
+        Create<Packet>(0, pauseh.GetSerializedSize() + 20 + PppHeader::GetStaticSize());
     p->AddHeader(pauseh);
     Ipv4Header ipv4h;  // Prepare IPv4 header
     ipv4h.SetProtocol(0xFE);
@@ -437,6 +443,7 @@ bool QbbNetDevice::Attach(Ptr<QbbChannel> ch) {
 }
 
 bool QbbNetDevice::TransmitStart(Ptr<Packet> p) {
+    NS_PROFILE_COUNT("queue/tx bytes", p->GetSize());
     NS_LOG_FUNCTION(this << p);
     NS_LOG_LOGIC("UID is " << p->GetUid() << ")");
     //
@@ -447,19 +454,34 @@ bool QbbNetDevice::TransmitStart(Ptr<Packet> p) {
     NS_ASSERT_MSG(m_txMachineState == READY, "Must be READY to transmit");
     m_txMachineState = BUSY;
     m_currentPkt = p;
-    m_phyTxBeginTrace(m_currentPkt);
-    Time txTime = Seconds(m_bps.CalculateTxTime(p->GetSize()));
+    NS_PACKET_TRACE(m_phyTxBeginTrace, (m_currentPkt));
+    Time txTime = GetTxTime(p->GetSize());
     Time txCompleteTime = txTime + m_tInterframeGap;
     NS_LOG_LOGIC("Schedule TransmitCompleteEvent in " << txCompleteTime.GetSeconds() << "sec");
     Simulator::Schedule(txCompleteTime, &QbbNetDevice::TransmitComplete, this);
 
     bool result = m_channel->TransmitStart(p, this, txTime);
     if (result == false) {
-        m_phyTxDropTrace(p);
+        NS_PACKET_TRACE(m_phyTxDropTrace, (p));
     }
     return result;
 }
 
+Time QbbNetDevice::GetTxTime(uint32_t size) {
+    static const uint32_t kMaxTableSize = 16384;  // larger packets are computed each time
+    // packets only get the capacity left over by fluid background flows
+    const DataRate &rate = m_fluidBps ? m_residualBps : m_bps;
+    if (rate.GetBitRate() != m_txTimeBps) {
+        m_txTimeBps = rate.GetBitRate();
+        m_txTime.clear();
+    }
+    if (size >= kMaxTableSize) return Seconds(rate.CalculateTxTime(size));
+    if (size >= m_txTime.size()) m_txTime.resize(size + 1, -1);
+    int64_t &steps = m_txTime[size];
+    if (steps < 0) steps = Seconds(rate.CalculateTxTime(size)).GetTimeStep();  // same rounding
+    return TimeStep(steps);
+}
+
 Ptr<Channel> QbbNetDevice::GetChannel(void) const { return m_channel; }
 
 bool QbbNetDevice::IsQbb(void) const { return true; }
@@ -481,7 +503,7 @@ Ptr<BEgressQueue> QbbNetDevice::GetQueue() { return m_queue; }
 Ptr<RdmaEgressQueue> QbbNetDevice::GetRdmaQueue() { return m_rdmaEQ; }
 
 void QbbNetDevice::RdmaEnqueueHighPrioQ(Ptr<Packet> p) {
-    m_traceEnqueue(p, 0);
+    NS_PACKET_TRACE(m_traceEnqueue, (p, 0));
     m_rdmaEQ->EnqueueHighPrioQ(p);
 }
 
@@ -498,13 +520,19 @@ void QbbNetDevice::TakeDown() {
         while (1) {
             Ptr<Packet> p = m_queue->DequeueRR(m_paused);
             if (p == 0) break;
-            m_traceDrop(p, m_queue->GetLastQueue());
+            NS_PACKET_TRACE(m_traceDrop, (p, m_queue->GetLastQueue()));
         }
         // TODO: Notify switch that this link is down
     }
     m_linkUp = false;
 }
 
+void QbbNetDevice::SetFluidRate(uint64_t bps) {
+    NS_ASSERT_MSG(bps < m_bps.GetBitRate(), "Fluid flows cannot take the whole link");
+    m_fluidBps = bps;
+    m_residualBps = DataRate(m_bps.GetBitRate() - bps);
+}
+
 void QbbNetDevice::UpdateNextAvail(Time t) {
     if (!m_nextSend.IsExpired() && t < m_nextSend.GetTs()) {
         Simulator::Cancel(m_nextSend);
@@ -26,6 +26,7 @@
 //#include "ns3/fivetuple.h"
 #include "ns3/event-id.h"
 #include "ns3/broadcom-egress-queue.h"
+#include "ns3/drop-tail-queue.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/udp-header.h"
@@ -46,7 +47,6 @@ public:
 	uint32_t m_rrlast;
 	Ptr<DropTailQueue> m_ackQ; // highest priority queue
 	Ptr<RdmaQueuePairGroup> m_qpGrp; // queue pairs
-	std::unordered_map<int32_t, Time> current_pause_time;
 
 	// callback for get next packet
 	typedef Callback<Ptr<Packet>, Ptr<RdmaQueuePair> > RdmaGetNxtPkt;
@@ -62,7 +62,7 @@ public:
 	Ptr<RdmaQueuePair> GetQp(uint32_t i);
 	void RecoverQueue(uint32_t i);
 	void EnqueueHighPrioQ(Ptr<Packet> p);
-	void CleanHighPrio(TracedCallback<Ptr<const Packet>, uint32_t> dropCb);
+	void CleanHighPrio(const TracedCallback<Ptr<const Packet>, uint32_t> &dropCb);
 
 	TracedCallback<Ptr<const Packet>, uint32_t> m_traceRdmaEnqueue;
 	TracedCallback<Ptr<const Packet>, uint32_t> m_traceRdmaDequeue;
@@ -136,6 +136,16 @@ public:
 
    uint32_t SendPfc(uint32_t qIndex, uint32_t type); // type: 0 = pause, 1 = resume
 
+   // PFC pauses received on this port for one priority, kept per pause/resume interval
+   struct PauseStats {
+     uint64_t nPause;	//< pauses that started while the queue was running
+     Time total;	//< paused time of finished intervals
+     Time longest;	//< longest finished interval
+     Time since;	//< start of the current interval, if paused
+   };
+   const PauseStats &GetPauseStats(uint32_t qIndex) const { return m_pauseStats[qIndex]; }
+   bool IsPaused(uint32_t qIndex) const { return m_paused[qIndex]; }
+
    TracedCallback<Ptr<const Packet>, uint32_t> m_traceEnqueue;
    TracedCallback<Ptr<const Packet>, uint32_t> m_traceDequeue;
    TracedCallback<Ptr<const Packet>, uint32_t> m_traceDrop;
@@ -151,6 +161,9 @@ public:
    /// Reset the channel into READY state and try transmit again
    virtual void TransmitComplete(void);
 
+   /// Serialization time of size bytes at the current rate, from a per-size table
+   Time GetTxTime(uint32_t size);
+
    /// Look for an available packet and send it using TransmitStart(p)
    virtual void DequeueAndTransmit(void);
 
@@ -172,6 +185,7 @@ public:
    bool m_dynamicth;
    uint32_t m_pausetime;	//< Time for each Pause
    bool m_paused[qCnt];	//< Whether a queue paused
+   PauseStats m_pauseStats[qCnt];
    EventId m_resumeEvt[qCnt];
 
    //qcn
@@ -193,6 +207,13 @@ public:
 
   std::vector<ECNAccount> *m_ecn_source;
 
+  uint64_t m_fluidBps;		//< rate reserved by fluid flows
+  DataRate m_residualBps;	//< m_bps - m_fluidBps, used to serialize packets
+
+  // tx time in time steps by packet size at rate m_txTimeBps, -1: not computed yet
+  std::vector<int64_t> m_txTime;
+  uint64_t m_txTimeBps;
+
 public:
 	Ptr<RdmaEgressQueue> m_rdmaEQ;
 	void RdmaEnqueueHighPrioQ(Ptr<Packet> p);
@@ -211,6 +232,11 @@ public:
 	void TakeDown(); // take down this device
 	void UpdateNextAvail(Time t);
 
+	// capacity taken by fluid (flow-level) background flows, see FluidFlowModel
+	void SetFluidRate(uint64_t bps);
+	uint64_t GetFluidRate(void) const { return m_fluidBps; }
+	DataRate GetResidualRate(void) const { return m_fluidBps ? m_residualBps : m_bps; }
+
 	TracedCallback<Ptr<const Packet>, Ptr<RdmaQueuePair> > m_traceQpDequeue; // the trace for printing dequeue
 };
 
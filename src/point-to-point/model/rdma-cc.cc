@@ -0,0 +1,130 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/rdma-cc.h"
+
+#include <iostream>
+
+#include "ns3/qbb-header.h"
+#include "ns3/rdma-hw.h"
+
+namespace ns3 {
+
+/*******************************
+ * Built-in algorithms. The control laws stay in RdmaHw (they share its attributes);
+ * these classes own the per-QP state and route the hooks.
+ ******************************/
+class RdmaCcDcqcn : public RdmaCongestionControl {
+   public:
+    explicit RdmaCcDcqcn(RdmaHw *hw) : RdmaCongestionControl(hw) {}
+    const char *GetName() const { return "dcqcn"; }
+    uint32_t GetQpStateSize() const { return sizeof(RdmaMlxState); }
+
+    void OnQpStart(Ptr<RdmaQueuePair> qp, DataRate lineRate) {
+        if (!qp->mlx) qp->mlx = RdmaCcStatePool<RdmaMlxState>::Get().Alloc();
+        qp->mlx->m_targetRate = lineRate;
+    }
+    void OnQpComplete(Ptr<RdmaQueuePair> qp) { m_hw->CancelTimersMlx(qp); }
+    void OnAck(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch) {
+        if ((ch.ack.flags >> qbbHeader::FLAG_CNP) & 1) m_hw->cnp_received_mlx(qp);
+    }
+};
+
+class RdmaCcHpcc : public RdmaCongestionControl {
+   public:
+    explicit RdmaCcHpcc(RdmaHw *hw) : RdmaCongestionControl(hw) {}
+    const char *GetName() const { return "hpcc"; }
+    uint32_t GetQpStateSize() const { return sizeof(RdmaHpState); }
+
+    void OnQpStart(Ptr<RdmaQueuePair> qp, DataRate lineRate) {
+        if (!qp->hp) qp->hp = RdmaCcStatePool<RdmaHpState>::Get().Alloc();
+        qp->hp->m_curRate = lineRate;
+        if (m_hw->m_multipleRate) {
+            for (uint32_t i = 0; i < IntHeader::maxHop; i++) qp->hp->hopState[i].Rc = lineRate;
+        }
+    }
+    void OnAck(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch) {
+        m_hw->HandleAckHp(qp, p, ch);
+    }
+};
+
+class RdmaCcTimely : public RdmaCongestionControl {
+   public:
+    explicit RdmaCcTimely(RdmaHw *hw) : RdmaCongestionControl(hw) {}
+    const char *GetName() const { return "timely"; }
+    uint32_t GetQpStateSize() const { return sizeof(RdmaTimelyState); }
+
+    void OnQpStart(Ptr<RdmaQueuePair> qp, DataRate lineRate) {
+        if (!qp->tmly) qp->tmly = RdmaCcStatePool<RdmaTimelyState>::Get().Alloc();
+        qp->tmly->m_curRate = lineRate;
+    }
+    void OnAck(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch) {
+        m_hw->HandleAckTimely(qp, p, ch);
+    }
+};
+
+class RdmaCcDctcp : public RdmaCongestionControl {
+   public:
+    explicit RdmaCcDctcp(RdmaHw *hw) : RdmaCongestionControl(hw) {}
+    const char *GetName() const { return "dctcp"; }
+    uint32_t GetQpStateSize() const { return sizeof(RdmaDctcpState); }
+
+    void OnQpStart(Ptr<RdmaQueuePair> qp, DataRate lineRate) {
+        if (!qp->dctcp) qp->dctcp = RdmaCcStatePool<RdmaDctcpState>::Get().Alloc();
+    }
+    void OnAck(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch) {
+        m_hw->HandleAckDctcp(qp, p, ch);
+    }
+};
+
+template <typename T>
+static Ptr<RdmaCongestionControl> MakeCc(RdmaHw *hw) {
+    return ns3::Create<T>(hw);
+}
+
+/*******************************
+ * Registry
+ ******************************/
+std::map<uint32_t, RdmaCongestionControl::Factory> &RdmaCongestionControl::GetRegistry() {
+    static std::map<uint32_t, Factory> registry;
+    if (registry.empty()) {
+        registry[CC_MODE_UNDEFINED] = &MakeCc<RdmaCongestionControl>;
+        registry[CC_MODE_DCQCN] = &MakeCc<RdmaCcDcqcn>;
+        registry[CC_MODE_HPCC] = &MakeCc<RdmaCcHpcc>;
+        registry[CC_MODE_TIMELY] = &MakeCc<RdmaCcTimely>;
+        registry[CC_MODE_DCTCP] = &MakeCc<RdmaCcDctcp>;
+    }
+    return registry;
+}
+
+RdmaCongestionControl::Registrar::Registrar(uint32_t ccMode, Factory factory) {
+    GetRegistry()[ccMode] = factory;
+}
+
+Ptr<RdmaCongestionControl> RdmaCongestionControl::Create(uint32_t ccMode, RdmaHw *hw) {
+    std::map<uint32_t, Factory> &registry = GetRegistry();
+    auto it = registry.find(ccMode);
+    if (it == registry.end()) {
+        std::cout << "ERROR: no congestion control registered for CC_MODE " << ccMode
+                  << std::endl;
+        exit(1);
+    }
+    return it->second(hw);
+}
+
+}  // namespace ns3
@@ -0,0 +1,138 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __RDMA_CC_H__
+#define __RDMA_CC_H__
+
+#include <map>
+#include <new>
+#include <vector>
+
+#include "ns3/custom-header.h"
+#include "ns3/data-rate.h"
+#include "ns3/object.h"
+#include "ns3/packet.h"
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+#include "rdma-queue-pair.h"
+
+namespace ns3 {
+
+class RdmaHw;
+
+/**
+ * @brief Free-list pool for one kind of per-QP congestion control state.
+ *
+ * There is one pool per state type. Slots are carved from fixed-size chunks and recycled,
+ * so a QP only pays for the state of the algorithm that is actually running.
+ */
+template <typename T>
+class RdmaCcStatePool {
+   public:
+    static RdmaCcStatePool &Get() {
+        // never destroyed: qps may still be released during static destruction
+        static RdmaCcStatePool *pool = new RdmaCcStatePool();
+        return *pool;
+    }
+
+    T *Alloc() {
+        if (m_free.empty()) Grow();
+        void *slot = m_free.back();
+        m_free.pop_back();
+        m_inUse++;
+        return new (slot) T();
+    }
+
+    void Free(T *t) {
+        t->~T();
+        m_free.push_back(t);
+        m_inUse--;
+    }
+
+    uint64_t GetInUse() const { return m_inUse; }
+    uint64_t GetCapacity() const { return m_chunks.size() * kChunkSize; }
+
+   private:
+    static const uint32_t kChunkSize = 256;  // slots per chunk
+
+    RdmaCcStatePool() : m_inUse(0) {}
+
+    void Grow() {
+        char *chunk = static_cast<char *>(::operator new(sizeof(T) * kChunkSize));
+        m_chunks.push_back(chunk);
+        for (uint32_t i = kChunkSize; i > 0; i--) {
+            m_free.push_back(chunk + sizeof(T) * (i - 1));
+        }
+    }
+
+    std::vector<char *> m_chunks;
+    std::vector<void *> m_free;
+    uint64_t m_inUse;
+};
+
+/**
+ * @brief Congestion control algorithm plugged into RdmaHw.
+ *
+ * Each RdmaHw creates one instance from the CcMode it is configured with and calls the
+ * hooks below; the per-ACK path is a single virtual call to OnAck. An algorithm keeps its
+ * per-QP state in its own pool (see RdmaCcStatePool): built-in ones use the typed pointers
+ * of RdmaQueuePair, others use RdmaQueuePair::m_ccPriv.
+ *
+ * New algorithms are added by subclassing and registering a factory under a new CcMode:
+ *
+ *   static Ptr<RdmaCongestionControl> MakeSwift(RdmaHw *hw) { return Create<SwiftCc>(hw); }
+ *   static RdmaCongestionControl::Registrar g_swift(CC_MODE_SWIFT, &MakeSwift);
+ */
+class RdmaCongestionControl : public SimpleRefCount<RdmaCongestionControl> {
+   public:
+    typedef Ptr<RdmaCongestionControl> (*Factory)(RdmaHw *hw);
+
+    struct Registrar {
+        Registrar(uint32_t ccMode, Factory factory);
+    };
+
+    static Ptr<RdmaCongestionControl> Create(uint32_t ccMode, RdmaHw *hw);
+
+    explicit RdmaCongestionControl(RdmaHw *hw) : m_hw(hw) {}
+    virtual ~RdmaCongestionControl() {}
+
+    virtual const char *GetName() const { return "none"; }
+    // bytes of per-QP state this algorithm allocates
+    virtual uint32_t GetQpStateSize() const { return 0; }
+
+    // a new qp starts on a NIC of the given line rate: allocate and initialize its state
+    virtual void OnQpStart(Ptr<RdmaQueuePair> qp, DataRate lineRate) {}
+    // the last byte of the qp is acknowledged (its state is freed with the qp itself)
+    virtual void OnQpComplete(Ptr<RdmaQueuePair> qp) {}
+    // every ACK/NACK, after the sequence state is updated; the CNP flag is in ch.ack.flags
+    virtual void OnAck(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch) {}
+    // a data packet of the qp left the NIC
+    virtual void OnSend(Ptr<RdmaQueuePair> qp, Ptr<Packet> p) {}
+    // the retransmission timer of the qp fired
+    virtual void OnTimeout(Ptr<RdmaQueuePair> qp) {}
+
+   protected:
+    RdmaHw *m_hw;
+
+   private:
+    static std::map<uint32_t, Factory> &GetRegistry();
+};
+
+}  // namespace ns3
+
+#endif
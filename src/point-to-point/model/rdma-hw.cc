@@ -5,6 +5,7 @@
 #include <ns3/simulator.h>
 #include <ns3/udp-header.h>
 
+#include <algorithm>
 #include <climits>
 
 #include "cn-header.h"
@@ -16,6 +17,7 @@
 #include "ns3/pointer.h"
 #include "ns3/ppp-header.h"
 #include "ns3/settings.h"
+#include "ns3/sim-profiler.h"
 #include "ns3/switch-node.h"
 #include "ns3/uinteger.h"
 #include "ppp-header.h"
@@ -26,7 +28,9 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE("RdmaHw");
 
 std::unordered_map<unsigned, unsigned> acc_timeout_count;
+extern std::unordered_map<unsigned, Time> acc_pause_time;
 uint64_t RdmaHw::nAllPkts = 0;
+uint64_t RdmaHw::nQpMigrations = 0;
 
 TypeId RdmaHw::GetTypeId(void) {
     static TypeId tid =
@@ -127,11 +131,23 @@ TypeId RdmaHw::GetTypeId(void) {
                           MakeUintegerAccessor(&RdmaHw::m_irn_bdp), MakeUintegerChecker<uint32_t>())
             .AddAttribute("L2Timeout", "Sender's timer of waiting for the ack",
                           TimeValue(MilliSeconds(4)), MakeTimeAccessor(&RdmaHw::m_waitAckTimeout),
+                          MakeTimeChecker())
+            .AddAttribute("NicPlacement",
+                          "How a new qp picks its NIC on multi-NIC hosts. 0: hash, 1: least-loaded, "
+                          "2: round-robin",
+                          UintegerValue(NIC_PLACEMENT_HASH),
+                          MakeUintegerAccessor(&RdmaHw::m_nicPlacement),
+                          MakeUintegerChecker<uint32_t>(0, 2))
+            .AddAttribute("MlxTimerTick",
+                          "Tick of the timer wheel running the DCQCN timers of all qps. 0 runs "
+                          "them as separate events per qp; 1ns gives identical timing",
+                          TimeValue(Seconds(0)), MakeTimeAccessor(&RdmaHw::m_mlxTimerTick),
                           MakeTimeChecker());
     return tid;
 }
 
 RdmaHw::RdmaHw() {
+    m_nicRoundRobin = 0;
     cnp_total = 0;
     cnp_by_ecn = 0;
     cnp_by_ooo = 0;
@@ -154,16 +170,56 @@ void RdmaHw::Setup(QpCompleteCallback cb) {
     }
     // setup qp complete callback
     m_qpCompleteCallback = cb;
+    // congestion control plugin, see rdma-cc.h
+    m_cc = RdmaCongestionControl::Create(m_cc_mode, this);
+    if (!m_mlxTimerTick.IsZero()) {
+        m_mlxWheel.SetTick(m_mlxTimerTick);
+        m_mlxWheel.SetHandler(MakeCallback(&RdmaHw::MlxTimerExpired, this));
+    }
 }
 
 uint32_t RdmaHw::GetNicIdxOfQp(Ptr<RdmaQueuePair> qp) {
+    // a qp stays on the NIC it was placed on until RedistributeQp migrates it
+    NS_ASSERT_MSG(qp->m_nicIdx < m_nic.size(), "qp is not placed on any NIC");
+    return qp->m_nicIdx;
+}
+
+uint32_t RdmaHw::SelectNic(Ptr<RdmaQueuePair> qp) {
     auto &v = m_rtTable[qp->dip.Get()];
-    if (v.size() > 0) {
-        return v[qp->GetHash() % v.size()];
+    if (v.size() == 0) {
+        NS_ASSERT_MSG(false, "We assume at least one NIC is alive");
+        std::cout << "We assume at least one NIC is alive" << std::endl;
+        exit(1);
+    }
+    if (v.size() == 1) return v[0];
+    switch (m_nicPlacement) {
+        case NIC_PLACEMENT_LEAST_LOADED: {
+            uint32_t best = v[0];
+            for (uint32_t i = 1; i < v.size(); i++) {
+                if (m_nic[v[i]].nQp < m_nic[best].nQp) best = v[i];
+            }
+            return best;
+        }
+        case NIC_PLACEMENT_ROUND_ROBIN:
+            return v[m_nicRoundRobin++ % v.size()];
+        default:
+            return v[qp->GetHash() % v.size()];
     }
-    NS_ASSERT_MSG(false, "We assume at least one NIC is alive");
-    std::cout << "We assume at least one NIC is alive" << std::endl;
-    exit(1);
+}
+
+void RdmaHw::MigrateQp(Ptr<RdmaQueuePair> qp, uint32_t nic_idx) {
+    m_nic[qp->m_nicIdx].nQp--;
+    m_nic[nic_idx].nQp++;
+    qp->m_nicIdx = nic_idx;
+    nQpMigrations++;
+
+    // sequence and CC state move with the qp. Packets in flight on the old rail may be
+    // lost with the link, so resume from the last ack (IRN recovers through its own SACKs).
+    if (!m_irn) RecoverQueue(qp);
+    // rails may run at different speeds
+    DataRate bps = m_nic[nic_idx].dev->GetDataRate();
+    qp->m_max_rate = bps;
+    if (qp->m_rate > bps) ChangeRate(qp, bps);
 }
 
 uint64_t RdmaHw::GetQpKey(uint32_t dip, uint16_t sport, uint16_t dport,
@@ -200,7 +256,9 @@ void RdmaHw::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4Addre
     }
 
     // add qp
-    uint32_t nic_idx = GetNicIdxOfQp(qp);
+    uint32_t nic_idx = SelectNic(qp);
+    qp->m_nicIdx = nic_idx;
+    m_nic[nic_idx].nQp++;
     m_nic[nic_idx].qpGrp->AddQp(qp);
     uint64_t key = GetQpKey(dip.Get(), sport, dport, pg);
     m_qpMap[key] = qp;
@@ -209,16 +267,7 @@ void RdmaHw::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4Addre
     DataRate m_bps = m_nic[nic_idx].dev->GetDataRate();
     qp->m_rate = m_bps;
     qp->m_max_rate = m_bps;
-    if (m_cc_mode == 1) {
-        qp->mlx.m_targetRate = m_bps;
-    } else if (m_cc_mode == 3) {
-        qp->hp.m_curRate = m_bps;
-        if (m_multipleRate) {
-            for (uint32_t i = 0; i < IntHeader::maxHop; i++) qp->hp.hopState[i].Rc = m_bps;
-        }
-    } else if (m_cc_mode == 7) {
-        qp->tmly.m_curRate = m_bps;
-    }
+    m_cc->OnQpStart(qp, m_bps);
 
     // Notify Nic
     m_nic[nic_idx].dev->NewQp(qp);
@@ -234,6 +283,7 @@ void RdmaHw::DeleteQueuePair(Ptr<RdmaQueuePair> qp) {
 
     // delete
     m_qpMap.erase(key);
+    m_nic[qp->m_nicIdx].nQp--;
 }
 
 // DATA UDP's src = this key's dst (receiver's dst)
@@ -290,6 +340,7 @@ void RdmaHw::DeleteRxQp(uint32_t dip, uint16_t dport, uint16_t sport, uint16_t p
 }
 
 int RdmaHw::ReceiveUdp(Ptr<Packet> p, CustomHeader &ch) {
+    NS_PROFILE_SCOPE("nic/rx data");
     uint8_t ecnbits = ch.GetIpv4EcnBits();
 
     uint32_t payload_size = p->GetSize() - ch.GetSerializedSize();
@@ -353,8 +404,10 @@ int RdmaHw::ReceiveUdp(Ptr<Packet> p, CustomHeader &ch) {
             seqh.SetCnp();
         }
 
+        // headroom for qbbHeader, IPv4 (20) and PPP, added without reallocating
         Ptr<Packet> newp =
-            Create<Packet>(std::max(60 - 14 - 20 - (int)seqh.GetSerializedSize(), 0));
+            Create<Packet>(std::max(60 - 14 - 20 - (int)seqh.GetSerializedSize(), 0),
+                           seqh.GetSerializedSize() + 20 + PppHeader::GetStaticSize());
         newp->AddHeader(seqh);
 
         Ipv4Header head;  // Prepare IPv4 header
@@ -424,27 +477,17 @@ int RdmaHw::ReceiveCnp(Ptr<Packet> p, CustomHeader &ch) {
     if (qp->m_rate == 0)  // lazy initialization
     {
         qp->m_rate = dev->GetDataRate();
-        if (m_cc_mode == 1) {
-            qp->mlx.m_targetRate = dev->GetDataRate();
-        } else if (m_cc_mode == 3) {
-            qp->hp.m_curRate = dev->GetDataRate();
-            if (m_multipleRate) {
-                for (uint32_t i = 0; i < IntHeader::maxHop; i++)
-                    qp->hp.hopState[i].Rc = dev->GetDataRate();
-            }
-        } else if (m_cc_mode == 7) {
-            qp->tmly.m_curRate = dev->GetDataRate();
-        }
+        m_cc->OnQpStart(qp, dev->GetDataRate());
     }
     return 0;
 }
 
 int RdmaHw::ReceiveAck(Ptr<Packet> p, CustomHeader &ch) {
+    NS_PROFILE_SCOPE("nic/rx ack");
     uint16_t qIndex = ch.ack.pg;
     uint16_t port = ch.ack.dport;   // sport for this host
     uint16_t sport = ch.ack.sport;  // dport for this host (sport of ACK packet)
     uint32_t seq = ch.ack.seq;
-    uint8_t cnp = (ch.ack.flags >> qbbHeader::FLAG_CNP) & 1;
     int i;
     uint64_t key = GetQpKey(ch.sip, port, sport, qIndex);
     Ptr<RdmaQueuePair> qp = GetQp(key);
@@ -543,20 +586,8 @@ int RdmaHw::ReceiveAck(Ptr<Packet> p, CustomHeader &ch) {
     } else if (ch.l3Prot == 0xFD)  // NACK
         RecoverQueue(qp);
 
-    // handle cnp
-    if (cnp) {
-        if (m_cc_mode == 1) {  // mlx version
-            cnp_received_mlx(qp);
-        }
-    }
-
-    if (m_cc_mode == 3) {
-        HandleAckHp(qp, p, ch);
-    } else if (m_cc_mode == 7) {
-        HandleAckTimely(qp, p, ch);
-    } else if (m_cc_mode == 8) {
-        HandleAckDctcp(qp, p, ch);
-    }
+    // congestion control (including the CNP flag)
+    m_cc->OnAck(qp, p, ch);
     // ACK may advance the on-the-fly window, allowing more packets to send
     dev->TriggerTransmit();
     return 0;
@@ -711,12 +742,12 @@ void RdmaHw::RecoverQueue(Ptr<RdmaQueuePair> qp) { qp->snd_nxt = qp->snd_una; }
 
 void RdmaHw::QpComplete(Ptr<RdmaQueuePair> qp) {
     NS_ASSERT(!m_qpCompleteCallback.IsNull());
-    if (m_cc_mode == 1) {
-        Simulator::Cancel(qp->mlx.m_eventUpdateAlpha);
-        Simulator::Cancel(qp->mlx.m_eventDecreaseRate);
-        Simulator::Cancel(qp->mlx.m_rpTimer);
-    }
+    m_cc->OnQpComplete(qp);
     if (qp->m_retransmit.IsRunning()) qp->m_retransmit.Cancel();
+    // PFC blocking of the qp, measured by RdmaEgressQueue, is charged to the flow once
+    if (qp->stat.pfcBlockedTime > 0) {
+        acc_pause_time[qp->m_flow_id] += TimeStep(qp->stat.pfcBlockedTime);
+    }
 
     // This callback will log info. It also calls deletetion the rxQp on the receiver
     m_qpCompleteCallback(qp);
@@ -742,10 +773,15 @@ void RdmaHw::RedistributeQp() {
         m_nic[i].qpGrp->Clear();
     }
 
-    // redistribute qp
+    // redistribute qp: a qp keeps its NIC while that NIC still routes to the destination,
+    // otherwise it is migrated live to one of the remaining ones
     for (auto &it : m_qpMap) {
         Ptr<RdmaQueuePair> qp = it.second;
-        uint32_t nic_idx = GetNicIdxOfQp(qp);
+        auto &v = m_rtTable[qp->dip.Get()];
+        if (std::find(v.begin(), v.end(), (int)qp->m_nicIdx) == v.end()) {
+            MigrateQp(qp, SelectNic(qp));
+        }
+        uint32_t nic_idx = qp->m_nicIdx;
         m_nic[nic_idx].qpGrp->AddQp(qp);
         // Notify Nic
         m_nic[nic_idx].dev->ReassignedQp(qp);
@@ -753,6 +789,7 @@ void RdmaHw::RedistributeQp() {
 }
 
 Ptr<Packet> RdmaHw::GetNxtPacket(Ptr<RdmaQueuePair> qp) {
+    NS_PROFILE_SCOPE("nic/tx packet");
     uint32_t payload_size = qp->GetBytesLeft();
     if (m_mtu < payload_size) {  // possibly last packet
         payload_size = m_mtu;
@@ -762,11 +799,13 @@ Ptr<Packet> RdmaHw::GetNxtPacket(Ptr<RdmaQueuePair> qp) {
     qp->stat.txTotalPkts += 1;
     qp->stat.txTotalBytes += payload_size;
 
-    Ptr<Packet> p = Create<Packet>(payload_size);
-    // add SeqTsHeader
     SeqTsHeader seqTs;
     seqTs.SetSeq(seq);
     seqTs.SetPG(qp->m_pg);
+    // headroom for SeqTs, UDP (8), IPv4 (20) and PPP, added without reallocating
+    Ptr<Packet> p = Create<Packet>(
+        payload_size, seqTs.GetSerializedSize() + 8 + 20 + PppHeader::GetStaticSize());
+    // add SeqTsHeader
     p->AddHeader(seqTs);
     // add udp header
     UdpHeader udpHeader;
@@ -846,6 +885,7 @@ void RdmaHw::PktSent(Ptr<RdmaQueuePair> qp, Ptr<Packet> pkt, Time interframeGap)
             if (qp->m_retransmit.IsRunning()) qp->m_retransmit.Cancel();
             qp->m_retransmit = Simulator::Schedule(qp->GetRto(m_mtu), &RdmaHw::HandleTimeout, this,
                                                    qp, qp->GetRto(m_mtu));
+            m_cc->OnSend(qp, pkt);
         } else if (ch.l3Prot == 0xFC || ch.l3Prot == 0xFD || ch.l3Prot == 0xFF) {  // ACK, NACK, CNP
         } else if (ch.l3Prot == 0xFE) {                                            // PFC
         }
@@ -872,6 +912,7 @@ void RdmaHw::HandleTimeout(Ptr<RdmaQueuePair> qp, Time rto) {
     if (qp->irn.m_enabled) qp->irn.m_recovery = true;
 
     RecoverQueue(qp);
+    m_cc->OnTimeout(qp);
     dev->TriggerTransmit();
 }
 
@@ -904,89 +945,131 @@ void RdmaHw::ChangeRate(Ptr<RdmaQueuePair> qp, DataRate new_rate) {
  *****************************/
 void RdmaHw::UpdateAlphaMlx(Ptr<RdmaQueuePair> q) {
 #if PRINT_LOG
-// std::cout << Simulator::Now() << " alpha update:" << m_node->GetId() << ' ' << q->mlx.m_alpha <<
-// ' ' << (int)q->mlx.m_alpha_cnp_arrived << '\n'; printf("%lu alpha update: %08x %08x %u %u
+// std::cout << Simulator::Now() << " alpha update:" << m_node->GetId() << ' ' << q->mlx->m_alpha <<
+// ' ' << (int)q->mlx->m_alpha_cnp_arrived << '\n'; printf("%lu alpha update: %08x %08x %u %u
 // %.6lf->", Simulator::Now().GetTimeStep(), q->sip.Get(), q->dip.Get(), q->sport, q->dport,
-// q->mlx.m_alpha);
+// q->mlx->m_alpha);
 #endif
-    if (q->mlx.m_alpha_cnp_arrived) {                       // cnp -> increase
-        q->mlx.m_alpha = (1 - m_g) * q->mlx.m_alpha + m_g;  // binary feedback
+    if (q->mlx->m_alpha_cnp_arrived) {                       // cnp -> increase
+        q->mlx->m_alpha = (1 - m_g) * q->mlx->m_alpha + m_g;  // binary feedback
     } else {                                                // no cnp -> decrease
-        q->mlx.m_alpha = (1 - m_g) * q->mlx.m_alpha;        // binary feedback
+        q->mlx->m_alpha = (1 - m_g) * q->mlx->m_alpha;        // binary feedback
     }
 #if PRINT_LOG
-// printf("%.6lf\n", q->mlx.m_alpha);
+// printf("%.6lf\n", q->mlx->m_alpha);
 #endif
-    q->mlx.m_alpha_cnp_arrived = false;  // clear the CNP_arrived bit
+    q->mlx->m_alpha_cnp_arrived = false;  // clear the CNP_arrived bit
     ScheduleUpdateAlphaMlx(q);
 }
 void RdmaHw::ScheduleUpdateAlphaMlx(Ptr<RdmaQueuePair> q) {
-    q->mlx.m_eventUpdateAlpha = Simulator::Schedule(MicroSeconds(m_alpha_resume_interval),
+    if (!m_mlxTimerTick.IsZero()) {
+        m_mlxWheel.Schedule(MicroSeconds(m_alpha_resume_interval), q, MLX_TIMER_ALPHA,
+                            &q->mlx->m_timerStamp[MLX_TIMER_ALPHA]);
+        return;
+    }
+    q->mlx->m_eventUpdateAlpha = Simulator::Schedule(MicroSeconds(m_alpha_resume_interval),
                                                     &RdmaHw::UpdateAlphaMlx, this, q);
 }
 
 void RdmaHw::cnp_received_mlx(Ptr<RdmaQueuePair> q) {
-    q->mlx.m_alpha_cnp_arrived = true;     // set CNP_arrived bit for alpha update
-    q->mlx.m_decrease_cnp_arrived = true;  // set CNP_arrived bit for rate decrease
-    if (q->mlx.m_first_cnp) {
+    NS_PROFILE_SCOPE("cc/dcqcn cnp");
+    q->mlx->m_alpha_cnp_arrived = true;     // set CNP_arrived bit for alpha update
+    q->mlx->m_decrease_cnp_arrived = true;  // set CNP_arrived bit for rate decrease
+    if (q->mlx->m_first_cnp) {
         // init alpha
-        q->mlx.m_alpha = 1;
-        q->mlx.m_alpha_cnp_arrived = false;
+        q->mlx->m_alpha = 1;
+        q->mlx->m_alpha_cnp_arrived = false;
         // schedule alpha update
         ScheduleUpdateAlphaMlx(q);
         // schedule rate decrease
         ScheduleDecreaseRateMlx(q, 1);  // add 1 ns to make sure rate decrease is after alpha update
         // set rate on first CNP
-        q->mlx.m_targetRate = q->m_rate = m_rateOnFirstCNP * q->m_rate;
-        q->mlx.m_first_cnp = false;
+        q->mlx->m_targetRate = q->m_rate = m_rateOnFirstCNP * q->m_rate;
+        q->mlx->m_first_cnp = false;
     }
 }
 
 void RdmaHw::CheckRateDecreaseMlx(Ptr<RdmaQueuePair> q) {
     ScheduleDecreaseRateMlx(q, 0);
-    if (q->mlx.m_decrease_cnp_arrived) {
+    if (q->mlx->m_decrease_cnp_arrived) {
 #if PRINT_LOG
         printf("%lu rate dec: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(),
                q->sip.Get(), q->dip.Get(), q->sport, q->dport,
-               q->mlx.m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
+               q->mlx->m_targetRate.GetBitRate() * 1e-9, q->m_rate.GetBitRate() * 1e-9);
 #endif
         bool clamp = true;
         if (!m_EcnClampTgtRate) {
-            if (q->mlx.m_rpTimeStage == 0) clamp = false;
+            if (q->mlx->m_rpTimeStage == 0) clamp = false;
         }
         if (clamp) {
-            q->mlx.m_targetRate = q->m_rate;
+            q->mlx->m_targetRate = q->m_rate;
         }
-        q->m_rate = std::max(m_minRate, q->m_rate * (1 - q->mlx.m_alpha / 2));
+        q->m_rate = std::max(m_minRate, q->m_rate * (1 - q->mlx->m_alpha / 2));
         // reset rate increase related things
-        q->mlx.m_rpTimeStage = 0;
-        q->mlx.m_decrease_cnp_arrived = false;
-        Simulator::Cancel(q->mlx.m_rpTimer);
-        q->mlx.m_rpTimer = Simulator::Schedule(MicroSeconds(m_rpgTimeReset),
-                                               &RdmaHw::RateIncEventTimerMlx, this, q);
+        q->mlx->m_rpTimeStage = 0;
+        q->mlx->m_decrease_cnp_arrived = false;
+        ScheduleRateIncMlx(q);
 #if PRINT_LOG
-        printf("(%.3lf %.3lf)\n", q->mlx.m_targetRate.GetBitRate() * 1e-9,
+        printf("(%.3lf %.3lf)\n", q->mlx->m_targetRate.GetBitRate() * 1e-9,
                q->m_rate.GetBitRate() * 1e-9);
 #endif
     }
 }
 void RdmaHw::ScheduleDecreaseRateMlx(Ptr<RdmaQueuePair> q, uint32_t delta) {
-    q->mlx.m_eventDecreaseRate =
+    if (!m_mlxTimerTick.IsZero()) {
+        m_mlxWheel.Schedule(MicroSeconds(m_rateDecreaseInterval) + NanoSeconds(delta), q,
+                            MLX_TIMER_DECREASE, &q->mlx->m_timerStamp[MLX_TIMER_DECREASE]);
+        return;
+    }
+    q->mlx->m_eventDecreaseRate =
         Simulator::Schedule(MicroSeconds(m_rateDecreaseInterval) + NanoSeconds(delta),
                             &RdmaHw::CheckRateDecreaseMlx, this, q);
 }
 
-void RdmaHw::RateIncEventTimerMlx(Ptr<RdmaQueuePair> q) {
-    q->mlx.m_rpTimer =
+// (re)start the rate increase timer
+void RdmaHw::ScheduleRateIncMlx(Ptr<RdmaQueuePair> q) {
+    if (!m_mlxTimerTick.IsZero()) {
+        RdmaTimerWheel::Cancel(&q->mlx->m_timerStamp[MLX_TIMER_RATE_INC]);
+        m_mlxWheel.Schedule(MicroSeconds(m_rpgTimeReset), q, MLX_TIMER_RATE_INC,
+                            &q->mlx->m_timerStamp[MLX_TIMER_RATE_INC]);
+        return;
+    }
+    Simulator::Cancel(q->mlx->m_rpTimer);
+    q->mlx->m_rpTimer =
         Simulator::Schedule(MicroSeconds(m_rpgTimeReset), &RdmaHw::RateIncEventTimerMlx, this, q);
+}
+
+void RdmaHw::RateIncEventTimerMlx(Ptr<RdmaQueuePair> q) {
+    ScheduleRateIncMlx(q);
     RateIncEventMlx(q);
-    q->mlx.m_rpTimeStage++;
+    q->mlx->m_rpTimeStage++;
 }
+void RdmaHw::MlxTimerExpired(Ptr<RdmaQueuePair> q, uint32_t timer) {
+    switch (timer) {
+        case MLX_TIMER_ALPHA:
+            UpdateAlphaMlx(q);
+            break;
+        case MLX_TIMER_DECREASE:
+            CheckRateDecreaseMlx(q);
+            break;
+        case MLX_TIMER_RATE_INC:
+            RateIncEventTimerMlx(q);
+            break;
+    }
+}
+
+void RdmaHw::CancelTimersMlx(Ptr<RdmaQueuePair> q) {
+    Simulator::Cancel(q->mlx->m_eventUpdateAlpha);
+    Simulator::Cancel(q->mlx->m_eventDecreaseRate);
+    Simulator::Cancel(q->mlx->m_rpTimer);
+    for (uint32_t i = 0; i < 3; i++) RdmaTimerWheel::Cancel(&q->mlx->m_timerStamp[i]);
+}
+
 void RdmaHw::RateIncEventMlx(Ptr<RdmaQueuePair> q) {
     // check which increase phase: fast recovery, active increase, hyper increase
-    if (q->mlx.m_rpTimeStage < m_rpgThreshold) {  // fast recovery
+    if (q->mlx->m_rpTimeStage < m_rpgThreshold) {  // fast recovery
         FastRecoveryMlx(q);
-    } else if (q->mlx.m_rpTimeStage == m_rpgThreshold) {  // active increase
+    } else if (q->mlx->m_rpTimeStage == m_rpgThreshold) {  // active increase
         ActiveIncreaseMlx(q);
     } else {  // hyper increase
         HyperIncreaseMlx(q);
@@ -996,48 +1079,48 @@ void RdmaHw::RateIncEventMlx(Ptr<RdmaQueuePair> q) {
 void RdmaHw::FastRecoveryMlx(Ptr<RdmaQueuePair> q) {
 #if PRINT_LOG
     printf("%lu fast recovery: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(),
-           q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx.m_targetRate.GetBitRate() * 1e-9,
+           q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx->m_targetRate.GetBitRate() * 1e-9,
            q->m_rate.GetBitRate() * 1e-9);
 #endif
-    q->m_rate = (q->m_rate / 2) + (q->mlx.m_targetRate / 2);
+    q->m_rate = (q->m_rate / 2) + (q->mlx->m_targetRate / 2);
 #if PRINT_LOG
-    printf("(%.3lf %.3lf)\n", q->mlx.m_targetRate.GetBitRate() * 1e-9,
+    printf("(%.3lf %.3lf)\n", q->mlx->m_targetRate.GetBitRate() * 1e-9,
            q->m_rate.GetBitRate() * 1e-9);
 #endif
 }
 void RdmaHw::ActiveIncreaseMlx(Ptr<RdmaQueuePair> q) {
 #if PRINT_LOG
     printf("%lu active inc: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(),
-           q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx.m_targetRate.GetBitRate() * 1e-9,
+           q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx->m_targetRate.GetBitRate() * 1e-9,
            q->m_rate.GetBitRate() * 1e-9);
 #endif
     // get NIC
     uint32_t nic_idx = GetNicIdxOfQp(q);
     Ptr<QbbNetDevice> dev = m_nic[nic_idx].dev;
     // increate rate
-    q->mlx.m_targetRate += m_rai;
-    if (q->mlx.m_targetRate > dev->GetDataRate()) q->mlx.m_targetRate = dev->GetDataRate();
-    q->m_rate = (q->m_rate / 2) + (q->mlx.m_targetRate / 2);
+    q->mlx->m_targetRate += m_rai;
+    if (q->mlx->m_targetRate > dev->GetDataRate()) q->mlx->m_targetRate = dev->GetDataRate();
+    q->m_rate = (q->m_rate / 2) + (q->mlx->m_targetRate / 2);
 #if PRINT_LOG
-    printf("(%.3lf %.3lf)\n", q->mlx.m_targetRate.GetBitRate() * 1e-9,
+    printf("(%.3lf %.3lf)\n", q->mlx->m_targetRate.GetBitRate() * 1e-9,
            q->m_rate.GetBitRate() * 1e-9);
 #endif
 }
 void RdmaHw::HyperIncreaseMlx(Ptr<RdmaQueuePair> q) {
 #if PRINT_LOG
     printf("%lu hyper inc: %08x %08x %u %u (%0.3lf %.3lf)->", Simulator::Now().GetTimeStep(),
-           q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx.m_targetRate.GetBitRate() * 1e-9,
+           q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->mlx->m_targetRate.GetBitRate() * 1e-9,
            q->m_rate.GetBitRate() * 1e-9);
 #endif
     // get NIC
     uint32_t nic_idx = GetNicIdxOfQp(q);
     Ptr<QbbNetDevice> dev = m_nic[nic_idx].dev;
     // increate rate
-    q->mlx.m_targetRate += m_rhai;
-    if (q->mlx.m_targetRate > dev->GetDataRate()) q->mlx.m_targetRate = dev->GetDataRate();
-    q->m_rate = (q->m_rate / 2) + (q->mlx.m_targetRate / 2);
+    q->mlx->m_targetRate += m_rhai;
+    if (q->mlx->m_targetRate > dev->GetDataRate()) q->mlx->m_targetRate = dev->GetDataRate();
+    q->m_rate = (q->m_rate / 2) + (q->mlx->m_targetRate / 2);
 #if PRINT_LOG
-    printf("(%.3lf %.3lf)\n", q->mlx.m_targetRate.GetBitRate() * 1e-9,
+    printf("(%.3lf %.3lf)\n", q->mlx->m_targetRate.GetBitRate() * 1e-9,
            q->m_rate.GetBitRate() * 1e-9);
 #endif
 }
@@ -1048,7 +1131,7 @@ void RdmaHw::HyperIncreaseMlx(Ptr<RdmaQueuePair> q) {
 void RdmaHw::HandleAckHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch) {
     uint32_t ack_seq = ch.ack.seq;
     // update rate
-    if (ack_seq > qp->hp.m_lastUpdateSeq) {  // if full RTT feedback is ready, do full update
+    if (ack_seq > qp->hp->m_lastUpdateSeq) {  // if full RTT feedback is ready, do full update
         UpdateRateHp(qp, p, ch, false);
     } else {  // do fast react
         FastReactHp(qp, p, ch);
@@ -1056,19 +1139,20 @@ void RdmaHw::HandleAckHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch)
 }
 
 void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool fast_react) {
+    NS_PROFILE_SCOPE("cc/hpcc ack");
     uint32_t next_seq = qp->snd_nxt;
     bool print = !fast_react || true;
-    if (qp->hp.m_lastUpdateSeq == 0) {  // first RTT
-        qp->hp.m_lastUpdateSeq = next_seq;
+    if (qp->hp->m_lastUpdateSeq == 0) {  // first RTT
+        qp->hp->m_lastUpdateSeq = next_seq;
         // store INT
         IntHeader &ih = ch.ack.ih;
         NS_ASSERT(ih.nhop <= IntHeader::maxHop);
-        for (uint32_t i = 0; i < ih.nhop; i++) qp->hp.hop[i] = ih.hop[i];
+        for (uint32_t i = 0; i < ih.nhop; i++) qp->hp->hop[i] = ih.hop[i];
 #if PRINT_LOG
         if (print) {
             printf("%lu %s %08x %08x %u %u [%u,%u,%u]", Simulator::Now().GetTimeStep(),
                    fast_react ? "fast" : "update", qp->sip.Get(), qp->dip.Get(), qp->sport,
-                   qp->dport, qp->hp.m_lastUpdateSeq, ch.ack.seq, next_seq);
+                   qp->dport, qp->hp->m_lastUpdateSeq, ch.ack.seq, next_seq);
             for (uint32_t i = 0; i < ih.nhop; i++)
                 printf(" %u %lu %lu", ih.hop[i].GetQlen(), ih.hop[i].GetBytes(),
                        ih.hop[i].GetTime());
@@ -1085,34 +1169,32 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
             if (print)
                 printf("%lu %s %08x %08x %u %u [%u,%u,%u]", Simulator::Now().GetTimeStep(),
                        fast_react ? "fast" : "update", qp->sip.Get(), qp->dip.Get(), qp->sport,
-                       qp->dport, qp->hp.m_lastUpdateSeq, ch.ack.seq, next_seq);
+                       qp->dport, qp->hp->m_lastUpdateSeq, ch.ack.seq, next_seq);
 #endif
+            // unpack every hop at once, then compute per-hop utilization over the batch
+            IntHopBatch batch;
+            ih.UnpackDeltas(qp->hp->hop, batch);
+            batch.ComputeUtilization(qp->m_max_rate.GetBitRate(), qp->m_win);
+
             // check each hop
             double U = 0;
             uint64_t dt = 0;
             bool updated[IntHeader::maxHop] = {false}, updated_any = false;
             NS_ASSERT(ih.nhop <= IntHeader::maxHop);
-            for (uint32_t i = 0; i < ih.nhop; i++) {
+            for (uint32_t i = 0; i < batch.n; i++) {
                 if (m_sampleFeedback) {
-                    if (ih.hop[i].GetQlen() == 0 and fast_react) continue;
+                    if (batch.qlen[i] == 0 and fast_react) continue;
                 }
                 updated[i] = updated_any = true;
 #if PRINT_LOG
                 if (print)
                     printf(" %u(%u) %lu(%lu) %lu(%lu)", ih.hop[i].GetQlen(),
-                           qp->hp.hop[i].GetQlen(), ih.hop[i].GetBytes(), qp->hp.hop[i].GetBytes(),
-                           ih.hop[i].GetTime(), qp->hp.hop[i].GetTime());
-#endif
-                uint64_t tau = ih.hop[i].GetTimeDelta(qp->hp.hop[i]);
-                ;
-                double duration = tau * 1e-9;
-                double txRate = (ih.hop[i].GetBytesDelta(qp->hp.hop[i])) * 8 / duration;
-                double u = txRate / ih.hop[i].GetLineRate() +
-                           (double)std::min(ih.hop[i].GetQlen(), qp->hp.hop[i].GetQlen()) *
-                               qp->m_max_rate.GetBitRate() / ih.hop[i].GetLineRate() / qp->m_win;
-#if PRINT_LOG
-                if (print) printf(" %.3lf %.3lf", txRate, u);
+                           qp->hp->hop[i].GetQlen(), ih.hop[i].GetBytes(), qp->hp->hop[i].GetBytes(),
+                           ih.hop[i].GetTime(), qp->hp->hop[i].GetTime());
+                if (print) printf(" %.3lf", batch.u[i]);
 #endif
+                uint64_t tau = batch.tau[i];
+                double u = batch.u[i];
                 if (!m_multipleRate) {
                     // for aggregate (single R)
                     if (u > U) {
@@ -1122,11 +1204,11 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
                 } else {
                     // for per hop (per hop R)
                     if (tau > qp->m_baseRtt) tau = qp->m_baseRtt;
-                    qp->hp.hopState[i].u =
-                        (qp->hp.hopState[i].u * (qp->m_baseRtt - tau) + u * tau) /
+                    qp->hp->hopState[i].u =
+                        (qp->hp->hopState[i].u * (qp->m_baseRtt - tau) + u * tau) /
                         double(qp->m_baseRtt);
                 }
-                qp->hp.hop[i] = ih.hop[i];
+                qp->hp->hop[i] = ih.hop[i];
             }
 
             DataRate new_rate;
@@ -1137,24 +1219,24 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
                 // for aggregate (single R)
                 if (updated_any) {
                     if (dt > qp->m_baseRtt) dt = qp->m_baseRtt;
-                    qp->hp.u = (qp->hp.u * (qp->m_baseRtt - dt) + U * dt) / double(qp->m_baseRtt);
-                    max_c = qp->hp.u / m_targetUtil;
+                    qp->hp->u = (qp->hp->u * (qp->m_baseRtt - dt) + U * dt) / double(qp->m_baseRtt);
+                    max_c = qp->hp->u / m_targetUtil;
 
-                    if (max_c >= 1 || qp->hp.m_incStage >= m_miThresh) {
-                        new_rate = qp->hp.m_curRate / max_c + m_rai;
+                    if (max_c >= 1 || qp->hp->m_incStage >= m_miThresh) {
+                        new_rate = qp->hp->m_curRate / max_c + m_rai;
                         new_incStage = 0;
                     } else {
-                        new_rate = qp->hp.m_curRate + m_rai;
-                        new_incStage = qp->hp.m_incStage + 1;
+                        new_rate = qp->hp->m_curRate + m_rai;
+                        new_incStage = qp->hp->m_incStage + 1;
                     }
                     if (new_rate < m_minRate) new_rate = m_minRate;
                     if (new_rate > qp->m_max_rate) new_rate = qp->m_max_rate;
 #if PRINT_LOG
-                    if (print) printf(" u=%.6lf U=%.3lf dt=%u max_c=%.3lf", qp->hp.u, U, dt, max_c);
+                    if (print) printf(" u=%.6lf U=%.3lf dt=%u max_c=%.3lf", qp->hp->u, U, dt, max_c);
 #endif
 #if PRINT_LOG
                     if (print)
-                        printf(" rate:%.3lf->%.3lf\n", qp->hp.m_curRate.GetBitRate() * 1e-9,
+                        printf(" rate:%.3lf->%.3lf\n", qp->hp->m_curRate.GetBitRate() * 1e-9,
                                new_rate.GetBitRate() * 1e-9);
 #endif
                 }
@@ -1163,13 +1245,13 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
                 new_rate = qp->m_max_rate;
                 for (uint32_t i = 0; i < ih.nhop; i++) {
                     if (updated[i]) {
-                        double c = qp->hp.hopState[i].u / m_targetUtil;
-                        if (c >= 1 || qp->hp.hopState[i].incStage >= m_miThresh) {
-                            new_rate_per_hop[i] = qp->hp.hopState[i].Rc / c + m_rai;
+                        double c = qp->hp->hopState[i].u / m_targetUtil;
+                        if (c >= 1 || qp->hp->hopState[i].incStage >= m_miThresh) {
+                            new_rate_per_hop[i] = qp->hp->hopState[i].Rc / c + m_rai;
                             new_incStage_per_hop[i] = 0;
                         } else {
-                            new_rate_per_hop[i] = qp->hp.hopState[i].Rc + m_rai;
-                            new_incStage_per_hop[i] = qp->hp.hopState[i].incStage + 1;
+                            new_rate_per_hop[i] = qp->hp->hopState[i].Rc + m_rai;
+                            new_incStage_per_hop[i] = qp->hp->hopState[i].incStage + 1;
                         }
                         // bound rate
                         if (new_rate_per_hop[i] < m_minRate) new_rate_per_hop[i] = m_minRate;
@@ -1178,15 +1260,15 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
                         // find min new_rate
                         if (new_rate_per_hop[i] < new_rate) new_rate = new_rate_per_hop[i];
 #if PRINT_LOG
-                        if (print) printf(" [%u]u=%.6lf c=%.3lf", i, qp->hp.hopState[i].u, c);
+                        if (print) printf(" [%u]u=%.6lf c=%.3lf", i, qp->hp->hopState[i].u, c);
 #endif
 #if PRINT_LOG
                         if (print)
-                            printf(" %.3lf->%.3lf", qp->hp.hopState[i].Rc.GetBitRate() * 1e-9,
+                            printf(" %.3lf->%.3lf", qp->hp->hopState[i].Rc.GetBitRate() * 1e-9,
                                    new_rate.GetBitRate() * 1e-9);
 #endif
                     } else {
-                        if (qp->hp.hopState[i].Rc < new_rate) new_rate = qp->hp.hopState[i].Rc;
+                        if (qp->hp->hopState[i].Rc < new_rate) new_rate = qp->hp->hopState[i].Rc;
                     }
                 }
 #if PRINT_LOG
@@ -1196,23 +1278,23 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
             if (updated_any) ChangeRate(qp, new_rate);
             if (!fast_react) {
                 if (updated_any) {
-                    qp->hp.m_curRate = new_rate;
-                    qp->hp.m_incStage = new_incStage;
+                    qp->hp->m_curRate = new_rate;
+                    qp->hp->m_incStage = new_incStage;
                 }
                 if (m_multipleRate) {
                     // for per hop (per hop R)
                     for (uint32_t i = 0; i < ih.nhop; i++) {
                         if (updated[i]) {
-                            qp->hp.hopState[i].Rc = new_rate_per_hop[i];
-                            qp->hp.hopState[i].incStage = new_incStage_per_hop[i];
+                            qp->hp->hopState[i].Rc = new_rate_per_hop[i];
+                            qp->hp->hopState[i].incStage = new_incStage_per_hop[i];
                         }
                     }
                 }
             }
         }
         if (!fast_react) {
-            if (next_seq > qp->hp.m_lastUpdateSeq)
-                qp->hp.m_lastUpdateSeq = next_seq;  //+ rand() % 2 * m_mtu;
+            if (next_seq > qp->hp->m_lastUpdateSeq)
+                qp->hp->m_lastUpdateSeq = next_seq;  //+ rand() % 2 * m_mtu;
         }
     }
 }
@@ -1227,19 +1309,20 @@ void RdmaHw::FastReactHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch)
 void RdmaHw::HandleAckTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch) {
     uint32_t ack_seq = ch.ack.seq;
     // update rate
-    if (ack_seq > qp->tmly.m_lastUpdateSeq) {  // if full RTT feedback is ready, do full update
+    if (ack_seq > qp->tmly->m_lastUpdateSeq) {  // if full RTT feedback is ready, do full update
         UpdateRateTimely(qp, p, ch, false);
     } else {  // do fast react
         FastReactTimely(qp, p, ch);
     }
 }
 void RdmaHw::UpdateRateTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool us) {
+    NS_PROFILE_SCOPE("cc/timely ack");
     uint32_t next_seq = qp->snd_nxt;
     uint64_t rtt = Simulator::Now().GetTimeStep() - ch.ack.ih.ts;
     bool print = !us;
-    if (qp->tmly.m_lastUpdateSeq != 0) {  // not first RTT
-        int64_t new_rtt_diff = (int64_t)rtt - (int64_t)qp->tmly.lastRtt;
-        double rtt_diff = (1 - m_tmly_alpha) * qp->tmly.rttDiff + m_tmly_alpha * new_rtt_diff;
+    if (qp->tmly->m_lastUpdateSeq != 0) {  // not first RTT
+        int64_t new_rtt_diff = (int64_t)rtt - (int64_t)qp->tmly->lastRtt;
+        double rtt_diff = (1 - m_tmly_alpha) * qp->tmly->rttDiff + m_tmly_alpha * new_rtt_diff;
         double gradient = rtt_diff / m_tmly_minRtt;
         bool inc = false;
         double c = 0;
@@ -1247,7 +1330,7 @@ void RdmaHw::UpdateRateTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader
         if (print)
             printf("%lu node:%u rtt:%lu rttDiff:%.0lf gradient:%.3lf rate:%.3lf",
                    Simulator::Now().GetTimeStep(), m_node->GetId(), rtt, rtt_diff, gradient,
-                   qp->tmly.m_curRate.GetBitRate() * 1e-9);
+                   qp->tmly->m_curRate.GetBitRate() * 1e-9);
 #endif
         if (rtt < m_tmly_TLow) {
             inc = true;
@@ -1262,23 +1345,23 @@ void RdmaHw::UpdateRateTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader
             inc = false;
         }
         if (inc) {
-            if (qp->tmly.m_incStage < 5) {
-                qp->m_rate = qp->tmly.m_curRate + m_rai;
+            if (qp->tmly->m_incStage < 5) {
+                qp->m_rate = qp->tmly->m_curRate + m_rai;
             } else {
-                qp->m_rate = qp->tmly.m_curRate + m_rhai;
+                qp->m_rate = qp->tmly->m_curRate + m_rhai;
             }
             if (qp->m_rate > qp->m_max_rate) qp->m_rate = qp->m_max_rate;
             if (!us) {
-                qp->tmly.m_curRate = qp->m_rate;
-                qp->tmly.m_incStage++;
-                qp->tmly.rttDiff = rtt_diff;
+                qp->tmly->m_curRate = qp->m_rate;
+                qp->tmly->m_incStage++;
+                qp->tmly->rttDiff = rtt_diff;
             }
         } else {
-            qp->m_rate = std::max(m_minRate, qp->tmly.m_curRate * c);
+            qp->m_rate = std::max(m_minRate, qp->tmly->m_curRate * c);
             if (!us) {
-                qp->tmly.m_curRate = qp->m_rate;
-                qp->tmly.m_incStage = 0;
-                qp->tmly.rttDiff = rtt_diff;
+                qp->tmly->m_curRate = qp->m_rate;
+                qp->tmly->m_incStage = 0;
+                qp->tmly->rttDiff = rtt_diff;
             }
         }
 #if PRINT_LOG
@@ -1287,10 +1370,10 @@ void RdmaHw::UpdateRateTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader
         }
 #endif
     }
-    if (!us && next_seq > qp->tmly.m_lastUpdateSeq) {
-        qp->tmly.m_lastUpdateSeq = next_seq;
+    if (!us && next_seq > qp->tmly->m_lastUpdateSeq) {
+        qp->tmly->m_lastUpdateSeq = next_seq;
         // update
-        qp->tmly.lastRtt = rtt;
+        qp->tmly->lastRtt = rtt;
     }
 }
 void RdmaHw::FastReactTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch) {}
@@ -1299,30 +1382,31 @@ void RdmaHw::FastReactTimely(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader
  * DCTCP
  *********************/
 void RdmaHw::HandleAckDctcp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch) {
+    NS_PROFILE_SCOPE("cc/dctcp ack");
     uint32_t ack_seq = ch.ack.seq;
     uint8_t cnp = (ch.ack.flags >> qbbHeader::FLAG_CNP) & 1;
     bool new_batch = false;
 
     // update alpha
-    qp->dctcp.m_ecnCnt += (cnp > 0);
-    if (ack_seq > qp->dctcp.m_lastUpdateSeq) {  // if full RTT feedback is ready, do alpha update
+    qp->dctcp->m_ecnCnt += (cnp > 0);
+    if (ack_seq > qp->dctcp->m_lastUpdateSeq) {  // if full RTT feedback is ready, do alpha update
 #if PRINT_LOG
         printf("%lu %s %08x %08x %u %u [%u,%u,%u] %.3lf->", Simulator::Now().GetTimeStep(), "alpha",
-               qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport, qp->dctcp.m_lastUpdateSeq,
-               ch.ack.seq, qp->snd_nxt, qp->dctcp.m_alpha);
+               qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport, qp->dctcp->m_lastUpdateSeq,
+               ch.ack.seq, qp->snd_nxt, qp->dctcp->m_alpha);
 #endif
         new_batch = true;
-        if (qp->dctcp.m_lastUpdateSeq == 0) {  // first RTT
-            qp->dctcp.m_lastUpdateSeq = qp->snd_nxt;
-            qp->dctcp.m_batchSizeOfAlpha = qp->snd_nxt / m_mtu + 1;
+        if (qp->dctcp->m_lastUpdateSeq == 0) {  // first RTT
+            qp->dctcp->m_lastUpdateSeq = qp->snd_nxt;
+            qp->dctcp->m_batchSizeOfAlpha = qp->snd_nxt / m_mtu + 1;
         } else {
-            double frac = std::min(1.0, double(qp->dctcp.m_ecnCnt) / qp->dctcp.m_batchSizeOfAlpha);
-            qp->dctcp.m_alpha = (1 - m_g) * qp->dctcp.m_alpha + m_g * frac;
-            qp->dctcp.m_lastUpdateSeq = qp->snd_nxt;
-            qp->dctcp.m_ecnCnt = 0;
-            qp->dctcp.m_batchSizeOfAlpha = (qp->snd_nxt - ack_seq) / m_mtu + 1;
+            double frac = std::min(1.0, double(qp->dctcp->m_ecnCnt) / qp->dctcp->m_batchSizeOfAlpha);
+            qp->dctcp->m_alpha = (1 - m_g) * qp->dctcp->m_alpha + m_g * frac;
+            qp->dctcp->m_lastUpdateSeq = qp->snd_nxt;
+            qp->dctcp->m_ecnCnt = 0;
+            qp->dctcp->m_batchSizeOfAlpha = (qp->snd_nxt - ack_seq) / m_mtu + 1;
 #if PRINT_LOG
-            printf("%.3lf F:%.3lf", qp->dctcp.m_alpha, frac);
+            printf("%.3lf F:%.3lf", qp->dctcp->m_alpha, frac);
 #endif
         }
 #if PRINT_LOG
@@ -1331,26 +1415,26 @@ void RdmaHw::HandleAckDctcp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &
     }
 
     // check cwr exit
-    if (qp->dctcp.m_caState == 1) {
-        if (ack_seq > qp->dctcp.m_highSeq) qp->dctcp.m_caState = 0;
+    if (qp->dctcp->m_caState == 1) {
+        if (ack_seq > qp->dctcp->m_highSeq) qp->dctcp->m_caState = 0;
     }
 
     // check if need to reduce rate: ECN and not in CWR
-    if (cnp && qp->dctcp.m_caState == 0) {
+    if (cnp && qp->dctcp->m_caState == 0) {
 #if PRINT_LOG
         printf("%lu %s %08x %08x %u %u %.3lf->", Simulator::Now().GetTimeStep(), "rate",
                qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport, qp->m_rate.GetBitRate() * 1e-9);
 #endif
-        qp->m_rate = std::max(m_minRate, qp->m_rate * (1 - qp->dctcp.m_alpha / 2));
+        qp->m_rate = std::max(m_minRate, qp->m_rate * (1 - qp->dctcp->m_alpha / 2));
 #if PRINT_LOG
         printf("%.3lf\n", qp->m_rate.GetBitRate() * 1e-9);
 #endif
-        qp->dctcp.m_caState = 1;
-        qp->dctcp.m_highSeq = qp->snd_nxt;
+        qp->dctcp->m_caState = 1;
+        qp->dctcp->m_highSeq = qp->snd_nxt;
     }
 
     // additive inc
-    if (qp->dctcp.m_caState == 0 && new_batch)
+    if (qp->dctcp->m_caState == 0 && new_batch)
         qp->m_rate = std::min(qp->m_max_rate, qp->m_rate + m_dctcp_rai);
 }
 
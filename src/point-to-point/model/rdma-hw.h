@@ -10,16 +10,19 @@
 #include <unordered_set>
 
 #include "qbb-net-device.h"
+#include "rdma-cc.h"
 #include "rdma-queue-pair.h"
+#include "rdma-timer-wheel.h"
 
 namespace ns3 {
 
 struct RdmaInterfaceMgr {
     Ptr<QbbNetDevice> dev;
     Ptr<RdmaQueuePairGroup> qpGrp;
+    uint32_t nQp;  // number of active tx qps pinned to this nic
 
-    RdmaInterfaceMgr() : dev(NULL), qpGrp(NULL) {}
-    RdmaInterfaceMgr(Ptr<QbbNetDevice> _dev) { dev = _dev; }
+    RdmaInterfaceMgr() : dev(NULL), qpGrp(NULL), nQp(0) {}
+    RdmaInterfaceMgr(Ptr<QbbNetDevice> _dev) : nQp(0) { dev = _dev; }
 };
 
 class RdmaHw : public Object {
@@ -27,6 +30,13 @@ class RdmaHw : public Object {
     static TypeId GetTypeId(void);
     RdmaHw();
 
+    // how a new qp picks its nic among the ones routing to its destination (multi-rail hosts)
+    enum NicPlacement {
+        NIC_PLACEMENT_HASH = 0,          // 5-tuple hash (default)
+        NIC_PLACEMENT_LEAST_LOADED = 1,  // nic with the fewest active qps
+        NIC_PLACEMENT_ROUND_ROBIN = 2,
+    };
+
     Ptr<Node> m_node;
     DataRate m_minRate;  //< Min sending rate
     uint32_t m_mtu;
@@ -37,6 +47,8 @@ class RdmaHw : public Object {
     bool m_backto0;
     bool m_var_win, m_fast_react;
     bool m_rateBound;
+    uint32_t m_nicPlacement;  // NicPlacement
+    uint32_t m_nicRoundRobin;
     std::vector<RdmaInterfaceMgr> m_nic;  // list of running nic controlled by this RdmaHw
     std::unordered_map<uint64_t, Ptr<RdmaQueuePair>> m_qpMap;      // mapping from uint64_t to qp
     std::unordered_map<uint64_t, Ptr<RdmaRxQueuePair>> m_rxQpMap;  // mapping from uint64_t to rx qp
@@ -47,6 +59,8 @@ class RdmaHw : public Object {
     typedef Callback<void, Ptr<RdmaQueuePair>> QpCompleteCallback;
     QpCompleteCallback m_qpCompleteCallback;
 
+    Ptr<RdmaCongestionControl> m_cc;  // created from m_cc_mode in Setup()
+
     void SetNode(Ptr<Node> node);
     void Setup(QpCompleteCallback cb);  // setup shared data and callbacks with the QbbNetDevice
 
@@ -54,12 +68,15 @@ class RdmaHw : public Object {
     std::unordered_set<uint64_t> akashic_Qp;    // instance for each src
     std::unordered_set<uint64_t> akashic_RxQp;  // instance for each dst
     static uint64_t nAllPkts;                   // number of total packets
+    static uint64_t nQpMigrations;              // qps moved to another nic after a link change
 
     /* TxQpeueuPair */
     static uint64_t GetQpKey(uint32_t dip, uint16_t sport, uint16_t dport,
                              uint16_t pg);          // get the lookup key for m_qpMap
     Ptr<RdmaQueuePair> GetQp(uint64_t key);         // get the qp
     uint32_t GetNicIdxOfQp(Ptr<RdmaQueuePair> qp);  // get the NIC index of the qp
+    uint32_t SelectNic(Ptr<RdmaQueuePair> qp);      // pick a NIC for the qp by m_nicPlacement
+    void MigrateQp(Ptr<RdmaQueuePair> qp, uint32_t nic_idx);  // move a live qp to another NIC
     void DeleteQueuePair(Ptr<RdmaQueuePair> qp);    // delete TxQP
 
     void AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address _sip, Ipv4Address _dip,
@@ -140,12 +157,25 @@ class RdmaHw : public Object {
     void ScheduleDecreaseRateMlx(Ptr<RdmaQueuePair> q, uint32_t delta);
 
     // Mellanox's version of rate increase
+    void ScheduleRateIncMlx(Ptr<RdmaQueuePair> q);
     void RateIncEventTimerMlx(Ptr<RdmaQueuePair> q);
     void RateIncEventMlx(Ptr<RdmaQueuePair> q);
     void FastRecoveryMlx(Ptr<RdmaQueuePair> q);
     void ActiveIncreaseMlx(Ptr<RdmaQueuePair> q);
     void HyperIncreaseMlx(Ptr<RdmaQueuePair> q);
 
+    // The three timers above either run as one scheduler event per qp and timer, or, if
+    // m_mlxTimerTick is non-zero, in a timer wheel with that tick (1ns: identical timing).
+    enum MlxTimer {
+        MLX_TIMER_ALPHA = 0,
+        MLX_TIMER_DECREASE = 1,
+        MLX_TIMER_RATE_INC = 2,
+    };
+    Time m_mlxTimerTick;
+    RdmaTimerWheel m_mlxWheel;
+    void MlxTimerExpired(Ptr<RdmaQueuePair> q, uint32_t timer);
+    void CancelTimersMlx(Ptr<RdmaQueuePair> q);
+
     // Implement Timeout according to IB Spec Vol. 1 C9-139.
     // For an HCA requester using Reliable Connection service, to detect missing responses,
     // every Send queue is required to implement a Transport Timer to time outstanding requests.
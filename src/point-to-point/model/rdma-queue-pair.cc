@@ -10,6 +10,7 @@
 
 #include "ns3/ppp-header.h"
 #include "ns3/settings.h"
+#include "rdma-cc.h"
 #include "rdma-hw.h"
 
 namespace ns3 {
@@ -41,32 +42,13 @@ RdmaQueuePair::RdmaQueuePair(uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, ui
     m_var_win = false;
     m_rate = 0;
     m_nextAvail = Time(0);
-    mlx.m_alpha = 1;
-    mlx.m_alpha_cnp_arrived = false;
-    mlx.m_first_cnp = true;
-    mlx.m_decrease_cnp_arrived = false;
-    mlx.m_rpTimeStage = 0;
-    hp.m_lastUpdateSeq = 0;
-    for (uint32_t i = 0; i < sizeof(hp.keep) / sizeof(hp.keep[0]); i++) hp.keep[i] = 0;
-    hp.m_incStage = 0;
-    hp.m_lastGap = 0;
-    hp.u = 1;
-    for (uint32_t i = 0; i < IntHeader::maxHop; i++) {
-        hp.hopState[i].u = 1;
-        hp.hopState[i].incStage = 0;
-    }
-
-    tmly.m_lastUpdateSeq = 0;
-    tmly.m_incStage = 0;
-    tmly.lastRtt = 0;
-    tmly.rttDiff = 0;
-
-    dctcp.m_lastUpdateSeq = 0;
-    dctcp.m_caState = 0;
-    dctcp.m_highSeq = 0;
-    dctcp.m_alpha = 1;
-    dctcp.m_ecnCnt = 0;
-    dctcp.m_batchSizeOfAlpha = 0;
+    m_nicIdx = (uint32_t)-1;
+    mlx = NULL;
+    hp = NULL;
+    tmly = NULL;
+    dctcp = NULL;
+    m_ccPriv = NULL;
+    m_ccPrivFree = NULL;
 
     irn.m_enabled = false;
     irn.m_highest_ack = 0;
@@ -76,6 +58,15 @@ RdmaQueuePair::RdmaQueuePair(uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, ui
     m_timeout = MilliSeconds(4);
 }
 
+RdmaQueuePair::~RdmaQueuePair() {
+    // pending CC timers hold a Ptr to this qp, so no one can reach the state any more
+    if (mlx) RdmaCcStatePool<RdmaMlxState>::Get().Free(mlx);
+    if (hp) RdmaCcStatePool<RdmaHpState>::Get().Free(hp);
+    if (tmly) RdmaCcStatePool<RdmaTimelyState>::Get().Free(tmly);
+    if (dctcp) RdmaCcStatePool<RdmaDctcpState>::Get().Free(dctcp);
+    if (m_ccPriv && m_ccPrivFree) m_ccPrivFree(m_ccPriv);
+}
+
 void RdmaQueuePair::SetSize(uint64_t size) { m_size = size; }
 
 void RdmaQueuePair::SetWin(uint32_t win) { m_win = win; }
@@ -152,7 +143,7 @@ uint64_t RdmaQueuePair::HpGetCurWin() {
     if (m_win == 0) return 0;
     uint64_t w;
     if (m_var_win) {
-        w = m_win * hp.m_curRate.GetBitRate() / m_max_rate.GetBitRate();
+        w = m_win * hp->m_curRate.GetBitRate() / m_max_rate.GetBitRate();
         if (w == 0) w = 1;  // must > 0
     } else {
         w = m_win;
@@ -9,6 +9,7 @@
 #include <ns3/object.h>
 #include <ns3/packet.h>
 #include <ns3/selective-packet-queue.h>
+#include <ns3/simulation-arena.h>
 
 #include <climits> /* for CHAR_BIT */
 #include <vector>
@@ -51,8 +52,88 @@ class IrnSackManager {
     friend std::ostream &operator<<(std::ostream &os, const IrnSackManager &im);
 };
 
+/**
+ * Per-QP state of the congestion control algorithms. A QP only carries the state of the
+ * algorithm that is running (see RdmaCongestionControl); it is taken from a per-algorithm
+ * pool so that QP churn does not hit the allocator.
+ */
+struct RdmaMlxState {  // Mellanox's version of DCQCN
+    DataRate m_targetRate;  //< Target rate
+    EventId m_eventUpdateAlpha;
+    double m_alpha;
+    bool m_alpha_cnp_arrived;  // indicate if CNP arrived in the last slot
+    bool m_first_cnp;          // indicate if the current CNP is the first CNP
+    EventId m_eventDecreaseRate;
+    bool m_decrease_cnp_arrived;  // indicate if CNP arrived in the last slot
+    uint32_t m_rpTimeStage;
+    EventId m_rpTimer;
+    uint32_t m_timerStamp[3];  // live timers in RdmaHw's timer wheel, by RdmaHw::MlxTimer
+
+    RdmaMlxState()
+        : m_alpha(1),
+          m_alpha_cnp_arrived(false),
+          m_first_cnp(true),
+          m_decrease_cnp_arrived(false),
+          m_rpTimeStage(0) {
+        m_timerStamp[0] = m_timerStamp[1] = m_timerStamp[2] = 0;
+    }
+};
+
+struct RdmaHpState {  // HPCC
+    uint32_t m_lastUpdateSeq;
+    DataRate m_curRate;
+    IntHop hop[IntHeader::maxHop];
+    uint32_t keep[IntHeader::maxHop];
+    uint32_t m_incStage;
+    double m_lastGap;
+    double u;
+    struct {
+        double u;
+        DataRate Rc;
+        uint32_t incStage;
+    } hopState[IntHeader::maxHop];
+
+    RdmaHpState() : m_lastUpdateSeq(0), m_incStage(0), m_lastGap(0), u(1) {
+        for (uint32_t i = 0; i < IntHeader::maxHop; i++) {
+            hop[i] = IntHop();
+            keep[i] = 0;
+            hopState[i].u = 1;
+            hopState[i].incStage = 0;
+        }
+    }
+};
+
+struct RdmaTimelyState {  // TIMELY
+    uint32_t m_lastUpdateSeq;
+    DataRate m_curRate;
+    uint32_t m_incStage;
+    uint64_t lastRtt;
+    double rttDiff;
+
+    RdmaTimelyState() : m_lastUpdateSeq(0), m_incStage(0), lastRtt(0), rttDiff(0) {}
+};
+
+struct RdmaDctcpState {  // DCTCP
+    uint32_t m_lastUpdateSeq;
+    uint32_t m_caState;
+    uint32_t m_highSeq;  // when to exit cwr
+    double m_alpha;
+    uint32_t m_ecnCnt;
+    uint32_t m_batchSizeOfAlpha;
+
+    RdmaDctcpState()
+        : m_lastUpdateSeq(0),
+          m_caState(0),
+          m_highSeq(0),
+          m_alpha(1),
+          m_ecnCnt(0),
+          m_batchSizeOfAlpha(0) {}
+};
+
 class RdmaQueuePair : public Object {
    public:
+    NS_SLAB_POOLED(RdmaQueuePair);
+
     Time startTime;
     Ipv4Address sip, dip;
     uint16_t sport, dport;
@@ -69,51 +150,19 @@ class RdmaQueuePair : public Object {
     uint32_t lastPktSize;
     int32_t m_flow_id;
     Time m_timeout;
+    uint32_t m_nicIdx;  // NIC (rail) this qp is pinned to, chosen by RdmaHw
 
     /******************************
      * runtime states
      *****************************/
     DataRate m_rate;  //< Current rate
-    struct {
-        DataRate m_targetRate;  //< Target rate
-        EventId m_eventUpdateAlpha;
-        double m_alpha;
-        bool m_alpha_cnp_arrived;  // indicate if CNP arrived in the last slot
-        bool m_first_cnp;          // indicate if the current CNP is the first CNP
-        EventId m_eventDecreaseRate;
-        bool m_decrease_cnp_arrived;  // indicate if CNP arrived in the last slot
-        uint32_t m_rpTimeStage;
-        EventId m_rpTimer;
-    } mlx;
-    struct {
-        uint32_t m_lastUpdateSeq;
-        DataRate m_curRate;
-        IntHop hop[IntHeader::maxHop];
-        uint32_t keep[IntHeader::maxHop];
-        uint32_t m_incStage;
-        double m_lastGap;
-        double u;
-        struct {
-            double u;
-            DataRate Rc;
-            uint32_t incStage;
-        } hopState[IntHeader::maxHop];
-    } hp;
-    struct {
-        uint32_t m_lastUpdateSeq;
-        DataRate m_curRate;
-        uint32_t m_incStage;
-        uint64_t lastRtt;
-        double rttDiff;
-    } tmly;
-    struct {
-        uint32_t m_lastUpdateSeq;
-        uint32_t m_caState;
-        uint32_t m_highSeq;  // when to exit cwr
-        double m_alpha;
-        uint32_t m_ecnCnt;
-        uint32_t m_batchSizeOfAlpha;
-    } dctcp;
+    // per-algorithm state, allocated by the running RdmaCongestionControl only (NULL otherwise)
+    RdmaMlxState *mlx;
+    RdmaHpState *hp;
+    RdmaTimelyState *tmly;
+    RdmaDctcpState *dctcp;
+    void *m_ccPriv;                       // state of an out-of-tree algorithm
+    void (*m_ccPrivFree)(void *);         // releases m_ccPriv when the qp is destroyed
 
     struct {
         bool m_enabled;
@@ -130,6 +179,10 @@ class RdmaQueuePair : public Object {
     struct {
         uint64_t txTotalPkts{0};
         uint64_t txTotalBytes{0};
+        // time the qp had data to send but its priority was PFC-paused; charged to
+        // acc_pause_time of the flow when the qp completes
+        int64_t pfcBlockedSince{-1};  // timestep, -1 if not blocked
+        int64_t pfcBlockedTime{0};
     } stat;
 
     // Implement Timeout according to IB Spec Vol. 1 C9-139.
@@ -143,6 +196,7 @@ class RdmaQueuePair : public Object {
     static TypeId GetTypeId(void);
     RdmaQueuePair(uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, uint16_t _sport,
                   uint16_t _dport);
+    ~RdmaQueuePair();
     void SetSize(uint64_t size);
     void SetWin(uint32_t win);
     void SetBaseRtt(uint64_t baseRtt);
@@ -188,6 +242,8 @@ class RdmaQueuePair : public Object {
 
 class RdmaRxQueuePair : public Object {  // Rx side queue pair
    public:
+    NS_SLAB_POOLED(RdmaRxQueuePair);
+
     struct ECNAccount {
         uint16_t qIndex;
         uint8_t ecnbits;
@@ -0,0 +1,79 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/rdma-timer-wheel.h"
+
+#include "ns3/assert.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+RdmaTimerWheel::RdmaTimerWheel()
+    : m_tickSteps(1), m_tick(TimeStep(1)), m_nFired(0), m_nEvents(0) {}
+
+RdmaTimerWheel::~RdmaTimerWheel() {}
+
+void RdmaTimerWheel::SetTick(Time tick) {
+    NS_ASSERT_MSG(m_buckets.empty(), "RdmaTimerWheel: tick changed with timers armed");
+    NS_ASSERT_MSG(tick.GetTimeStep() > 0, "RdmaTimerWheel: tick must be positive");
+    m_tick = tick;
+    m_tickSteps = tick.GetTimeStep();
+}
+
+void RdmaTimerWheel::Schedule(Time delay, Ptr<RdmaQueuePair> qp, uint32_t kind,
+                              const uint32_t *stamp) {
+    uint64_t now = Simulator::Now().GetTimeStep();
+    uint64_t tick = (now + delay.GetTimeStep() + m_tickSteps - 1) / m_tickSteps;
+    std::map<uint64_t, Bucket>::iterator it = m_buckets.find(tick);
+    if (it == m_buckets.end()) {
+        it = m_buckets.insert(std::make_pair(tick, Bucket())).first;
+        if (!m_spare.empty()) {
+            it->second.swap(m_spare.back());
+            m_spare.pop_back();
+        }
+        Simulator::Schedule(TimeStep(tick * m_tickSteps - now), &RdmaTimerWheel::Expire, this,
+                            tick);
+        m_nEvents++;
+    }
+    Entry e;
+    e.qp = qp;
+    e.stamp = stamp;
+    e.armed = *stamp;
+    e.kind = kind;
+    it->second.push_back(e);
+}
+
+void RdmaTimerWheel::Expire(uint64_t tick) {
+    std::map<uint64_t, Bucket>::iterator it = m_buckets.find(tick);
+    NS_ASSERT(it != m_buckets.end());
+    // handlers re-arm into later ticks, so the bucket can be taken out before the walk
+    m_expiring.swap(it->second);
+    m_spare.push_back(Bucket());
+    m_spare.back().swap(it->second);
+    m_buckets.erase(it);
+
+    for (size_t i = 0; i < m_expiring.size(); i++) {
+        Entry &e = m_expiring[i];
+        if (*e.stamp != e.armed) continue;  // cancelled
+        m_nFired++;
+        m_handler(e.qp, e.kind);
+    }
+    m_expiring.clear();
+}
+
+}  // namespace ns3
@@ -0,0 +1,87 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __RDMA_TIMER_WHEEL_H__
+#define __RDMA_TIMER_WHEEL_H__
+
+#include <map>
+#include <vector>
+
+#include "ns3/callback.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "rdma-queue-pair.h"
+
+namespace ns3 {
+
+/**
+ * @brief Per-NIC timer wheel for per-QP congestion control timers.
+ *
+ * Timers are kept in buckets of one tick each. All QPs whose timer expires in the same
+ * tick are handled by a single scheduler event that walks the bucket in arming order,
+ * instead of one scheduler event per QP and timer.
+ *
+ * An expiry time is rounded up to the next multiple of the tick. With a tick of 1ns
+ * every timer fires at exactly the time the per-QP event would have, in the same
+ * order among timers.
+ *
+ * Cancellation is lazy: each timer of a QP has a stamp owned by the QP state. Arming
+ * records the current stamp; Cancel() bumps it, so entries armed before are skipped.
+ */
+class RdmaTimerWheel {
+   public:
+    // (qp, timer kind) of an expired timer
+    typedef Callback<void, Ptr<RdmaQueuePair>, uint32_t> Handler;
+
+    RdmaTimerWheel();
+    ~RdmaTimerWheel();
+
+    void SetTick(Time tick);
+    Time GetTick() const { return m_tick; }
+    void SetHandler(Handler handler) { m_handler = handler; }
+
+    // arm timer `kind` of qp to expire after delay; `stamp` identifies the live timer
+    void Schedule(Time delay, Ptr<RdmaQueuePair> qp, uint32_t kind, const uint32_t *stamp);
+    static void Cancel(uint32_t *stamp) { (*stamp)++; }
+
+    uint64_t GetNFired() const { return m_nFired; }    // timers handled
+    uint64_t GetNEvents() const { return m_nEvents; }  // scheduler events used for them
+
+   private:
+    struct Entry {
+        Ptr<RdmaQueuePair> qp;
+        const uint32_t *stamp;
+        uint32_t armed;  // *stamp when armed
+        uint32_t kind;
+    };
+    typedef std::vector<Entry> Bucket;
+
+    void Expire(uint64_t tick);
+
+    uint64_t m_tickSteps;
+    Time m_tick;
+    Handler m_handler;
+    std::map<uint64_t, Bucket> m_buckets;  // tick index -> timers expiring in it
+    Bucket m_expiring;                     // bucket being walked, its storage is reused
+    std::vector<Bucket> m_spare;           // emptied buckets kept for their capacity
+    uint64_t m_nFired, m_nEvents;
+};
+
+}  // namespace ns3
+
+#endif /* __RDMA_TIMER_WHEEL_H__ */
@@ -1,19 +1,26 @@
 #include "ns3/settings.h"
 
+#include "ns3/assert.h"
+
 namespace ns3 {
 /* helper function */
 Ipv4Address Settings::node_id_to_ip(uint32_t id) {
     return Ipv4Address(0x0b000001 + ((id / 256) * 0x00010000) + ((id % 256) * 0x00000100));
 }
 uint32_t Settings::ip_to_node_id(Ipv4Address ip) {
-    return (ip.Get() >> 8) & 0xffff;
+    uint32_t id = HostIdOfIp(ip.Get());  // hosts with other addressing, see BuildHostIndex
+    return id != INVALID_ID ? id : (ip.Get() >> 8) & 0xffff;
 }
 
 /* others */
 uint32_t Settings::lb_mode = 0;
 
-std::map<uint32_t, uint32_t> Settings::hostIp2IdMap;
-std::map<uint32_t, uint32_t> Settings::hostId2IpMap;
+std::vector<uint32_t> Settings::hostId2Ip;
+std::vector<uint32_t> Settings::hostId2ToRId;
+bool Settings::hostIpDirect = true;
+std::vector<uint32_t> Settings::hostIpHash(1, Settings::INVALID_ID);
+uint32_t Settings::hostIpHashMul = 0;
+uint32_t Settings::hostIpHashShift = 31;
 
 /* statistics */
 uint32_t Settings::node_num = 0;
@@ -25,7 +32,58 @@ uint32_t Settings::packet_payload = 1000;
 uint32_t Settings::dropped_pkt_sw_ingress = 0;
 uint32_t Settings::dropped_pkt_sw_egress = 0;
 
-/* for load balancer */
-std::map<uint32_t, uint32_t> Settings::hostIp2SwitchId;
+/* host index */
+const uint32_t Settings::INVALID_ID;
+
+void Settings::AddHost(uint32_t hostId, uint32_t ip) {
+    if (hostId >= hostId2Ip.size()) {
+        hostId2Ip.resize(hostId + 1, 0);
+        hostId2ToRId.resize(hostId + 1, INVALID_ID);
+    }
+    hostId2Ip[hostId] = ip;
+}
+
+void Settings::BuildHostIndex() {
+    std::vector<uint32_t> ips, ids;
+    hostIpDirect = true;
+    for (uint32_t id = 0; id < hostId2Ip.size(); id++) {
+        if (hostId2Ip[id] == 0) continue;
+        ips.push_back(hostId2Ip[id]);
+        ids.push_back(id);
+        if (((hostId2Ip[id] >> 8) & 0xffff) != id) hostIpDirect = false;
+    }
+    if (hostIpDirect) return;
+
+    // look for a multiplier that maps every host IP to its own slot, growing the table
+    // (from 2x the number of hosts) when none is found within a few tries
+    uint32_t bits = 1;
+    while ((1u << bits) < 2 * ips.size()) bits++;
+    uint32_t mul = 0x9e3779b1;
+    for (;; bits++) {
+        NS_ASSERT_MSG(bits < 32, "Settings::BuildHostIndex: cannot hash host IPs");
+        for (uint32_t attempt = 0; attempt < 64; attempt++) {
+            mul = mul * 1664525 + 1013904223;
+            mul |= 1;
+            hostIpHash.assign(1u << bits, INVALID_ID);
+            bool collision = false;
+            for (uint32_t k = 0; k < ips.size() && !collision; k++) {
+                uint32_t &slot = hostIpHash[(ips[k] * mul) >> (32 - bits)];
+                if (slot != INVALID_ID) collision = true;
+                slot = ids[k];
+            }
+            if (!collision) {
+                hostIpHashMul = mul;
+                hostIpHashShift = 32 - bits;
+                return;
+            }
+        }
+    }
+}
+
+void Settings::SetHostToR(uint32_t ip, uint32_t torId) {
+    uint32_t id = HostIdOfIp(ip);
+    NS_ASSERT_MSG(id != INVALID_ID, "Settings::SetHostToR: unknown host IP (BuildHostIndex?)");
+    hostId2ToRId[id] = torId;
+}
 
 }  // namespace ns3
@@ -28,6 +28,7 @@
 #include "ns3/object.h"
 #include "ns3/packet.h"
 #include "ns3/ptr.h"
+#include "ns3/simulation-arena.h"
 #include "ns3/string.h"
 #include "ns3/tag.h"
 #include "ns3/uinteger.h"
@@ -37,15 +38,15 @@ namespace ns3 {
 #define SLB_DEBUG (false)
 
 #define PARSE_FIVE_TUPLE(ch)                                                    \
-    DEPARSE_FIVE_TUPLE(std::to_string(Settings::hostIp2IdMap[ch.sip]),          \
+    DEPARSE_FIVE_TUPLE(std::to_string(Settings::HostIdOfIp(ch.sip)),          \
                        std::to_string(ch.udp.sport),                            \
-                       std::to_string(Settings::hostIp2IdMap[ch.dip]),          \
+                       std::to_string(Settings::HostIdOfIp(ch.dip)),          \
                        std::to_string(ch.udp.dport), std::to_string(ch.l3Prot), \
                        std::to_string(ch.udp.seq), std::to_string(ch.GetIpv4EcnBits()))
 #define PARSE_REVERSE_FIVE_TUPLE(ch)                                            \
-    DEPARSE_FIVE_TUPLE(std::to_string(Settings::hostIp2IdMap[ch.dip]),          \
+    DEPARSE_FIVE_TUPLE(std::to_string(Settings::HostIdOfIp(ch.dip)),          \
                        std::to_string(ch.udp.dport),                            \
-                       std::to_string(Settings::hostIp2IdMap[ch.sip]),          \
+                       std::to_string(Settings::HostIdOfIp(ch.sip)),          \
                        std::to_string(ch.udp.sport), std::to_string(ch.l3Prot), \
                        std::to_string(ch.udp.seq), std::to_string(ch.GetIpv4EcnBits()))
 #define DEPARSE_FIVE_TUPLE(sip, sport, dip, dport, protocol, seq, ecn)                        \
@@ -69,6 +70,8 @@ struct Flowlet {
     Time _activatedTime;  // start time of new flowlet
     uint32_t _PathId;     // current pathId
     uint32_t _nPackets;   // for debugging
+
+    NS_SLAB_POOLED(Flowlet);
 };
 
 /**
@@ -130,10 +133,37 @@ class Settings {
     static uint32_t switch_num;
     static uint64_t cnt_finished_flows;  // number of finished flows (in qp_finish())
 
-    /* The map between hosts' IP and ID, initial when build topology */
-    static std::map<uint32_t, uint32_t> hostIp2IdMap;
-    static std::map<uint32_t, uint32_t> hostId2IpMap;
-    static std::map<uint32_t, uint32_t> hostIp2SwitchId;  // host's IP -> connected Switch's Id
+    /**
+     * Dense host index: host IP -> host ID -> IP / connected ToR's ID, built once with the
+     * topology (AddHost for every host, then BuildHostIndex, then SetHostToR).
+     * Hosts addressed by node_id_to_ip() are resolved by arithmetic; any other addressing goes
+     * through a collision-free multiplicative hash over the host IPs. Lookups of unknown IPs
+     * return INVALID_ID.
+     */
+    static const uint32_t INVALID_ID = 0xffffffff;
+    static void AddHost(uint32_t hostId, uint32_t ip);
+    static void BuildHostIndex();
+    static void SetHostToR(uint32_t ip, uint32_t torId);
+
+    static inline uint32_t HostIdOfIp(uint32_t ip) {
+        uint32_t id = hostIpDirect ? (ip >> 8) & 0xffff
+                                   : hostIpHash[(ip * hostIpHashMul) >> hostIpHashShift];
+        if (id >= hostId2Ip.size() || hostId2Ip[id] != ip) return INVALID_ID;
+        return id;
+    }
+    static inline uint32_t IpOfHost(uint32_t hostId) {
+        return hostId < hostId2Ip.size() ? hostId2Ip[hostId] : 0;
+    }
+    static inline uint32_t ToROfIp(uint32_t ip) {  // host's IP -> connected Switch's Id
+        uint32_t id = HostIdOfIp(ip);
+        return id == INVALID_ID ? INVALID_ID : hostId2ToRId[id];
+    }
+
+    static std::vector<uint32_t> hostId2Ip;     // indexed by host ID, 0 if not a host
+    static std::vector<uint32_t> hostId2ToRId;  // indexed by host ID
+    static bool hostIpDirect;                   // all hosts follow node_id_to_ip()
+    static std::vector<uint32_t> hostIpHash;    // hash slot -> host ID, otherwise
+    static uint32_t hostIpHashMul, hostIpHashShift;
 
     static uint32_t dropped_pkt_sw_ingress;
     static uint32_t dropped_pkt_sw_egress;
@@ -1,5 +1,6 @@
 #include "switch-mmu.h"
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
@@ -47,7 +48,13 @@ TypeId SwitchMmu::GetTypeId(void) {
                 "PGHeadroomLimit", "Headroom Limit per PG",
                 UintegerValue(12500 + 2 * MTU),  // 2*(LinkDelay*Bandwidth+MTU) 2*1us*450Gbps+2*MTU
                 MakeUintegerAccessor(&SwitchMmu::SetPgHdrmLimit, &SwitchMmu::GetPgHdrmLimit),
-                MakeUintegerChecker<uint32_t>());
+                MakeUintegerChecker<uint32_t>())
+            .AddAttribute("CellSize",
+                          "Size of a buffer cell in bytes, the unit of buffer accounting (1: exact "
+                          "byte accounting)",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&SwitchMmu::SetCellSize, &SwitchMmu::GetCellSize),
+                          MakeUintegerChecker<uint32_t>(1));
     return tid;
 }
 SwitchMmu::SwitchMmu(void) {
@@ -55,73 +62,104 @@ SwitchMmu::SwitchMmu(void) {
     // 12-port switch: 12 * 375kB = 4.5MB
     // 32-port switch: 32 * 375kB = 12MB
     // m_maxBufferBytes = 4500 * 1000; //Originally: 9MB Current:4.5MB
+    // a member, not made by CreateObject, so its attributes are not initialised: without
+    // this the ECN draws flip to 1 - u whenever the MMU lands on reused heap memory
+    m_uniform_random_var.SetAntithetic(false);
     m_uniform_random_var.SetStream(0);
 
     // dynamic threshold
     m_dynamicth = false;
+    m_PFCenabled = false;
+    for (uint32_t i = 0; i < DROP_REASON_COUNT; i++) m_drops[i] = 0;
 
     InitSwitch();
 }
 
+void SwitchMmu::EnsurePorts(uint32_t n) {
+    if (n <= m_port.size()) return;
+    uint32_t old = m_port.size();
+    m_port.resize(n);
+    for (uint32_t i = old; i < n; i++) {
+        PortState &ps = m_port[i];
+        memset(&ps, 0, sizeof(ps));
+        ps.pgHdrmLimitBytes = m_defaultPgHdrmLimit;
+        ps.pgHdrmLimit = Cells(m_defaultPgHdrmLimit);
+    }
+    kmin.resize(n, 0);
+    kmax.resize(n, 0);
+    pmax.resize(n, 0);
+    std::array<uint32_t, qCnt> zero;
+    zero.fill(0);
+    std::array<bool, qCnt> no;
+    no.fill(false);
+    paused.resize(n, zero);
+    resumeEvt.resize(n);
+    m_pause_remote.resize(n, no);
+    egress_bytes.resize(n, zero);
+}
+
 void SwitchMmu::InitSwitch(void) {
+    EnsurePorts(m_activePortCnt + 1);  // port 0 is not used
     m_maxBufferBytes = m_staticMaxBufferBytes ? m_staticMaxBufferBytes
                                               : (m_maxBufferBytesPerPort * m_activePortCnt);
-    m_usedTotalBytes = 0;
+    m_maxBufferCells = Cells(m_maxBufferBytes);
+    m_usedTotalCells = 0;
 
     if (m_dynamicth) {
-        m_pg_shared_limit_cell = m_maxBufferBytes;  // using dynamic threshold, we don't respect the
+        m_pg_shared_limit_cell = m_maxBufferCells;  // using dynamic threshold, we don't respect the
                                                     // static thresholds anymore
-        m_port_max_shared_cell = m_maxBufferBytes;
+        m_port_max_shared_cell = m_maxBufferCells;
     } else {
-        m_pg_shared_limit_cell = 20 * MTU;    // max buffer for an ingress pg
-        m_port_max_shared_cell = 4800 * MTU;  // max buffer for an ingress port
+        m_pg_shared_limit_cell = Cells(20 * MTU);    // max buffer for an ingress pg
+        m_port_max_shared_cell = Cells(4800 * MTU);  // max buffer for an ingress port
     }
 
-    for (uint32_t i = 0; i < pCnt; i++)  // port 0 is not used
-    {
-        m_usedIngressPortBytes[i] = 0;
-        m_usedEgressPortBytes[i] = 0;
+    for (uint32_t i = 0; i < m_port.size(); i++) {
+        PortState &ps = m_port[i];
+        ps.ingressPort = 0;
+        ps.egressPort = 0;
+        ps.pgAboveMin = 0;
         for (uint32_t j = 0; j < qCnt; j++) {
-            m_usedIngressPGBytes[i][j] = 0;
-            m_usedIngressPGHeadroomBytes[i][j] = 0;
-            m_usedEgressQMinBytes[i][j] = 0;
-            m_usedEgressQSharedBytes[i][j] = 0;
+            ps.ingressPG[j] = 0;
+            ps.ingressPGHeadroom[j] = 0;
+            ps.egressQMin[j] = 0;
+            ps.egressQShared[j] = 0;
         }
     }
     for (int i = 0; i < 4; i++) {
-        m_usedIngressSPBytes[i] = 0;
-        m_usedEgressSPBytes[i] = 0;
+        m_usedIngressSPCells[i] = 0;
+        m_usedEgressSPCells[i] = 0;
     }
     // ingress params
-    m_buffer_cell_limit_sp = 4000 * MTU;  // ingress sp buffer threshold
+    m_buffer_cell_limit_sp = Cells(4000 * MTU);  // ingress sp buffer threshold
     // m_buffer_cell_limit_sp_shared=4000*MTU; //ingress sp buffer shared threshold, nonshare ->
     // share
-    m_pg_min_cell = MTU;    // ingress pg guarantee
-    m_port_min_cell = MTU;  // ingress port guarantee
+    m_pg_min_cell = Cells(MTU);    // ingress pg guarantee
+    m_port_min_cell = Cells(MTU);  // ingress port guarantee
     // m_pg_hdrm_limit = 103000; //2*10us*40Gbps+2*1.5kB //106 * MTU; //ingress pg headroom // set
     // dynamically
-    m_port_max_pkt_size = 100 * MTU;  // ingress global headroom
+    m_port_max_pkt_size = Cells(100 * MTU);  // ingress global headroom
     uint32_t total_m_pg_hdrm_limit = 0;
-    for (int i = 0; i < m_activePortCnt; i++) total_m_pg_hdrm_limit += m_pg_hdrm_limit[i];
+    for (uint32_t i = 0; i < m_activePortCnt; i++) total_m_pg_hdrm_limit += m_port[i].pgHdrmLimit;
     m_buffer_cell_limit_sp =
-        m_maxBufferBytes - total_m_pg_hdrm_limit -
+        m_maxBufferCells - total_m_pg_hdrm_limit -
         (m_activePortCnt)*std::max(qCnt * m_pg_min_cell,
                                    m_port_min_cell);  // 12000 * MTU; //ingress sp buffer threshold
     // still needs reset limits..
-    m_port_min_cell_off = 4700 * MTU;
-    m_pg_shared_limit_cell_off = m_pg_shared_limit_cell - 2 * MTU;
+    m_port_min_cell_off = Cells(4700 * MTU);
+    m_pg_shared_limit_cell_off = m_pg_shared_limit_cell - Cells(2 * MTU);
 
     // egress params
     m_op_buffer_shared_limit_cell =
-        m_maxBufferBytes -
+        m_maxBufferCells -
         (m_activePortCnt)*std::max(
             qCnt * m_pg_min_cell,
             m_port_min_cell);  // m_maxBufferBytes; //per egress sp limit, //maxBufferBytes(375KB *
                                // activePortNumber) - activePortNumber * (MTU * 8) ~ 367KB *
                                // activePortNumber
-    m_op_uc_port_config_cell = m_maxBufferBytes;  // per egress port limit
-    m_q_min_cell = 1 + MTU;
-    m_op_uc_port_config1_cell = m_maxBufferBytes;
+    m_op_uc_port_config_cell = m_maxBufferCells;  // per egress port limit
+    m_q_min_cell = Cells(1 + MTU);
+    m_op_uc_port_config1_cell = m_maxBufferCells;
 
     m_port_shared_alpha_cell = 128;  // not used for now. not sure whether this is used on switches
     m_pg_shared_alpha_cell_off_diff = 16;
@@ -133,27 +171,26 @@ void SwitchMmu::InitSwitch(void) {
 
 bool SwitchMmu::CheckIngressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize) {
     NS_ASSERT(m_pg_shared_alpha_cell > 0);
+    const PortState &ps = m_port[port];
+    uint32_t cells = Cells(psize);
 
-    if (m_usedTotalBytes + psize > m_maxBufferBytes)  // buffer full, usually should not reach here.
+    if (m_usedTotalCells + cells > m_maxBufferCells)  // buffer full, usually should not reach here.
     {
-        std::cerr << "WARNING: Drop because ingress buffer full\n";
+        NS_LOG_WARN("Drop because ingress buffer full");
+        m_drops[DROP_INGRESS_BUFFER_FULL]++;
         return false;
     }
-    if (m_usedIngressPGBytes[port][qIndex] + psize > m_pg_min_cell &&
-        m_usedIngressPortBytes[port] + psize >
-            m_port_min_cell)  // exceed guaranteed, use share buffer
+    if (ps.ingressPG[qIndex] + cells > m_pg_min_cell &&
+        ps.ingressPort + cells > m_port_min_cell)  // exceed guaranteed, use share buffer
     {
-        if (m_usedIngressSPBytes[GetIngressSP(port, qIndex)] >
+        if (m_usedIngressSPCells[GetIngressSP(port, qIndex)] >
             m_buffer_cell_limit_sp)  // check if headroom is already being used
         {
-            if (m_usedIngressPGHeadroomBytes[port][qIndex] + psize >
-                m_pg_hdrm_limit[port])  // exceed headroom space
+            if (ps.ingressPGHeadroom[qIndex] + cells > ps.pgHdrmLimit)  // exceed headroom space
             {
-                if (m_PFCenabled) {
-                    std::cerr << "WARNING: Drop because ingress headroom full:"
-                              << m_usedIngressPGHeadroomBytes[port][qIndex] << "\t"
-                              << m_pg_hdrm_limit << "\n";
-                }
+                NS_LOG_WARN("Drop because ingress headroom full:" << ps.ingressPGHeadroom[qIndex]
+                                                                  << "\t" << ps.pgHdrmLimit);
+                m_drops[DROP_INGRESS_HEADROOM_FULL]++;
                 return false;
             }
         }
@@ -163,65 +200,64 @@ bool SwitchMmu::CheckIngressAdmission(uint32_t port, uint32_t qIndex, uint32_t p
 
 bool SwitchMmu::CheckEgressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize) {
     NS_ASSERT(m_pg_shared_alpha_cell_egress > 0);
+    const PortState &ps = m_port[port];
+    uint32_t cells = Cells(psize);
+    uint32_t usedSP = m_usedEgressSPCells[GetEgressSP(port, qIndex)];
 
     // PFC OFF Nothing
-    bool threshold = true;
-    if (m_usedEgressSPBytes[GetEgressSP(port, qIndex)] + psize >
-        m_op_buffer_shared_limit_cell)  // exceed the sp limit
+    if (usedSP + cells > m_op_buffer_shared_limit_cell)  // exceed the sp limit
     {
-        std::cerr << "WARNING: Drop because egress SP buffer full (exceed the sp limit), "
-                  << Simulator::Now() << std::endl;
+        NS_LOG_WARN("Drop because egress SP buffer full (exceed the sp limit), "
+                    << Simulator::Now());
+        m_drops[DROP_EGRESS_SP_LIMIT]++;
         return false;
     }
-    if (m_usedEgressPortBytes[port] + psize > m_op_uc_port_config_cell)  // exceed the port limit
+    if (ps.egressPort + cells > m_op_uc_port_config_cell)  // exceed the port limit
     {
-        std::cerr << "WARNING: Drop because egress Port buffer full (exceed the port limit), "
-                  << Simulator::Now() << std::endl;
+        NS_LOG_WARN("Drop because egress Port buffer full (exceed the port limit), "
+                    << Simulator::Now());
+        m_drops[DROP_EGRESS_PORT_LIMIT]++;
         return false;
     }
-    if (m_usedEgressQSharedBytes[port][qIndex] + psize >
-        m_op_uc_port_config1_cell)  // exceed the queue limit
+    if (ps.egressQShared[qIndex] + cells > m_op_uc_port_config1_cell)  // exceed the queue limit
     {
-        std::cerr << "WARNING: Drop because egress Q buffer full (exceed the queue limit), "
-                  << Simulator::Now() << std::endl;
+        NS_LOG_WARN("Drop because egress Q buffer full (exceed the queue limit), "
+                    << Simulator::Now());
+        m_drops[DROP_EGRESS_QUEUE_LIMIT]++;
         return false;
     }
 
-    if ((double)m_usedEgressQSharedBytes[port][qIndex] + psize >
-        m_pg_shared_alpha_cell_egress * ((double)m_op_buffer_shared_limit_cell -
-                                         m_usedEgressSPBytes[GetEgressSP(port, qIndex)])) {
-#if (SLB_DEBUG == true)
-        // std::cerr << "WARNING: Drop because egress DT threshold exceed, Port:" << port
-        //           << ", Queue:" << qIndex
-        //           << ", QlenInfo:"
-        //           << ((double)m_usedEgressQSharedBytes[port][qIndex] + psize) << " > "
-        //           << (m_pg_shared_alpha_cell_egress * ((double)m_op_buffer_shared_limit_cell -
-        //           m_usedEgressSPBytes[GetEgressSP(port, qIndex)]))
-        //           << ". Natural if not using PFC"
-        //           << std::endl;
-#endif
-        threshold = false;
-        // drop because it exceeds threshold
+    // drop because it exceeds the dynamic threshold; natural if not using PFC
+    if ((double)ps.egressQShared[qIndex] + cells >
+        m_pg_shared_alpha_cell_egress * ((double)m_op_buffer_shared_limit_cell - usedSP)) {
+        m_drops[DROP_EGRESS_DYNAMIC_THRESHOLD]++;
+        return false;
     }
-    return threshold;
+    return true;
 }
 void SwitchMmu::UpdateIngressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize) {
-    m_usedTotalBytes += psize;  // count total buffer usage
-    m_usedIngressSPBytes[GetIngressSP(port, qIndex)] += psize;
-    m_usedIngressPortBytes[port] += psize;
-    m_usedIngressPGBytes[port][qIndex] += psize;
-    if (m_usedIngressSPBytes[GetIngressSP(port, qIndex)] >
-        m_buffer_cell_limit_sp)  // begin to use headroom buffer
+    PortState &ps = m_port[port];
+    uint32_t cells = Cells(psize);
+    uint32_t &usedSP = m_usedIngressSPCells[GetIngressSP(port, qIndex)];
+    m_usedTotalCells += cells;  // count total buffer usage
+    usedSP += cells;
+    ps.ingressPort += cells;
+    ps.ingressPG[qIndex] += cells;
+    UpdatePgAboveMin(ps, qIndex);
+    if (usedSP > m_buffer_cell_limit_sp)  // begin to use headroom buffer
     {
-        m_usedIngressPGHeadroomBytes[port][qIndex] += psize;
+        ps.ingressPGHeadroom[qIndex] += cells;
     }
 }
 
 void SwitchMmu::UpdateEgressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize) {
-    if (m_usedEgressQMinBytes[port][qIndex] + psize < m_q_min_cell)  // guaranteed
+    PortState &ps = m_port[port];
+    uint32_t cells = Cells(psize);
+    uint32_t &usedSP = m_usedEgressSPCells[GetEgressSP(port, qIndex)];
+    if (ps.egressQMin[qIndex] + cells < m_q_min_cell)  // guaranteed
     {
-        m_usedEgressQMinBytes[port][qIndex] += psize;
-        m_usedEgressPortBytes[port] = m_usedEgressPortBytes[port] + psize;
+        ps.egressQMin[qIndex] += cells;
+        ps.egressPort += cells;
         return;
     } else {
         /*
@@ -229,63 +265,59 @@ void SwitchMmu::UpdateEgressAdmission(uint32_t port, uint32_t qIndex, uint32_t p
         First, when there is left space in q_min_cell, and we should use remaining space in
         q_min_cell and add rest to the shared_pool Second, just adding to shared pool
         */
-        if (m_usedEgressQMinBytes[port][qIndex] != m_q_min_cell) {
-            m_usedEgressQSharedBytes[port][qIndex] = m_usedEgressQSharedBytes[port][qIndex] +
-                                                     psize + m_usedEgressQMinBytes[port][qIndex] -
-                                                     m_q_min_cell;
-            m_usedEgressPortBytes[port] =
-                m_usedEgressPortBytes[port] +
-                psize;  //+ m_usedEgressQMinBytes[port][qIndex] - m_q_min_cell ;
-            m_usedEgressSPBytes[GetEgressSP(port, qIndex)] =
-                m_usedEgressSPBytes[GetEgressSP(port, qIndex)] + psize +
-                m_usedEgressQMinBytes[port][qIndex] - m_q_min_cell;
-            m_usedEgressQMinBytes[port][qIndex] = m_q_min_cell;
-
+        if (ps.egressQMin[qIndex] != m_q_min_cell) {
+            ps.egressQShared[qIndex] += cells + ps.egressQMin[qIndex] - m_q_min_cell;
+            ps.egressPort += cells;
+            usedSP += cells + ps.egressQMin[qIndex] - m_q_min_cell;
+            ps.egressQMin[qIndex] = m_q_min_cell;
         } else {
-            m_usedEgressQSharedBytes[port][qIndex] += psize;
-            m_usedEgressPortBytes[port] += psize;
-            m_usedEgressSPBytes[GetEgressSP(port, qIndex)] += psize;
+            ps.egressQShared[qIndex] += cells;
+            ps.egressPort += cells;
+            usedSP += cells;
         }
     }
 }
 void SwitchMmu::RemoveFromIngressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize) {
-    if (m_usedTotalBytes < psize) {
-        m_usedTotalBytes = psize;
-        std::cerr << "Warning : Illegal Remove" << std::endl;
-    }
-    if (m_usedIngressSPBytes[GetIngressSP(port, qIndex)] < psize) {
-        m_usedIngressSPBytes[GetIngressSP(port, qIndex)] = psize;
+    PortState &ps = m_port[port];
+    uint32_t cells = Cells(psize);
+    uint32_t &usedSP = m_usedIngressSPCells[GetIngressSP(port, qIndex)];
+    if (m_usedTotalCells < cells) {
+        m_usedTotalCells = cells;
         std::cerr << "Warning : Illegal Remove" << std::endl;
     }
-    if (m_usedIngressSPBytes[GetIngressSP(port, qIndex)] < psize) {
-        m_usedIngressSPBytes[GetIngressSP(port, qIndex)] = psize;
+    if (usedSP < cells) {
+        usedSP = cells;
         std::cerr << "Warning : Illegal Remove" << std::endl;
     }
-    if (m_usedIngressPortBytes[port] < psize) {
-        m_usedIngressPortBytes[port] = psize;
+    if (ps.ingressPort < cells) {
+        ps.ingressPort = cells;
         std::cerr << "Warning : Illegal Remove" << std::endl;
     }
-    if (m_usedIngressPGBytes[port][qIndex] < psize) {
-        m_usedIngressPGBytes[port][qIndex] = psize;
+    if (ps.ingressPG[qIndex] < cells) {
+        ps.ingressPG[qIndex] = cells;
         std::cerr << "Warning : Illegal Remove" << std::endl;
     }
-    m_usedTotalBytes -= psize;
-    m_usedIngressSPBytes[GetIngressSP(port, qIndex)] -= psize;
-    m_usedIngressPortBytes[port] -= psize;
-    m_usedIngressPGBytes[port][qIndex] -= psize;
-    if ((double)m_usedIngressPGHeadroomBytes[port][qIndex] - psize > 0)
-        m_usedIngressPGHeadroomBytes[port][qIndex] -= psize;
+    m_usedTotalCells -= cells;
+    usedSP -= cells;
+    ps.ingressPort -= cells;
+    ps.ingressPG[qIndex] -= cells;
+    UpdatePgAboveMin(ps, qIndex);
+    if (ps.ingressPGHeadroom[qIndex] > cells)
+        ps.ingressPGHeadroom[qIndex] -= cells;
     else
-        m_usedIngressPGHeadroomBytes[port][qIndex] = 0;
+        ps.ingressPGHeadroom[qIndex] = 0;
 }
 void SwitchMmu::RemoveFromEgressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize) {
-    if (m_usedEgressQMinBytes[port][qIndex] < m_q_min_cell)  // guaranteed
+    PortState &ps = m_port[port];
+    uint32_t cells = Cells(psize);
+    uint32_t &usedSP = m_usedEgressSPCells[GetEgressSP(port, qIndex)];
+    if (ps.egressQMin[qIndex] < m_q_min_cell)  // guaranteed
     {
-        if (m_usedEgressQMinBytes[port][qIndex] < psize) {
+        if (ps.egressQMin[qIndex] < cells) {
             std::cerr << "STOP overflow\n";
         }
-        m_usedEgressQMinBytes[port][qIndex] -= psize;
-        m_usedEgressPortBytes[port] -= psize;
+        ps.egressQMin[qIndex] -= cells;
+        ps.egressPort -= cells;
         return;
     } else {
         /*
@@ -295,28 +327,22 @@ void SwitchMmu::RemoveFromEgressAdmission(uint32_t port, uint32_t qIndex, uint32
         */
 
         // first case
-        if (m_usedEgressQMinBytes[port][qIndex] == m_q_min_cell &&
-            m_usedEgressQSharedBytes[port][qIndex] < psize) {
-            m_usedEgressQMinBytes[port][qIndex] = m_usedEgressQMinBytes[port][qIndex] +
-                                                  m_usedEgressQSharedBytes[port][qIndex] - psize;
-            m_usedEgressSPBytes[GetEgressSP(port, qIndex)] =
-                m_usedEgressSPBytes[GetEgressSP(port, qIndex)] -
-                m_usedEgressQSharedBytes[port][qIndex];
-            m_usedEgressQSharedBytes[port][qIndex] = 0;
-            if (m_usedEgressPortBytes[port] < psize) {
+        if (ps.egressQMin[qIndex] == m_q_min_cell && ps.egressQShared[qIndex] < cells) {
+            ps.egressQMin[qIndex] = ps.egressQMin[qIndex] + ps.egressQShared[qIndex] - cells;
+            usedSP -= ps.egressQShared[qIndex];
+            ps.egressQShared[qIndex] = 0;
+            if (ps.egressPort < cells) {
                 std::cerr << "STOP overflow\n";
             }
-            m_usedEgressPortBytes[port] -= psize;
+            ps.egressPort -= cells;
 
         } else {
-            if (m_usedEgressQSharedBytes[port][qIndex] < psize ||
-                m_usedEgressPortBytes[port] < psize ||
-                m_usedEgressSPBytes[GetEgressSP(port, qIndex)] < psize) {
+            if (ps.egressQShared[qIndex] < cells || ps.egressPort < cells || usedSP < cells) {
                 std::cerr << "STOP overflow\n";
             }
-            m_usedEgressQSharedBytes[port][qIndex] -= psize;
-            m_usedEgressPortBytes[port] -= psize;
-            m_usedEgressSPBytes[GetEgressSP(port, qIndex)] -= psize;
+            ps.egressQShared[qIndex] -= cells;
+            ps.egressPort -= cells;
+            usedSP -= cells;
         }
         return;
     }
@@ -326,25 +352,27 @@ void SwitchMmu::GetPauseClasses(uint32_t port, uint32_t qIndex, bool pClasses[])
     if (port > m_activePortCnt) {
         std::cerr << "ERROR: port is " << port << std::endl;
     }
+    const PortState &ps = m_port[port];
     if (m_dynamicth) {
-        for (uint32_t i = 0; i < qCnt; i++) {
-            pClasses[i] = false;
-            if (m_usedIngressPGBytes[port][i] <= m_pg_min_cell + m_port_min_cell) continue;
-
-            // std::cerr << "BCM : Used=" << m_usedIngressPGBytes[port][i] << ", thresh=" <<
-            // m_pg_shared_alpha_cell*((double)m_buffer_cell_limit_sp -
-            // m_usedIngressSPBytes[GetIngressSP(port, qIndex)]) + m_pg_min_cell+m_port_min_cell <<
-            // std::endl;
-
-            if ((double)m_usedIngressPGBytes[port][i] - m_pg_min_cell - m_port_min_cell >
-                    m_pg_shared_alpha_cell * ((double)m_buffer_cell_limit_sp -
-                                              m_usedIngressSPBytes[GetIngressSP(port, qIndex)]) ||
-                m_usedIngressPGHeadroomBytes[port][qIndex] != 0) {
+        for (uint32_t i = 0; i < qCnt; i++) pClasses[i] = false;
+        // only pgs above their guarantee can cross the threshold, which is the same for all
+        // of them (it depends on the sp of qIndex)
+        uint32_t above = ps.pgAboveMin;
+        if (!above) return;
+        double threshold =
+            m_pg_shared_alpha_cell *
+            ((double)m_buffer_cell_limit_sp - m_usedIngressSPCells[GetIngressSP(port, qIndex)]);
+        bool headroom = ps.ingressPGHeadroom[qIndex] != 0;
+        while (above) {
+            uint32_t i = __builtin_ctz(above);
+            above &= above - 1;
+            if (headroom ||
+                (double)ps.ingressPG[i] - m_pg_min_cell - m_port_min_cell > threshold) {
                 pClasses[i] = true;
             }
         }
     } else {
-        if (m_usedIngressPortBytes[port] > m_port_max_shared_cell)  // pause the whole port
+        if (ps.ingressPort > m_port_max_shared_cell)  // pause the whole port
         {
             for (uint32_t i = 0; i < qCnt; i++) {
                 pClasses[i] = true;
@@ -355,7 +383,7 @@ void SwitchMmu::GetPauseClasses(uint32_t port, uint32_t qIndex, bool pClasses[])
                 pClasses[i] = false;
             }
         }
-        if (m_usedIngressPGBytes[port][qIndex] > m_pg_shared_limit_cell) {
+        if (ps.ingressPG[qIndex] > m_pg_shared_limit_cell) {
             pClasses[qIndex] = true;
         }
     }
@@ -364,52 +392,39 @@ void SwitchMmu::GetPauseClasses(uint32_t port, uint32_t qIndex, bool pClasses[])
 
 bool SwitchMmu::GetResumeClasses(uint32_t port, uint32_t qIndex) {
     if (!paused[port][qIndex]) return false;
+    const PortState &ps = m_port[port];
     if (m_dynamicth) {
-        if ((double)m_usedIngressPGBytes[port][qIndex] - m_pg_min_cell - m_port_min_cell <
+        if ((double)ps.ingressPG[qIndex] - m_pg_min_cell - m_port_min_cell <
                 m_pg_shared_alpha_cell * ((double)m_buffer_cell_limit_sp -
-                                          m_usedIngressSPBytes[GetIngressSP(port, qIndex)] -
+                                          m_usedIngressSPCells[GetIngressSP(port, qIndex)] -
                                           m_pg_shared_alpha_cell_off_diff) &&
-            m_usedIngressPGHeadroomBytes[port][qIndex] == 0) {
+            ps.ingressPGHeadroom[qIndex] == 0) {
             return true;
         }
     } else {
-        if (m_usedIngressPGBytes[port][qIndex] < m_pg_shared_limit_cell_off &&
-            m_usedIngressPortBytes[port] < m_port_min_cell_off) {
+        if (ps.ingressPG[qIndex] < m_pg_shared_limit_cell_off &&
+            ps.ingressPort < m_port_min_cell_off) {
             return true;
         }
     }
     return false;
 }
 
-uint32_t SwitchMmu::GetIngressSP(uint32_t port, uint32_t pgIndex) {
-    if (pgIndex == 1)
-        return 1;
-    else
-        return 0;
-}
-
-uint32_t SwitchMmu::GetEgressSP(uint32_t port, uint32_t qIndex) {
-    if (qIndex == 0)
-        return 0;
-    else
-        return 1;
-}
-
 bool SwitchMmu::ShouldSendCN(uint32_t ifindex, uint32_t qIndex) {
     if (qIndex == 0)  // qidx=0 as highest priority
         return false;
 
-    if (m_usedEgressQSharedBytes[ifindex][qIndex] > kmax[ifindex]) {
+    uint32_t used = m_port[ifindex].egressQShared[qIndex] * m_cellSize;  // kmin/kmax in bytes
+    if (used > kmax[ifindex]) {
         return true;
-    } else if (m_usedEgressQSharedBytes[ifindex][qIndex] > kmin[ifindex] &&
-               kmin[ifindex] != kmax[ifindex]) {
-        double p = 1.0 * (m_usedEgressQSharedBytes[ifindex][qIndex] - kmin[ifindex]) /
-                   (kmax[ifindex] - kmin[ifindex]) * pmax[ifindex];
+    } else if (used > kmin[ifindex] && kmin[ifindex] != kmax[ifindex]) {
+        double p = 1.0 * (used - kmin[ifindex]) / (kmax[ifindex] - kmin[ifindex]) * pmax[ifindex];
         if (m_uniform_random_var.GetValue(0, 1) < p) return true;
     }
     return false;
 }
 
+// all sizes in cells
 void SwitchMmu::SetBroadcomParams(
     uint32_t buffer_cell_limit_sp,  // ingress sp buffer threshold p.120
     uint32_t
@@ -431,7 +446,12 @@ void SwitchMmu::SetBroadcomParams(
     m_port_min_cell = port_min_cell;
     m_pg_shared_limit_cell = pg_shared_limit_cell;
     m_port_max_shared_cell = port_max_shared_cell;
-    for (int i = 0; i < pCnt; i++) m_pg_hdrm_limit[i] = pg_hdrm_limit;
+    m_defaultPgHdrmLimit = pg_hdrm_limit * m_cellSize;
+    for (uint32_t i = 0; i < m_port.size(); i++) {
+        m_port[i].pgHdrmLimitBytes = m_defaultPgHdrmLimit;
+        m_port[i].pgHdrmLimit = pg_hdrm_limit;
+        for (uint32_t j = 0; j < qCnt; j++) UpdatePgAboveMin(m_port[i], j);  // new guarantees
+    }
     m_port_max_pkt_size = port_max_pkt_size;
     m_q_min_cell = q_min_cell;
     m_op_uc_port_config1_cell = op_uc_port_config1_cell;
@@ -441,7 +461,7 @@ void SwitchMmu::SetBroadcomParams(
     m_port_shared_alpha_cell = port_share_alpha_cell;
 }
 
-uint32_t SwitchMmu::GetUsedBufferTotal() { return m_usedTotalBytes; }
+uint32_t SwitchMmu::GetUsedBufferTotal() { return m_usedTotalCells * m_cellSize; }
 
 void SwitchMmu::SetDynamicThreshold(bool v) {
     m_dynamicth = v;
@@ -449,7 +469,25 @@ void SwitchMmu::SetDynamicThreshold(bool v) {
     return;
 }
 
+void SwitchMmu::SetPgHdrmLimit(uint32_t v) {
+    m_defaultPgHdrmLimit = v;
+    for (uint32_t i = 0; i < m_port.size(); i++) {
+        m_port[i].pgHdrmLimitBytes = v;
+        m_port[i].pgHdrmLimit = Cells(v);
+    }
+    InitSwitch();
+}
+
+void SwitchMmu::SetCellSize(uint32_t v) {
+    m_cellSize = v;
+    for (uint32_t i = 0; i < m_port.size(); i++) {
+        m_port[i].pgHdrmLimit = Cells(m_port[i].pgHdrmLimitBytes);
+    }
+    InitSwitch();
+}
+
 void SwitchMmu::ConfigEcn(uint32_t port, uint32_t _kmin, uint32_t _kmax, double _pmax) {
+    EnsurePorts(port + 1);
     kmin[port] = _kmin * 1000;
     kmax[port] = _kmax * 1000;
     pmax[port] = _pmax;
@@ -467,7 +505,9 @@ void SwitchMmu::SetResume(uint32_t port, uint32_t qIndex) {
 }
 
 void SwitchMmu::ConfigHdrm(uint32_t port, uint32_t size) {
-    m_pg_hdrm_limit[port] = size;
+    EnsurePorts(port + 1);
+    m_port[port].pgHdrmLimitBytes = size;
+    m_port[port].pgHdrmLimit = Cells(size);
     InitSwitch();
 }
 void SwitchMmu::ConfigNPort(uint32_t n_port) {
@@ -4,6 +4,7 @@
 #include <ns3/node.h>
 #include <ns3/random-variable-stream.h>
 
+#include <array>
 #include <list>
 #include <unordered_map>
 
@@ -17,10 +18,19 @@ namespace ns3 {
 
 class Packet;
 
+/**
+ * @brief Broadcom-style shared-buffer MMU of a switch.
+ *
+ * Occupancy is accounted in buffer cells of CellSize bytes (a packet takes
+ * ceil(size / CellSize) cells), like the MMU of a switch ASIC; the thresholds below are kept
+ * in cells too. With the default CellSize of 1 the accounting is exact in bytes.
+ *
+ * Per-port state is sized by the number of ports configured (ConfigNPort, ConfigEcn,
+ * ConfigHdrm), so there is no limit on the switch radix.
+ */
 class SwitchMmu : public Object {
    public:
     static const unsigned qCnt = 8;    // Number of queues/priorities used
-    static const unsigned pCnt = 128;  // port 0 is not used so + 1	// Number of ports used
     static const unsigned MTU = 1048;  // 1000 + headers
 
     static TypeId GetTypeId(void);
@@ -60,7 +70,7 @@ class SwitchMmu : public Object {
 
     bool ShouldSendCN(uint32_t ifindex, uint32_t qIndex);
 
-    uint32_t GetUsedBufferTotal();
+    uint32_t GetUsedBufferTotal();  // bytes (cells * CellSize)
 
     void SetDynamicThreshold(bool value);
     bool GetDynamicThreshold(void) const { return m_dynamicth; }
@@ -73,20 +83,31 @@ class SwitchMmu : public Object {
     void ConfigHdrm(uint32_t port, uint32_t size);
     void ConfigNPort(uint32_t n_port);
 
-    uint32_t GetIngressSP(uint32_t port, uint32_t pgIndex);
-    uint32_t GetEgressSP(uint32_t port, uint32_t qIndex);
+    static uint32_t GetIngressSP(uint32_t port, uint32_t pgIndex) { return pgIndex == 1 ? 1 : 0; }
+    static uint32_t GetEgressSP(uint32_t port, uint32_t qIndex) { return qIndex == 0 ? 0 : 1; }
+
+    // drops by reason, see CheckIngressAdmission / CheckEgressAdmission
+    enum DropReason {
+        DROP_INGRESS_BUFFER_FULL = 0,
+        DROP_INGRESS_HEADROOM_FULL,
+        DROP_EGRESS_SP_LIMIT,
+        DROP_EGRESS_PORT_LIMIT,
+        DROP_EGRESS_QUEUE_LIMIT,
+        DROP_EGRESS_DYNAMIC_THRESHOLD,
+        DROP_REASON_COUNT,
+    };
+    uint64_t GetDropCount(DropReason reason) const { return m_drops[reason]; }
 
     // config
     uint32_t node_id;
 
-    uint32_t kmin[pCnt], kmax[pCnt];
-    double pmax[pCnt];
-    uint32_t paused[pCnt][qCnt];
-    EventId resumeEvt[pCnt][qCnt];
-    bool m_pause_remote[pCnt][qCnt];
+    std::vector<uint32_t> kmin, kmax;  // bytes
+    std::vector<double> pmax;
+    std::vector<std::array<uint32_t, qCnt> > paused;
+    std::vector<std::array<EventId, qCnt> > resumeEvt;
+    std::vector<std::array<bool, qCnt> > m_pause_remote;
 
-    uint32_t pfc_a_shift[pCnt];         // legacy: not used anymore
-    uint32_t egress_bytes[pCnt][qCnt];  // legacy: not used anymore
+    std::vector<std::array<uint32_t, qCnt> > egress_bytes;  // legacy: not used anymore
 
     uint32_t GetActivePortCnt(void) const { return m_activePortCnt; }
     void SetActivePortCnt(uint32_t v) {
@@ -101,11 +122,11 @@ class SwitchMmu : public Object {
         InitSwitch();
     }
 
-    uint32_t GetPgHdrmLimit(void) const { return m_pg_hdrm_limit[0]; }
-    void SetPgHdrmLimit(uint32_t v) {
-        for (int i = 0; i < pCnt; i++) m_pg_hdrm_limit[i] = v;
-        InitSwitch();
-    }
+    uint32_t GetPgHdrmLimit(void) const { return m_defaultPgHdrmLimit; }
+    void SetPgHdrmLimit(uint32_t v);
+
+    uint32_t GetCellSize(void) const { return m_cellSize; }
+    void SetCellSize(uint32_t v);
 
     /*------------ Conga Objects-------------*/
     CongaRouting m_congaRouting;
@@ -117,24 +138,45 @@ class SwitchMmu : public Object {
     ConWeaveRouting m_conweaveRouting;
 
    private:
+    // occupancy and limits of one port, in cells
+    struct PortState {
+        uint32_t ingressPG[qCnt];
+        uint32_t ingressPGHeadroom[qCnt];
+        uint32_t egressQMin[qCnt];
+        uint32_t egressQShared[qCnt];
+        uint32_t ingressPort;
+        uint32_t egressPort;
+        uint32_t pgHdrmLimit;
+        uint32_t pgHdrmLimitBytes;
+        // pgs with ingressPG[i] > m_pg_min_cell + m_port_min_cell: only these can be paused
+        // by the dynamic threshold, so GetPauseClasses only looks at them
+        uint8_t pgAboveMin;
+    };
+
+    uint32_t Cells(uint32_t bytes) const { return (bytes + m_cellSize - 1) / m_cellSize; }
+    void EnsurePorts(uint32_t n);  // per-port state for ports [0, n)
+    void UpdatePgAboveMin(PortState &ps, uint32_t pg) {
+        if (ps.ingressPG[pg] > m_pg_min_cell + m_port_min_cell)
+            ps.pgAboveMin |= (uint8_t)(1u << pg);
+        else
+            ps.pgAboveMin &= (uint8_t)~(1u << pg);
+    }
+
     bool m_PFCenabled;
 
+    uint32_t m_cellSize{1};
     uint32_t m_maxBufferBytes{0};
-    uint32_t m_usedTotalBytes{0};
+    uint32_t m_maxBufferCells{0};
+    uint32_t m_usedTotalCells{0};
 
     unsigned m_activePortCnt{0};
     uint32_t m_maxBufferBytesPerPort{0};  // use this to calculate m_maxBufferBytes
     uint32_t m_staticMaxBufferBytes{0};   // use this to calculate m_maxBufferBytes
+    uint32_t m_defaultPgHdrmLimit{0};     // bytes, for ports without ConfigHdrm
 
-    uint32_t m_usedIngressPGBytes[pCnt][qCnt];
-    uint32_t m_usedIngressPortBytes[pCnt];
-    uint32_t m_usedIngressSPBytes[4];
-    uint32_t m_usedIngressPGHeadroomBytes[pCnt][qCnt];
-
-    uint32_t m_usedEgressQMinBytes[pCnt][qCnt];
-    uint32_t m_usedEgressQSharedBytes[pCnt][qCnt];
-    uint32_t m_usedEgressPortBytes[pCnt];
-    uint32_t m_usedEgressSPBytes[4];
+    std::vector<PortState> m_port;
+    uint32_t m_usedIngressSPCells[4];
+    uint32_t m_usedEgressSPCells[4];
 
     // ingress params
     uint32_t m_buffer_cell_limit_sp;  // ingress sp buffer threshold p.120
@@ -144,7 +186,6 @@ class SwitchMmu : public Object {
     uint32_t m_port_min_cell;           // ingress port guarantee
     uint32_t m_pg_shared_limit_cell;    // max buffer for an ingress pg
     uint32_t m_port_max_shared_cell;    // max buffer for an ingress port
-    uint32_t m_pg_hdrm_limit[pCnt];     // ingress pg headroom
     uint32_t m_port_max_pkt_size;       // ingress global headroom
     // still needs reset limits..
     uint32_t m_port_min_cell_off;  // PAUSE off threshold
@@ -169,6 +210,8 @@ class SwitchMmu : public Object {
     double m_log_end;
     double m_log_step;
 
+    uint64_t m_drops[DROP_REASON_COUNT];
+
     UniformRandomVariable m_uniform_random_var;
 };
 
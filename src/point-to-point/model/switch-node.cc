@@ -12,12 +12,15 @@
 #include "ns3/packet.h"
 #include "ns3/pause-header.h"
 #include "ns3/settings.h"
+#include "ns3/sim-profiler.h"
 #include "ns3/uinteger.h"
 #include "ppp-header.h"
 #include "qbb-net-device.h"
 
 namespace ns3 {
 
+uint64_t SwitchNode::nRxPkts = 0;
+
 TypeId SwitchNode::GetTypeId(void) {
     static TypeId tid =
         TypeId("ns3::SwitchNode")
@@ -50,9 +53,6 @@ SwitchNode::SwitchNode() {
     m_mmu->m_conweaveRouting.SetSwitchSendToDevCallback(
         MakeCallback(&SwitchNode::SendToDevContinue, this));
 
-    for (uint32_t i = 0; i < pCnt; i++) {
-        m_txBytes[i] = 0;
-    }
 }
 
 /**
@@ -191,6 +191,8 @@ void SwitchNode::CheckAndSendResume(uint32_t inDev, uint32_t qIndex) {
 // This function can only be called in switch mode
 bool SwitchNode::SwitchReceiveFromDevice(Ptr<NetDevice> device, Ptr<Packet> packet,
                                          CustomHeader &ch) {
+    NS_PROFILE_SCOPE("switch/receive");
+    nRxPkts++;
     SendToDev(packet, ch);
     return true;
 }
@@ -243,6 +245,7 @@ void SwitchNode::SendToDevContinue(Ptr<Packet> p, CustomHeader &ch) {
 }
 
 int SwitchNode::GetOutDev(Ptr<Packet> p, CustomHeader &ch) {
+    NS_PROFILE_SCOPE("lb/next hop");
     // look up entries
     auto entry = m_rtTable.find(ch.dip);
 
@@ -282,6 +285,7 @@ int SwitchNode::GetOutDev(Ptr<Packet> p, CustomHeader &ch) {
  * The (possible) callback point when conweave dequeues packets from buffer
  */
 void SwitchNode::DoSwitchSend(Ptr<Packet> p, CustomHeader &ch, uint32_t outDev, uint32_t qIndex) {
+    NS_PROFILE_SCOPE("switch/send");
     // admission control
     FlowIdTag t;
     p->PeekPacketTag(t);
@@ -311,6 +315,7 @@ void SwitchNode::DoSwitchSend(Ptr<Packet> p, CustomHeader &ch, uint32_t outDev,
                 //           << ",At " << Simulator::Now() << std::endl;
 #endif
                 Settings::dropped_pkt_sw_ingress++;
+                NS_PROFILE_COUNT("switch/ingress drops", 1);
                 return;  // drop
             }
         } else { /** DROP: At Egress */
@@ -321,6 +326,7 @@ void SwitchNode::DoSwitchSend(Ptr<Packet> p, CustomHeader &ch, uint32_t outDev,
             //           << Simulator::Now() << std::endl;
 #endif
             Settings::dropped_pkt_sw_egress++;
+            NS_PROFILE_COUNT("switch/egress drops", 1);
             return;  // drop
         }
 
@@ -331,6 +337,7 @@ void SwitchNode::DoSwitchSend(Ptr<Packet> p, CustomHeader &ch, uint32_t outDev,
 }
 
 void SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p) {
+    NS_PROFILE_SCOPE("switch/dequeue");
     FlowIdTag t;
     p->PeekPacketTag(t);
     if (qIndex != 0) {
@@ -359,17 +366,18 @@ void SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Pack
         }
     }
 
-    // HPCC's INT
-    if (1) {
+    if (ifIndex >= m_txBytes.size()) m_txBytes.resize(ifIndex + 1, 0);
+    // HPCC's INT: only touch the raw buffer when HPCC is actually running
+    if (m_ccMode == 3) {
+        // ppp, ip, udp, SeqTs, INT
+        static const uint32_t kIpProtoOffset = PppHeader::GetStaticSize() + 9;
+        static const uint32_t kIntOffset = PppHeader::GetStaticSize() + 20 + 8 + 6;
         uint8_t *buf = p->GetBuffer();
-        if (buf[PppHeader::GetStaticSize() + 9] == 0x11) {  // udp packet
-            IntHeader *ih = (IntHeader *)&buf[PppHeader::GetStaticSize() + 20 + 8 +
-                                              6];  // ppp, ip, udp, SeqTs, INT
+        if (buf[kIpProtoOffset] == 0x11) {  // udp packet
+            IntHeader *ih = (IntHeader *)&buf[kIntOffset];
             Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(m_devices[ifIndex]);
-            if (m_ccMode == 3) {  // HPCC
-                ih->PushHop(Simulator::Now().GetTimeStep(), m_txBytes[ifIndex],
-                            dev->GetQueue()->GetNBytesTotal(), dev->GetDataRate().GetBitRate());
-            }
+            ih->PushHop(Simulator::Now().GetTimeStep(), m_txBytes[ifIndex],
+                        dev->GetQueue()->GetNBytesTotal(), dev->GetDataRate().GetBitRate());
         }
     }
     m_txBytes[ifIndex] += p->GetSize();
@@ -423,8 +431,7 @@ void SwitchNode::AddTableEntry(Ipv4Address &dstAddr, uint32_t intf_idx) {
 void SwitchNode::ClearTable() { m_rtTable.clear(); }
 
 uint64_t SwitchNode::GetTxBytesOutDev(uint32_t outdev) {
-    assert(outdev < pCnt);
-    return m_txBytes[outdev];
+    return outdev < m_txBytes.size() ? m_txBytes[outdev] : 0;
 }
 
 } /* namespace ns3 */
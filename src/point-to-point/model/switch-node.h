@@ -15,13 +15,12 @@ class Packet;
 
 class SwitchNode : public Node {
     static const unsigned qCnt = 8;    // Number of queues/priorities used
-    static const unsigned pCnt = 128;  // port 0 is not used so + 1	// Number of ports used
     uint32_t m_ecmpSeed;
     std::unordered_map<uint32_t, std::vector<int> >
         m_rtTable;  // map from ip address (u32) to possible ECMP port (index of dev)
 
     // monitor uplinks
-    uint64_t m_txBytes[pCnt];  // counter of tx bytes, for HPCC
+    std::vector<uint64_t> m_txBytes;  // counter of tx bytes per port, for HPCC
 
    protected:
     bool m_ecnEnabled;
@@ -62,6 +61,7 @@ class SwitchNode : public Node {
     Ptr<SwitchMmu> m_mmu;
     bool m_isToR;                                 // true if ToR switch
     std::unordered_set<uint32_t> m_isToR_hostIP;  // host's IP connected to this ToR
+    static uint64_t nRxPkts;                      // packets received by all switches
 
     static TypeId GetTypeId(void);
     SwitchNode();
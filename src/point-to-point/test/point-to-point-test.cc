@@ -3,6 +3,24 @@
 #include "ns3/simulator.h"
 #include "ns3/point-to-point-net-device.h"
 #include "ns3/point-to-point-channel.h"
+#include "ns3/rdma-timer-wheel.h"
+#include "ns3/switch-mmu.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/fluid-flow-model.h"
+#include "ns3/qbb-net-device.h"
+#include "ns3/double.h"
+#include "ns3/topology-spec.h"
+#include "ns3/pfc-monitor.h"
+#include "ns3/switch-node.h"
+#include "ns3/qbb-channel.h"
+#include "ns3/pause-header.h"
+#include "ns3/ppp-header.h"
+#include "ns3/ipv4-header.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
 
 namespace ns3 {
 
@@ -56,6 +74,985 @@ PointToPointTest::DoRun (void)
   Simulator::Destroy ();
 }
 //-----------------------------------------------------------------------------
+// Periodic DCQCN-like timers (alpha update, rate decrease check, rate increase) of
+// many qps, with random start times and restarts, run once as separate scheduler
+// events and once in an RdmaTimerWheel. With a 1ns tick both must expire at the same
+// times in the same order; with a coarser tick each expiry is rounded up to the tick.
+class RdmaTimerWheelTest : public TestCase
+{
+public:
+  RdmaTimerWheelTest ();
+
+  virtual void DoRun (void);
+
+private:
+  struct Expiry
+  {
+    uint64_t t;
+    uint32_t qp;
+    uint32_t timer;
+    bool operator== (const Expiry &o) const
+    {
+      return t == o.t && qp == o.qp && timer == o.timer;
+    }
+  };
+
+  void Run (Time tick, std::vector<Expiry> &log);
+  void Arm (uint32_t qp, uint32_t timer, Time delay);
+  void EventExpired (uint32_t qp, uint32_t timer);
+  void WheelExpired (Ptr<RdmaQueuePair> qp, uint32_t timer);
+  void Expired (uint32_t qp, uint32_t timer);
+  void Restart (uint32_t qp);
+
+  static const uint32_t kQps = 200;
+  Time m_period[3];
+  Time m_tick;
+  RdmaTimerWheel *m_wheel;
+  std::vector<Ptr<RdmaQueuePair> > m_qps;
+  std::vector<EventId> m_events;
+  std::vector<uint32_t> m_stamps;
+  std::vector<Expiry> *m_log;
+};
+
+const uint32_t RdmaTimerWheelTest::kQps;
+
+RdmaTimerWheelTest::RdmaTimerWheelTest ()
+  : TestCase ("RdmaTimerWheel")
+{
+  m_period[0] = MicroSeconds (1);
+  m_period[1] = MicroSeconds (4);
+  m_period[2] = MicroSeconds (300);
+}
+
+void
+RdmaTimerWheelTest::Arm (uint32_t qp, uint32_t timer, Time delay)
+{
+  if (m_tick.IsZero ())
+    {
+      m_events[qp * 3 + timer] = Simulator::Schedule (delay, &RdmaTimerWheelTest::EventExpired,
+                                                      this, qp, timer);
+    }
+  else
+    {
+      m_wheel->Schedule (delay, m_qps[qp], timer, &m_stamps[qp * 3 + timer]);
+    }
+}
+
+void
+RdmaTimerWheelTest::EventExpired (uint32_t qp, uint32_t timer)
+{
+  Expired (qp, timer);
+}
+
+void
+RdmaTimerWheelTest::WheelExpired (Ptr<RdmaQueuePair> qp, uint32_t timer)
+{
+  Expired (qp->sport, timer);
+}
+
+void
+RdmaTimerWheelTest::Expired (uint32_t qp, uint32_t timer)
+{
+  Expiry e;
+  e.t = Simulator::Now ().GetTimeStep ();
+  e.qp = qp;
+  e.timer = timer;
+  m_log->push_back (e);
+  Arm (qp, timer, m_period[timer]);
+}
+
+// like a rate decrease: restart the rate increase timer of the qp
+void
+RdmaTimerWheelTest::Restart (uint32_t qp)
+{
+  if (m_tick.IsZero ())
+    {
+      Simulator::Cancel (m_events[qp * 3 + 2]);
+    }
+  else
+    {
+      RdmaTimerWheel::Cancel (&m_stamps[qp * 3 + 2]);
+    }
+  Arm (qp, 2, m_period[2]);
+}
+
+void
+RdmaTimerWheelTest::Run (Time tick, std::vector<Expiry> &log)
+{
+  RdmaTimerWheel wheel;
+  m_tick = tick;
+  m_wheel = &wheel;
+  m_log = &log;
+  if (!tick.IsZero ())
+    {
+      wheel.SetTick (tick);
+      wheel.SetHandler (MakeCallback (&RdmaTimerWheelTest::WheelExpired, this));
+    }
+  m_qps.clear ();
+  m_events.assign (kQps * 3, EventId ());
+  m_stamps.assign (kQps * 3, 0);
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  rng->SetStream (1);
+  for (uint32_t i = 0; i < kQps; i++)
+    {
+      m_qps.push_back (Create<RdmaQueuePair> (3, Ipv4Address ((uint32_t)0), Ipv4Address ((uint32_t)0), i, 0));
+      // start like a first CNP: alpha timer, rate decrease 1ns later
+      Time start = NanoSeconds (rng->GetInteger (0, 20000));
+      Simulator::Schedule (start, &RdmaTimerWheelTest::Arm, this, i, 0, m_period[0]);
+      Simulator::Schedule (start, &RdmaTimerWheelTest::Arm, this, i, 1, m_period[1] + NanoSeconds (1));
+      Simulator::Schedule (start, &RdmaTimerWheelTest::Arm, this, i, 2, m_period[2]);
+      for (uint32_t k = 0; k < 5; k++)
+        {
+          Simulator::Schedule (start + NanoSeconds (rng->GetInteger (0, 1000000)),
+                               &RdmaTimerWheelTest::Restart, this, i);
+        }
+    }
+  Simulator::Stop (MilliSeconds (2));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  m_qps.clear ();
+}
+
+void
+RdmaTimerWheelTest::DoRun (void)
+{
+  std::vector<Expiry> events, exact, coarse;
+  Run (Seconds (0), events);
+  Run (NanoSeconds (1), exact);
+  NS_TEST_ASSERT_MSG_GT (events.size (), kQps * 1000, "timers did not run");
+  NS_TEST_ASSERT_MSG_EQ (exact.size (), events.size (), "1ns wheel fired a different number of timers");
+  for (uint32_t i = 0; i < events.size () && i < exact.size (); i++)
+    {
+      if (!(events[i] == exact[i]))
+        {
+          NS_TEST_ASSERT_MSG_EQ (exact[i].t, events[i].t, "1ns wheel diverges at expiry " << i);
+          NS_TEST_ASSERT_MSG_EQ (exact[i].qp, events[i].qp, "1ns wheel diverges at expiry " << i);
+          NS_TEST_ASSERT_MSG_EQ (exact[i].timer, events[i].timer, "1ns wheel diverges at expiry " << i);
+          break;
+        }
+    }
+
+  // coarse tick: expiries are rounded up to whole ticks
+  Run (MicroSeconds (1), coarse);
+  NS_TEST_ASSERT_MSG_GT (coarse.size (), kQps * 1000, "timers did not run");
+  for (uint32_t i = 0; i < coarse.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (coarse[i].t % MicroSeconds (1).GetTimeStep (), 0, "expiry off the tick");
+    }
+}
+//-----------------------------------------------------------------------------
+// SwitchMmu (cells of 1 byte) against the byte-array Broadcom admission it replaced,
+// kept below as the reference: same admission, pause/resume and ECN decisions under
+// random incast traffic, with dynamic and static thresholds.
+class SwitchMmuTest : public TestCase
+{
+public:
+  SwitchMmuTest ();
+
+  virtual void DoRun (void);
+
+private:
+  struct Reference
+  {
+    static const uint32_t qCnt = 8;
+    static const uint32_t MTU = 1048;
+    uint32_t nPort;
+    bool dynamicth;
+    double alphaIn, alphaEg;
+    uint32_t maxBufferBytes, usedTotalBytes;
+    std::vector<uint32_t> hdrm, ingressPort, egressPort, kmax;
+    std::vector<std::vector<uint32_t> > ingressPG, ingressHdrm, egressQMin, egressQShared;
+    uint32_t ingressSP[4], egressSP[4];
+    uint32_t limitSp, pgMin, portMin, pgSharedLimit, portMaxShared, portMinOff, pgSharedLimitOff;
+    uint32_t qMin, opUcPortConfig1, opUcPortConfig, opBufferSharedLimit;
+
+    void Init (uint32_t n, uint32_t buffer, uint32_t hdrmLimit, bool dynamic);
+    bool CheckIngress (uint32_t port, uint32_t q, uint32_t psize);
+    bool CheckEgress (uint32_t port, uint32_t q, uint32_t psize);
+    void UpdateIngress (uint32_t port, uint32_t q, uint32_t psize);
+    void UpdateEgress (uint32_t port, uint32_t q, uint32_t psize);
+    void RemoveIngress (uint32_t port, uint32_t q, uint32_t psize);
+    void RemoveEgress (uint32_t port, uint32_t q, uint32_t psize);
+    void GetPauseClasses (uint32_t port, uint32_t q, bool pClasses[]);
+    bool GetResumeClasses (uint32_t port, uint32_t q);
+  };
+
+  struct Pkt
+  {
+    uint32_t in, out, q, size;
+  };
+
+  void Compare (bool dynamic);
+};
+
+SwitchMmuTest::SwitchMmuTest ()
+  : TestCase ("SwitchMmu")
+{
+}
+
+void
+SwitchMmuTest::Reference::Init (uint32_t n, uint32_t buffer, uint32_t hdrmLimit, bool dynamic)
+{
+  nPort = n;
+  dynamicth = dynamic;
+  alphaIn = 0.0625;
+  alphaEg = 1.;
+  maxBufferBytes = buffer;
+  usedTotalBytes = 0;
+  hdrm.assign (n + 1, hdrmLimit);
+  ingressPort.assign (n + 1, 0);
+  egressPort.assign (n + 1, 0);
+  kmax.assign (n + 1, 40000);
+  ingressPG.assign (n + 1, std::vector<uint32_t> (qCnt, 0));
+  ingressHdrm = egressQMin = egressQShared = ingressPG;
+  for (int i = 0; i < 4; i++)
+    {
+      ingressSP[i] = egressSP[i] = 0;
+    }
+  pgSharedLimit = dynamic ? maxBufferBytes : 20 * MTU;
+  portMaxShared = dynamic ? maxBufferBytes : 4800 * MTU;
+  pgMin = MTU;
+  portMin = MTU;
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      total += hdrm[i];
+    }
+  limitSp = maxBufferBytes - total - n * std::max (qCnt * pgMin, portMin);
+  portMinOff = 4700 * MTU;
+  pgSharedLimitOff = pgSharedLimit - 2 * MTU;
+  opBufferSharedLimit = maxBufferBytes - n * std::max (qCnt * pgMin, portMin);
+  opUcPortConfig = maxBufferBytes;
+  qMin = 1 + MTU;
+  opUcPortConfig1 = maxBufferBytes;
+}
+
+bool
+SwitchMmuTest::Reference::CheckIngress (uint32_t port, uint32_t q, uint32_t psize)
+{
+  if (usedTotalBytes + psize > maxBufferBytes)
+    {
+      return false;
+    }
+  if (ingressPG[port][q] + psize > pgMin && ingressPort[port] + psize > portMin)
+    {
+      if (ingressSP[SwitchMmu::GetIngressSP (port, q)] > limitSp)
+        {
+          if (ingressHdrm[port][q] + psize > hdrm[port])
+            {
+              return false;
+            }
+        }
+    }
+  return true;
+}
+
+bool
+SwitchMmuTest::Reference::CheckEgress (uint32_t port, uint32_t q, uint32_t psize)
+{
+  uint32_t sp = SwitchMmu::GetEgressSP (port, q);
+  if (egressSP[sp] + psize > opBufferSharedLimit || egressPort[port] + psize > opUcPortConfig
+      || egressQShared[port][q] + psize > opUcPortConfig1)
+    {
+      return false;
+    }
+  return !((double)egressQShared[port][q] + psize > alphaEg * ((double)opBufferSharedLimit - egressSP[sp]));
+}
+
+void
+SwitchMmuTest::Reference::UpdateIngress (uint32_t port, uint32_t q, uint32_t psize)
+{
+  uint32_t sp = SwitchMmu::GetIngressSP (port, q);
+  usedTotalBytes += psize;
+  ingressSP[sp] += psize;
+  ingressPort[port] += psize;
+  ingressPG[port][q] += psize;
+  if (ingressSP[sp] > limitSp)
+    {
+      ingressHdrm[port][q] += psize;
+    }
+}
+
+void
+SwitchMmuTest::Reference::UpdateEgress (uint32_t port, uint32_t q, uint32_t psize)
+{
+  uint32_t sp = SwitchMmu::GetEgressSP (port, q);
+  if (egressQMin[port][q] + psize < qMin)
+    {
+      egressQMin[port][q] += psize;
+      egressPort[port] += psize;
+    }
+  else if (egressQMin[port][q] != qMin)
+    {
+      egressQShared[port][q] = egressQShared[port][q] + psize + egressQMin[port][q] - qMin;
+      egressPort[port] += psize;
+      egressSP[sp] = egressSP[sp] + psize + egressQMin[port][q] - qMin;
+      egressQMin[port][q] = qMin;
+    }
+  else
+    {
+      egressQShared[port][q] += psize;
+      egressPort[port] += psize;
+      egressSP[sp] += psize;
+    }
+}
+
+void
+SwitchMmuTest::Reference::RemoveIngress (uint32_t port, uint32_t q, uint32_t psize)
+{
+  usedTotalBytes -= psize;
+  ingressSP[SwitchMmu::GetIngressSP (port, q)] -= psize;
+  ingressPort[port] -= psize;
+  ingressPG[port][q] -= psize;
+  if ((double)ingressHdrm[port][q] - psize > 0)
+    {
+      ingressHdrm[port][q] -= psize;
+    }
+  else
+    {
+      ingressHdrm[port][q] = 0;
+    }
+}
+
+void
+SwitchMmuTest::Reference::RemoveEgress (uint32_t port, uint32_t q, uint32_t psize)
+{
+  uint32_t sp = SwitchMmu::GetEgressSP (port, q);
+  if (egressQMin[port][q] < qMin)
+    {
+      egressQMin[port][q] -= psize;
+      egressPort[port] -= psize;
+    }
+  else if (egressQMin[port][q] == qMin && egressQShared[port][q] < psize)
+    {
+      egressQMin[port][q] = egressQMin[port][q] + egressQShared[port][q] - psize;
+      egressSP[sp] = egressSP[sp] - egressQShared[port][q];
+      egressQShared[port][q] = 0;
+      egressPort[port] -= psize;
+    }
+  else
+    {
+      egressQShared[port][q] -= psize;
+      egressPort[port] -= psize;
+      egressSP[sp] -= psize;
+    }
+}
+
+void
+SwitchMmuTest::Reference::GetPauseClasses (uint32_t port, uint32_t q, bool pClasses[])
+{
+  if (dynamicth)
+    {
+      for (uint32_t i = 0; i < qCnt; i++)
+        {
+          pClasses[i] = false;
+          if (ingressPG[port][i] <= pgMin + portMin)
+            {
+              continue;
+            }
+          if ((double)ingressPG[port][i] - pgMin - portMin
+              > alphaIn * ((double)limitSp - ingressSP[SwitchMmu::GetIngressSP (port, q)])
+              || ingressHdrm[port][q] != 0)
+            {
+              pClasses[i] = true;
+            }
+        }
+    }
+  else
+    {
+      for (uint32_t i = 0; i < qCnt; i++)
+        {
+          pClasses[i] = ingressPort[port] > portMaxShared;
+        }
+      if (ingressPG[port][q] > pgSharedLimit)
+        {
+          pClasses[q] = true;
+        }
+    }
+}
+
+bool
+SwitchMmuTest::Reference::GetResumeClasses (uint32_t port, uint32_t q)
+{
+  if (dynamicth)
+    {
+      return (double)ingressPG[port][q] - pgMin - portMin
+             < alphaIn * ((double)limitSp - ingressSP[SwitchMmu::GetIngressSP (port, q)] - 16)
+             && ingressHdrm[port][q] == 0;
+    }
+  return ingressPG[port][q] < pgSharedLimitOff && ingressPort[port] < portMinOff;
+}
+
+void
+SwitchMmuTest::Compare (bool dynamic)
+{
+  const uint32_t nPort = 16, hdrm = 12500 + 2 * SwitchMmu::MTU, buffer = 2 * 1024 * 1024;
+  Ptr<SwitchMmu> mmu = CreateObject<SwitchMmu> ();
+  mmu->SetDynamicThreshold (dynamic);
+  for (uint32_t j = 1; j <= nPort; j++)
+    {
+      mmu->ConfigEcn (j, 40, 40, 0.2);
+      mmu->ConfigHdrm (j, hdrm);
+    }
+  mmu->ConfigNPort (nPort);
+  mmu->ConfigBufferSize (buffer);
+  Reference ref;
+  ref.Init (nPort, buffer, hdrm, dynamic);
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  rng->SetStream (2);
+  std::vector<Pkt> queued;
+  uint32_t nAdmitted = 0, nDropped = 0, nPause = 0;
+  for (uint32_t step = 0; step < 400000; step++)
+    {
+      // incast towards two egress ports, drained more slowly than it is filled
+      if (queued.empty () || rng->GetValue () < 0.52)
+        {
+          Pkt pkt;
+          pkt.in = rng->GetInteger (1, nPort);
+          pkt.out = rng->GetInteger (1, 2);
+          pkt.q = rng->GetInteger (1, 4);
+          pkt.size = rng->GetInteger (64, 1100);
+          bool a = mmu->CheckEgressAdmission (pkt.out, pkt.q, pkt.size)
+                   && mmu->CheckIngressAdmission (pkt.in, pkt.q, pkt.size);
+          bool b = ref.CheckEgress (pkt.out, pkt.q, pkt.size)
+                   && ref.CheckIngress (pkt.in, pkt.q, pkt.size);
+          NS_TEST_ASSERT_MSG_EQ (a, b, "admission differs at step " << step);
+          if (!a)
+            {
+              nDropped++;
+              continue;
+            }
+          nAdmitted++;
+          mmu->UpdateIngressAdmission (pkt.in, pkt.q, pkt.size);
+          mmu->UpdateEgressAdmission (pkt.out, pkt.q, pkt.size);
+          ref.UpdateIngress (pkt.in, pkt.q, pkt.size);
+          ref.UpdateEgress (pkt.out, pkt.q, pkt.size);
+          queued.push_back (pkt);
+          bool pa[SwitchMmu::qCnt] = {0}, pb[SwitchMmu::qCnt] = {0};
+          mmu->GetPauseClasses (pkt.in, pkt.q, pa);
+          ref.GetPauseClasses (pkt.in, pkt.q, pb);
+          for (uint32_t i = 0; i < SwitchMmu::qCnt; i++)
+            {
+              NS_TEST_ASSERT_MSG_EQ (pa[i], pb[i], "pause class " << i << " differs at step " << step);
+              nPause += pa[i];
+            }
+        }
+      else
+        {
+          uint32_t k = rng->GetInteger (0, queued.size () - 1);
+          Pkt pkt = queued[k];
+          queued[k] = queued.back ();
+          queued.pop_back ();
+          mmu->RemoveFromIngressAdmission (pkt.in, pkt.q, pkt.size);
+          mmu->RemoveFromEgressAdmission (pkt.out, pkt.q, pkt.size);
+          ref.RemoveIngress (pkt.in, pkt.q, pkt.size);
+          ref.RemoveEgress (pkt.out, pkt.q, pkt.size);
+          mmu->paused[pkt.in][pkt.q] = 1;
+          NS_TEST_ASSERT_MSG_EQ (mmu->GetResumeClasses (pkt.in, pkt.q), ref.GetResumeClasses (pkt.in, pkt.q),
+                                 "resume differs at step " << step);
+          NS_TEST_ASSERT_MSG_EQ (mmu->ShouldSendCN (pkt.out, pkt.q),
+                                 (ref.egressQShared[pkt.out][pkt.q] > ref.kmax[pkt.out]),
+                                 "ECN marking differs at step " << step);
+        }
+      NS_TEST_ASSERT_MSG_EQ (mmu->GetUsedBufferTotal (), ref.usedTotalBytes, "occupancy differs at step " << step);
+    }
+  NS_TEST_ASSERT_MSG_GT (nDropped, 0, "workload never reached the admission limits");
+  if (dynamic)
+    {
+      NS_TEST_ASSERT_MSG_GT (nPause, 0, "workload never crossed the pause threshold");
+    }
+}
+
+void
+SwitchMmuTest::DoRun (void)
+{
+  Compare (true);
+  Compare (false);
+
+  // radix above the former 128-port limit, and accounting in 256-byte cells
+  Ptr<SwitchMmu> mmu = CreateObject<SwitchMmu> ();
+  mmu->SetCellSize (256);
+  for (uint32_t j = 1; j <= 256; j++)
+    {
+      mmu->ConfigEcn (j, 40, 40, 0.2);
+      mmu->ConfigHdrm (j, 12500 + 2 * SwitchMmu::MTU);
+    }
+  mmu->ConfigNPort (256);
+  mmu->ConfigBufferSize (64 * 1024 * 1024);
+  NS_TEST_ASSERT_MSG_EQ (mmu->CheckEgressAdmission (250, 3, 1000), true, "port 250 rejected");
+  NS_TEST_ASSERT_MSG_EQ (mmu->CheckIngressAdmission (200, 3, 1000), true, "port 200 rejected");
+  mmu->UpdateIngressAdmission (200, 3, 1000);
+  mmu->UpdateEgressAdmission (250, 3, 1000);
+  NS_TEST_ASSERT_MSG_EQ (mmu->GetUsedBufferTotal (), 1024, "1000B should take 4 cells of 256B");
+  mmu->RemoveFromIngressAdmission (200, 3, 1000);
+  mmu->RemoveFromEgressAdmission (250, 3, 1000);
+  NS_TEST_ASSERT_MSG_EQ (mmu->GetUsedBufferTotal (), 0, "cells leaked");
+  Simulator::Destroy ();
+}
+//-----------------------------------------------------------------------------
+// FluidFlowModel: max-min fair rates by progressive filling over links of different
+// capacity, the residual rate left to packets on each device, and the rates after a
+// flow completes. MaxLinkShare must leave part of every link to packets.
+class FluidFlowModelTest : public TestCase
+{
+public:
+  FluidFlowModelTest ();
+
+  virtual void DoRun (void);
+
+private:
+  void Done (uint32_t id);
+
+  std::vector<std::pair<uint32_t, Time> > m_done;
+};
+
+FluidFlowModelTest::FluidFlowModelTest ()
+  : TestCase ("FluidFlowModel")
+{
+}
+
+void
+FluidFlowModelTest::Done (uint32_t id)
+{
+  m_done.push_back (std::make_pair (id, Simulator::Now ()));
+}
+
+void
+FluidFlowModelTest::DoRun (void)
+{
+  const uint64_t G = 1000000000;
+  Ptr<QbbNetDevice> d0 = CreateObject<QbbNetDevice> ();
+  Ptr<QbbNetDevice> d1 = CreateObject<QbbNetDevice> ();
+  Ptr<QbbNetDevice> d2 = CreateObject<QbbNetDevice> ();
+  d0->SetDataRate (DataRate (10 * G));
+  d1->SetDataRate (DataRate (10 * G));
+  d2->SetDataRate (DataRate (40 * G));
+
+  Ptr<FluidFlowModel> model = CreateObject<FluidFlowModel> ();
+  NS_TEST_ASSERT_MSG_EQ (model->SetAttributeFailSafe ("MaxLinkShare", DoubleValue (1.0)), false,
+                         "fluid flows must not be allowed to take whole links");
+  model->SetAttribute ("MaxLinkShare", DoubleValue (0.5));
+
+  // capacities 5, 5 and 20 Gbps. Flows 0 and 1 share d0 (2.5 each), flow 2 gets what flow 1
+  // leaves on d1 (2.5), flow 3 gets what flow 2 leaves on d2 (17.5)
+  std::vector<Ptr<QbbNetDevice> > p0 (1, d0), p1, p2, p3 (1, d2);
+  p1.push_back (d0);
+  p1.push_back (d1);
+  p2.push_back (d1);
+  p2.push_back (d2);
+  FluidFlowModel::FluidFlowDoneCallback cb = MakeCallback (&FluidFlowModelTest::Done, this);
+  model->AddFlow (0, 1250000, p0, MicroSeconds (1), cb);   // 1.25MB: 4ms at 2.5Gbps
+  model->AddFlow (1, 100000000, p1, MicroSeconds (2), cb);
+  model->AddFlow (2, 100000000, p2, MicroSeconds (2), cb);
+  model->AddFlow (3, 100000000, p3, MicroSeconds (1), cb);
+  NS_TEST_ASSERT_MSG_EQ (model->GetFlowRate (0), 2500000000ull, "flow 0 not at its fair share");
+  NS_TEST_ASSERT_MSG_EQ (model->GetFlowRate (1), 2500000000ull, "flow 1 not at its fair share");
+  NS_TEST_ASSERT_MSG_EQ (model->GetFlowRate (2), 2500000000ull, "flow 2 not at its fair share");
+  NS_TEST_ASSERT_MSG_EQ (model->GetFlowRate (3), 17500000000ull, "flow 3 not at its fair share");
+  NS_TEST_ASSERT_MSG_EQ (d0->GetFluidRate (), 5 * G, "fluid load of d0");
+  NS_TEST_ASSERT_MSG_EQ (d1->GetFluidRate (), 5 * G, "fluid load of d1");
+  NS_TEST_ASSERT_MSG_EQ (d2->GetFluidRate (), 20 * G, "fluid load of d2");
+  NS_TEST_ASSERT_MSG_EQ (d0->GetResidualRate ().GetBitRate (), 5 * G, "residual rate of d0");
+  NS_TEST_ASSERT_MSG_EQ (d2->GetResidualRate ().GetBitRate (), 20 * G, "residual rate of d2");
+
+  // flow 0 ends at 4ms: flow 1 is still held to 2.5 by d1, so d0 returns 2.5 to packets
+  Simulator::Stop (MilliSeconds (5));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_done.size (), 1, "only flow 0 should have completed");
+  if (m_done.size () == 1)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_done[0].first, 0, "wrong flow completed");
+      NS_TEST_ASSERT_MSG_EQ (m_done[0].second, MilliSeconds (4) + MicroSeconds (1),
+                             "completion not at transfer time + propagation delay");
+    }
+  NS_TEST_ASSERT_MSG_EQ (model->GetNActiveFlows (), 3, "completed flow still active");
+  NS_TEST_ASSERT_MSG_EQ (model->GetFlowRate (1), 2500000000ull, "flow 1 rate after completion");
+  NS_TEST_ASSERT_MSG_EQ (d0->GetFluidRate (), 2500000000ull, "fluid load of d0 after completion");
+  NS_TEST_ASSERT_MSG_EQ (d0->GetResidualRate ().GetBitRate (), 7500000000ull,
+                         "residual rate of d0 after completion");
+  model->Dispose ();
+  Simulator::Destroy ();
+
+  // the largest share still leaves packets a non-zero rate
+  m_done.clear ();
+  Ptr<QbbNetDevice> d = CreateObject<QbbNetDevice> ();
+  d->SetDataRate (DataRate (100 * G));
+  model = CreateObject<FluidFlowModel> ();
+  model->SetAttribute ("MaxLinkShare", DoubleValue (0.99));
+  model->AddFlow (0, 100000000, std::vector<Ptr<QbbNetDevice> > (1, d), Seconds (0), cb);
+  NS_TEST_ASSERT_MSG_EQ (d->GetFluidRate (), 99 * G, "fluid load at the largest share");
+  NS_TEST_ASSERT_MSG_EQ (d->GetResidualRate ().GetBitRate (), 1 * G,
+                         "residual rate at the largest share");
+  model->Dispose ();
+  Simulator::Destroy ();
+}
+//-----------------------------------------------------------------------------
+// TopologySpec: text round trip, every rejection of Validate, node and link counts of the
+// generators with their parameter checks, and the key check of TopologyCache.
+class TopologySpecTest : public TestCase
+{
+public:
+  TopologySpecTest ();
+
+  virtual void DoRun (void);
+
+private:
+  void CheckRejected (const TopologySpec &t, uint32_t badLink, const std::string &msg);
+  void CheckGenerated (const std::string &spec, uint32_t nNodes, uint32_t nSwitches,
+                       uint32_t nLinks, uint64_t delayNs);
+  static bool Same (const TopologySpec &a, const TopologySpec &b);
+};
+
+TopologySpecTest::TopologySpecTest ()
+  : TestCase ("TopologySpec")
+{
+}
+
+bool
+TopologySpecTest::Same (const TopologySpec &a, const TopologySpec &b)
+{
+  if (a.nNodes != b.nNodes || a.isSwitch != b.isSwitch || a.links.size () != b.links.size ())
+    {
+      return false;
+    }
+  for (uint32_t i = 0; i < a.links.size (); i++)
+    {
+      const TopologyLink &x = a.links[i], &y = b.links[i];
+      if (x.src != y.src || x.dst != y.dst || x.rate != y.rate || x.delay != y.delay
+          || x.bps != y.bps || x.delayNs != y.delayNs || x.errorRate != y.errorRate)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+void
+TopologySpecTest::CheckRejected (const TopologySpec &t, uint32_t badLink, const std::string &msg)
+{
+  std::string err;
+  uint32_t bad = 12345;
+  NS_TEST_ASSERT_MSG_EQ (t.Validate (&err, &bad), false, "accepted a spec with " << msg);
+  NS_TEST_ASSERT_MSG_EQ (bad, badLink, "wrong link blamed for " << msg);
+  NS_TEST_ASSERT_MSG_NE (err.find (msg), std::string::npos, "unexpected error '" << err << "'");
+}
+
+void
+TopologySpecTest::CheckGenerated (const std::string &spec, uint32_t nNodes, uint32_t nSwitches,
+                                  uint32_t nLinks, uint64_t delayNs)
+{
+  TopologySpec t;
+  std::string err;
+  NS_TEST_ASSERT_MSG_EQ (TopologySpec::IsGeneratorSpec (spec), true, spec << " not a generator");
+  NS_TEST_ASSERT_MSG_EQ (TopologySpec::Generate (spec, t, &err), true, spec << ": " << err);
+  NS_TEST_ASSERT_MSG_EQ (t.nNodes, nNodes, "node count of " << spec);
+  NS_TEST_ASSERT_MSG_EQ (t.GetNSwitches (), nSwitches, "switch count of " << spec);
+  NS_TEST_ASSERT_MSG_EQ (t.links.size (), nLinks, "link count of " << spec);
+  NS_TEST_ASSERT_MSG_EQ (t.links.back ().delayNs, delayNs, "link delay of " << spec);
+}
+
+void
+TopologySpecTest::DoRun (void)
+{
+  // 3 hosts, 2 switches; host 0 has two NICs
+  const std::string text =
+    "5 2 5\n"
+    "3 4\n"
+    "0 3 100Gbps 1000ns 0\n"
+    "0 4 100Gbps 1000ns 0\n"
+    "1 3 100Gbps 1us 0\n"
+    "2 4 40Gbps 1000ns 0.001\n"
+    "3 4 400Gbps 2us 0\n";
+  TopologySpec t;
+  std::string err;
+  std::istringstream is (text);
+  NS_TEST_ASSERT_MSG_EQ (t.Load (is, &err), true, err);
+  NS_TEST_ASSERT_MSG_EQ (t.GetNSwitches (), 2, "switches of the loaded spec");
+  NS_TEST_ASSERT_MSG_EQ (t.links[2].delayNs, 1000, "1us not parsed as 1000ns");
+  NS_TEST_ASSERT_MSG_EQ (t.links[4].bps, 400000000000ull, "400Gbps not parsed");
+  std::ostringstream os;
+  t.Write (os);
+  TopologySpec u;
+  std::istringstream is2 (os.str ());
+  NS_TEST_ASSERT_MSG_EQ (u.Load (is2, &err), true, err);
+  NS_TEST_ASSERT_MSG_EQ (Same (t, u), true, "spec changed through Write and Load");
+  std::ostringstream os2;
+  u.Write (os2);
+  NS_TEST_ASSERT_MSG_EQ (os2.str (), os.str (), "Write not stable");
+
+  std::istringstream bad ("5 2 5\n3 4\n0 3 100Gbps 1000ns 0\n0 4 100Gbit 1000ns 0\n");
+  NS_TEST_ASSERT_MSG_EQ (u.Load (bad, &err), false, "accepted a bad rate");
+  NS_TEST_ASSERT_MSG_EQ (err, "line 4: bad rate 100Gbit", "load error without its line");
+
+  // every rejection of Validate, with the link at fault
+  u = t;
+  u.isSwitch.pop_back ();
+  CheckRejected (u, 5, "node types do not match the node count");
+  u = t;
+  u.links[1].dst = 5;
+  CheckRejected (u, 1, "node out of range");
+  u = t;
+  u.links[2].dst = 1;
+  CheckRejected (u, 2, "self loop");
+  u = t;
+  u.links[2].dst = 2;
+  CheckRejected (u, 2, "hosts attach to switches only");
+  u = t;
+  u.links[4].src = 4;
+  u.links[4].dst = 0;
+  CheckRejected (u, 4, "parallel link");
+  u = t;
+  u.links[3].bps = 0;
+  CheckRejected (u, 3, "zero rate");
+  u = t;
+  u.links[0].delayNs = 0;
+  CheckRejected (u, 0, "zero delay");
+  u = t;
+  u.links[3].errorRate = 1.5;
+  CheckRejected (u, 3, "error rate not in [0, 1]");
+  u = t;
+  u.links[3].errorRate = -0.1;
+  CheckRejected (u, 3, "error rate not in [0, 1]");
+  u = t;
+  u.links.erase (u.links.begin () + 3);
+  CheckRejected (u, 4, "host 2 belongs to no link");
+
+  // generators: 4 leaves x 3 hosts, 2 spines, 2 planes; k=4 fat-tree with 2 hosts per ToR
+  CheckGenerated ("leaf_spine:leaves=4,spines=2,hosts=3,planes=2", 24, 12, 40, 1000);
+  CheckGenerated ("leaf_spine:leaves=4,spines=2,hosts=3,delay=2us,uplink=400Gbps", 18, 6, 20,
+                  2000);
+  CheckGenerated ("fat_tree:k=4,os=1,delay=500", 36, 20, 48, 500);
+  CheckGenerated ("fat_tree:k=4,os=2", 52, 20, 64, 1000);
+  const char *rejected[] = {
+    "leaf_spine:leaves=4x", "leaf_spine:leaves=0", "leaf_spine:hosts=", "leaf_spine:planes=-1",
+    "leaf_spine:delay=1x", "leaf_spine:delay=0", "leaf_spine:rate=100", "leaf_spine:bogus=1",
+    "fat_tree:k=5", "fat_tree:k=4.0", "fat_tree:os=99999999999", "mesh:n=4",
+  };
+  for (uint32_t i = 0; i < sizeof (rejected) / sizeof (rejected[0]); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (TopologySpec::Generate (rejected[i], u, &err), false,
+                             "accepted " << rejected[i]);
+    }
+
+  // ToR-to-ToR load balancers need single-NIC hosts: host 0 above has two, and so has every
+  // host of a leaf-spine with two planes
+  const uint32_t torLbModes[] = {3, 6, 9};
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (t.SupportsLbMode (torLbModes[i], &err), false,
+                             "lb_mode " << torLbModes[i] << " accepted with a multi-NIC host");
+      NS_TEST_ASSERT_MSG_NE (err.find ("host 0 has 2 NICs"), std::string::npos,
+                             "unexpected error '" << err << "'");
+    }
+  NS_TEST_ASSERT_MSG_EQ (t.SupportsLbMode (0, &err), true, "ECMP rejected with a multi-NIC host");
+  NS_TEST_ASSERT_MSG_EQ (TopologySpec::Generate ("leaf_spine:leaves=4,spines=4,hosts=8,planes=2",
+                                                 u, &err), true, err);
+  NS_TEST_ASSERT_MSG_EQ (u.SupportsLbMode (3, &err), false, "CONGA accepted with two planes");
+  NS_TEST_ASSERT_MSG_EQ (TopologySpec::Generate ("leaf_spine:leaves=4,spines=4,hosts=8", u, &err),
+                         true, err);
+  NS_TEST_ASSERT_MSG_EQ (u.SupportsLbMode (3, &err), true, "CONGA rejected with one plane");
+
+  // the cache is only used with the key it was saved with
+  TopologyRoutes routes, loadedRoutes;
+  TopologyRoutes::Entry e;
+  e.node = 3;
+  e.host = 1;
+  e.delay = 1000;
+  e.txDelay = 80;
+  e.bw = 100000000000ull;
+  e.nexts.push_back (1);
+  routes.entries.push_back (e);
+  uint64_t key, otherKey;
+  NS_TEST_ASSERT_MSG_EQ (TopologyCache::SourceKey ("fat_tree:k=4", 0, key), true, "no key");
+  NS_TEST_ASSERT_MSG_EQ (TopologyCache::SourceKey ("fat_tree:k=4", 1, otherKey), true, "no key");
+  NS_TEST_ASSERT_MSG_NE (key, otherKey, "extra not part of the key");
+  std::string file = CreateTempDirFilename ("topology-cache.bin");
+  NS_TEST_ASSERT_MSG_EQ (TopologyCache::Save (file, key, t, routes), true, "cannot save " << file);
+  u = TopologySpec ();
+  NS_TEST_ASSERT_MSG_EQ (TopologyCache::Load (file, otherKey, u, loadedRoutes), false,
+                         "cache used with another key");
+  NS_TEST_ASSERT_MSG_EQ (TopologyCache::Load (file, key, u, loadedRoutes), true,
+                         "cache not used with its key");
+  NS_TEST_ASSERT_MSG_EQ (Same (t, u), true, "spec changed through the cache");
+  NS_TEST_ASSERT_MSG_EQ (loadedRoutes.entries.size (), 1, "routes lost in the cache");
+  if (loadedRoutes.entries.size () == 1)
+    {
+      const TopologyRoutes::Entry &l = loadedRoutes.entries[0];
+      bool same = l.node == e.node && l.host == e.host && l.delay == e.delay
+        && l.txDelay == e.txDelay && l.bw == e.bw && l.nexts == e.nexts;
+      NS_TEST_ASSERT_MSG_EQ (same, true, "route changed through the cache");
+    }
+
+  // a truncated or damaged file is a miss that leaves the outputs alone
+  std::string bytes;
+  {
+    std::ifstream in (file.c_str (), std::ios::binary);
+    std::ostringstream oss;
+    oss << in.rdbuf ();
+    bytes = oss.str ();
+  }
+  std::string damaged = CreateTempDirFilename ("topology-cache-damaged.bin");
+  const uint64_t hugeCount = ~(uint64_t)0;
+  std::string huge = bytes;  // the entry count is 48 bytes from the end: 8 + one entry of 40
+  huge.replace (huge.size () - 48, 8, (const char *)&hugeCount, 8);
+  const std::string variants[] = {bytes.substr (0, bytes.size () - 2),
+                                  bytes.substr (0, bytes.size () / 2), huge};
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      std::ofstream out (damaged.c_str (), std::ios::binary);
+      out << variants[i];
+      out.close ();
+      NS_TEST_ASSERT_MSG_EQ (TopologyCache::Load (damaged, key, u, loadedRoutes), false,
+                             "damaged cache " << i << " used");
+      NS_TEST_ASSERT_MSG_EQ (Same (t, u) && loadedRoutes.entries.size () == 1, true,
+                             "damaged cache " << i << " changed the outputs");
+    }
+  // route node ids out of range, or towards a switch
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      TopologyRoutes wrong = routes;
+      if (i == 0)
+        {
+          wrong.entries[0].node = 5;
+        }
+      else if (i == 1)
+        {
+          wrong.entries[0].nexts.push_back (7);
+        }
+      else
+        {
+          wrong.entries[0].host = 4;
+        }
+      NS_TEST_ASSERT_MSG_EQ (TopologyCache::Save (damaged, key, t, wrong), true, "cannot save");
+      NS_TEST_ASSERT_MSG_EQ (TopologyCache::Load (damaged, key, u, loadedRoutes), false,
+                             "cache with bad route " << i << " used");
+    }
+  std::remove (damaged.c_str ());
+  std::remove (file.c_str ());
+}
+//-----------------------------------------------------------------------------
+// PfcMonitor: three switches in a ring, each paused towards the next one on the same
+// priority. The cycle is a deadlock once every pause has lasted StormThreshold, and the
+// devices account the paused time of each interval.
+class PfcMonitorTest : public TestCase
+{
+public:
+  PfcMonitorTest ();
+
+  virtual void DoRun (void);
+
+private:
+  static Ptr<Packet> MakePfc (uint32_t qIndex, uint32_t time);
+  void Pfc (Ptr<QbbNetDevice> dev, uint32_t qIndex, uint32_t time);
+  void Check (uint32_t nDeadlocks);
+
+  Ptr<PfcMonitor> m_monitor;
+};
+
+PfcMonitorTest::PfcMonitorTest ()
+  : TestCase ("PfcMonitor")
+{
+}
+
+// a PFC frame as QbbNetDevice::SendPfc builds it, time in us (0: resume)
+Ptr<Packet>
+PfcMonitorTest::MakePfc (uint32_t qIndex, uint32_t time)
+{
+  Ptr<Packet> p = Create<Packet> (0);
+  p->AddHeader (PauseHeader (time, 0, qIndex));
+  Ipv4Header ipv4h;
+  ipv4h.SetProtocol (0xFE);
+  ipv4h.SetDestination (Ipv4Address ("255.255.255.255"));
+  ipv4h.SetPayloadSize (p->GetSize ());
+  ipv4h.SetTtl (1);
+  p->AddHeader (ipv4h);
+  PppHeader ppp;
+  ppp.SetProtocol (0x0021);
+  p->AddHeader (ppp);
+  return p;
+}
+
+void
+PfcMonitorTest::Pfc (Ptr<QbbNetDevice> dev, uint32_t qIndex, uint32_t time)
+{
+  dev->Receive (MakePfc (qIndex, time));
+}
+
+void
+PfcMonitorTest::Check (uint32_t nDeadlocks)
+{
+  m_monitor->CheckDeadlock ();
+  NS_TEST_ASSERT_MSG_EQ (m_monitor->GetNDeadlocks (), nDeadlocks,
+                         "deadlocks at " << Simulator::Now ().GetMicroSeconds () << " us");
+}
+
+void
+PfcMonitorTest::DoRun (void)
+{
+  const uint32_t q = 3;
+  std::vector<Ptr<SwitchNode> > sw;
+  std::vector<Ptr<QbbNetDevice> > dev;  // dev[i]: port of sw[i] towards sw[i + 1]
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      sw.push_back (CreateObject<SwitchNode> ());
+    }
+  m_monitor = CreateObject<PfcMonitor> ();
+  m_monitor->SetAttribute ("StormThreshold", TimeValue (MilliSeconds (1)));
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      Ptr<QbbNetDevice> a = CreateObject<QbbNetDevice> ();
+      Ptr<QbbNetDevice> b = CreateObject<QbbNetDevice> ();
+      a->SetQueue (CreateObject<BEgressQueue> ());
+      b->SetQueue (CreateObject<BEgressQueue> ());
+      sw[i]->AddDevice (a);
+      sw[(i + 1) % 3]->AddDevice (b);
+      Ptr<QbbChannel> ch = CreateObject<QbbChannel> ();
+      a->Attach (ch);
+      b->Attach (ch);
+      m_monitor->AddDevice (a);
+      m_monitor->AddDevice (b);
+      dev.push_back (a);
+    }
+
+  // pauses of 10ms; dev[1] is paused again while paused, dev[0] resumes at 3ms
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      Simulator::Schedule (Seconds (0), &PfcMonitorTest::Pfc, this, dev[i], q, 10000);
+    }
+  Simulator::Schedule (MicroSeconds (500), &PfcMonitorTest::Check, this, 0);
+  Simulator::Schedule (MicroSeconds (700), &PfcMonitorTest::Pfc, this, dev[1], q, 10000);
+  Simulator::Schedule (MilliSeconds (2), &PfcMonitorTest::Check, this, 1);
+  Simulator::Schedule (MicroSeconds (2500), &PfcMonitorTest::Check, this, 1);
+  Simulator::Schedule (MilliSeconds (3), &PfcMonitorTest::Pfc, this, dev[0], q, 0);
+  Simulator::Schedule (MilliSeconds (4), &PfcMonitorTest::Check, this, 1);
+  Simulator::Stop (MilliSeconds (4));
+  Simulator::Run ();
+
+  const QbbNetDevice::PauseStats &ps0 = dev[0]->GetPauseStats (q);
+  NS_TEST_ASSERT_MSG_EQ (dev[0]->IsPaused (q), false, "dev 0 not resumed");
+  NS_TEST_ASSERT_MSG_EQ (ps0.nPause, 1, "pauses of dev 0");
+  NS_TEST_ASSERT_MSG_EQ (ps0.total, MilliSeconds (3), "paused time of dev 0");
+  NS_TEST_ASSERT_MSG_EQ (ps0.longest, MilliSeconds (3), "longest pause of dev 0");
+  const QbbNetDevice::PauseStats &ps1 = dev[1]->GetPauseStats (q);
+  NS_TEST_ASSERT_MSG_EQ (dev[1]->IsPaused (q), true, "dev 1 resumed");
+  NS_TEST_ASSERT_MSG_EQ (ps1.nPause, 1, "a pause while paused counted as a new one");
+  NS_TEST_ASSERT_MSG_EQ (ps1.since, Seconds (0), "open interval of dev 1 restarted");
+  NS_TEST_ASSERT_MSG_EQ (ps1.total, Seconds (0), "open interval of dev 1 accounted");
+  NS_TEST_ASSERT_MSG_EQ (dev[0]->GetPauseStats (q + 1).nPause, 0, "pause on the wrong priority");
+
+  std::ostringstream os, cycle;
+  m_monitor->Report (os);
+  cycle << "PFC deadlock at 2000 us, prio 3: node " << sw[0]->GetId () << " -> "
+        << sw[1]->GetId () << " -> " << sw[2]->GetId () << " -> " << sw[0]->GetId ();
+  NS_TEST_ASSERT_MSG_NE (os.str ().find (cycle.str ()), std::string::npos,
+                         "cycle not reported: " << os.str ());
+  m_monitor->Dispose ();
+  m_monitor = 0;
+  Simulator::Destroy ();
+}
+//-----------------------------------------------------------------------------
 class PointToPointTestSuite : public TestSuite
 {
 public:
@@ -66,6 +1063,11 @@ PointToPointTestSuite::PointToPointTestSuite ()
   : TestSuite ("devices-point-to-point", UNIT)
 {
   AddTestCase (new PointToPointTest);
+  AddTestCase (new RdmaTimerWheelTest);
+  AddTestCase (new SwitchMmuTest);
+  AddTestCase (new FluidFlowModelTest);
+  AddTestCase (new TopologySpecTest);
+  AddTestCase (new PfcMonitorTest);
 }
 
 static PointToPointTestSuite g_pointToPointTestSuite;
@@ -0,0 +1,193 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Cost of the callbacks on the packet path: a member function bound to its object, as
+// m_rdmaGetNxtPkt and m_rdmaReceiveCb, and a function with bound arguments, as the switch send
+// callbacks of CONGA and ConWeave. Each is made, copied and invoked from a table of kTable
+// callbacks with distinct targets, so that the targets are not all in the L1 cache. The
+// reference is the same callback with its implementation on the heap, shared by reference
+// count, as every Callback was before the inline buffer.
+
+#include <stdlib.h>  // for exit ()
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/callback.h"
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/system-wall-clock-ms.h"
+
+using namespace ns3;
+
+static const uint32_t kTable = 4096;
+
+class Target : public SimpleRefCount<Target> {
+   public:
+    explicit Target(uint32_t id) : m_id(id), m_count(0) {}
+    uint32_t Receive(uint32_t size, uint32_t port) {
+        m_count += size;
+        return m_id + port;
+    }
+
+    uint32_t m_id;
+    uint64_t m_count;
+};
+
+static uint32_t SwitchSend(Ptr<Target> sw, uint32_t port, uint32_t size, uint32_t qIndex) {
+    return sw->Receive(size, port) + qIndex;
+}
+
+typedef Callback<uint32_t, uint32_t, uint32_t> MemberCb;
+typedef Callback<uint32_t, uint32_t> BoundCb;
+
+static MemberCb MakeMember(Ptr<Target> t, bool inlined) {
+    if (inlined) {
+        return MakeCallback(&Target::Receive, t);
+    }
+    Ptr<CallbackImpl<uint32_t, uint32_t, uint32_t, empty, empty, empty, empty, empty, empty,
+                     empty> >
+        impl = Create<MemPtrCallbackImpl<Ptr<Target>, uint32_t (Target::*)(uint32_t, uint32_t),
+                                         uint32_t, uint32_t, uint32_t, empty, empty, empty,
+                                         empty, empty, empty, empty> >(t, &Target::Receive);
+    return MemberCb(impl);
+}
+
+static BoundCb MakeBound(Ptr<Target> t, uint32_t port, uint32_t size, bool inlined) {
+    if (inlined) {
+        return MakeBoundCallback(&SwitchSend, t, port, size);
+    }
+    Ptr<CallbackImpl<uint32_t, uint32_t, empty, empty, empty, empty, empty, empty, empty,
+                     empty> >
+        impl = Create<ThreeBoundFunctorCallbackImpl<
+            uint32_t (*)(Ptr<Target>, uint32_t, uint32_t, uint32_t), uint32_t, Ptr<Target>,
+            uint32_t, uint32_t, uint32_t, empty, empty, empty, empty, empty> >(&SwitchSend, t,
+                                                                               port, size);
+    return BoundCb(impl);
+}
+
+static std::vector<Ptr<Target> > g_targets;
+
+static void MakeTable(std::vector<MemberCb> &m, std::vector<BoundCb> &b, bool inlined) {
+    m.clear();
+    b.clear();
+    for (uint32_t i = 0; i < kTable; i++) {
+        m.push_back(MakeMember(g_targets[i], inlined));
+        b.push_back(MakeBound(g_targets[i], i % 16, 1000 + i, inlined));
+    }
+}
+
+static uint64_t InvokeAll(const std::vector<MemberCb> &m, const std::vector<BoundCb> &b,
+                          uint32_t n) {
+    uint64_t sum = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        uint32_t i = (k * 2654435761u) % kTable;  // not in table order
+        sum += m[i](1000, k & 15);
+        sum += b[i](k & 7);
+    }
+    return sum;
+}
+
+static void CheckEquivalence(void) {
+    std::vector<MemberCb> m1, m2;
+    std::vector<BoundCb> b1, b2;
+    MakeTable(m1, b1, false);
+    MakeTable(m2, b2, true);
+    uint64_t a = InvokeAll(m1, b1, 100000);
+    uint64_t c = InvokeAll(m2, b2, 100000);
+    std::vector<MemberCb> m3(m2);  // copies of inline callbacks
+    std::vector<BoundCb> b3(b2);
+    uint64_t d = InvokeAll(m3, b3, 100000);
+    if (a != c || c != d) {
+        std::cerr << "Error-- callback results differ: " << a << " " << c << " " << d
+                  << std::endl;
+        exit(1);
+    }
+    if (!m3[7].IsEqual(m2[7]) || m3[7].IsEqual(m2[8])) {
+        std::cerr << "Error-- copied callbacks do not compare equal" << std::endl;
+        exit(1);
+    }
+}
+
+static uint64_t g_sink;
+
+static void Print(double ns, const char *what, uint64_t deltaMs, const char *impl) {
+    std::cout << ns << " ns/" << what << " (" << deltaMs << " ms elapsed)\t" << impl
+              << std::endl;
+}
+
+static void RunBench(uint32_t n, bool inlined) {
+    const char *impl = inlined ? "inline buffer" : "heap, refcounted";
+    std::vector<MemberCb> m;
+    std::vector<BoundCb> b;
+    SystemWallClockMs time;
+
+    time.Start();
+    for (uint32_t k = 0; k < n / kTable; k++) {
+        MakeTable(m, b, inlined);
+    }
+    uint64_t deltaMs = time.End();
+    Print(deltaMs * 1e6 / std::max(n / kTable * kTable * 2, 1u), "make+destroy", deltaMs, impl);
+
+    time.Start();
+    g_sink += InvokeAll(m, b, n);
+    deltaMs = time.End();
+    Print(deltaMs * 1e6 / std::max(n * 2, 1u), "invoke", deltaMs, impl);
+
+    time.Start();
+    for (uint32_t k = 0; k < n / kTable; k++) {
+        std::vector<MemberCb> m2(m);
+        std::vector<BoundCb> b2(b);
+        g_sink += m2.size() + b2.size();
+    }
+    deltaMs = time.End();
+    Print(deltaMs * 1e6 / std::max(n / kTable * kTable * 2, 1u), "copy+destroy", deltaMs, impl);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t n = 0;
+    while (argc > 0) {
+        if (strncmp("--n=", argv[0], strlen("--n=")) == 0) {
+            char const *nAscii = argv[0] + strlen("--n=");
+            std::istringstream iss;
+            iss.str(nAscii);
+            iss >> n;
+        }
+        argc--;
+        argv++;
+    }
+    if (n == 0) {
+        std::cerr << "Error-- number of calls must be specified "
+                  << "by command-line argument --n=(number of calls)" << std::endl;
+        exit(1);
+    }
+    std::cout << "Running bench-callback with n=" << n << ", " << sizeof(MemberCb)
+              << " bytes/Callback" << std::endl;
+
+    for (uint32_t i = 0; i < kTable; i++) {
+        g_targets.push_back(Create<Target>(i));
+    }
+    CheckEquivalence();
+    RunBench(n, false);
+    RunBench(n, true);
+    return g_sink == 0xdeadbeef;
+}
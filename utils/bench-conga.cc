@@ -0,0 +1,265 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Cost of a CONGA flowlet decision at a TxToR of a leaf-spine: GetBestPath over the paths to
+// the destination ToR, then the DRE update of the chosen uplink, with feedback arriving in
+// between and the DRE decaying every m_dreTime. The former tables (std::map/std::set, a copy
+// of the feedback map per decision, a periodic DRE event over all ports) are kept here as
+// the reference.
+
+#include <stdlib.h>  // for exit ()
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/conga-routing.h"
+#include "ns3/custom-header.h"
+#include "ns3/simulator.h"
+#include "ns3/system-wall-clock-ms.h"
+
+using namespace ns3;
+
+static const uint32_t kNToR = 8;       // destination ToRs
+static const uint32_t kNUplink = 16;   // uplinks (spines), one path per uplink
+static const uint32_t kChunk = 256;    // decisions per simulation event
+static const uint64_t kBitRate = 100000000000lu;
+static const Time kDreTime = MicroSeconds(50);  // driver defaults
+static const uint32_t kQuantizeBit = 3;
+static const double kAlpha = 0.2;
+
+static uint32_t PathOf(uint32_t uplink, uint32_t dstToR) {
+    uint8_t ports[4] = {(uint8_t)(1 + uplink), (uint8_t)(1 + dstToR), 0, 0};
+    return *((uint32_t *)ports);
+}
+
+// reference: the CONGA tables before they became dense arrays
+class LegacyConga {
+   public:
+    void Start() { m_dreEvent = Simulator::Schedule(kDreTime, &LegacyConga::DreEvent, this); }
+    void Stop() { m_dreEvent.Cancel(); }
+    void AddPath(uint32_t dstToR, uint32_t pathId) {
+        m_congaRoutingTable[dstToR].insert(pathId);
+        m_congaToLeafTable[dstToR];
+    }
+    void SetLinkCapacity(uint32_t outPort, uint64_t bitRate) { m_bitRate[outPort] = bitRate; }
+    void UpdateToLeaf(uint32_t dstToR, uint32_t pathId, uint32_t ce) {
+        OutpathInfo &info = m_congaToLeafTable[dstToR][pathId];
+        info._ce = ce;
+        info._updateTime = Simulator::Now();
+    }
+    uint32_t UpdateLocalDre(Ptr<Packet> p, CustomHeader ch, uint32_t outPort) {
+        uint32_t newX = m_DreMap[outPort] + p->GetSize();
+        m_DreMap[outPort] = newX;
+        return newX;
+    }
+    uint32_t QuantizingX(uint32_t outPort, uint32_t X) {
+        auto it = m_bitRate.find(outPort);
+        assert(it != m_bitRate.end());
+        double ratio = static_cast<double>(X * 8) / (it->second * kDreTime.GetSeconds() / kAlpha);
+        return static_cast<uint32_t>(ratio * std::pow(2, kQuantizeBit));
+    }
+    uint32_t GetBestPath(uint32_t dstToRId, uint32_t nSample) {
+        auto pathItr = m_congaRoutingTable.find(dstToRId);
+        std::set<uint32_t>::iterator innerPathItr = pathItr->second.begin();
+        if (pathItr->second.size() >= nSample) {
+            std::advance(innerPathItr, rand() % (pathItr->second.size() - nSample + 1));
+        } else {
+            nSample = pathItr->second.size();
+        }
+        auto pathInfoMap = m_congaToLeafTable[dstToRId];
+        std::vector<uint32_t> candidatePaths;
+        uint32_t minCongestion = CONGA_NULL;
+        for (uint32_t i = 0; i < nSample; i++) {
+            uint32_t pathId = *innerPathItr;
+            auto innerPathInfo = pathInfoMap.find(pathId);
+            uint32_t localCongestion = 0;
+            uint32_t remoteCongestion = 0;
+            auto outPort = CongaRouting::GetOutPortFromPath(pathId, 0);
+            auto innerDre = m_DreMap.find(outPort);
+            if (innerDre != m_DreMap.end()) {
+                localCongestion = QuantizingX(outPort, innerDre->second);
+            }
+            if (innerPathInfo != pathInfoMap.end()) {
+                remoteCongestion = innerPathInfo->second._ce;
+            }
+            uint32_t CurrCongestion = std::max(localCongestion, remoteCongestion);
+            if (minCongestion > CurrCongestion) {
+                minCongestion = CurrCongestion;
+                candidatePaths.clear();
+                candidatePaths.push_back(pathId);
+            } else if (minCongestion == CurrCongestion) {
+                candidatePaths.push_back(pathId);
+            }
+            std::advance(innerPathItr, 1);
+        }
+        return candidatePaths[rand() % candidatePaths.size()];
+    }
+
+   private:
+    void DreEvent() {
+        for (auto itr = m_DreMap.begin(); itr != m_DreMap.end(); ++itr) {
+            uint32_t newX = itr->second * (1 - kAlpha);
+            itr->second = newX;
+        }
+        m_dreEvent = Simulator::Schedule(kDreTime, &LegacyConga::DreEvent, this);
+    }
+    EventId m_dreEvent;
+    std::map<uint32_t, std::set<uint32_t> > m_congaRoutingTable;
+    std::map<uint32_t, std::map<uint32_t, OutpathInfo> > m_congaToLeafTable;
+    std::map<uint32_t, uint64_t> m_bitRate;
+    std::map<uint32_t, uint32_t> m_DreMap;
+};
+
+// CongaRouting is an Object, reached through a Ptr; this gives it the same call syntax
+struct NewConga {
+    Ptr<CongaRouting> c;
+    void Start() { c->StartDre(); }
+    void Stop() {}
+    void AddPath(uint32_t dstToR, uint32_t pathId) { c->AddPath(dstToR, pathId); }
+    void SetLinkCapacity(uint32_t outPort, uint64_t bitRate) { c->SetLinkCapacity(outPort, bitRate); }
+    void UpdateToLeaf(uint32_t dstToR, uint32_t pathId, uint32_t ce) {
+        c->UpdateToLeaf(dstToR, pathId, ce);
+    }
+    uint32_t UpdateLocalDre(Ptr<Packet> p, CustomHeader &ch, uint32_t outPort) {
+        return c->UpdateLocalDre(p, ch, outPort);
+    }
+    uint32_t GetBestPath(uint32_t dstToRId, uint32_t nSample) {
+        return c->GetBestPath(dstToRId, nSample);
+    }
+};
+
+static NewConga MakeConga() {
+    NewConga nc;
+    nc.c = CreateObject<CongaRouting>();
+    nc.c->SetConstants(kDreTime, MicroSeconds(500), MicroSeconds(100), kQuantizeBit, kAlpha);
+    return nc;
+}
+
+template <typename C>
+struct Driver {
+    C *conga;
+    uint32_t n, done, lcg;
+    uint64_t acc;
+    std::vector<uint32_t> *order;
+    Ptr<Packet> p;
+    CustomHeader ch;
+
+    void Chunk() {
+        for (uint32_t k = 0; k < kChunk && done < n; k++, done++) {
+            uint32_t dst = done % kNToR;
+            uint32_t path = conga->GetBestPath(dst, 4);
+            conga->UpdateLocalDre(p, ch, CongaRouting::GetOutPortFromPath(path, 0));
+            acc += path;
+            if (order) order->push_back(path);
+            lcg = lcg * 1103515245 + 12345;  // feedback, independent of rand()
+            if ((lcg >> 16) % 4 == 0) {
+                conga->UpdateToLeaf(dst, PathOf((lcg >> 8) % kNUplink, dst), (lcg >> 20) % 8);
+            }
+        }
+        if (done < n) {
+            Simulator::Schedule(NanoSeconds(7001), &Driver::Chunk, this);
+        } else {
+            conga->Stop();
+        }
+    }
+};
+
+template <typename C>
+static uint64_t Drive(C &conga, uint32_t n, std::vector<uint32_t> *order) {
+    for (uint32_t t = 0; t < kNToR; t++) {
+        for (uint32_t u = kNUplink; u-- > 0;) {
+            conga.AddPath(t, PathOf(u, t));
+        }
+    }
+    for (uint32_t u = 0; u < kNUplink; u++) {
+        conga.SetLinkCapacity(1 + u, kBitRate);
+    }
+    Driver<C> d;
+    d.conga = &conga;
+    d.n = n;
+    d.done = 0;
+    d.lcg = 1;
+    d.acc = 0;
+    d.order = order;
+    d.p = Create<Packet>(1000);
+    srand(1);
+    conga.Start();
+    Simulator::ScheduleNow(&Driver<C>::Chunk, &d);
+    Simulator::Run();
+    Simulator::Destroy();
+    return d.acc;
+}
+
+static void CheckEquivalence(uint32_t n) {
+    LegacyConga legacy;
+    NewConga dense = MakeConga();
+    std::vector<uint32_t> a, b;
+    Drive(legacy, n, &a);
+    Drive(dense, n, &b);
+    if (a != b) {
+        std::cerr << "Error-- dense CONGA tables choose other paths than the former tables"
+                  << std::endl;
+        exit(1);
+    }
+}
+
+template <typename C>
+static void RunBench(C &conga, uint32_t n, char const *name) {
+    SystemWallClockMs time;
+    time.Start();
+    volatile uint64_t sink = Drive(conga, n, 0);
+    (void)sink;
+    uint64_t deltaMs = time.End();
+    double ps = n;
+    ps *= 1000;
+    ps /= std::max(deltaMs, (uint64_t)1);
+    std::cout << ps << " decisions/s (" << deltaMs << " ms elapsed)\t" << name << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t n = 0;
+    while (argc > 0) {
+        if (strncmp("--n=", argv[0], strlen("--n=")) == 0) {
+            char const *nAscii = argv[0] + strlen("--n=");
+            std::istringstream iss;
+            iss.str(nAscii);
+            iss >> n;
+        }
+        argc--;
+        argv++;
+    }
+    if (n == 0) {
+        std::cerr << "Error-- number of decisions must be specified "
+                  << "by command-line argument --n=(number of decisions)" << std::endl;
+        exit(1);
+    }
+    std::cout << "Running bench-conga with n=" << n << std::endl;
+
+    CheckEquivalence(std::min(n, (uint32_t)200000));
+    LegacyConga legacy;
+    RunBench(legacy, n, "std::map tables, periodic DRE decay");
+    NewConga dense = MakeConga();
+    RunBench(dense, n, "Dense tables, DRE decay on read");
+    return 0;
+}
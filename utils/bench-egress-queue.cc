@@ -0,0 +1,219 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Packet rate of a switch egress port: a backlogged BEgressQueue is dequeued and every
+// packet is enqueued again, with some queues PFC-paused part of the time. The former
+// scheduler (a DropTailQueue per class, a linear RR scan peeking the FlowIDNUMTag of
+// paused heads) is kept here as the reference. Rates are also given relative to a
+// 400Gbps port sending 1000B packets. The last run of each load connects a sink to the
+// BeqDequeue trace source; the others fire the four trace sources of the queue with none.
+
+#include <stdlib.h>  // for exit ()
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/broadcom-egress-queue.h"
+#include "ns3/drop-tail-queue.h"
+#include "ns3/flow-id-num-tag.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/system-wall-clock-ms.h"
+
+using namespace ns3;
+
+static const uint32_t kQCnt = BEgressQueue::qCnt;
+static const uint32_t kPktSize = 1000;
+static const double k400GPps = 400e9 / 8 / (kPktSize + 48);  // 48B of headers on the wire
+
+// reference: the RR dequeue BEgressQueue had before the bitmap scheduler
+class LegacyEgressQueue {
+   public:
+    LegacyEgressQueue() : m_rrlast(0), m_qlast(0), m_bytes(0) {
+        for (uint32_t i = 0; i < kQCnt; i++) m_queues.push_back(CreateObject<DropTailQueue>());
+    }
+    void Enqueue(Ptr<Packet> p, uint32_t qIndex) {
+        m_queues[qIndex]->Enqueue(p);
+        m_bytes += p->GetSize();
+    }
+    Ptr<Packet> DequeueRR(bool paused[]) {
+        if (m_bytes == 0) return 0;
+        bool found = false;
+        uint32_t qIndex;
+        if (m_queues[0]->GetNPackets() > 0) {
+            found = true;
+            qIndex = 0;
+        } else {
+            for (qIndex = 1; qIndex <= kQCnt; qIndex++) {
+                bool cond1 = !paused[(qIndex + m_rrlast) % kQCnt];
+                bool cond2 = m_queues[(qIndex + m_rrlast) % kQCnt]->GetNPackets() > 0;
+                if (!cond1 && cond2) {
+                    FlowIDNUMTag fit;
+                    Ptr<Packet> p = ConstCast<Packet, const Packet>(
+                        m_queues[(qIndex + m_rrlast) % kQCnt]->Peek());
+                    if (p->PeekPacketTag(fit)) {
+                        unsigned flowid = static_cast<unsigned>(fit.GetId());
+                        if (m_pauseTime.find(flowid) == m_pauseTime.end())
+                            m_pauseTime[flowid] = Simulator::Now();
+                    }
+                } else if (cond1 && cond2) {
+                    found = true;
+                    break;
+                }
+            }
+            qIndex = (qIndex + m_rrlast) % kQCnt;
+        }
+        if (!found) return 0;
+        Ptr<Packet> p = m_queues[qIndex]->Dequeue();
+        FlowIDNUMTag fit;
+        if (p->PeekPacketTag(fit)) {
+            unsigned flowid = static_cast<unsigned>(fit.GetId());
+            if (m_pauseTime.find(flowid) != m_pauseTime.end()) m_pauseTime.erase(flowid);
+        }
+        m_bytes -= p->GetSize();
+        if (qIndex != 0) m_rrlast = qIndex;
+        m_qlast = qIndex;
+        return p;
+    }
+    uint32_t GetLastQueue() { return m_qlast; }
+
+   private:
+    std::vector<Ptr<DropTailQueue> > m_queues;
+    std::unordered_map<unsigned, Time> m_pauseTime;
+    uint32_t m_rrlast, m_qlast, m_bytes;
+};
+
+// queue of the k-th packet, and the pause pattern in force at dequeue n
+static uint32_t QueueOf(uint32_t k, uint32_t nActive) { return 1 + k % nActive; }
+static bool IsPaused(uint32_t n, uint32_t q) { return q == 2 && (n >> 10) % 4 == 0; }
+
+template <typename Q>
+static void Fill(Q &queue, uint32_t nActive, uint32_t depth) {
+    for (uint32_t k = 0; k < nActive * depth; k++) {
+        Ptr<Packet> p = Create<Packet>(kPktSize);
+        FlowIDNUMTag fit;
+        fit.SetId(k % 64);
+        p->AddPacketTag(fit);
+        queue.Enqueue(p, QueueOf(k, nActive));
+    }
+}
+
+template <typename Q>
+static uint64_t Drive(Q &queue, uint32_t n, std::vector<uint32_t> *order) {
+    bool paused[kQCnt] = {0};
+    uint64_t acc = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        paused[2] = IsPaused(i, 2);
+        Ptr<Packet> p = queue.DequeueRR(paused);
+        uint32_t q = queue.GetLastQueue();
+        acc += q;
+        if (order) order->push_back(q);
+        queue.Enqueue(p, q);  // keep the port backlogged
+    }
+    return acc;
+}
+
+static uint64_t g_traced;
+static void CountDequeue(Ptr<const Packet> p, uint32_t qIndex) { g_traced += qIndex; }
+
+// BEgressQueue is an Object, reached through a Ptr; this gives it the same call syntax
+struct NewQueue {
+    Ptr<BEgressQueue> q;
+    void Enqueue(Ptr<Packet> p, uint32_t qIndex) { q->Enqueue(p, qIndex); }
+    Ptr<Packet> DequeueRR(bool paused[]) { return q->DequeueRR(paused); }
+    uint32_t GetLastQueue() { return q->GetLastQueue(); }
+};
+
+static NewQueue MakeQueue(std::string mode) {
+    NewQueue nq;
+    nq.q = CreateObject<BEgressQueue>();
+    nq.q->SetAttribute("SchedulingMode", StringValue(mode));
+    nq.q->SetAttribute("Weights", StringValue("1,1,2,3,4,1,1,1"));
+    return nq;
+}
+
+static void CheckEquivalence(uint32_t nActive) {
+    LegacyEgressQueue legacy;
+    NewQueue rr = MakeQueue("RR");
+    Fill(legacy, nActive, 64);
+    Fill(rr, nActive, 64);
+    std::vector<uint32_t> a, b;
+    Drive(legacy, 100000, &a);
+    Drive(rr, 100000, &b);
+    if (a != b) {
+        std::cerr << "Error-- RR order differs from the former scheduler with " << nActive
+                  << " active queues" << std::endl;
+        exit(1);
+    }
+}
+
+template <typename Q>
+static void RunBench(Q &queue, uint32_t n, uint32_t nActive, char const *name) {
+    SystemWallClockMs time;
+    time.Start();
+    volatile uint64_t sink = Drive(queue, n, 0);
+    (void)sink;
+    uint64_t deltaMs = time.End();
+    double ps = n;
+    ps *= 1000;
+    ps /= std::max(deltaMs, (uint64_t)1);
+    std::cout << ps << " packets/s (" << ps / k400GPps << "x 400G) (" << deltaMs
+              << " ms elapsed)\t" << name << ", " << nActive << " active queues" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t n = 0;
+    while (argc > 0) {
+        if (strncmp("--n=", argv[0], strlen("--n=")) == 0) {
+            char const *nAscii = argv[0] + strlen("--n=");
+            std::istringstream iss;
+            iss.str(nAscii);
+            iss >> n;
+        }
+        argc--;
+        argv++;
+    }
+    if (n == 0) {
+        std::cerr << "Error-- number of packets must be specified "
+                  << "by command-line argument --n=(number of packets)" << std::endl;
+        exit(1);
+    }
+    std::cout << "Running bench-egress-queue with n=" << n << std::endl;
+
+    const uint32_t active[2] = {2, 7};
+    for (uint32_t a = 0; a < 2; a++) {
+        CheckEquivalence(active[a]);
+        LegacyEgressQueue legacy;
+        Fill(legacy, active[a], 64);
+        RunBench(legacy, n, active[a], "Former RR scan");
+        const char *modes[4] = {"RR", "SP", "DWRR", "WFQ"};
+        for (uint32_t m = 0; m < 4; m++) {
+            NewQueue q = MakeQueue(modes[m]);
+            Fill(q, active[a], 64);
+            RunBench(q, n, active[a], (std::string("Bitmap ") + modes[m]).c_str());
+        }
+        NewQueue traced = MakeQueue("RR");
+        traced.q->TraceConnectWithoutContext("BeqDequeue", MakeCallback(&CountDequeue));
+        Fill(traced, active[a], 64);
+        RunBench(traced, n, active[a], "Bitmap RR, BeqDequeue sink");
+    }
+    return g_traced == 0xdeadbeef;
+}
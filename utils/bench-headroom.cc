@@ -0,0 +1,184 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Buffer work of the RDMA packets: the NIC builds a data packet (payload, then SeqTs, UDP,
+// IPv4 and PPP headers in front, as RdmaHw::GetNxtPacket), the receiver removes the headers
+// and builds the ACK (padding, then qbbHeader, IPv4 and PPP, as RdmaHw::ReceiveUdp). The SeqTs
+// and qbbHeader sizes are those of DCQCN (no INT) and of HPCC (5 INT hops). Packets are made
+// with no headroom, which reallocates at every header as every packet did before the buffers
+// were recycled, with the headroom Buffer learns at runtime, and with the exact headroom of
+// their header stack. Reported per data+ACK pair: time, buffer reallocations and real byte
+// buffers allocated rather than taken from a free list.
+
+#include <stdlib.h>  // for exit ()
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "ns3/buffer.h"
+#include "ns3/header.h"
+#include "ns3/packet.h"
+#include "ns3/system-wall-clock-ms.h"
+
+using namespace ns3;
+
+template <int N>
+class BenchHeader : public Header {
+   public:
+    BenchHeader() : m_value(0) {}
+    explicit BenchHeader(uint32_t value) : m_value(value) {}
+    static std::string GetTypeName(void) {
+        std::ostringstream oss;
+        oss << "ns3::BenchHeader<" << N << ">";
+        return oss.str();
+    }
+    static TypeId GetTypeId(void) {
+        static TypeId tid = TypeId(GetTypeName().c_str()).SetParent<Header>();
+        return tid;
+    }
+    virtual TypeId GetInstanceTypeId(void) const { return GetTypeId(); }
+    virtual uint32_t GetSerializedSize(void) const { return N; }
+    // the value in the first (up to) 4 bytes
+    virtual void Serialize(Buffer::Iterator i) const {
+        for (int k = 0; k < N; k++) i.WriteU8(k < 4 ? m_value >> (8 * k) : k);
+    }
+    virtual uint32_t Deserialize(Buffer::Iterator i) {
+        m_value = 0;
+        for (int k = 0; k < N; k++) {
+            uint32_t byte = i.ReadU8();
+            if (k < 4) m_value |= byte << (8 * k);
+        }
+        return N;
+    }
+    virtual void Print(std::ostream &os) const { os << m_value; }
+
+    uint32_t m_value;
+};
+
+typedef BenchHeader<8> UdpHdr;
+typedef BenchHeader<20> Ipv4Hdr;
+typedef BenchHeader<14> PppHdr;  // PppHeader is Ethernet-sized in this stack
+
+enum Headroom { NONE, LEARNED, EXACT };
+
+static Ptr<Packet> MakePacket(uint32_t size, uint32_t headroom, Headroom mode) {
+    switch (mode) {
+        case NONE:
+            return Create<Packet>(size, 0u);
+        case LEARNED:
+            return Create<Packet>(size);
+        default:
+            return Create<Packet>(size, headroom);
+    }
+}
+
+// one data packet and its ACK; returns a checksum of the header values read
+template <typename SeqHdr>
+static uint32_t DataAndAck(uint32_t seq, Headroom mode) {
+    uint32_t sum = 0;
+    Ptr<Packet> p = MakePacket(1000, SeqHdr().GetSerializedSize() + 8 + 20 + 14, mode);
+    p->AddHeader(SeqHdr(seq));
+    p->AddHeader(UdpHdr(seq + 1));
+    p->AddHeader(Ipv4Hdr(seq + 2));
+    p->AddHeader(PppHdr(seq + 3));
+
+    PppHdr ppp;
+    Ipv4Hdr ip;
+    UdpHdr udp;
+    SeqHdr seqTs;
+    p->RemoveHeader(ppp);
+    p->RemoveHeader(ip);
+    p->RemoveHeader(udp);
+    p->RemoveHeader(seqTs);
+    sum += ppp.m_value + ip.m_value + udp.m_value + seqTs.m_value + p->GetSize();
+
+    uint32_t ackHeader = SeqHdr().GetSerializedSize();
+    Ptr<Packet> ack =
+        MakePacket(std::max(60 - 14 - 20 - (int)ackHeader, 0), ackHeader + 20 + 14, mode);
+    ack->AddHeader(SeqHdr(seq));
+    ack->AddHeader(Ipv4Hdr(seq + 4));
+    ack->AddHeader(PppHdr(seq + 5));
+    ack->RemoveHeader(ppp);
+    sum += ppp.m_value + ack->GetSize();
+    return sum;
+}
+
+static uint64_t g_sink;
+
+template <typename SeqHdr>
+static void RunBench(uint32_t n, Headroom mode, const char *stack) {
+    static const char *names[] = {"no headroom", "learned headroom", "exact headroom"};
+    uint64_t reallocs = Buffer::GetNReallocations();
+    uint64_t allocs = Buffer::GetNAllocations();
+    SystemWallClockMs time;
+    time.Start();
+    for (uint32_t i = 0; i < n; i++) {
+        g_sink += DataAndAck<SeqHdr>(i, mode);
+    }
+    uint64_t deltaMs = time.End();
+    double pairs = std::max(n, 1u);
+    std::cout << deltaMs * 1e6 / pairs << " ns/pair, "
+              << (Buffer::GetNReallocations() - reallocs) / pairs << " reallocations/pair, "
+              << (Buffer::GetNAllocations() - allocs) / pairs << " allocations/pair ("
+              << deltaMs << " ms elapsed)\t" << stack << ", " << names[mode] << std::endl;
+}
+
+template <typename SeqHdr>
+static void CheckEquivalence(void) {
+    for (uint32_t seq = 0; seq < 1000; seq++) {
+        uint32_t a = DataAndAck<SeqHdr>(seq, NONE);
+        uint32_t b = DataAndAck<SeqHdr>(seq, LEARNED);
+        uint32_t c = DataAndAck<SeqHdr>(seq, EXACT);
+        if (a != b || b != c) {
+            std::cerr << "Error-- header values differ for seq " << seq << ": " << a << " " << b
+                      << " " << c << std::endl;
+            exit(1);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t n = 0;
+    while (argc > 0) {
+        if (strncmp("--n=", argv[0], strlen("--n=")) == 0) {
+            char const *nAscii = argv[0] + strlen("--n=");
+            std::istringstream iss;
+            iss.str(nAscii);
+            iss >> n;
+        }
+        argc--;
+        argv++;
+    }
+    if (n == 0) {
+        std::cerr << "Error-- number of packets must be specified "
+                  << "by command-line argument --n=(number of packets)" << std::endl;
+        exit(1);
+    }
+    std::cout << "Running bench-headroom with n=" << n << std::endl;
+
+    CheckEquivalence<BenchHeader<6> >();
+    CheckEquivalence<BenchHeader<48> >();
+    for (int mode = NONE; mode <= EXACT; mode++) {
+        RunBench<BenchHeader<6> >(n, (Headroom)mode, "DCQCN");
+        RunBench<BenchHeader<48> >(n, (Headroom)mode, "HPCC");
+    }
+    return g_sink == 0xdeadbeef;
+}
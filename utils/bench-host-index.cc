@@ -0,0 +1,150 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Per-packet cost of resolving (srcToR, dstToR) from a packet's IPs in the RouteInput of
+// the load balancers: the former std::map (two asserted finds, two lookups) versus the
+// dense Settings host index, with node_id_to_ip() addressing and with arbitrary addressing.
+
+#include <stdlib.h>  // for exit ()
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/settings.h"
+#include "ns3/system-wall-clock-ms.h"
+
+using namespace ns3;
+
+static const uint32_t kNPkts = 4096;  // distinct (sip, dip) pairs cycled through
+
+static std::map<uint32_t, uint32_t> g_ip2ToR;
+static std::vector<uint32_t> g_sip, g_dip;
+static volatile uint32_t g_sink;
+
+static void BuildTopology(uint32_t nHost, uint32_t hostsPerToR, bool nodeIdAddressing) {
+    Settings::hostId2Ip.clear();
+    Settings::hostId2ToRId.clear();
+    g_ip2ToR.clear();
+    std::vector<uint32_t> ips;
+    for (uint32_t i = 0; i < nHost; i++) {
+        uint32_t ip = nodeIdAddressing ? Settings::node_id_to_ip(i).Get()
+                                       : 0x0a000000 + (uint32_t)rand() % 0x00ffffff;
+        while (!nodeIdAddressing && std::find(ips.begin(), ips.end(), ip) != ips.end()) {
+            ip = 0x0a000000 + (uint32_t)rand() % 0x00ffffff;
+        }
+        ips.push_back(ip);
+        Settings::AddHost(i, ip);
+    }
+    Settings::BuildHostIndex();
+    for (uint32_t i = 0; i < nHost; i++) {
+        uint32_t tor = nHost + i / hostsPerToR;
+        Settings::SetHostToR(ips[i], tor);
+        g_ip2ToR[ips[i]] = tor;
+    }
+    g_sip.resize(kNPkts);
+    g_dip.resize(kNPkts);
+    for (uint32_t k = 0; k < kNPkts; k++) {
+        g_sip[k] = ips[rand() % nHost];
+        g_dip[k] = ips[rand() % nHost];
+    }
+}
+
+// reference: the lookups RouteInput did with Settings::hostIp2SwitchId
+static uint32_t MapLookup(uint32_t sip, uint32_t dip) {
+    assert(g_ip2ToR.find(sip) != g_ip2ToR.end());
+    assert(g_ip2ToR.find(dip) != g_ip2ToR.end());
+    uint32_t srcToRId = g_ip2ToR[sip];
+    uint32_t dstToRId = g_ip2ToR[dip];
+    return srcToRId ^ dstToRId;
+}
+
+static uint32_t IndexLookup(uint32_t sip, uint32_t dip) {
+    uint32_t srcToRId = Settings::ToROfIp(sip);
+    uint32_t dstToRId = Settings::ToROfIp(dip);
+    assert(srcToRId != Settings::INVALID_ID);
+    assert(dstToRId != Settings::INVALID_ID);
+    return srcToRId ^ dstToRId;
+}
+
+static void CheckEquivalence(uint32_t nHost) {
+    for (uint32_t k = 0; k < kNPkts; k++) {
+        uint32_t other = Settings::HostIdOfIp(g_sip[k] + 1);  // normally not a host
+        if (MapLookup(g_sip[k], g_dip[k]) != IndexLookup(g_sip[k], g_dip[k]) ||
+            (other != Settings::INVALID_ID && Settings::IpOfHost(other) != g_sip[k] + 1)) {
+            std::cerr << "Error-- host index differs from the map at nHost=" << nHost
+                      << " sample " << k << std::endl;
+            exit(1);
+        }
+    }
+}
+
+static void RunBench(uint32_t (*lookup)(uint32_t, uint32_t), uint32_t n, uint32_t nHost,
+                     char const *name) {
+    uint32_t acc = 0;
+    SystemWallClockMs time;
+    time.Start();
+    for (uint32_t k = 0; k < n; k++) {
+        acc += (*lookup)(g_sip[k % kNPkts], g_dip[k % kNPkts]);
+    }
+    uint64_t deltaMs = time.End();
+    g_sink = acc;
+    double ps = n;
+    ps *= 1000;
+    ps /= std::max(deltaMs, (uint64_t)1);
+    std::cout << ps << " packets/s"
+              << " (" << deltaMs << " ms elapsed)\t" << name << ", " << nHost << " hosts"
+              << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t n = 0;
+    while (argc > 0) {
+        if (strncmp("--n=", argv[0], strlen("--n=")) == 0) {
+            char const *nAscii = argv[0] + strlen("--n=");
+            std::istringstream iss;
+            iss.str(nAscii);
+            iss >> n;
+        }
+        argc--;
+        argv++;
+    }
+    if (n == 0) {
+        std::cerr << "Error-- number of packets must be specified "
+                  << "by command-line argument --n=(number of packets)" << std::endl;
+        exit(1);
+    }
+    std::cout << "Running bench-host-index with n=" << n << std::endl;
+
+    srand(1);
+    const uint32_t hosts[3] = {128, 1024, 16384};
+    for (uint32_t h = 0; h < 3; h++) {
+        BuildTopology(hosts[h], 16, true);
+        CheckEquivalence(hosts[h]);
+        RunBench(&MapLookup, n, hosts[h], "std::map");
+        RunBench(&IndexLookup, n, hosts[h], "Dense index, node_id_to_ip addressing");
+        BuildTopology(hosts[h], 16, false);
+        CheckEquivalence(hosts[h]);
+        RunBench(&IndexLookup, n, hosts[h], "Dense index, hashed addressing");
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Cost of the per-ACK HPCC utilization computation (RdmaHw::UpdateRateHp) for
+// 2-tier (3 hops) and 3-tier (5 hops) paths: the per-hop loop over the bit-packed
+// IntHop fields versus IntHeader::UnpackDeltas + IntHopBatch::ComputeUtilization.
+
+#include <stdlib.h>  // for exit ()
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "ns3/int-header.h"
+#include "ns3/system-wall-clock-ms.h"
+
+using namespace ns3;
+
+static const uint64_t kMaxRate = 100000000000lu;
+static const uint32_t kWin = 100000;
+static const uint32_t kNFeedback = 64;  // distinct INT samples cycled through
+
+static IntHeader g_feedback[kNFeedback];
+static volatile double g_sink;
+
+static void FillFeedback(uint32_t nhop) {
+    uint64_t t = 0, bytes[IntHeader::maxHop] = {0};
+    for (uint32_t k = 0; k < kNFeedback; k++) {
+        IntHeader &ih = g_feedback[k];
+        ih.nhop = 0;
+        t += 1000 + rand() % 4000;
+        for (uint32_t i = 0; i < nhop; i++) {
+            bytes[i] += 10000 + rand() % 50000;
+            ih.PushHop(t, bytes[i], rand() % 200000, kMaxRate);
+        }
+    }
+}
+
+// reference: the original per-hop loop of UpdateRateHp
+static double LegacyAck(IntHeader &ih, IntHop prev[]) {
+    double U = 0;
+    for (uint32_t i = 0; i < ih.nhop; i++) {
+        uint64_t tau = ih.hop[i].GetTimeDelta(prev[i]);
+        double duration = tau * 1e-9;
+        double txRate = (ih.hop[i].GetBytesDelta(prev[i])) * 8 / duration;
+        double u = txRate / ih.hop[i].GetLineRate() +
+                   (double)std::min(ih.hop[i].GetQlen(), prev[i].GetQlen()) * kMaxRate /
+                       ih.hop[i].GetLineRate() / kWin;
+        if (u > U) U = u;
+        prev[i] = ih.hop[i];
+    }
+    return U;
+}
+
+static double BatchAck(IntHeader &ih, IntHop prev[]) {
+    IntHopBatch batch;
+    ih.UnpackDeltas(prev, batch);
+    batch.ComputeUtilization(kMaxRate, kWin);
+    double U = 0;
+    for (uint32_t i = 0; i < batch.n; i++) {
+        if (batch.u[i] > U) U = batch.u[i];
+        prev[i] = ih.hop[i];
+    }
+    return U;
+}
+
+static void CheckEquivalence(uint32_t nhop) {
+    IntHop prevA[IntHeader::maxHop], prevB[IntHeader::maxHop];
+    for (uint32_t i = 0; i < IntHeader::maxHop; i++) prevA[i] = prevB[i] = IntHop();
+    for (uint32_t k = 0; k < kNFeedback; k++) {
+        double a = LegacyAck(g_feedback[k], prevA);
+        double b = BatchAck(g_feedback[k], prevB);
+        if (a != b && !(std::isnan(a) && std::isnan(b))) {
+            std::cerr << "Error-- batch result differs at nhop=" << nhop << " sample " << k
+                      << ": " << a << " vs " << b << std::endl;
+            exit(1);
+        }
+    }
+}
+
+static void RunBench(double (*ack)(IntHeader &, IntHop[]), uint32_t n, uint32_t nhop,
+                     char const *name) {
+    IntHop prev[IntHeader::maxHop];
+    for (uint32_t i = 0; i < IntHeader::maxHop; i++) prev[i] = IntHop();
+    double acc = 0;
+    SystemWallClockMs time;
+    time.Start();
+    for (uint32_t k = 0; k < n; k++) {
+        acc += (*ack)(g_feedback[k % kNFeedback], prev);
+    }
+    uint64_t deltaMs = time.End();
+    g_sink = acc;
+    double ps = n;
+    ps *= 1000;
+    ps /= std::max(deltaMs, (uint64_t)1);
+    std::cout << ps << " acks/s"
+              << " (" << deltaMs << " ms elapsed)\t" << name << ", " << nhop << " hops"
+              << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t n = 0;
+    while (argc > 0) {
+        if (strncmp("--n=", argv[0], strlen("--n=")) == 0) {
+            char const *nAscii = argv[0] + strlen("--n=");
+            std::istringstream iss;
+            iss.str(nAscii);
+            iss >> n;
+        }
+        argc--;
+        argv++;
+    }
+    if (n == 0) {
+        std::cerr << "Error-- number of ACKs must be specified "
+                  << "by command-line argument --n=(number of ACKs)" << std::endl;
+        exit(1);
+    }
+    std::cout << "Running bench-hpcc with n=" << n << std::endl;
+
+    srand(1);
+    const uint32_t paths[2] = {3, 5};  // 2-tier leaf-spine, 3-tier fat-tree
+    for (uint32_t p = 0; p < 2; p++) {
+        FillFeedback(paths[p]);
+        CheckEquivalence(paths[p]);
+        RunBench(&LegacyAck, n, paths[p], "Per-hop IntHop loop");
+        RunBench(&BatchAck, n, paths[p], "Batched SoA");
+    }
+    return 0;
+}
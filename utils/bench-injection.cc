@@ -0,0 +1,270 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Cost of the events other threads inject into the main loop with ScheduleWithContext (tap,
+// emulation, a background thread). The main loop polls the injection queue after every event:
+// the cost per event is measured with nothing injected, with one thread injecting and, per
+// injected item, with four threads injecting at once. The reference is the queue
+// DefaultSimulatorImpl had before MpscQueue: a std::list and an empty flag under a mutex. Last,
+// the simulator itself runs a chain of events while a thread injects into it.
+
+#include <stdlib.h>  // for exit ()
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/mpsc-queue.h"
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+#include "ns3/system-mutex.h"
+#include "ns3/system-thread.h"
+#include "ns3/system-wall-clock-ms.h"
+
+using namespace ns3;
+
+struct Item {
+    uint32_t producer;
+    uint32_t seq;
+    uint64_t timestamp;
+};
+
+// the queue before: every push and every drain takes the mutex
+class LegacyQueue {
+   public:
+    LegacyQueue() : m_empty(true) {}
+    void Push(const Item &item) {
+        CriticalSection cs(m_mutex);
+        m_items.push_back(item);
+        m_empty = false;
+    }
+    // volatile: the original plain bool is a data race the compiler could hoist out of the loop
+    bool IsEmpty(void) const { return m_empty; }
+    void PopAll(std::vector<Item> &items) {
+        std::list<Item> taken;
+        {
+            CriticalSection cs(m_mutex);
+            m_items.swap(taken);
+            m_empty = true;
+        }
+        items.insert(items.end(), taken.begin(), taken.end());
+    }
+
+   private:
+    SystemMutex m_mutex;
+    std::list<Item> m_items;
+    volatile bool m_empty;
+};
+
+template <typename Queue>
+class Producer {
+   public:
+    Producer(Queue *queue, uint32_t id, uint32_t count) : m_queue(queue), m_id(id), m_count(count) {}
+    void Run(void) {
+        for (uint32_t seq = 0; seq < m_count; seq++) {
+            Item item = {m_id, seq, seq * 1000ull};
+            m_queue->Push(item);
+        }
+    }
+
+   private:
+    Queue *m_queue;
+    uint32_t m_id;
+    uint32_t m_count;
+};
+
+// what the main loop got; items of each producer must come in order
+class Received {
+   public:
+    explicit Received(uint32_t producers) : m_next(producers, 0), m_total(0) {}
+    void Take(const std::vector<Item> &items) {
+        for (size_t i = 0; i < items.size(); i++) {
+            if (items[i].seq != m_next[items[i].producer]++) {
+                std::cerr << "Error-- producer " << items[i].producer << " out of order"
+                          << std::endl;
+                exit(1);
+            }
+        }
+        m_total += items.size();
+    }
+    uint64_t GetTotal(void) const { return m_total; }
+
+   private:
+    std::vector<uint32_t> m_next;
+    uint64_t m_total;
+};
+
+static uint64_t g_sink;
+
+// stands for the work of one event
+static uint64_t __attribute__((noinline)) Work(uint32_t i) { return (i * 2654435761u) >> 7; }
+
+template <typename Queue>
+static void MainLoop(Queue &queue, uint32_t n, Received &received) {
+    std::vector<Item> batch;
+    for (uint32_t i = 0; i < n; i++) {
+        g_sink += Work(i);
+        if (!queue.IsEmpty()) {
+            batch.clear();
+            queue.PopAll(batch);
+            received.Take(batch);
+        }
+    }
+}
+
+template <typename Queue>
+static void Drain(Queue &queue, uint64_t total, Received &received) {
+    std::vector<Item> batch;
+    while (received.GetTotal() < total) {
+        batch.clear();
+        queue.PopAll(batch);
+        received.Take(batch);
+    }
+}
+
+template <typename Queue>
+static uint64_t Inject(Queue &queue, uint32_t producers, uint32_t count, uint32_t events,
+                       Received &received) {
+    std::vector<Producer<Queue> *> p;
+    std::vector<Ptr<SystemThread> > threads;
+    SystemWallClockMs time;
+    time.Start();
+    for (uint32_t i = 0; i < producers; i++) {
+        p.push_back(new Producer<Queue>(&queue, i, count));
+        threads.push_back(Create<SystemThread>(MakeCallback(&Producer<Queue>::Run, p[i])));
+        threads[i]->Start();
+    }
+    MainLoop(queue, events, received);
+    Drain(queue, (uint64_t)producers * count, received);
+    uint64_t deltaMs = time.End();
+    for (uint32_t i = 0; i < producers; i++) {
+        threads[i]->Join();
+        delete p[i];
+    }
+    return deltaMs;
+}
+
+static void Print(double ns, const char *what, uint64_t deltaMs, const char *impl) {
+    std::cout << ns << " ns/" << what << " (" << deltaMs << " ms elapsed)\t" << impl
+              << std::endl;
+}
+
+template <typename Queue>
+static void RunBench(uint32_t n, const char *impl) {
+    SystemWallClockMs time;
+    {
+        Queue queue;
+        Received received(1);
+        time.Start();
+        MainLoop(queue, n, received);
+        uint64_t deltaMs = time.End();
+        Print(deltaMs * 1e6 / std::max(n, 1u), "event, nothing injected", deltaMs, impl);
+    }
+    {
+        Queue queue;
+        Received received(1);
+        uint64_t deltaMs = Inject(queue, 1, n / 8, n, received);
+        Print(deltaMs * 1e6 / std::max(n, 1u), "event, 1 thread injecting n/8", deltaMs, impl);
+    }
+    {
+        Queue queue;
+        Received received(4);
+        uint64_t deltaMs = Inject(queue, 4, n / 4, 0, received);
+        Print(deltaMs * 1e6 / std::max(n / 4 * 4, 1u), "item, 4 threads injecting", deltaMs,
+              impl);
+    }
+}
+
+// the simulator: a chain of events, and a thread injecting into it from the first event
+static uint32_t g_chain;
+static uint32_t g_chainLength;
+static uint32_t g_injected;
+static uint32_t g_toInject;
+static Ptr<SystemThread> g_injector;
+
+static void Injected(void) { g_injected++; }
+
+static void InjectorRun(void) {
+    for (uint32_t i = 0; i < g_toInject; i++) {
+        Simulator::ScheduleWithContext(i, Seconds(0), &Injected);
+    }
+}
+
+static void Chain(void) {
+    if (g_chain++ == 0 && g_toInject > 0) {
+        g_injector = Create<SystemThread>(MakeCallback(&InjectorRun));
+        g_injector->Start();
+    }
+    // goes on until every injected event ran, however slow the injector is
+    if (g_chain < g_chainLength || g_injected < g_toInject) {
+        Simulator::Schedule(NanoSeconds(1), &Chain);
+    }
+}
+
+static void RunSimulator(uint32_t n, uint32_t toInject, const char *impl) {
+    g_chain = 0;
+    g_chainLength = n;
+    g_injected = 0;
+    g_toInject = toInject;
+    SystemWallClockMs time;
+    time.Start();
+    Simulator::Schedule(NanoSeconds(1), &Chain);
+    Simulator::Run();
+    uint64_t deltaMs = time.End();
+    if (g_injector != 0) {
+        g_injector->Join();
+        g_injector = 0;
+    }
+    Simulator::Destroy();
+    if (g_injected != toInject) {
+        std::cerr << "Error-- " << g_injected << " of " << toInject << " injected events ran"
+                  << std::endl;
+        exit(1);
+    }
+    Print(deltaMs * 1e6 / std::max(g_chain + g_injected, 1u), "event", deltaMs, impl);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t n = 0;
+    while (argc > 0) {
+        if (strncmp("--n=", argv[0], strlen("--n=")) == 0) {
+            char const *nAscii = argv[0] + strlen("--n=");
+            std::istringstream iss;
+            iss.str(nAscii);
+            iss >> n;
+        }
+        argc--;
+        argv++;
+    }
+    if (n == 0) {
+        std::cerr << "Error-- number of events must be specified "
+                  << "by command-line argument --n=(number of events)" << std::endl;
+        exit(1);
+    }
+    std::cout << "Running bench-injection with n=" << n << std::endl;
+
+    RunBench<LegacyQueue>(n, "list under mutex");
+    RunBench<MpscQueue<Item> >(n, "MpscQueue");
+    RunSimulator(n, 0, "simulator, nothing injected");
+    RunSimulator(n, n / 8, "simulator, 1 thread injecting n/8");
+    return g_sink == 0xdeadbeef;
+}
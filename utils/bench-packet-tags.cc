@@ -0,0 +1,251 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Packet tag operations over the life of a data packet: the sender adds the flow tags and the
+// LB tag, then at every hop the switch copies the packet, adds and later removes FlowIdTag
+// (ingress port), peeks the flow tags and rewrites the LB tag. Tag sizes are those of
+// FlowIdTag (4), FlowStatTag (9), FlowIDNUMTag (12), CongaTag (20) and ConWeaveDataTag (36).
+// The former PacketTagList (one 512-byte node per tag, shared tails) is kept here as the
+// reference; the bench also reports the tag memory a packet holds at its peak.
+
+#include <stdlib.h>  // for exit ()
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "ns3/packet-tag-list.h"
+#include "ns3/system-wall-clock-ms.h"
+#include "ns3/tag-buffer.h"
+#include "ns3/tag.h"
+
+using namespace ns3;
+
+template <int N>
+class BenchTag : public Tag {
+   public:
+    BenchTag() : m_value(0) {}
+    explicit BenchTag(uint32_t value) : m_value(value) {}
+    static std::string GetTypeName(void) {
+        std::ostringstream oss;
+        oss << "ns3::BenchTag<" << N << ">";
+        return oss.str();
+    }
+    static TypeId GetTypeId(void) {
+        static TypeId tid = TypeId(GetTypeName().c_str()).SetParent<Tag>();
+        return tid;
+    }
+    virtual TypeId GetInstanceTypeId(void) const { return GetTypeId(); }
+    virtual uint32_t GetSerializedSize(void) const { return N; }
+    virtual void Serialize(TagBuffer i) const {
+        i.WriteU32(m_value);
+        for (int k = 4; k < N; k++) i.WriteU8(k);
+    }
+    virtual void Deserialize(TagBuffer i) {
+        m_value = i.ReadU32();
+        for (int k = 4; k < N; k++) i.ReadU8();
+    }
+    virtual void Print(std::ostream &os) const { os << m_value; }
+
+    uint32_t m_value;
+};
+
+typedef BenchTag<4> IngressTag;   // FlowIdTag
+typedef BenchTag<9> StatTag;      // FlowStatTag
+typedef BenchTag<12> FlowNumTag;  // FlowIDNUMTag
+typedef BenchTag<20> CongaLbTag;  // CongaTag
+typedef BenchTag<36> CwLbTag;     // ConWeaveDataTag
+
+// reference: PacketTagList before the compact tag blocks
+class LegacyTagList {
+   public:
+    struct TagData {
+        uint8_t data[PACKET_TAG_MAX_SIZE];
+        struct TagData *next;
+        TypeId tid;
+        uint32_t count;
+    };
+
+    LegacyTagList() : m_next(0) {}
+    LegacyTagList(LegacyTagList const &o) : m_next(o.m_next) {
+        if (m_next != 0) m_next->count++;
+    }
+    ~LegacyTagList() { RemoveAll(); }
+
+    void Add(Tag const &tag) {
+        struct TagData *head = new TagData();
+        head->count = 1;
+        head->tid = tag.GetInstanceTypeId();
+        head->next = m_next;
+        tag.Serialize(TagBuffer(head->data, head->data + tag.GetSerializedSize()));
+        m_next = head;
+    }
+    bool Peek(Tag &tag) const {
+        TypeId tid = tag.GetInstanceTypeId();
+        for (struct TagData *cur = m_next; cur != 0; cur = cur->next) {
+            if (cur->tid == tid) {
+                tag.Deserialize(TagBuffer(cur->data, cur->data + PACKET_TAG_MAX_SIZE));
+                return true;
+            }
+        }
+        return false;
+    }
+    bool Remove(Tag &tag) {
+        TypeId tid = tag.GetInstanceTypeId();
+        if (!Peek(tag)) return false;
+        struct TagData *start = 0;
+        struct TagData **prevNext = &start;
+        for (struct TagData *cur = m_next; cur != 0; cur = cur->next) {
+            if (cur->tid == tid) continue;
+            struct TagData *copy = new TagData();
+            copy->tid = cur->tid;
+            copy->count = 1;
+            copy->next = 0;
+            memcpy(copy->data, cur->data, PACKET_TAG_MAX_SIZE);
+            *prevNext = copy;
+            prevNext = &copy->next;
+        }
+        *prevNext = 0;
+        RemoveAll();
+        m_next = start;
+        return true;
+    }
+    void RemoveAll(void) {
+        struct TagData *prev = 0;
+        for (struct TagData *cur = m_next; cur != 0; cur = cur->next) {
+            cur->count--;
+            if (cur->count > 0) break;
+            if (prev != 0) delete prev;
+            prev = cur;
+        }
+        if (prev != 0) delete prev;
+        m_next = 0;
+    }
+    uint32_t GetAllocatedSize(void) const {
+        uint32_t size = 0;
+        for (struct TagData *cur = m_next; cur != 0; cur = cur->next) size += sizeof(TagData);
+        return size;
+    }
+
+   private:
+    LegacyTagList &operator=(LegacyTagList const &o);
+    struct TagData *m_next;
+};
+
+static uint32_t g_peakBytes;
+
+// one data packet crossing nhop switches; returns a checksum of the tag values read
+template <typename List, typename LbTag>
+static uint32_t PacketLife(uint32_t flow, uint32_t nhop) {
+    uint32_t sum = 0;
+    List *p = new List;
+    p->Add(FlowNumTag(flow));
+    p->Add(StatTag(flow + 1));
+    p->Add(LbTag(flow + 2));
+    for (uint32_t h = 0; h < nhop; h++) {
+        List *q = new List(*p);  // the switch forwards a copy
+        delete p;
+        p = q;
+        p->Add(IngressTag(h));
+        g_peakBytes = std::max(g_peakBytes, p->GetAllocatedSize());
+        FlowNumTag fnt;
+        p->Peek(fnt);
+        LbTag lb;
+        p->Remove(lb);
+        lb.m_value += h;
+        p->Add(lb);
+        IngressTag in;
+        p->Peek(in);
+        p->Remove(in);
+        sum += fnt.m_value + lb.m_value + in.m_value;
+    }
+    StatTag st;
+    p->Peek(st);
+    sum += st.m_value;
+    delete p;
+    return sum;
+}
+
+template <typename LbTag>
+static void CheckEquivalence(uint32_t nhop) {
+    for (uint32_t flow = 0; flow < 100; flow++) {
+        uint32_t a = PacketLife<LegacyTagList, LbTag>(flow, nhop);
+        uint32_t b = PacketLife<PacketTagList, LbTag>(flow, nhop);
+        if (a != b) {
+            std::cerr << "Error-- tag values differ for flow " << flow << ": " << a << " vs " << b
+                      << std::endl;
+            exit(1);
+        }
+    }
+}
+
+static uint32_t g_sink;
+
+template <typename List, typename LbTag>
+static void RunBench(uint32_t n, uint32_t nhop, char const *name, char const *lb) {
+    uint32_t sum = 0;
+    g_peakBytes = 0;
+    SystemWallClockMs time;
+    time.Start();
+    for (uint32_t k = 0; k < n; k++) {
+        sum += PacketLife<List, LbTag>(k, nhop);
+    }
+    uint64_t deltaMs = time.End();
+    g_sink += sum;
+    uint32_t ops = 3 + nhop * 6 + 1;  // tag operations per packet
+    double ns = deltaMs * 1e6 / std::max((double)n * ops, 1.0);
+    double ps = n;
+    ps *= 1000;
+    ps /= std::max(deltaMs, (uint64_t)1);
+    std::cout << ps << " packets/s, " << ns << " ns/tag op, " << g_peakBytes
+              << " tag bytes/packet (" << deltaMs << " ms elapsed)\t" << name << ", " << lb
+              << ", " << nhop << " hops" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t n = 0;
+    while (argc > 0) {
+        if (strncmp("--n=", argv[0], strlen("--n=")) == 0) {
+            char const *nAscii = argv[0] + strlen("--n=");
+            std::istringstream iss;
+            iss.str(nAscii);
+            iss >> n;
+        }
+        argc--;
+        argv++;
+    }
+    if (n == 0) {
+        std::cerr << "Error-- number of packets must be specified "
+                  << "by command-line argument --n=(number of packets)" << std::endl;
+        exit(1);
+    }
+    std::cout << "Running bench-packet-tags with n=" << n << std::endl;
+
+    const uint32_t paths[2] = {3, 5};  // 2-tier leaf-spine, 3-tier fat-tree
+    for (uint32_t p = 0; p < 2; p++) {
+        CheckEquivalence<CongaLbTag>(paths[p]);
+        CheckEquivalence<CwLbTag>(paths[p]);
+        RunBench<LegacyTagList, CongaLbTag>(n, paths[p], "512B tag nodes", "CONGA");
+        RunBench<PacketTagList, CongaLbTag>(n, paths[p], "Tag blocks", "CONGA");
+        RunBench<LegacyTagList, CwLbTag>(n, paths[p], "512B tag nodes", "ConWeave");
+        RunBench<PacketTagList, CwLbTag>(n, paths[p], "Tag blocks", "ConWeave");
+    }
+    return 0;
+}
@@ -0,0 +1,195 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2023 NUS
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Per-packet costs of the switch and the driver outside the event loop: the MMU admission
+// cycle of a packet through a 16-port switch under incast (ingress/egress admission and
+// update on arrival, PFC pause classes, then release, ECN marking and resume on dequeue),
+// with the static and the dynamic threshold, and the writing of the FCT and PFC traces in
+// the formats of scratch/network-load-balance.cc (one fflush per record, as the driver does,
+// and buffered). With --json=FILE the results are also written as one JSON object; `waf
+// bench' runs this next to the simulations.
+
+#include <stdio.h>
+#include <stdlib.h>  // for exit ()
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/switch-mmu.h"
+#include "ns3/system-wall-clock-ms.h"
+
+using namespace ns3;
+
+static const uint32_t kNPort = 16;
+static const uint32_t kPktSize = 1048;                // SwitchMmu::MTU
+static const uint32_t kBufferSize = 9 * 1024 * 1024;  // BUFFER_SIZE 9
+static const uint32_t kHeadroom = 2 * 12500 + 2 * kPktSize;  // 100G links of 1 us
+static const uint32_t kDepth = 4000;  // standing queue of the incast, in packets
+
+struct Result {
+    std::string name;
+    double value;
+};
+static std::vector<Result> g_results;
+static uint64_t g_sink;
+
+static void Report(const std::string &name, double value, const char *unit, uint64_t deltaMs,
+                   const std::string &what) {
+    Result r = {name, value};
+    g_results.push_back(r);
+    std::cout << value << " " << unit << " (" << deltaMs << " ms elapsed)\t" << what << std::endl;
+}
+
+static Ptr<SwitchMmu> MakeMmu(bool dynamic) {
+    Ptr<SwitchMmu> mmu = CreateObject<SwitchMmu>();
+    mmu->SetDynamicThreshold(dynamic);
+    for (uint32_t j = 1; j <= kNPort; j++) {
+        mmu->ConfigEcn(j, 100, 400, 0.2);  // KMIN/KMAX/PMAX_MAP of 100G
+        mmu->ConfigHdrm(j, kHeadroom);
+    }
+    mmu->ConfigNPort(kNPort);
+    mmu->ConfigBufferSize(kBufferSize);
+    return mmu;
+}
+
+// packets from ports 2..kNPort to port 1, queue 3, dequeued once kDepth packets are queued
+static void BenchMmu(uint32_t n, bool dynamic) {
+    Ptr<SwitchMmu> mmu = MakeMmu(dynamic);
+    const uint32_t qIndex = 3, outDev = 1;
+    std::deque<uint32_t> queue;  // ingress port of each queued packet
+    uint64_t admitted = 0, pauses = 0, marks = 0;
+    bool pClasses[SwitchMmu::qCnt];
+    SystemWallClockMs time;
+    time.Start();
+    for (uint32_t k = 0; k < n; k++) {
+        uint32_t inDev = 2 + k % (kNPort - 1);
+        if (mmu->CheckEgressAdmission(outDev, qIndex, kPktSize) &&
+            mmu->CheckIngressAdmission(inDev, qIndex, kPktSize)) {
+            mmu->UpdateIngressAdmission(inDev, qIndex, kPktSize);
+            mmu->UpdateEgressAdmission(outDev, qIndex, kPktSize);
+            memset(pClasses, 0, sizeof(pClasses));
+            mmu->GetPauseClasses(inDev, qIndex, pClasses);
+            pauses += pClasses[qIndex];
+            queue.push_back(inDev);
+            admitted++;
+        }
+        if (queue.size() > kDepth || (k % 4 == 0 && !queue.empty())) {
+            uint32_t from = queue.front();
+            queue.pop_front();
+            mmu->RemoveFromIngressAdmission(from, qIndex, kPktSize);
+            mmu->RemoveFromEgressAdmission(outDev, qIndex, kPktSize);
+            marks += mmu->ShouldSendCN(outDev, qIndex);
+            g_sink += mmu->GetResumeClasses(from, qIndex);
+        }
+    }
+    uint64_t deltaMs = time.End();
+    g_sink += admitted + pauses + marks;
+    const char *name = dynamic ? "mmu_dynamic_ns_per_pkt" : "mmu_static_ns_per_pkt";
+    std::ostringstream what;
+    what << "MMU admission, " << (dynamic ? "dynamic" : "static") << " threshold ("
+         << admitted * 100 / std::max(n, 1u) << "% admitted, " << pauses << " pauses, " << marks
+         << " ECN marks)";
+    Report(name, deltaMs * 1e6 / std::max(n, 1u), "ns/packet", deltaMs, what.str());
+}
+
+// FCT records as written by qp_finish, and PFC records as written by get_pfc
+static void BenchTrace(uint32_t n, bool flush) {
+    char path[] = "/tmp/bench-rdma-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        std::cerr << "Error-- cannot create a temporary file" << std::endl;
+        exit(1);
+    }
+    FILE *fout = fdopen(fd, "w");
+    SystemWallClockMs time;
+    time.Start();
+    for (uint32_t k = 0; k < n; k++) {
+        uint64_t start = 2000000000lu + k * 137lu;
+        if (k % 8 == 0) {
+            fprintf(fout, "%lu %u %u %u %u\n", start, 128 + k % 16, 1, 1 + k % 16, k % 2);
+        } else {
+            fprintf(fout, "%u %u %u %u %lu %lu %lu %lu\n", k % 128, (k * 7) % 128,
+                    10000 + k % 50000, 100, (uint64_t)(k % 1000) * 1000 + 1000, start,
+                    (uint64_t)8000 + k % 100000, (uint64_t)8000);
+        }
+        if (flush) fflush(fout);
+    }
+    fflush(fout);
+    long bytes = ftell(fout);
+    fclose(fout);
+    uint64_t deltaMs = time.End();
+    unlink(path);
+    double rs = n * 1000.0 / std::max(deltaMs, (uint64_t)1);
+    std::ostringstream what;
+    what << "FCT/PFC trace records, " << (flush ? "fflush per record" : "buffered") << ", "
+         << bytes / std::max(n, 1u) << " bytes/record";
+    Report(flush ? "trace_flushed_records_per_s" : "trace_buffered_records_per_s", rs,
+           "records/s", deltaMs, what.str());
+}
+
+static void WriteJson(const std::string &file, uint32_t n) {
+    FILE *f = fopen(file.c_str(), "w");
+    if (f == NULL) {
+        std::cerr << "Error-- cannot write " << file << std::endl;
+        exit(1);
+    }
+    fprintf(f, "{\"n\": %u", n);
+    for (size_t i = 0; i < g_results.size(); i++) {
+        fprintf(f, ", \"%s\": %.3f", g_results[i].name.c_str(), g_results[i].value);
+    }
+    fprintf(f, "}\n");
+    fclose(f);
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t n = 0;
+    std::string json;
+    while (argc > 0) {
+        if (strncmp("--n=", argv[0], strlen("--n=")) == 0) {
+            char const *nAscii = argv[0] + strlen("--n=");
+            std::istringstream iss;
+            iss.str(nAscii);
+            iss >> n;
+        } else if (strncmp("--json=", argv[0], strlen("--json=")) == 0) {
+            json = argv[0] + strlen("--json=");
+        }
+        argc--;
+        argv++;
+    }
+    if (n == 0) {
+        std::cerr << "Error-- number of packets must be specified "
+                  << "by command-line argument --n=(number of packets)" << std::endl;
+        exit(1);
+    }
+    std::cout << "Running bench-rdma with n=" << n << std::endl;
+
+    BenchMmu(n, false);
+    BenchMmu(n, true);
+    BenchTrace(n / 10, true);
+    BenchTrace(n / 10, false);
+    if (!json.empty()) {
+        WriteJson(json, n);
+    }
+    return g_sink == 0xdeadbeef;
+}